@@ -98,8 +98,15 @@
 #import "WebActionController.h"
 #import "WebRequest.h"
 #import "WebResponse.h"
+#import "WebDeferredResponse.h"
+#import "WebStreamingResponse.h"
+#import "WebRequestArena.h"
+#import "WebTaskGroup.h"
 #import "WebLayoutView.h"
 #import "WebActionView.h"
+#import "WebTemplateRegistry.h"
+#import "WebFragmentCache.h"
+#import "WebTemplateEnginePool.h"
 #import "WebComponent.h"
 
 #import "WebSession+User.h"
@@ -130,7 +137,9 @@
 #import "MemcachedConnector.h"
 #import "MGTemplateMarker.h"
 #import "AGRegexTemplateMatcher.h"
+#import "WKScanningTemplateMatcher.h"
 #import "DDXML.h"
+#import "WKXmlParser.h"
 #import "JSON.h"
 
 //Templating Filters and Functions
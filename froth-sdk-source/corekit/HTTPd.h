@@ -65,6 +65,11 @@
 	
 	NSThread* httpdThread;
 	NSMutableArray* workerTheadPool;
+	
+	//Deferred responses are completed on other threads, and sent from the event loop when it is woken up.
+	NSMutableArray* m_completedRequests;
+	int m_wakeupPipe[2];
+	struct event* m_wakeupEvent;
 }
 
 - (id)initWithAddress:(NSString*)ip port:(int)port application:(WebApplication*)webApp;
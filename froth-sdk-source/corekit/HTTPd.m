@@ -10,9 +10,79 @@
 #import "WebRequest+HTTPd.h"
 #import "WebApplication.h"
 #import "WebResponse.h"
+#import "WebRequestArena.h"
+#import "WebDeferredResponse.h"
+
+#import <event.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 BOOL kLibEventInitalized;
 
+@class HTTPdParkedRequest;
+
+@interface HTTPd (Private)
+- (void)_addRequest:(HTTPdParkedRequest*)parked;
+- (void)_removeRequest:(HTTPdParkedRequest*)parked;
+- (void)_deferredRequestCompleted:(HTTPdParkedRequest*)parked;
+- (void)_sendCompletedRequests;
+@end
+
+/* 
+	Continuation for a deferred response, forwards the completed request to the server's event loop. Parked requests are
+	kept by the server until sent, or until libevent closes the connection and frees the evhttp request.
+ */
+@interface HTTPdParkedRequest : NSObject {
+	HTTPd* m_server;
+	WebMutableRequest* m_request;
+	BOOL m_closed;
+}
+- (id)initWithServer:(HTTPd*)server request:(WebMutableRequest*)request;
+- (WebMutableRequest*)request;
+- (BOOL)isClosed;
+- (void)connectionClosed;
+- (void)deferredResponseCompleted:(WebResponse*)response;
+@end
+
+@implementation HTTPdParkedRequest
+
+- (id)initWithServer:(HTTPd*)server request:(WebMutableRequest*)request {
+	if(self = [super init]) {
+		m_server = server;
+		m_request = [request retain];
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_request release];
+	[super dealloc];
+}
+
+- (WebMutableRequest*)request {
+	return m_request;
+}
+
+- (BOOL)isClosed {
+	return m_closed;
+}
+
+//Called from the event loop, the evhttp request is freed after this returns.
+- (void)connectionClosed {
+	m_closed = YES;
+	[m_request setInternalRequestPointer:NULL];
+	[m_request setConnectionClosed:YES];
+	
+	[[self retain] autorelease];
+	[m_server _removeRequest:self];
+}
+
+- (void)deferredResponseCompleted:(WebResponse*)response {
+	[m_server _deferredRequestCompleted:self];
+}
+
+@end
+
 @implementation HTTPd
 
 - (id)initWithAddress:(NSString*)anIp port:(int)aPort application:(WebApplication*)theWebApp {
@@ -23,6 +93,8 @@ BOOL kLibEventInitalized;
 		}
 		
 		hangingRequests = [[NSMutableArray alloc] init];
+		m_completedRequests = [[NSMutableArray alloc] init];
+		m_wakeupPipe[0] = m_wakeupPipe[1] = -1;
 		webApp = theWebApp;
 		
 		ip = [anIp retain];
@@ -40,6 +112,11 @@ BOOL kLibEventInitalized;
 	
 	[ip release], ip = nil;
 	[hangingRequests release], hangingRequests = nil;
+	[m_completedRequests release], m_completedRequests = nil;
+	
+	if(m_wakeupEvent) event_free(m_wakeupEvent);
+	if(m_wakeupPipe[0] >= 0) close(m_wakeupPipe[0]);
+	if(m_wakeupPipe[1] >= 0) close(m_wakeupPipe[1]);
 	[super dealloc];
 }
 
@@ -50,6 +127,9 @@ BOOL kLibEventInitalized;
 - (void)sendResponseForRequest:(WebRequest*)request {
 	WebResponse* response = [request response];
 	struct evhttp_request* req = [request internalRequestPointer];
+	if(!req) {
+		return;
+	}
 	
 	//Add in headers
 	struct evkeyvalq * evheaders = evhttp_request_get_output_headers(req);
@@ -80,38 +160,108 @@ BOOL kLibEventInitalized;
 	evbuffer_free(obuff);	
 }
 
-- (void)_addRequest:(WebRequest*)req {
+- (void)_addRequest:(HTTPdParkedRequest*)parked {
 	@synchronized(hangingRequests) {
-		[hangingRequests addObject:req];
+		[hangingRequests addObject:parked];
 	}
 }
 
-- (void)_removeRequest:(WebRequest*)req {
+- (void)_removeRequest:(HTTPdParkedRequest*)parked {
 	@synchronized(hangingRequests) {
-		[hangingRequests removeObject:req];
+		[hangingRequests removeObjectIdenticalTo:parked];
+	}
+}
+
+//Called on the thread that completed the deferred response, evhttp may only be used from the event loop.
+- (void)_deferredRequestCompleted:(HTTPdParkedRequest*)parked {
+	@synchronized(m_completedRequests) {
+		[m_completedRequests addObject:parked];
+	}
+	
+	char wake = 1;
+	write(m_wakeupPipe[1], &wake, 1);
+}
+
+- (void)_sendCompletedRequests {
+	NSArray* completed = nil;
+	@synchronized(m_completedRequests) {
+		completed = [NSArray arrayWithArray:m_completedRequests];
+		[m_completedRequests removeAllObjects];
+	}
+	
+	//Requests whose connection closed while the response was pending are dropped
+	for(HTTPdParkedRequest* parked in completed) {
+		if(![parked isClosed]) {
+			struct evhttp_request* req = [[parked request] internalRequestPointer];
+			evhttp_connection_set_closecb(evhttp_request_get_connection(req), NULL, NULL);
+			[self sendResponseForRequest:[parked request]];
+		}
+		[self _removeRequest:parked];
 	}
 }
 
 #pragma mark -
 #pragma mark evhttp
 
+void handleWakeup(evutil_socket_t fd, short what, void* arg) {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	
+	char buf[64];
+	while(read(fd, buf, sizeof(buf)) > 0);
+	
+	[(HTTPd*)arg _sendCompletedRequests];
+	
+	[pool drain];
+}
+
+//The client disconnected or the request timed out while parked, libevent frees the request after this returns.
+void handleParkedConnectionClosed(struct evhttp_connection* connection, void* arg) {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	
+	HTTPdParkedRequest* parked = (HTTPdParkedRequest*)arg;
+	evhttp_connection_set_closecb(connection, NULL, NULL);
+	[parked connectionClosed];
+	
+	[pool drain];
+}
+
 void handleRequest(struct evhttp_request* req, void*arg) {
 	id self = arg;
 	
+	//Scratch buffers for decoding the request come from the arena
+	[WebRequestArena beginRequest];
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	
 	WebMutableRequest* request = [[WebMutableRequest alloc] initWithEVhttp:req];	
 	static SEL kHandlerMethod;
 	if(!kHandlerMethod) {
 		kHandlerMethod = @selector(asyncProcessRequest:);
 	}
 	
-	[[self webApp] handle:request];
-	[self sendResponseForRequest:request];
+	WebResponse* response = [[self webApp] handle:request];
+	if([response isKindOfClass:[WebDeferredResponse class]]) {
+		//Keep the evhttp request open, its sent from the event loop once the response completes.
+		HTTPdParkedRequest* parked = [[HTTPdParkedRequest alloc] initWithServer:self request:request];
+		[self _addRequest:parked];
+		evhttp_connection_set_closecb(evhttp_request_get_connection(req), handleParkedConnectionClosed, parked);
+		
+		[(WebDeferredResponse*)response setContinuationTarget:parked selector:@selector(deferredResponseCompleted:)];
+		[parked release];
+	} else {
+		[self sendResponseForRequest:request];
+	}
 	[request release];
+	
+	[pool drain];
+	[WebRequestArena endRequest];
 }
 
 - (void)start {
 	NSLog(@"++starting HTTPd on port:%i\n", port);
 	
+	//Load templates before the first request is accepted
+	[webApp warmUp];
+	
 	int err;
 	httpd = evhttp_new(evbase);
 	if((err = evhttp_bind_socket(httpd, [ip UTF8String], port)) < 0) {
@@ -119,6 +269,16 @@ void handleRequest(struct evhttp_request* req, void*arg) {
 		return;
 	}
 	
+	//Wakes the event loop to send deferred responses
+	if(pipe(m_wakeupPipe) == 0) {
+		fcntl(m_wakeupPipe[0], F_SETFL, O_NONBLOCK);
+		fcntl(m_wakeupPipe[1], F_SETFL, O_NONBLOCK);
+		m_wakeupEvent = event_new(evbase, m_wakeupPipe[0], EV_READ|EV_PERSIST, handleWakeup, self);
+		event_add(m_wakeupEvent, NULL);
+	} else {
+		NSLog(@"[[ERROR]] HTTPd unable to create wakeup pipe, deferred responses will not be sent");
+	}
+	
 	//Set a callback for all requests. We could have a callback per path with evhttp_set_cb..
 	evhttp_set_gencb(httpd, handleRequest, self);
 	evhttp_set_timeout(httpd, 5);
@@ -47,4 +47,8 @@
 #import "SBJSON.h"
 #import "NSObject+SBJSON.h"
 #import "NSString+SBJSON.h"
+#import "NSData+SBJSON.h"
+#import "WKJsonParser.h"
+#import "WKJsonStreamParser.h"
+#import "WKJsonWriter.h"
 
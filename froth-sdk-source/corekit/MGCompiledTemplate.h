@@ -0,0 +1,120 @@
+//
+//  MGCompiledTemplate.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "MGTemplateEscaping.h"
+
+@class MGTemplateEngine;
+@class MGVariablePath;
+
+/*!
+	\brief	A template parsed once by an MGTemplateEngine matcher, so it can be rendered many times without re-scanning its text.
+ 
+	The compiled template keeps each marker found by the matcher (the same dictionaries -firstMarkerWithinRange: returns)
+	ordered by location, together with the literal text between them. When rendering, the engine finds the next marker 
+	with a binary search from its remaining range instead of running the matcher, so markers that move the remaining range 
+	(ie for loops) keep working unchanged.
+ 
+	Compiled templates are immutable and can be shared between engines and threads. They are only valid for engines with the
+	same delimiters as the engine that compiled them (see -matchesDelimitersOfEngine:).
+ 
+	\code
+	MGCompiledTemplate* compiled = [engine compileTemplate:templateString];
+	NSString* result = [engine processCompiledTemplate:compiled withVariables:variables];
+	\endcode
+ */
+@interface MGCompiledTemplate : NSObject {
+	NSString* m_templateContents;
+	NSArray* m_markers;
+	NSArray* m_literals;
+	NSArray* m_UTF8Literals;
+	NSRange* m_ranges;
+	NSUInteger m_count;
+	NSArray* m_delimiters;
+	NSArray* m_variablePaths;
+	MGTemplateEscapeContext* m_HTMLEscapeContexts;
+}
+
+/*! \brief Used by MGTemplateEngine -compileTemplate:, markers must be in template order. */
+- (id)initWithTemplate:(NSString*)templateString markers:(NSArray*)markers delimiters:(NSArray*)delimiters;
+
+/*! 
+	\brief	Recreates a compiled template from -archivedMarkers without running a matcher. 
+			Returns nil if the archive is malformed or was not made from templateString.
+ */
+- (id)initWithTemplate:(NSString*)templateString archivedMarkers:(NSData*)archive;
+
+/*! \brief The delimiters and markers serialized in a compact binary form, the template itself is not included. */
+- (NSData*)archivedMarkers;
+
+/*! \brief The source of the template. */
+- (NSString*)templateContents;
+
+/*! \brief The number of markers and expressions in the template. */
+- (NSUInteger)markerCount;
+
+/*! \brief The marker dictionary (see MARKER_*_KEY) at index. */
+- (NSDictionary*)markerAtIndex:(NSUInteger)index;
+
+/*! \brief The variable path of the expression at index, split at compile time (nil for markers). */
+- (MGVariablePath*)variablePathOfMarkerAtIndex:(NSUInteger)index;
+
+/*! 
+	\brief	The escape context of the expression at index when the template is html, found from the html structure of 
+			the template's text when it is compiled (see MGTemplateHTMLScanner).
+ */
+- (MGTemplateEscapeContext)HTMLEscapeContextOfMarkerAtIndex:(NSUInteger)index;
+
+/*! \brief The range of the marker at index in the template. */
+- (NSRange)rangeOfMarkerAtIndex:(NSUInteger)index;
+
+/*! \brief The index of the first marker that starts at or after location, or NSNotFound. */
+- (NSUInteger)indexOfFirstMarkerFromLocation:(NSUInteger)location;
+
+/*! 
+	\brief	The text before the marker at index, back to the end of the previous marker (or the start of the template). 
+			Index markerCount is the text after the last marker.
+ */
+- (NSString*)literalBeforeMarkerAtIndex:(NSUInteger)index;
+
+/*! \brief The literal before the marker at index, encoded once as utf8 for rendering into data. */
+- (NSData*)UTF8LiteralBeforeMarkerAtIndex:(NSUInteger)index;
+
+/*! \brief The location the literal before the marker at index starts. */
+- (NSUInteger)locationOfLiteralBeforeMarkerAtIndex:(NSUInteger)index;
+
+/*! \brief The delimiters the template was compiled with. */
+- (NSArray*)delimiters;
+
+/*! \brief If the template was compiled with the same delimiters as engine currently uses. */
+- (BOOL)matchesDelimitersOfEngine:(MGTemplateEngine*)engine;
+
+@end
+
+/*! \brief The delimiters of engine, as compared by -matchesDelimitersOfEngine: */
+NSArray* MGCompiledTemplateDelimitersForEngine(MGTemplateEngine* engine);
@@ -0,0 +1,313 @@
+//
+//  MGCompiledTemplate.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "MGCompiledTemplate.h"
+#import "MGTemplateEngine.h"
+
+#include <arpa/inet.h>
+
+#define kArchiveNilLength	0xFFFFFFFF
+
+/*
+	Archived markers are the delimiters followed by each marker's range, type, name, arguments, filter and filter arguments.
+	Numbers are 32bit in network order, strings are a byte length followed by utf8 (kArchiveNilLength for nil) and arrays 
+	are a count followed by their strings.
+ */
+static void archiveAppendUInt32(NSMutableData* data, uint32_t value) {
+	uint32_t v = htonl(value);
+	[data appendBytes:&v length:sizeof(v)];
+}
+
+static void archiveAppendString(NSMutableData* data, NSString* string) {
+	if(!string) {
+		archiveAppendUInt32(data, kArchiveNilLength);
+		return;
+	}
+	const char* utf8 = [string UTF8String];
+	uint32_t length = (uint32_t)strlen(utf8);
+	archiveAppendUInt32(data, length);
+	[data appendBytes:utf8 length:length];
+}
+
+static void archiveAppendStrings(NSMutableData* data, NSArray* strings) {
+	if(!strings) {
+		archiveAppendUInt32(data, kArchiveNilLength);
+		return;
+	}
+	archiveAppendUInt32(data, (uint32_t)[strings count]);
+	for(NSString* string in strings) {
+		archiveAppendString(data, string);
+	}
+}
+
+typedef struct {
+	const uint8_t* bytes;
+	const uint8_t* end;
+} ArchiveReader;
+
+static BOOL archiveReadUInt32(ArchiveReader* reader, uint32_t* value) {
+	if(reader->end - reader->bytes < (ptrdiff_t)sizeof(uint32_t)) return NO;
+	uint32_t v;
+	memcpy(&v, reader->bytes, sizeof(v));
+	*value = ntohl(v);
+	reader->bytes += sizeof(v);
+	return YES;
+}
+
+static BOOL archiveReadString(ArchiveReader* reader, NSString** string) {
+	uint32_t length;
+	if(!archiveReadUInt32(reader, &length)) return NO;
+	if(length == kArchiveNilLength) {
+		*string = nil;
+		return YES;
+	}
+	if(reader->end - reader->bytes < (ptrdiff_t)length) return NO;
+	*string = [[[NSString alloc] initWithBytes:reader->bytes length:length encoding:NSUTF8StringEncoding] autorelease];
+	reader->bytes += length;
+	return (*string != nil);
+}
+
+static BOOL archiveReadStrings(ArchiveReader* reader, NSArray** strings) {
+	uint32_t count;
+	if(!archiveReadUInt32(reader, &count)) return NO;
+	if(count == kArchiveNilLength) {
+		*strings = nil;
+		return YES;
+	}
+	NSMutableArray* array = [NSMutableArray arrayWithCapacity:count];
+	for(uint32_t i=0; i<count; i++) {
+		NSString* string;
+		if(!archiveReadString(reader, &string) || !string) return NO;
+		[array addObject:string];
+	}
+	*strings = array;
+	return YES;
+}
+
+static void setIfPresent(NSMutableDictionary* dict, id value, NSString* key) {
+	if(value) {
+		[dict setObject:value forKey:key];
+	}
+}
+
+NSArray* MGCompiledTemplateDelimitersForEngine(MGTemplateEngine* engine) {
+	return [NSArray arrayWithObjects:engine.markerStartDelimiter, engine.markerEndDelimiter, 
+			engine.expressionStartDelimiter, engine.expressionEndDelimiter, engine.filterDelimiter, nil];
+}
+
+@implementation MGCompiledTemplate
+
+- (id)initWithTemplate:(NSString*)templateString markers:(NSArray*)markers delimiters:(NSArray*)delimiters {
+	if(self = [super init]) {
+		m_templateContents = [templateString copy];
+		m_markers = [markers copy];
+		m_delimiters = [delimiters copy];
+		m_count = [m_markers count];
+		
+		m_ranges = malloc(sizeof(NSRange) * (m_count + 1));
+		NSMutableArray* literals = [[NSMutableArray alloc] initWithCapacity:m_count + 1];
+		
+		NSUInteger location = 0;
+		for(NSUInteger i=0; i<m_count; i++) {
+			NSRange range = [[[m_markers objectAtIndex:i] objectForKey:MARKER_RANGE_KEY] rangeValue];
+			m_ranges[i] = range;
+			
+			[literals addObject:[m_templateContents substringWithRange:NSMakeRange(location, range.location - location)]];
+			location = NSMaxRange(range);
+		}
+		[literals addObject:[m_templateContents substringFromIndex:location]];
+		
+		m_literals = literals;
+		
+		NSMutableArray* UTF8Literals = [[NSMutableArray alloc] initWithCapacity:m_count + 1];
+		for(NSString* literal in m_literals) {
+			[UTF8Literals addObject:[literal dataUsingEncoding:NSUTF8StringEncoding]];
+		}
+		m_UTF8Literals = UTF8Literals;
+		
+		NSMutableArray* variablePaths = [[NSMutableArray alloc] initWithCapacity:m_count];
+		for(NSDictionary* marker in m_markers) {
+			NSString* name = [marker objectForKey:MARKER_NAME_KEY];
+			if(name && [[marker objectForKey:MARKER_TYPE_KEY] isEqualToString:MARKER_TYPE_EXPRESSION]) {
+				[variablePaths addObject:[MGVariablePath pathWithString:name]];
+			} else {
+				[variablePaths addObject:[NSNull null]];
+			}
+		}
+		m_variablePaths = variablePaths;
+		
+		MGTemplateHTMLScanner scanner;
+		MGTemplateHTMLScannerInit(&scanner);
+		m_HTMLEscapeContexts = malloc(sizeof(MGTemplateEscapeContext) * (m_count + 1));
+		for(NSUInteger i=0; i<m_count; i++) {
+			MGTemplateHTMLScannerScanLiteral(&scanner, [m_literals objectAtIndex:i]);
+			
+			NSDictionary* marker = [m_markers objectAtIndex:i];
+			if([[marker objectForKey:MARKER_TYPE_KEY] isEqualToString:MARKER_TYPE_EXPRESSION]) {
+				m_HTMLEscapeContexts[i] = MGTemplateHTMLScannerExpression(&scanner);
+			} else {
+				m_HTMLEscapeContexts[i] = MGTemplateEscapeNone;
+			}
+		}
+	}
+	return self;
+}
+
+- (id)initWithTemplate:(NSString*)templateString archivedMarkers:(NSData*)archive {
+	ArchiveReader reader = { [archive bytes], (const uint8_t*)[archive bytes] + [archive length] };
+	NSUInteger templateLength = [templateString length];
+	
+	NSArray* delimiters = nil;
+	uint32_t count;
+	if(!archiveReadStrings(&reader, &delimiters) || !delimiters || !archiveReadUInt32(&reader, &count)) {
+		[self release];
+		return nil;
+	}
+	
+	NSMutableArray* markers = [NSMutableArray arrayWithCapacity:count];
+	NSUInteger previousEnd = 0;
+	for(uint32_t i=0; i<count; i++) {
+		uint32_t location, length;
+		NSString* type, *name, *filter;
+		NSArray* args, *filterArgs;
+		if(!archiveReadUInt32(&reader, &location) || !archiveReadUInt32(&reader, &length) ||
+		   !archiveReadString(&reader, &type) || !archiveReadString(&reader, &name) || !archiveReadStrings(&reader, &args) ||
+		   !archiveReadString(&reader, &filter) || !archiveReadStrings(&reader, &filterArgs)) {
+			[self release];
+			return nil;
+		}
+		
+		//Markers are in order and must lie within the template
+		if(location < previousEnd || (NSUInteger)location + length > templateLength) {
+			[self release];
+			return nil;
+		}
+		previousEnd = location + length;
+		
+		NSMutableDictionary* marker = [[NSMutableDictionary alloc] initWithCapacity:6];
+		[marker setObject:[NSValue valueWithRange:NSMakeRange(location, length)] forKey:MARKER_RANGE_KEY];
+		setIfPresent(marker, type, MARKER_TYPE_KEY);
+		setIfPresent(marker, name, MARKER_NAME_KEY);
+		setIfPresent(marker, args, MARKER_ARGUMENTS_KEY);
+		setIfPresent(marker, filter, MARKER_FILTER_KEY);
+		setIfPresent(marker, filterArgs, MARKER_FILTER_ARGUMENTS_KEY);
+		[markers addObject:marker];
+		[marker release];
+	}
+	
+	return [self initWithTemplate:templateString markers:markers delimiters:delimiters];
+}
+
+- (NSData*)archivedMarkers {
+	NSMutableData* data = [NSMutableData dataWithCapacity:m_count * 32 + 64];
+	archiveAppendStrings(data, m_delimiters);
+	archiveAppendUInt32(data, (uint32_t)m_count);
+	for(NSUInteger i=0; i<m_count; i++) {
+		NSDictionary* marker = [m_markers objectAtIndex:i];
+		archiveAppendUInt32(data, (uint32_t)m_ranges[i].location);
+		archiveAppendUInt32(data, (uint32_t)m_ranges[i].length);
+		archiveAppendString(data, [marker objectForKey:MARKER_TYPE_KEY]);
+		archiveAppendString(data, [marker objectForKey:MARKER_NAME_KEY]);
+		archiveAppendStrings(data, [marker objectForKey:MARKER_ARGUMENTS_KEY]);
+		archiveAppendString(data, [marker objectForKey:MARKER_FILTER_KEY]);
+		archiveAppendStrings(data, [marker objectForKey:MARKER_FILTER_ARGUMENTS_KEY]);
+	}
+	return data;
+}
+
+- (void)dealloc {
+	[m_templateContents release];
+	[m_markers release];
+	[m_literals release];
+	[m_UTF8Literals release];
+	[m_variablePaths release];
+	[m_delimiters release];
+	free(m_ranges);
+	free(m_HTMLEscapeContexts);
+	[super dealloc];
+}
+
+- (NSString*)templateContents {
+	return m_templateContents;
+}
+
+- (NSUInteger)markerCount {
+	return m_count;
+}
+
+- (NSDictionary*)markerAtIndex:(NSUInteger)index {
+	return [m_markers objectAtIndex:index];
+}
+
+- (MGVariablePath*)variablePathOfMarkerAtIndex:(NSUInteger)index {
+	id path = [m_variablePaths objectAtIndex:index];
+	return (path == [NSNull null]) ? nil : path;
+}
+
+- (MGTemplateEscapeContext)HTMLEscapeContextOfMarkerAtIndex:(NSUInteger)index {
+	return m_HTMLEscapeContexts[index];
+}
+
+- (NSRange)rangeOfMarkerAtIndex:(NSUInteger)index {
+	return m_ranges[index];
+}
+
+- (NSUInteger)indexOfFirstMarkerFromLocation:(NSUInteger)location {
+	NSUInteger low = 0, high = m_count;
+	while(low < high) {
+		NSUInteger mid = low + (high - low) / 2;
+		if(m_ranges[mid].location < location) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return (low < m_count) ? low : NSNotFound;
+}
+
+- (NSString*)literalBeforeMarkerAtIndex:(NSUInteger)index {
+	return [m_literals objectAtIndex:index];
+}
+
+- (NSData*)UTF8LiteralBeforeMarkerAtIndex:(NSUInteger)index {
+	return [m_UTF8Literals objectAtIndex:index];
+}
+
+- (NSUInteger)locationOfLiteralBeforeMarkerAtIndex:(NSUInteger)index {
+	return (index == 0) ? 0 : NSMaxRange(m_ranges[index-1]);
+}
+
+- (NSArray*)delimiters {
+	return m_delimiters;
+}
+
+- (BOOL)matchesDelimitersOfEngine:(MGTemplateEngine*)engine {
+	return [m_delimiters isEqualToArray:MGCompiledTemplateDelimitersForEngine(engine)];
+}
+
+@end
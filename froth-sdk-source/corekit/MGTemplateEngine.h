@@ -38,6 +38,9 @@
 #define MARKER_FILTER_ARGUMENTS_KEY		@"filterArgs"		// NSArray of filter arguments, if any
 #define MARKER_RANGE_KEY				@"range"			// NSRange (as NSValue) of marker's range
 
+// Filter that outputs an expression's value without autoescaping, e.g. {{ post.body | raw }}
+#define RAW_FILTER						@"raw"
+
 @protocol MGTemplateEngineMatcher
 @required
 - (id)initWithTemplateEngine:(MGTemplateEngine *)engine;
@@ -45,8 +48,33 @@
 - (NSDictionary *)firstMarkerWithinRange:(NSRange)range;
 @end
 
+// Receives streamed utf8 output. Flush asks for what has been written so far to be sent on (ie to the client).
+@protocol MGTemplateOutputSink
+@required
+- (void)writeUTF8Bytes:(const void *)bytes length:(NSUInteger)length;
+- (void)flush;
+@end
+
+// A variable value that renders itself, ie a nested template. When the engine is streaming the value renders straight 
+// into the engine's sink (after what came before it has been flushed), otherwise its rendered data is output.
+@protocol MGTemplateRenderable
+@required
+- (void)renderToSink:(id <MGTemplateOutputSink>)sink;
+- (NSData *)renderedUTF8Data;
+@end
+
+// A store for rendered fragments, used by the cache marker. Fragments are utf8 data, the name is the fragment's key 
+// as written in the template (before variables are substituted) and may be used to group statistics.
+@protocol MGTemplateFragmentCache
+@required
+- (NSData *)fragmentForKey:(NSString *)key name:(NSString *)name;
+- (void)setFragment:(NSData *)fragment forKey:(NSString *)key name:(NSString *)name lifetime:(NSTimeInterval)seconds;
+@end
+
 #import "MGTemplateMarker.h"
 #import "MGTemplateFilter.h"
+#import "MGCompiledTemplate.h"
+#import "MGVariablePath.h"
 
 @interface MGTemplateEngine : NSObject {
 @public
@@ -65,7 +93,11 @@
 	NSMutableDictionary *_filters;
 	NSMutableDictionary *_markers;
 	NSMutableDictionary *_templateVariables;
+	NSMutableDictionary *_variablePaths;
 	BOOL _literal;
+	void *_output;					// current rendering output, only set while processing
+	MGCompiledTemplate *_compiled;	// weak ref, only set while processing a compiled template
+	MGTemplateEscapeContext _autoescape;
 @public
 	NSRange remainingRange;
 	id <MGTemplateEngineDelegate> delegate;
@@ -85,6 +117,12 @@
 @property(retain) id <MGTemplateEngineMatcher> matcher;
 @property(retain, readonly) NSString *templateContents;
 
+// Escapes the values of expressions, default MGTemplateEscapeNone. With MGTemplateEscapeHTML each expression in a compiled 
+// template is escaped for where it is in the html (text, attribute, url, script), any other context applies to all 
+// expressions. Values with the raw filter, NSData and MGTemplateRenderable values (already rendered output) and the 
+// output of markers are not escaped. Reset by -releaseTemplateState.
+@property(assign) MGTemplateEscapeContext autoescape;
+
 // Creation.
 + (NSString *)version;
 + (MGTemplateEngine *)templateEngine;
@@ -100,10 +138,44 @@
 
 // Utilities.
 - (NSObject *)resolveVariable:(NSString *)var;
+- (NSObject *)resolveVariablePath:(MGVariablePath *)path;
 - (NSDictionary *)templateVariables;
+- (NSObject *)applyFilter:(NSString *)filter withArguments:(NSArray *)args onValue:(NSObject *)value; // value unchanged if no such filter
+
+// Fragment caching. The cache is shared by all engines, with no cache set the cache marker renders its block every time.
++ (void)setFragmentCache:(id <MGTemplateFragmentCache>)cache;
++ (id <MGTemplateFragmentCache>)fragmentCache;
+
+// Helpers for block markers, only valid while processing a template. A capture returns the utf8 output rendered 
+// since it began, and holds output back from a sink until it ends (every begin must be ended). The range of a block's 
+// end marker takes nested blocks of the same name into account and has a location of NSNotFound if the block is not 
+// closed. Flushing writes buffered output to the sink and flushes it, if there is a sink and no capture is open.
+- (NSUInteger)beginOutputCapture;
+- (NSData *)endOutputCaptureFromMark:(NSUInteger)mark;
+- (NSRange)rangeOfEndMarker:(NSArray *)endMarkers forBlock:(NSString *)blockName afterRange:(NSRange)markerRange;
+- (void)flushOutput;
 
 // Processing templates.
 - (NSString *)processTemplate:(NSString *)templateString withVariables:(NSDictionary *)variables;
 - (NSString *)processTemplateInFileAtPath:(NSString *)templatePath withVariables:(NSDictionary *)variables;
 
+// Releases the template and variables of the last render, ie before an engine is kept idle for reuse.
+- (void)releaseTemplateState;
+
+// Compiled templates. The matcher is only used to compile, rendering a compiled template does not re-scan its text.
+- (MGCompiledTemplate *)compileTemplate:(NSString *)templateString;
+- (NSString *)processCompiledTemplate:(MGCompiledTemplate *)compiledTemplate withVariables:(NSDictionary *)variables;
+
+// Checks that the blocks of the loaded markers are balanced, returns a description of each problem found (with its line) 
+// or nil. The first of a block's end markers closes it, any others (ie else) continue it. Unknown markers are not checked.
+- (NSArray *)blockErrorsInCompiledTemplate:(MGCompiledTemplate *)compiledTemplate;
+
+// Renders straight into utf8 data. NSData values (ie a rendered action in a layout) are treated as utf8 text in all modes, 
+// and are copied into the output as is.
+- (NSData *)processCompiledTemplateToUTF8Data:(MGCompiledTemplate *)compiledTemplate withVariables:(NSDictionary *)variables;
+
+// Streams utf8 output to a sink, in chunks as the output buffer fills and whenever the template flushes.
+- (void)processCompiledTemplate:(MGCompiledTemplate *)compiledTemplate withVariables:(NSDictionary *)variables 
+						 toSink:(id <MGTemplateOutputSink>)sink;
+
 @end
@@ -27,13 +27,142 @@
 #define GLOBAL_DELIM_EXPR_END		@"expressionEnd"
 #define GLOBAL_DELIM_FILTER			@"filter"
 
+#define OUTPUT_SINK_THRESHOLD		16384	// buffered bytes written to a sink at a time
+
+// Rendering output, either a string or utf8 data.
+typedef struct {
+	NSMutableString *string;
+	NSMutableData *data;
+	id <MGTemplateOutputSink> sink;	// when set, data is a buffer that is written to the sink as it fills
+	NSUInteger flushedLength;		// bytes already written to the sink
+	int captures;					// open captures, the buffer is kept while any are open
+} MGTemplateOutput;
+
+static id <MGTemplateFragmentCache> _fragmentCache = nil;
+
+static void MGTemplateOutputAppendString(MGTemplateOutput *output, NSString *string)
+{
+	if (!string) {
+		return;
+	}
+	if (output->string) {
+		[output->string appendString:string];
+		return;
+	}
+	
+	// Encode in chunks on the stack rather than making an autoreleased copy of each value.
+	char buffer[1024];
+	NSUInteger used = 0;
+	NSRange range = NSMakeRange(0, [string length]);
+	while (range.length > 0) {
+		if (![string getBytes:buffer maxLength:sizeof(buffer) usedLength:&used 
+					 encoding:NSUTF8StringEncoding options:0 range:range remainingRange:&range] || used == 0) {
+			[output->data appendData:[[string substringWithRange:range] dataUsingEncoding:NSUTF8StringEncoding]];
+			break;
+		}
+		[output->data appendBytes:buffer length:used];
+	}
+}
+
+static void MGTemplateOutputWriteToSink(MGTemplateOutput *output)
+{
+	if (!output->sink || output->captures > 0 || [output->data length] == 0) {
+		return;
+	}
+	[output->sink writeUTF8Bytes:[output->data bytes] length:[output->data length]];
+	output->flushedLength += [output->data length];
+	[output->data setLength:0];
+}
+
+static void MGTemplateOutputAppendValue(MGTemplateOutput *output, NSObject *value)
+{
+	if ([value isKindOfClass:[NSString class]]) {
+		MGTemplateOutputAppendString(output, (NSString *)value);
+	} else if ([value isKindOfClass:[NSData class]]) {
+		if (output->data) {
+			[output->data appendData:(NSData *)value];
+		} else {
+			NSString *string = [[NSString alloc] initWithData:(NSData *)value encoding:NSUTF8StringEncoding];
+			MGTemplateOutputAppendString(output, string);
+			[string release];
+		}
+	} else if ([value conformsToProtocol:@protocol(MGTemplateRenderable)]) {
+		if (output->sink && output->captures == 0) {
+			// Send what we have so far (ie the head of a layout) before the value renders into the sink.
+			MGTemplateOutputWriteToSink(output);
+			[output->sink flush];
+			[(id <MGTemplateRenderable>)value renderToSink:output->sink];
+		} else {
+			MGTemplateOutputAppendValue(output, [(id <MGTemplateRenderable>)value renderedUTF8Data]);
+		}
+	} else {
+		MGTemplateOutputAppendString(output, [value description]);
+	}
+}
+
+// Escapes a value for context, data and renderables are already rendered output and are not escaped.
+static void MGTemplateOutputAppendEscapedValue(MGTemplateOutput *output, NSObject *value, MGTemplateEscapeContext context)
+{
+	if (context == MGTemplateEscapeNone || [value isKindOfClass:[NSData class]] || 
+		[value conformsToProtocol:@protocol(MGTemplateRenderable)]) {
+		MGTemplateOutputAppendValue(output, value);
+		return;
+	}
+	
+	NSString *string = ([value isKindOfClass:[NSString class]]) ? (NSString *)value : [value description];
+	if (output->string || MGTemplateEscapeWholeValue(context)) {
+		// Urls are checked and javascript values quoted as a whole.
+		MGTemplateOutputAppendString(output, MGTemplateEscapeString(context, string));
+		return;
+	}
+	
+	// Chunks end on character boundaries, so each can be escaped on its own.
+	char buffer[1024];
+	NSUInteger used = 0;
+	NSRange range = NSMakeRange(0, [string length]);
+	while (range.length > 0) {
+		if (![string getBytes:buffer maxLength:sizeof(buffer) usedLength:&used 
+					 encoding:NSUTF8StringEncoding options:0 range:range remainingRange:&range] || used == 0) {
+			MGTemplateOutputAppendString(output, MGTemplateEscapeString(context, [string substringWithRange:range]));
+			break;
+		}
+		MGTemplateEscapeUTF8(context, buffer, used, output->data);
+	}
+}
+
+static void MGTemplateOutputAppendLiteral(MGTemplateOutput *output, MGCompiledTemplate *compiled, NSUInteger index)
+{
+	if (output->data) {
+		[output->data appendData:[compiled UTF8LiteralBeforeMarkerAtIndex:index]];
+	} else {
+		[output->string appendString:[compiled literalBeforeMarkerAtIndex:index]];
+	}
+}
+
+static NSUInteger MGTemplateLineOfLocation(NSString *string, NSUInteger location)
+{
+	NSUInteger line = 1;
+	NSRange searchRange = NSMakeRange(0, location);
+	NSRange newline;
+	while ((newline = [string rangeOfString:@"\n" options:NSLiteralSearch range:searchRange]).location != NSNotFound) {
+		line++;
+		searchRange.location = NSMaxRange(newline);
+		searchRange.length = location - searchRange.location;
+	}
+	return line;
+}
+
+
 @interface MGTemplateEngine (PrivateMethods)
 
 - (NSObject *)valueForVariable:(NSString *)var parent:(NSObject **)parent parentKey:(NSString **)parentKey;
+- (NSDictionary *)containerForVariableNamed:(NSString *)firstVar;
 - (void)setValue:(NSObject *)newValue forVariable:(NSString *)var forceCurrentStackFrame:(BOOL)inStackFrame;
 - (void)reportError:(NSString *)errorStr code:(int)code continuing:(BOOL)continuing;
 - (void)reportBlockBoundaryStarted:(BOOL)started;
 - (void)reportTemplateProcessingFinished;
+- (id)processTemplate:(NSString *)templateString compiled:(MGCompiledTemplate *)compiled withVariables:(NSDictionary *)variables 
+				UTF8:(BOOL)UTF8 sink:(id <MGTemplateOutputSink>)sink;
 
 @end
 
@@ -65,6 +194,7 @@
 		_markers = [[NSMutableDictionary alloc] init];
 		_filters = [[NSMutableDictionary alloc] init];
 		_templateVariables = [[NSMutableDictionary alloc] init];
+		_variablePaths = [[NSMutableDictionary alloc] init];
 		_outputDisabledCount = 0; // i.e. not disabled.
 		self.markerStartDelimiter = DEFAULT_MARKER_START;
 		self.markerEndDelimiter = DEFAULT_MARKER_END;
@@ -100,6 +230,8 @@
 	templateContents = nil;
 	[_templateVariables release];
 	_templateVariables = nil;
+	[_variablePaths release];
+	_variablePaths = nil;
 	self.markerStartDelimiter = nil;
 	self.markerEndDelimiter = nil;
 	self.expressionStartDelimiter = nil;
@@ -235,23 +367,7 @@
 	
 	// Check to see if there's a top-level entry for first part of var in templateVariables.
 	NSString *firstVar = [dotBits objectAtIndex:0];
-	
-	if ([_templateVariables objectForKey:firstVar]) {
-		currObj = _templateVariables;
-	} else if ([_globals objectForKey:firstVar]) {
-		currObj = _globals;
-	} else {
-		// Attempt to find firstVar in stack variables.
-		NSEnumerator *stack = [_openBlocksStack reverseObjectEnumerator];
-		NSDictionary *stackFrame = nil;
-		while (stackFrame = [stack nextObject]) {
-			NSDictionary *vars = [stackFrame objectForKey:BLOCK_VARIABLES_KEY];
-			if (vars && [vars objectForKey:firstVar]) {
-				currObj = vars;
-				break;
-			}
-		}
-	}
+	currObj = [self containerForVariableNamed:firstVar];
 	
 	if (!currObj) {
 		return nil;
@@ -369,13 +485,47 @@
 }
 
 
+- (NSDictionary *)containerForVariableNamed:(NSString *)firstVar
+{
+	if ([_templateVariables objectForKey:firstVar]) {
+		return _templateVariables;
+	} else if ([_globals objectForKey:firstVar]) {
+		return _globals;
+	}
+	
+	// Attempt to find firstVar in stack variables.
+	NSEnumerator *stack = [_openBlocksStack reverseObjectEnumerator];
+	NSDictionary *stackFrame = nil;
+	while (stackFrame = [stack nextObject]) {
+		NSDictionary *vars = [stackFrame objectForKey:BLOCK_VARIABLES_KEY];
+		if (vars && [vars objectForKey:firstVar]) {
+			return vars;
+		}
+	}
+	return nil;
+}
+
+
 - (NSObject *)resolveVariable:(NSString *)var
 {
-	NSObject *parent = nil;
-	NSString *key = nil;
-	NSObject *result = [self valueForVariable:var parent:&parent parentKey:&key];
-	//NSLog(@"var: %@, parent: %@, key: %@, result: %@", var, parent, key, result);
-	return result;
+	// Paths are split once per engine, markers resolve the same arguments on every pass of a loop.
+	MGVariablePath *path = [_variablePaths objectForKey:var];
+	if (!path) {
+		path = [[MGVariablePath alloc] initWithString:var];
+		[_variablePaths setObject:path forKey:var];
+		[path release];
+	}
+	return [self resolveVariablePath:path];
+}
+
+
+- (NSObject *)resolveVariablePath:(MGVariablePath *)path
+{
+	NSDictionary *container = [self containerForVariableNamed:[path firstKey]];
+	if (!container) {
+		return nil;
+	}
+	return [path valueInContainer:container];
 }
 
 
@@ -385,10 +535,281 @@
 }
 
 
+- (NSObject *)applyFilter:(NSString *)filter withArguments:(NSArray *)args onValue:(NSObject *)value
+{
+	NSObject <MGTemplateFilter> *filterHandler = [_filters objectForKey:filter];
+	if (!filterHandler) {
+		return value;
+	}
+	return [filterHandler filterInvoked:filter withArguments:args onValue:value];
+}
+
+
+#pragma mark Fragment caching.
+
+
++ (void)setFragmentCache:(id <MGTemplateFragmentCache>)cache
+{
+	// Set once at startup, read without locking by every engine.
+	if (cache != _fragmentCache) {
+		[(NSObject *)_fragmentCache release];
+		_fragmentCache = [(NSObject *)cache retain];
+	}
+}
+
+
++ (id <MGTemplateFragmentCache>)fragmentCache
+{
+	return _fragmentCache;
+}
+
+
+- (NSUInteger)beginOutputCapture
+{
+	MGTemplateOutput *output = (MGTemplateOutput *)_output;
+	if (!output) {
+		return NSNotFound;
+	}
+	output->captures++;
+	return (output->data) ? output->flushedLength + [output->data length] : [output->string length];
+}
+
+
+- (NSData *)endOutputCaptureFromMark:(NSUInteger)mark
+{
+	MGTemplateOutput *output = (MGTemplateOutput *)_output;
+	if (!output || mark == NSNotFound) {
+		return nil;
+	}
+	if (output->captures > 0) {
+		output->captures--;
+	}
+	
+	if (output->data) {
+		// Nothing is written to a sink while a capture is open, so the captured bytes are all still buffered.
+		if (mark < output->flushedLength || mark - output->flushedLength > [output->data length]) {
+			return nil;
+		}
+		NSUInteger start = mark - output->flushedLength;
+		return [output->data subdataWithRange:NSMakeRange(start, [output->data length] - start)];
+	}
+	if (mark > [output->string length]) {
+		return nil;
+	}
+	return [[output->string substringFromIndex:mark] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+
+- (void)flushOutput
+{
+	MGTemplateOutput *output = (MGTemplateOutput *)_output;
+	if (output && output->sink && output->captures == 0) {
+		MGTemplateOutputWriteToSink(output);
+		[output->sink flush];
+	}
+}
+
+
+- (NSRange)rangeOfEndMarker:(NSArray *)endMarkers forBlock:(NSString *)blockName afterRange:(NSRange)markerRange
+{
+	NSUInteger location = NSMaxRange(markerRange);
+	NSUInteger depth = 0;
+	BOOL literal = NO;
+	
+	while (location < (NSUInteger)_templateLength) {
+		NSDictionary *matchInfo = nil;
+		if (_compiled) {
+			NSUInteger index = [_compiled indexOfFirstMarkerFromLocation:location];
+			if (index != NSNotFound) {
+				matchInfo = [_compiled markerAtIndex:index];
+			}
+		} else {
+			matchInfo = [matcher firstMarkerWithinRange:NSMakeRange(location, _templateLength - location)];
+		}
+		if (!matchInfo) {
+			break;
+		}
+		
+		NSRange matchRange = [[matchInfo objectForKey:MARKER_RANGE_KEY] rangeValue];
+		location = NSMaxRange(matchRange);
+		
+		// Markers inside a literal section are text.
+		NSString *name = [matchInfo objectForKey:MARKER_NAME_KEY];
+		if ([name isEqualToString:self.literalEndMarker]) {
+			literal = NO;
+			continue;
+		} else if (literal) {
+			continue;
+		} else if ([name isEqualToString:self.literalStartMarker]) {
+			literal = YES;
+			continue;
+		}
+		
+		if (![[matchInfo objectForKey:MARKER_TYPE_KEY] isEqualToString:MARKER_TYPE_MARKER]) {
+			continue;
+		}
+		if ([name isEqualToString:blockName]) {
+			depth++;
+		} else if ([endMarkers containsObject:name]) {
+			if (depth == 0) {
+				return matchRange;
+			}
+			depth--;
+		}
+	}
+	
+	return NSMakeRange(NSNotFound, 0);
+}
+
+
 #pragma mark Processing templates.
 
 
 - (NSString *)processTemplate:(NSString *)templateString withVariables:(NSDictionary *)variables
+{
+	return [self processTemplate:templateString compiled:nil withVariables:variables UTF8:NO sink:nil];
+}
+
+
+- (MGCompiledTemplate *)compileTemplate:(NSString *)templateString
+{
+	if (!matcher) {
+		[self reportError:@"No matcher has been configured for the template engine" code:7 continuing:NO];
+		return nil;
+	}
+	
+	// The matcher reads the template from us.
+	[templateContents release];
+	templateContents = [templateString retain];
+	_templateLength = [templateString length];
+	[matcher engineSettingsChanged];
+	
+	NSMutableArray *markers = [NSMutableArray array];
+	NSRange range = NSMakeRange(0, _templateLength);
+	while (range.length > 0) {
+		NSDictionary *matchInfo = [matcher firstMarkerWithinRange:range];
+		if (!matchInfo) {
+			break;
+		}
+		[markers addObject:[[matchInfo copy] autorelease]];
+		
+		NSRange matchRange = [[matchInfo objectForKey:MARKER_RANGE_KEY] rangeValue];
+		range.location = NSMaxRange(matchRange);
+		range.length = _templateLength - range.location;
+	}
+	
+	return [[[MGCompiledTemplate alloc] initWithTemplate:templateString 
+												 markers:markers 
+											  delimiters:MGCompiledTemplateDelimitersForEngine(self)] autorelease];
+}
+
+
+- (NSArray *)blockErrorsInCompiledTemplate:(MGCompiledTemplate *)compiledTemplate
+{
+	NSString *contents = [compiledTemplate templateContents];
+	NSMutableArray *errors = [NSMutableArray array];
+	
+	// Every marker that can end or continue a block of a loaded marker.
+	NSMutableSet *blockEndMarkers = [NSMutableSet set];
+	for (NSString *markerName in _markers) {
+		NSArray *endMarkers = [[_markers objectForKey:markerName] endMarkersForMarker:markerName];
+		if (endMarkers) {
+			[blockEndMarkers addObjectsFromArray:endMarkers];
+		}
+	}
+	
+	NSMutableArray *openBlocks = [NSMutableArray array];	// [name, end markers, location]
+	BOOL literal = NO;
+	NSUInteger count = [compiledTemplate markerCount];
+	for (NSUInteger i = 0; i < count; i++) {
+		NSDictionary *marker = [compiledTemplate markerAtIndex:i];
+		NSString *name = [marker objectForKey:MARKER_NAME_KEY];
+		if (!name || ![[marker objectForKey:MARKER_TYPE_KEY] isEqualToString:MARKER_TYPE_MARKER]) {
+			continue;
+		}
+		NSUInteger location = [compiledTemplate rangeOfMarkerAtIndex:i].location;
+		
+		if ([name isEqualToString:literalEndMarker]) {
+			literal = NO;
+			continue;
+		} else if (literal) {
+			continue;
+		} else if ([name isEqualToString:literalStartMarker]) {
+			literal = YES;
+			continue;
+		}
+		
+		NSArray *openBlock = [openBlocks lastObject];
+		NSArray *endMarkers = [openBlock objectAtIndex:1];
+		if ([endMarkers containsObject:name]) {
+			if ([name isEqualToString:[endMarkers objectAtIndex:0]]) {
+				[openBlocks removeLastObject];
+			}
+			continue;
+		} else if ([blockEndMarkers containsObject:name]) {
+			if (openBlock) {
+				[errors addObject:[NSString stringWithFormat:@"line %d: unexpected \"%@\" inside \"%@\" block from line %d", 
+								   (int)MGTemplateLineOfLocation(contents, location), name, [openBlock objectAtIndex:0], 
+								   (int)MGTemplateLineOfLocation(contents, [[openBlock objectAtIndex:2] unsignedIntegerValue])]];
+			} else {
+				[errors addObject:[NSString stringWithFormat:@"line %d: unexpected \"%@\" outside of a block", 
+								   (int)MGTemplateLineOfLocation(contents, location), name]];
+			}
+			continue;
+		}
+		
+		NSArray *nameEndMarkers = [[_markers objectForKey:name] endMarkersForMarker:name];
+		if ([nameEndMarkers count] > 0) {
+			[openBlocks addObject:[NSArray arrayWithObjects:name, nameEndMarkers, [NSNumber numberWithUnsignedInteger:location], nil]];
+		}
+	}
+	
+	if (literal) {
+		[errors addObject:[NSString stringWithFormat:@"\"%@\" section is not closed", literalStartMarker]];
+	}
+	for (NSArray *openBlock in openBlocks) {
+		[errors addObject:[NSString stringWithFormat:@"line %d: \"%@\" block is not closed, expected \"%@\"", 
+						   (int)MGTemplateLineOfLocation(contents, [[openBlock objectAtIndex:2] unsignedIntegerValue]), 
+						   [openBlock objectAtIndex:0], [[openBlock objectAtIndex:1] objectAtIndex:0]]];
+	}
+	
+	return ([errors count] > 0) ? errors : nil;
+}
+
+
+- (NSString *)processCompiledTemplate:(MGCompiledTemplate *)compiledTemplate withVariables:(NSDictionary *)variables
+{
+	if (![compiledTemplate matchesDelimitersOfEngine:self]) {
+		[self reportError:@"Compiled template was compiled with different delimiters, recompiling" code:8 continuing:YES];
+		compiledTemplate = [self compileTemplate:[compiledTemplate templateContents]];
+	}
+	return [self processTemplate:[compiledTemplate templateContents] compiled:compiledTemplate withVariables:variables UTF8:NO sink:nil];
+}
+
+
+- (NSData *)processCompiledTemplateToUTF8Data:(MGCompiledTemplate *)compiledTemplate withVariables:(NSDictionary *)variables
+{
+	if (![compiledTemplate matchesDelimitersOfEngine:self]) {
+		[self reportError:@"Compiled template was compiled with different delimiters, recompiling" code:8 continuing:YES];
+		compiledTemplate = [self compileTemplate:[compiledTemplate templateContents]];
+	}
+	return [self processTemplate:[compiledTemplate templateContents] compiled:compiledTemplate withVariables:variables UTF8:YES sink:nil];
+}
+
+
+- (void)processCompiledTemplate:(MGCompiledTemplate *)compiledTemplate withVariables:(NSDictionary *)variables 
+						 toSink:(id <MGTemplateOutputSink>)sink
+{
+	if (![compiledTemplate matchesDelimitersOfEngine:self]) {
+		[self reportError:@"Compiled template was compiled with different delimiters, recompiling" code:8 continuing:YES];
+		compiledTemplate = [self compileTemplate:[compiledTemplate templateContents]];
+	}
+	[self processTemplate:[compiledTemplate templateContents] compiled:compiledTemplate withVariables:variables UTF8:YES sink:sink];
+}
+
+
+- (id)processTemplate:(NSString *)templateString compiled:(MGCompiledTemplate *)compiled withVariables:(NSDictionary *)variables 
+				UTF8:(BOOL)UTF8 sink:(id <MGTemplateOutputSink>)sink
 {
 	// Set up environment.
 	[_openBlocksStack release];
@@ -419,27 +840,68 @@
 	_templateLength = [templateString length];
 	[_templateVariables release];
 	_templateVariables = [variables deepMutableCopy];
+	
+	// Data is only ever output, so it is used by reference rather than copied.
+	for (NSString *key in variables) {
+		NSObject *value = [variables objectForKey:key];
+		if ([value isKindOfClass:[NSData class]]) {
+			[_templateVariables setObject:value forKey:key];
+		}
+	}
 	remainingRange = NSMakeRange(0, [templateString length]);
 	_literal = NO;
 		
-	// Ensure we have a matcher.
-	if (!matcher) {
-		[self reportError:@"No matcher has been configured for the template engine" code:7 continuing:NO];
-		return nil;
+	// Ensure we have a matcher, compiled templates have already been matched.
+	if (!compiled) {
+		if (!matcher) {
+			[self reportError:@"No matcher has been configured for the template engine" code:7 continuing:NO];
+			return nil;
+		}
+		
+		// Tell our matcher to take note of our settings.
+		[matcher engineSettingsChanged];
 	}
+	MGTemplateOutput output;
+	output.string = (UTF8) ? nil : [NSMutableString string];
+	output.data = (UTF8) ? [NSMutableData dataWithCapacity:(sink) ? OUTPUT_SINK_THRESHOLD : [templateString length] * 2] : nil;
+	output.sink = sink;
+	output.flushedLength = 0;
+	output.captures = 0;
 	
-	// Tell our matcher to take note of our settings.
-	[matcher engineSettingsChanged];
-	NSMutableString *output = [NSMutableString string];
+	// Markers may capture output and look ahead for block ends while we render.
+	void *previousOutput = _output;
+	MGCompiledTemplate *previousCompiled = _compiled;
+	_output = &output;
+	_compiled = compiled;
 	
 	while (remainingRange.location != NSNotFound) {
-		NSDictionary *matchInfo = [matcher firstMarkerWithinRange:remainingRange];
+		if (sink && [output.data length] >= OUTPUT_SINK_THRESHOLD) {
+			MGTemplateOutputWriteToSink(&output);
+		}
+		
+		NSDictionary *matchInfo = nil;
+		NSUInteger compiledIndex = NSNotFound;
+		if (compiled) {
+			compiledIndex = [compiled indexOfFirstMarkerFromLocation:remainingRange.location];
+			// Respect a shortened range handed back by a marker, as the matcher would.
+			if (compiledIndex != NSNotFound && 
+				NSMaxRange([compiled rangeOfMarkerAtIndex:compiledIndex]) <= NSMaxRange(remainingRange)) {
+				matchInfo = [compiled markerAtIndex:compiledIndex];
+			}
+		} else {
+			matchInfo = [matcher firstMarkerWithinRange:remainingRange];
+		}
+		
 		if (matchInfo) {
 			// Append output before marker if appropriate.
 			NSRange matchRange = [[matchInfo objectForKey:MARKER_RANGE_KEY] rangeValue];
 			if (_outputDisabledCount == 0) {
-				NSRange preMarkerRange = NSMakeRange(remainingRange.location, matchRange.location - remainingRange.location);
-				[output appendFormat:@"%@", [templateContents substringWithRange:preMarkerRange]];
+				if (compiled && [compiled locationOfLiteralBeforeMarkerAtIndex:compiledIndex] == remainingRange.location) {
+					MGTemplateOutputAppendLiteral(&output, compiled, compiledIndex);
+				} else {
+					NSRange preMarkerRange = NSMakeRange(remainingRange.location, matchRange.location - remainingRange.location);
+					MGTemplateOutputAppendString(&output, [templateContents substringWithRange:preMarkerRange]);
+				}
 			}
 			
 			// Adjust remainingRange.
@@ -454,7 +916,7 @@
 			if ([matchMarker isEqualToString:self.literalStartMarker]) {
 				if (_literal && _outputDisabledCount == 0) {
 					// Output this tag literally.
-					[output appendFormat:@"%@", [templateContents substringWithRange:matchRange]];
+					MGTemplateOutputAppendString(&output, [templateContents substringWithRange:matchRange]);
 				} else {
 					// Enable literal mode.
 					_literal = YES;
@@ -465,7 +927,7 @@
 				_literal = NO;
 				continue;
 			} else if (_literal && _outputDisabledCount == 0) {
-				[output appendFormat:@"%@", [templateContents substringWithRange:matchRange]];
+				MGTemplateOutputAppendString(&output, [templateContents substringWithRange:matchRange]);
 				continue;
 			}
 			
@@ -519,6 +981,13 @@
 					break;
 				}
 				
+				// A marker that rewinds (ie the end of a loop) would have the matcher scan the same text again on every pass, 
+				// so compile the template once and carry on from the compiled markers.
+				if (!compiled && remainingRange.location < NSMaxRange(matchRange)) {
+					compiled = [self compileTemplate:[[templateContents retain] autorelease]];
+					_compiled = compiled;
+				}
+				
 				BOOL forceVarsToStack = NO;
 				if (blockStarted && blockEnded) {
 					// This is considered an error on the part of the marker-handler. Report to delegate.
@@ -593,7 +1062,8 @@ but current block was started by \"%@\" marker",
 				
 			} else {
 				// Check to see if the first word of the match is a variable.
-				val = [self resolveVariable:matchMarker];
+				MGVariablePath *path = (compiled) ? [compiled variablePathOfMarkerAtIndex:compiledIndex] : nil;
+				val = (path) ? [self resolveVariablePath:path] : [self resolveVariable:matchMarker];
 			}
 			
 			// Prepare result for output, if we have a result.
@@ -601,15 +1071,16 @@ but current block was started by \"%@\" marker",
 				// Process filter if specified.
 				NSString *filter = [matchInfo objectForKey:MARKER_FILTER_KEY];
 				if (filter) {
-					NSObject <MGTemplateFilter> *filterHandler = [_filters objectForKey:filter];
-					if (filterHandler) {
-						val = [filterHandler filterInvoked:filter 
-											 withArguments:[matchInfo objectForKey:MARKER_FILTER_ARGUMENTS_KEY] onValue:val];
-					}
+					val = [self applyFilter:filter withArguments:[matchInfo objectForKey:MARKER_FILTER_ARGUMENTS_KEY] onValue:val];
 				}
 				
-				// Output result.
-				[output appendFormat:@"%@", val];
+				// Output result, escaping expressions.
+				MGTemplateEscapeContext context = MGTemplateEscapeNone;
+				if (!isMarker && _autoescape != MGTemplateEscapeNone && ![filter isEqualToString:RAW_FILTER]) {
+					context = (_autoescape == MGTemplateEscapeHTML && compiled && compiledIndex != NSNotFound) ? 
+								[compiled HTMLEscapeContextOfMarkerAtIndex:compiledIndex] : _autoescape;
+				}
+				MGTemplateOutputAppendEscapedValue(&output, val, context);
 			} else if ((!val && !isMarker && _outputDisabledCount == 0) || (isMarker && !markerHandler)) {
 				// Call delegate's error-reporting method, if implemented.
 				[self reportError:[NSString stringWithFormat:@"\"%@\" is not a valid %@", 
@@ -619,7 +1090,13 @@ but current block was started by \"%@\" marker",
 		} else {
 			// Append output to end of template.
 			if (_outputDisabledCount == 0) {
-				[output appendFormat:@"%@", [templateContents substringWithRange:remainingRange]];
+				NSUInteger lastIndex = (compiled) ? [compiled markerCount] : NSNotFound;
+				if (compiled && NSMaxRange(remainingRange) == _templateLength && 
+					[compiled locationOfLiteralBeforeMarkerAtIndex:lastIndex] == remainingRange.location) {
+					MGTemplateOutputAppendLiteral(&output, compiled, lastIndex);
+				} else {
+					MGTemplateOutputAppendString(&output, [templateContents substringWithRange:remainingRange]);
+				}
 			}
 			
 			// Check to see if there are open blocks left over.
@@ -640,10 +1117,28 @@ but current block was started by \"%@\" marker",
 	// Tell all marker-handlers we're done.
 	[[_markers allValues] makeObjectsPerformSelector:@selector(engineFinishedProcessingTemplate)];
 	
+	// Anything left goes to the sink, including captures left open by unterminated blocks.
+	output.captures = 0;
+	MGTemplateOutputWriteToSink(&output);
+	_output = previousOutput;
+	_compiled = previousCompiled;
+	
 	// Inform delegate we're done.
 	[self reportTemplateProcessingFinished];
 
-	return output;
+	return (UTF8) ? (id)output.data : (id)output.string;
+}
+
+
+- (void)releaseTemplateState
+{
+	[templateContents release];
+	templateContents = nil;
+	_templateLength = 0;
+	[_templateVariables release];
+	_templateVariables = [[NSMutableDictionary alloc] init];
+	[_openBlocksStack removeAllObjects];
+	_autoescape = MGTemplateEscapeNone;
 }
 
 
@@ -673,6 +1168,7 @@ but current block was started by \"%@\" marker",
 @synthesize delegate;
 @synthesize matcher;
 @synthesize templateContents;
+@synthesize autoescape = _autoescape;
 
 
 @end
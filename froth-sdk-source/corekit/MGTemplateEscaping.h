@@ -0,0 +1,97 @@
+//
+//  MGTemplateEscaping.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+	\brief	How an expression's value is escaped for where it appears in the output.
+ 
+	Escaping copies runs of bytes that need no escaping in bulk and only rewrites the characters that do, so values that are 
+	already safe (the common case) are copied once without being changed.
+ */
+typedef enum {
+	MGTemplateEscapeNone = 0,
+	MGTemplateEscapeHTML,				// Text content, & < > " ' become entities
+	MGTemplateEscapeAttribute,			// A quoted attribute value, as html plus `
+	MGTemplateEscapeUnquotedAttribute,	// An unquoted attribute value or inside a tag, as attribute plus whitespace and =
+	MGTemplateEscapeURL,				// The start of a url attribute (href, src...), unsafe schemes (ie javascript:) become #, then as attribute
+	MGTemplateEscapeURLPath,			// Later in the path of a url attribute, percent encoded except for /
+	MGTemplateEscapeURLQuery,			// In the query or fragment of a url attribute, percent encoded
+	MGTemplateEscapeJSON,				// Inside a json string, non ascii text is kept as is
+	MGTemplateEscapeUnquotedURL,		// The start of an unquoted url attribute, unsafe schemes become #, then as unquoted attribute
+	MGTemplateEscapeJavaScript,			// Inside a string, template literal, regexp or comment of a script element, as json plus ` $ and /
+	MGTemplateEscapeJavaScriptValue,	// A value in the code of a script element, a complete "quoted" javascript string
+	MGTemplateEscapeJavaScriptAttribute,		// Inside a string of an event handler attribute, as javascript plus whitespace
+	MGTemplateEscapeJavaScriptAttributeValue,	// A value in the code of an event handler attribute, a complete javascript string quoted with &#34;
+	MGTemplateEscapeContextCount
+} MGTemplateEscapeContext;
+
+/*! \brief Appends bytes, utf8 text, escaped for context to output. */
+void MGTemplateEscapeUTF8(MGTemplateEscapeContext context, const void* bytes, NSUInteger length, NSMutableData* output);
+
+/*! \brief The string escaped for context, the string itself if nothing needs escaping. */
+NSString* MGTemplateEscapeString(MGTemplateEscapeContext context, NSString* string);
+
+/*! \brief If values are escaped in one piece for context (urls have their scheme checked, javascript values are quoted), not in chunks. */
+BOOL MGTemplateEscapeWholeValue(MGTemplateEscapeContext context);
+
+/*!
+	\brief	Follows the html structure of a template's literal text, to find the escape context of the expressions between them.
+ 
+	Literals are scanned in template order and each expression is taken to be a value at the point the text before it 
+	stops (ie in an attribute value, or inside a script element). The template's markers do not change the structure.
+ 
+	Script elements and event handler attributes are followed as javascript, so an expression inside a string is escaped 
+	for the string and an expression in code is output as a complete quoted string (var name = {{ user.name }};).
+ */
+typedef struct {
+	int state;
+	int rawText;			// the element whose content is not html (script or style), or 0
+	BOOL closingTag;
+	BOOL URLQuery;			// the current url attribute value has a ? or #
+	NSUInteger valueLength;	// characters in the current attribute value so far
+	char tagName[16];
+	char attributeName[16];
+	
+	int script;				// where the javascript of a script element or event handler attribute is (code, a string...)
+	BOOL scriptEscaped;		// after a \ in a javascript string or regexp
+	BOOL scriptRegexpClass;	// inside [ ] of a regexp
+	BOOL scriptRegexp;		// a / in code starts a regexp rather than dividing
+	char scriptWord[12];	// the identifier before the position, to tell a regexp after return (or typeof...) from division
+	uint32_t scriptTemplateBraces;	// a bit for each open brace, set for the ${ of a template literal
+	int scriptBraceDepth;
+} MGTemplateHTMLScanner;
+
+void MGTemplateHTMLScannerInit(MGTemplateHTMLScanner* scanner);
+
+/*! \brief Advances the scanner over literal text. */
+void MGTemplateHTMLScannerScanLiteral(MGTemplateHTMLScanner* scanner, NSString* literal);
+
+/*! \brief The escape context for an expression at the scanner's position, the expression is taken to be part of any attribute value. */
+MGTemplateEscapeContext MGTemplateHTMLScannerExpression(MGTemplateHTMLScanner* scanner);
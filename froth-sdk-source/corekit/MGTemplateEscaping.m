@@ -0,0 +1,729 @@
+//
+//  MGTemplateEscaping.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#import "MGTemplateEscaping.h"
+#include <pthread.h>
+#include <ctype.h>
+#include <strings.h>
+
+/*
+	A byte's class in kEscapeTables is 0 if the byte is copied as is in that context, otherwise it is rewritten.
+ */
+#define kByteCopy		0
+#define kByteEntity		1	// &#N; or a named entity
+#define kBytePercent	2	// %XX
+#define kByteJSON		3	// \uXXXX or a short escape
+#define kByteCheck		4	// the start of a sequence that may need escaping (U+2028 and U+2029 in json)
+
+static uint8_t kEscapeTables[MGTemplateEscapeContextCount][256];
+static pthread_once_t kEscapeTablesOnce = PTHREAD_ONCE_INIT;
+
+static void setClass(uint8_t* table, const char* chars, uint8_t byteClass) {
+	for(; *chars; chars++) {
+		table[(uint8_t)*chars] = byteClass;
+	}
+}
+
+static void initEscapeTables(void) {
+	memset(kEscapeTables, kByteCopy, sizeof(kEscapeTables));
+	
+	setClass(kEscapeTables[MGTemplateEscapeHTML], "&<>\"'", kByteEntity);
+	
+	setClass(kEscapeTables[MGTemplateEscapeAttribute], "&<>\"'`", kByteEntity);
+	setClass(kEscapeTables[MGTemplateEscapeURL], "&<>\"'`", kByteEntity);
+	
+	setClass(kEscapeTables[MGTemplateEscapeUnquotedAttribute], "&<>\"'`= \t\n\r\f", kByteEntity);
+	setClass(kEscapeTables[MGTemplateEscapeUnquotedURL], "&<>\"'`= \t\n\r\f", kByteEntity);
+	
+	uint8_t* path = kEscapeTables[MGTemplateEscapeURLPath];
+	uint8_t* query = kEscapeTables[MGTemplateEscapeURLQuery];
+	for(int c=0; c<256; c++) {
+		BOOL unreserved = ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || 
+						   c == '-' || c == '_' || c == '.' || c == '~');
+		query[c] = (unreserved) ? kByteCopy : kBytePercent;
+		path[c] = (unreserved || c == '/') ? kByteCopy : kBytePercent;
+	}
+	
+	uint8_t* json = kEscapeTables[MGTemplateEscapeJSON];
+	for(int c=0; c<0x20; c++) {
+		json[c] = kByteJSON;
+	}
+	setClass(json, "\"\\<>&'", kByteJSON);
+	json[0x7F] = kByteJSON;
+	json[0xE2] = kByteCheck;
+	
+	//Javascript is escaped as json, so a value can not end a template literal or regexp either
+	uint8_t* script = kEscapeTables[MGTemplateEscapeJavaScript];
+	memcpy(script, json, 256);
+	setClass(script, "`$/", kByteJSON);
+	memcpy(kEscapeTables[MGTemplateEscapeJavaScriptValue], script, 256);
+	
+	//In an attribute whitespace could end an unquoted value
+	uint8_t* scriptAttribute = kEscapeTables[MGTemplateEscapeJavaScriptAttribute];
+	memcpy(scriptAttribute, script, 256);
+	setClass(scriptAttribute, " ", kByteJSON);
+	memcpy(kEscapeTables[MGTemplateEscapeJavaScriptAttributeValue], scriptAttribute, 256);
+}
+
+static const char kHexDigits[] = "0123456789ABCDEF";
+
+static void appendEntity(NSMutableData* output, uint8_t c) {
+	switch(c) {
+		case '&': [output appendBytes:"&amp;" length:5]; break;
+		case '<': [output appendBytes:"&lt;" length:4]; break;
+		case '>': [output appendBytes:"&gt;" length:4]; break;
+		default: {
+			char entity[8];
+			int length = snprintf(entity, sizeof(entity), "&#%d;", (int)c);
+			[output appendBytes:entity length:length];
+		}
+	}
+}
+
+static void appendPercent(NSMutableData* output, uint8_t c) {
+	char escaped[3] = { '%', kHexDigits[c >> 4], kHexDigits[c & 0xF] };
+	[output appendBytes:escaped length:3];
+}
+
+static void appendJSONEscape(NSMutableData* output, unsigned int c) {
+	switch(c) {
+		case '\\': [output appendBytes:"\\\\" length:2]; return;
+		case '\n': [output appendBytes:"\\n" length:2]; return;
+		case '\r': [output appendBytes:"\\r" length:2]; return;
+		case '\t': [output appendBytes:"\\t" length:2]; return;
+	}
+	//Everything else as \uXXXX, quotes and < > & included so a value can not end an attribute or a script element
+	char escaped[6] = { '\\', 'u', kHexDigits[(c >> 12) & 0xF], kHexDigits[(c >> 8) & 0xF], kHexDigits[(c >> 4) & 0xF], kHexDigits[c & 0xF] };
+	[output appendBytes:escaped length:6];
+}
+
+/*
+	Only a few schemes are allowed at the start of a url attribute, a relative url has no scheme.
+ */
+static BOOL isSafeURL(const uint8_t* bytes, NSUInteger length) {
+	NSUInteger i = 0;
+	while(i < length && (bytes[i] == ' ' || bytes[i] == '\t' || bytes[i] == '\n' || bytes[i] == '\r')) i++;
+	
+	NSUInteger start = i;
+	for(; i < length; i++) {
+		uint8_t c = bytes[i];
+		if(c == ':') {
+			NSUInteger schemeLength = i - start;
+			const char* safeSchemes[] = { "http", "https", "mailto", "ftp", "tel", NULL };
+			for(int s=0; safeSchemes[s]; s++) {
+				if(strlen(safeSchemes[s]) == schemeLength && strncasecmp((const char*)bytes + start, safeSchemes[s], schemeLength) == 0) {
+					return YES;
+				}
+			}
+			return NO;
+		} else if(c == '/' || c == '?' || c == '#') {
+			return YES;
+		}
+	}
+	return YES;
+}
+
+/* The quote around a javascript value, NULL for other contexts. */
+static const char* quoteForContext(MGTemplateEscapeContext context) {
+	if(context == MGTemplateEscapeJavaScriptValue) {
+		return "\"";
+	} else if(context == MGTemplateEscapeJavaScriptAttributeValue) {
+		return "&#34;";
+	}
+	return NULL;
+}
+
+BOOL MGTemplateEscapeWholeValue(MGTemplateEscapeContext context) {
+	return (context == MGTemplateEscapeURL || context == MGTemplateEscapeUnquotedURL || quoteForContext(context) != NULL);
+}
+
+void MGTemplateEscapeUTF8(MGTemplateEscapeContext context, const void* bytes, NSUInteger length, NSMutableData* output) {
+	if(context == MGTemplateEscapeNone || context >= MGTemplateEscapeContextCount) {
+		[output appendBytes:bytes length:length];
+		return;
+	}
+	pthread_once(&kEscapeTablesOnce, initEscapeTables);
+	
+	const uint8_t* b = (const uint8_t*)bytes;
+	if((context == MGTemplateEscapeURL || context == MGTemplateEscapeUnquotedURL) && !isSafeURL(b, length)) {
+		[output appendBytes:"#" length:1];
+		return;
+	}
+	
+	const char* quote = quoteForContext(context);
+	if(quote) {
+		[output appendBytes:quote length:strlen(quote)];
+	}
+	
+	const uint8_t* table = kEscapeTables[context];
+	NSUInteger i = 0;
+	while(i < length) {
+		//Skip clean runs four bytes at a time, then copy them in one go.
+		NSUInteger start = i;
+		while(i + 4 <= length && (table[b[i]] | table[b[i+1]] | table[b[i+2]] | table[b[i+3]]) == kByteCopy) {
+			i += 4;
+		}
+		while(i < length && table[b[i]] == kByteCopy) {
+			i++;
+		}
+		if(i > start) {
+			[output appendBytes:b + start length:i - start];
+		}
+		if(i >= length) break;
+		
+		uint8_t c = b[i];
+		switch(table[c]) {
+			case kByteEntity: appendEntity(output, c); break;
+			case kBytePercent: appendPercent(output, c); break;
+			case kByteJSON: appendJSONEscape(output, c); break;
+			case kByteCheck:
+				//U+2028 and U+2029 end a line in javascript
+				if(i + 2 < length && b[i+1] == 0x80 && (b[i+2] == 0xA8 || b[i+2] == 0xA9)) {
+					appendJSONEscape(output, (b[i+2] == 0xA8) ? 0x2028 : 0x2029);
+					i += 2;
+				} else {
+					[output appendBytes:&c length:1];
+				}
+				break;
+		}
+		i++;
+	}
+	
+	if(quote) {
+		[output appendBytes:quote length:strlen(quote)];
+	}
+}
+
+NSString* MGTemplateEscapeString(MGTemplateEscapeContext context, NSString* string) {
+	if(context == MGTemplateEscapeNone || context >= MGTemplateEscapeContextCount || !string) {
+		return string;
+	}
+	pthread_once(&kEscapeTablesOnce, initEscapeTables);
+	
+	const char* utf8 = [string UTF8String];
+	size_t length = strlen(utf8);
+	
+	//Nothing to escape is the common case, and needs no copy.
+	const uint8_t* table = kEscapeTables[context];
+	size_t i = 0;
+	while(i < length && table[(uint8_t)utf8[i]] == kByteCopy) {
+		i++;
+	}
+	if(i == length && !MGTemplateEscapeWholeValue(context)) {
+		return string;
+	}
+	
+	NSMutableData* escaped = [[NSMutableData alloc] initWithCapacity:length + 16];
+	MGTemplateEscapeUTF8(context, utf8, length, escaped);
+	NSString* result = [[NSString alloc] initWithData:escaped encoding:NSUTF8StringEncoding];
+	[escaped release];
+	return [result autorelease];
+}
+
+#pragma mark -
+#pragma mark HTML Scanner
+
+enum {
+	kScanText = 0,
+	kScanTagOpen,
+	kScanTagName,
+	kScanInTag,
+	kScanAttributeName,
+	kScanAfterAttributeName,
+	kScanBeforeAttributeValue,
+	kScanDoubleQuotedValue,
+	kScanSingleQuotedValue,
+	kScanUnquotedValue,
+	kScanComment,
+	kScanRawText
+};
+
+enum {
+	kRawTextNone = 0,
+	kRawTextScript,
+	kRawTextStyle
+};
+
+enum {
+	kScriptCode = 0,
+	kScriptDoubleQuoted,
+	kScriptSingleQuoted,
+	kScriptTemplate,
+	kScriptRegexp,
+	kScriptLineComment,
+	kScriptBlockComment
+};
+
+static BOOL isSpace(unichar c) {
+	return (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f');
+}
+
+static void appendName(char* name, unichar c) {
+	size_t length = strlen(name);
+	if(length < 15 && c < 0x80) {
+		name[length] = (char)tolower((int)c);
+		name[length+1] = '\0';
+	}
+}
+
+/* If characters at i match the ascii string, ignoring case. */
+static BOOL matchesAt(const unichar* characters, NSUInteger length, NSUInteger i, const char* match) {
+	for(; *match; match++, i++) {
+		if(i >= length || characters[i] > 0x7F || tolower((int)characters[i]) != *match) return NO;
+	}
+	return YES;
+}
+
+static BOOL isURLAttribute(const char* name) {
+	const char* names[] = { "href", "src", "action", "formaction", "cite", "background", "poster", "data", NULL };
+	for(int i=0; names[i]; i++) {
+		if(strcmp(name, names[i]) == 0) return YES;
+	}
+	return NO;
+}
+
+static BOOL isEventAttribute(const char* name) {
+	return (strncmp(name, "on", 2) == 0);
+}
+
+#pragma mark -
+#pragma mark Javascript
+
+static BOOL isScriptIdentifier(unichar c) {
+	return ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$' || c >= 0x80);
+}
+
+/* Keywords followed by an expression, a / after them starts a regexp. */
+static BOOL isRegexpKeyword(const char* word) {
+	const char* keywords[] = { "return", "typeof", "instanceof", "in", "of", "new", "delete", "void", "throw", "case", "do", "else", "yield", "await", NULL };
+	for(int i=0; keywords[i]; i++) {
+		if(strcmp(word, keywords[i]) == 0) return YES;
+	}
+	return NO;
+}
+
+static void beginScript(MGTemplateHTMLScanner* scanner) {
+	scanner->script = kScriptCode;
+	scanner->scriptEscaped = NO;
+	scanner->scriptRegexpClass = NO;
+	scanner->scriptRegexp = YES;
+	scanner->scriptWord[0] = '\0';
+	scanner->scriptTemplateBraces = 0;
+	scanner->scriptBraceDepth = 0;
+}
+
+/*
+	Decodes the character reference at i (an event handler is html decoded before it is run), end is set to its last character.
+ */
+static unichar decodeEntity(const unichar* characters, NSUInteger length, NSUInteger i, NSUInteger* end) {
+	const char* names[] = { "&quot;", "&apos;", "&amp;", "&lt;", "&gt;", NULL };
+	const unichar decoded[] = { '"', '\'', '&', '<', '>' };
+	for(int n=0; names[n]; n++) {
+		if(matchesAt(characters, length, i, names[n])) {
+			*end = i + strlen(names[n]) - 1;
+			return decoded[n];
+		}
+	}
+	
+	if(i + 1 < length && characters[i+1] == '#') {
+		NSUInteger j = i + 2;
+		BOOL hex = (j < length && (characters[j] == 'x' || characters[j] == 'X'));
+		if(hex) j++;
+		
+		NSUInteger digits = j;
+		unsigned int value = 0;
+		for(; j < length && value <= 0xFFFF; j++) {
+			unichar d = characters[j];
+			if(d >= '0' && d <= '9') value = value * ((hex) ? 16 : 10) + (d - '0');
+			else if(hex && d >= 'a' && d <= 'f') value = value * 16 + (d - 'a' + 10);
+			else if(hex && d >= 'A' && d <= 'F') value = value * 16 + (d - 'A' + 10);
+			else break;
+		}
+		if(j > digits) {
+			*end = (j < length && characters[j] == ';') ? j : j - 1;
+			return (value <= 0xFFFF) ? (unichar)value : 0xFFFD;
+		}
+	}
+	*end = i;
+	return '&';
+}
+
+/*
+	Advances the javascript state over c, the character at i. Returns the index of the last character used, ie the * that starts a comment.
+ */
+static NSUInteger scanScript(MGTemplateHTMLScanner* scanner, const unichar* characters, NSUInteger length, NSUInteger i, unichar c) {
+	unichar next = (i + 1 < length) ? characters[i+1] : 0;
+	
+	switch(scanner->script) {
+		case kScriptCode:
+			if(isScriptIdentifier(c)) {
+				size_t wordLength = strlen(scanner->scriptWord);
+				if(wordLength < sizeof(scanner->scriptWord) - 1) {
+					scanner->scriptWord[wordLength] = (c < 0x80) ? (char)c : '?';
+					scanner->scriptWord[wordLength+1] = '\0';
+				}
+				scanner->scriptRegexp = isRegexpKeyword(scanner->scriptWord);
+				break;
+			}
+			
+			scanner->scriptWord[0] = '\0';
+			if(isSpace(c)) {
+				break;
+			} else if(c == '"') {
+				scanner->script = kScriptDoubleQuoted;
+			} else if(c == '\'') {
+				scanner->script = kScriptSingleQuoted;
+			} else if(c == '`') {
+				scanner->script = kScriptTemplate;
+			} else if(c == '/' && next == '/') {
+				scanner->script = kScriptLineComment;
+				return i + 1;
+			} else if(c == '/' && next == '*') {
+				scanner->script = kScriptBlockComment;
+				return i + 1;
+			} else if(c == '/' && scanner->scriptRegexp) {
+				scanner->script = kScriptRegexp;
+				scanner->scriptRegexpClass = NO;
+			} else if(c == '{') {
+				if(scanner->scriptBraceDepth < 32) scanner->scriptTemplateBraces &= ~(1u << scanner->scriptBraceDepth);
+				scanner->scriptBraceDepth++;
+				scanner->scriptRegexp = YES;
+			} else if(c == '}') {
+				if(scanner->scriptBraceDepth > 0) {
+					scanner->scriptBraceDepth--;
+					if(scanner->scriptBraceDepth < 32 && (scanner->scriptTemplateBraces & (1u << scanner->scriptBraceDepth))) {
+						//The end of a ${ } in a template literal
+						scanner->script = kScriptTemplate;
+						break;
+					}
+				}
+				scanner->scriptRegexp = YES;
+			} else {
+				scanner->scriptRegexp = (c != ')' && c != ']');
+			}
+			break;
+			
+		case kScriptDoubleQuoted:
+		case kScriptSingleQuoted:
+			if(scanner->scriptEscaped) {
+				scanner->scriptEscaped = NO;
+			} else if(c == '\\') {
+				scanner->scriptEscaped = YES;
+			} else if((c == '"' && scanner->script == kScriptDoubleQuoted) || (c == '\'' && scanner->script == kScriptSingleQuoted)) {
+				scanner->script = kScriptCode;
+				scanner->scriptRegexp = NO;
+			}
+			break;
+			
+		case kScriptTemplate:
+			if(scanner->scriptEscaped) {
+				scanner->scriptEscaped = NO;
+			} else if(c == '\\') {
+				scanner->scriptEscaped = YES;
+			} else if(c == '`') {
+				scanner->script = kScriptCode;
+				scanner->scriptRegexp = NO;
+			} else if(c == '$' && next == '{') {
+				if(scanner->scriptBraceDepth < 32) scanner->scriptTemplateBraces |= (1u << scanner->scriptBraceDepth);
+				scanner->scriptBraceDepth++;
+				scanner->script = kScriptCode;
+				scanner->scriptRegexp = YES;
+				return i + 1;
+			}
+			break;
+			
+		case kScriptRegexp:
+			if(scanner->scriptEscaped) {
+				scanner->scriptEscaped = NO;
+			} else if(c == '\\') {
+				scanner->scriptEscaped = YES;
+			} else if(c == '[') {
+				scanner->scriptRegexpClass = YES;
+			} else if(c == ']') {
+				scanner->scriptRegexpClass = NO;
+			} else if(c == '/' && !scanner->scriptRegexpClass) {
+				scanner->script = kScriptCode;
+				scanner->scriptRegexp = NO;
+			}
+			break;
+			
+		case kScriptLineComment:
+			if(c == '\n' || c == '\r') {
+				scanner->script = kScriptCode;
+			}
+			break;
+			
+		case kScriptBlockComment:
+			if(c == '*' && next == '/') {
+				scanner->script = kScriptCode;
+				return i + 1;
+			}
+			break;
+	}
+	return i;
+}
+
+/* The context for an expression in javascript, in code the value is a complete string so it can not be run. */
+static MGTemplateEscapeContext scriptExpression(MGTemplateHTMLScanner* scanner, BOOL attribute) {
+	if(scanner->script == kScriptCode) {
+		//A / after the string divides
+		scanner->scriptRegexp = NO;
+		scanner->scriptWord[0] = '\0';
+		return (attribute) ? MGTemplateEscapeJavaScriptAttributeValue : MGTemplateEscapeJavaScriptValue;
+	}
+	//An escaped value always ends with a complete escape
+	scanner->scriptEscaped = NO;
+	return (attribute) ? MGTemplateEscapeJavaScriptAttribute : MGTemplateEscapeJavaScript;
+}
+
+#pragma mark -
+
+static void endTag(MGTemplateHTMLScanner* scanner) {
+	scanner->state = kScanText;
+	if(!scanner->closingTag) {
+		if(strcmp(scanner->tagName, "script") == 0) {
+			scanner->state = kScanRawText;
+			scanner->rawText = kRawTextScript;
+			beginScript(scanner);
+		} else if(strcmp(scanner->tagName, "style") == 0) {
+			scanner->state = kScanRawText;
+			scanner->rawText = kRawTextStyle;
+		}
+	}
+}
+
+static void beginValue(MGTemplateHTMLScanner* scanner, int state) {
+	scanner->state = state;
+	scanner->valueLength = 0;
+	scanner->URLQuery = NO;
+	beginScript(scanner);
+}
+
+void MGTemplateHTMLScannerInit(MGTemplateHTMLScanner* scanner) {
+	memset(scanner, 0, sizeof(MGTemplateHTMLScanner));
+}
+
+void MGTemplateHTMLScannerScanLiteral(MGTemplateHTMLScanner* scanner, NSString* literal) {
+	NSUInteger length = [literal length];
+	if(length == 0) return;
+	
+	unichar stackBuffer[512];
+	unichar* characters = (length <= 512) ? stackBuffer : malloc(sizeof(unichar) * length);
+	[literal getCharacters:characters];
+	
+	for(NSUInteger i=0; i<length; i++) {
+		unichar c = characters[i];
+		switch(scanner->state) {
+			case kScanText:
+				if(c == '<') {
+					scanner->state = kScanTagOpen;
+					scanner->closingTag = NO;
+					scanner->tagName[0] = '\0';
+				}
+				break;
+				
+			case kScanTagOpen:
+				if(c == '!' && matchesAt(characters, length, i+1, "--")) {
+					scanner->state = kScanComment;
+					i += 2;
+				} else if(c == '/') {
+					scanner->closingTag = YES;
+				} else if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+					scanner->state = kScanTagName;
+					appendName(scanner->tagName, c);
+				} else {
+					//Not a tag, ie "a < b" or a doctype
+					scanner->state = (c == '!' || c == '?') ? kScanInTag : kScanText;
+				}
+				break;
+				
+			case kScanTagName:
+				if(isSpace(c) || c == '/') {
+					scanner->state = kScanInTag;
+				} else if(c == '>') {
+					endTag(scanner);
+				} else {
+					appendName(scanner->tagName, c);
+				}
+				break;
+				
+			case kScanInTag:
+				if(c == '>') {
+					endTag(scanner);
+				} else if(!isSpace(c) && c != '/') {
+					scanner->state = kScanAttributeName;
+					scanner->attributeName[0] = '\0';
+					appendName(scanner->attributeName, c);
+				}
+				break;
+				
+			case kScanAttributeName:
+			case kScanAfterAttributeName:
+				if(c == '=') {
+					scanner->state = kScanBeforeAttributeValue;
+				} else if(c == '>') {
+					endTag(scanner);
+				} else if(isSpace(c) || c == '/') {
+					scanner->state = kScanAfterAttributeName;
+				} else if(scanner->state == kScanAfterAttributeName) {
+					scanner->state = kScanAttributeName;
+					scanner->attributeName[0] = '\0';
+					appendName(scanner->attributeName, c);
+				} else {
+					appendName(scanner->attributeName, c);
+				}
+				break;
+				
+			case kScanBeforeAttributeValue:
+				if(c == '"') {
+					beginValue(scanner, kScanDoubleQuotedValue);
+				} else if(c == '\'') {
+					beginValue(scanner, kScanSingleQuotedValue);
+				} else if(c == '>') {
+					endTag(scanner);
+				} else if(!isSpace(c)) {
+					beginValue(scanner, kScanUnquotedValue);
+					if(isEventAttribute(scanner->attributeName)) {
+						if(c == '&') c = decodeEntity(characters, length, i, &i);
+						i = scanScript(scanner, characters, length, i, c);
+					} else {
+						if(c == '?' || c == '#') scanner->URLQuery = YES;
+						scanner->valueLength = 1;
+					}
+				}
+				break;
+				
+			case kScanDoubleQuotedValue:
+			case kScanSingleQuotedValue:
+				if((c == '"' && scanner->state == kScanDoubleQuotedValue) || (c == '\'' && scanner->state == kScanSingleQuotedValue)) {
+					scanner->state = kScanInTag;
+				} else if(isEventAttribute(scanner->attributeName)) {
+					if(c == '&') c = decodeEntity(characters, length, i, &i);
+					i = scanScript(scanner, characters, length, i, c);
+				} else {
+					if(c == '?' || c == '#') scanner->URLQuery = YES;
+					scanner->valueLength++;
+				}
+				break;
+				
+			case kScanUnquotedValue:
+				if(c == '>') {
+					endTag(scanner);
+				} else if(isSpace(c)) {
+					scanner->state = kScanInTag;
+				} else if(isEventAttribute(scanner->attributeName)) {
+					if(c == '&') c = decodeEntity(characters, length, i, &i);
+					i = scanScript(scanner, characters, length, i, c);
+				} else {
+					if(c == '?' || c == '#') scanner->URLQuery = YES;
+					scanner->valueLength++;
+				}
+				break;
+				
+			case kScanComment:
+				if(c == '-' && matchesAt(characters, length, i, "-->")) {
+					scanner->state = kScanText;
+					i += 2;
+				}
+				break;
+				
+			case kScanRawText:
+				if(c == '<' && matchesAt(characters, length, i, (scanner->rawText == kRawTextScript) ? "</script" : "</style")) {
+					//Continue as the closing tag
+					i += (scanner->rawText == kRawTextScript) ? 7 : 6;
+					strcpy(scanner->tagName, (scanner->rawText == kRawTextScript) ? "script" : "style");
+					scanner->closingTag = YES;
+					scanner->rawText = kRawTextNone;
+					scanner->state = kScanTagName;
+				} else if(scanner->rawText == kRawTextScript) {
+					i = scanScript(scanner, characters, length, i, c);
+				}
+				break;
+		}
+	}
+	
+	if(characters != stackBuffer) {
+		free(characters);
+	}
+}
+
+MGTemplateEscapeContext MGTemplateHTMLScannerExpression(MGTemplateHTMLScanner* scanner) {
+	MGTemplateEscapeContext context = MGTemplateEscapeHTML;
+	
+	switch(scanner->state) {
+		case kScanText:
+		case kScanComment:
+			break;
+			
+		case kScanRawText:
+			context = (scanner->rawText == kRawTextScript) ? scriptExpression(scanner, NO) : MGTemplateEscapeHTML;
+			break;
+			
+		case kScanDoubleQuotedValue:
+		case kScanSingleQuotedValue:
+			if(isEventAttribute(scanner->attributeName)) {
+				context = scriptExpression(scanner, YES);
+			} else if(isURLAttribute(scanner->attributeName)) {
+				if(scanner->valueLength == 0) {
+					context = MGTemplateEscapeURL;
+				} else {
+					context = (scanner->URLQuery) ? MGTemplateEscapeURLQuery : MGTemplateEscapeURLPath;
+				}
+			} else {
+				context = MGTemplateEscapeAttribute;
+			}
+			scanner->valueLength++;
+			break;
+			
+		case kScanBeforeAttributeValue:
+			//The expression starts an unquoted value
+			beginValue(scanner, kScanUnquotedValue);
+			//Fall through
+		case kScanUnquotedValue:
+			if(isEventAttribute(scanner->attributeName)) {
+				context = scriptExpression(scanner, YES);
+			} else if(isURLAttribute(scanner->attributeName)) {
+				if(scanner->valueLength == 0) {
+					context = MGTemplateEscapeUnquotedURL;
+				} else {
+					context = (scanner->URLQuery) ? MGTemplateEscapeURLQuery : MGTemplateEscapeURLPath;
+				}
+			} else {
+				context = MGTemplateEscapeUnquotedAttribute;
+			}
+			scanner->valueLength++;
+			break;
+			
+		default:
+			//Inside a tag, ie an attribute name
+			context = MGTemplateEscapeUnquotedAttribute;
+			break;
+	}
+	return context;
+}
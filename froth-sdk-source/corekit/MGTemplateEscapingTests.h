@@ -0,0 +1,15 @@
+//
+//  MGTemplateEscapingTests.h
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "FrothTestCase.h"
+
+
+@interface MGTemplateEscapingTests : FrothTestCase {
+
+}
+
+@end
@@ -0,0 +1,133 @@
+//
+//  MGTemplateEscapingTests.m
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "MGTemplateEscapingTests.h"
+#import "MGTemplateEngine.h"
+#import "AGRegexTemplateMatcher.h"
+
+#define kHTMLValue		@"\"><b>&"
+#define kScriptValue	@"';alert(1)//"
+
+/*
+	Renders template with html autoescaping and x as the only variable, as a string and as utf8 data (which escapes in chunks).
+ */
+static NSString* renderEscaped(NSString* template, NSString* x, NSString** dataResult) {
+	MGTemplateEngine* engine = [MGTemplateEngine templateEngine];
+	[engine setMatcher:[AGRegexTemplateMatcher matcherWithTemplateEngine:engine]];
+	[engine setAutoescape:MGTemplateEscapeHTML];
+	
+	MGCompiledTemplate* compiled = [engine compileTemplate:template];
+	NSDictionary* variables = [NSDictionary dictionaryWithObject:x forKey:@"x"];
+	
+	NSData* data = [engine processCompiledTemplateToUTF8Data:compiled withVariables:variables];
+	*dataResult = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+	return [engine processCompiledTemplate:compiled withVariables:variables];
+}
+
+/*
+	Each case is a template, the value of x and the expected output.
+ */
+static int failedEscapingCases(NSArray* cases) {
+	int failed = 0;
+	for(NSUInteger i = 0; i + 2 < [cases count]; i += 3) {
+		NSString* template = [cases objectAtIndex:i];
+		NSString* expected = [cases objectAtIndex:i+2];
+		NSString* dataResult = nil;
+		NSString* result = renderEscaped(template, [cases objectAtIndex:i+1], &dataResult);
+		if(![result isEqualToString:expected] || ![dataResult isEqualToString:expected]) {
+			NSLog(@"+++ [[ERROR]] Escaping [%@]\nexpected:%@\nstring:%@\ndata:%@", template, expected, result, dataResult);
+			failed++;
+		}
+	}
+	return failed;
+}
+
+@implementation MGTemplateEscapingTests
+
+- (NSArray*)tests {
+	return [NSArray arrayWithObjects:@"test_text", 
+			@"test_attributes", 
+			@"test_urls", 
+			@"test_script", 
+			@"test_eventHandlers", nil];
+}
+
+- (void)test_text {
+	NSArray* cases = [NSArray arrayWithObjects:
+		@"<p>{{ x }}</p>", kHTMLValue, @"<p>&#34;&gt;&lt;b&gt;&amp;</p>", 
+		@"<!-- {{ x }} -->", kHTMLValue, @"<!-- &#34;&gt;&lt;b&gt;&amp; -->", 
+		@"<p>{{ x | raw }}</p>", @"<b>bold</b>", @"<p><b>bold</b></p>", 
+		@"<style>p{}</style><p>{{ x }}</p>", @"<b>", @"<style>p{}</style><p>&lt;b&gt;</p>", nil];
+	
+	int failed = failedEscapingCases(cases);
+	FRAssertTrue(failed == 0, @"%i text cases escaped incorrectly", failed);
+	FRPass(@"Escaped %i text cases", (int)[cases count] / 3);
+}
+
+- (void)test_attributes {
+	NSArray* cases = [NSArray arrayWithObjects:
+		@"<p title=\"{{ x }}\">", kHTMLValue, @"<p title=\"&#34;&gt;&lt;b&gt;&amp;\">", 
+		@"<p title='{{ x }}'>", @"it's `ok`", @"<p title='it&#39;s &#96;ok&#96;'>", 
+		@"<p title={{ x }}>", @"a b=c", @"<p title=a&#32;b&#61;c>", 
+		@"<p title=a{{ x }} class=\"{{ x }}\">", @"b c", @"<p title=ab&#32;c class=\"b c\">", nil];
+	
+	int failed = failedEscapingCases(cases);
+	FRAssertTrue(failed == 0, @"%i attribute cases escaped incorrectly", failed);
+	FRPass(@"Escaped %i attribute cases", (int)[cases count] / 3);
+}
+
+- (void)test_urls {
+	NSArray* cases = [NSArray arrayWithObjects:
+		@"<a href=\"{{ x }}\">", @"javascript:alert(1)", @"<a href=\"#\">", 
+		@"<a href=\"{{ x }}\">", @"http://example.com/a?b=c&d", @"<a href=\"http://example.com/a?b=c&amp;d\">", 
+		@"<a href={{ x }}>", @"http://example.com/a?b=c", @"<a href=http://example.com/a?b&#61;c>", 
+		@"<a href={{ x }}>", @"JavaScript:alert(1)", @"<a href=#>", 
+		@"<a href=\"/users/{{ x }}?q={{ x }}\">", @"a b&c", @"<a href=\"/users/a%20b%26c?q=a%20b%26c\">", 
+		@"<img src=/images/{{ x }}>", @"a b/c.png", @"<img src=/images/a%20b/c.png>", nil];
+	
+	int failed = failedEscapingCases(cases);
+	FRAssertTrue(failed == 0, @"%i url cases escaped incorrectly", failed);
+	FRPass(@"Escaped %i url cases", (int)[cases count] / 3);
+}
+
+- (void)test_script {
+	NSArray* cases = [NSArray arrayWithObjects:
+		@"<script>var a = {{ x }};</script>", kScriptValue, 
+			@"<script>var a = \"\\u0027;alert(1)\\u002F\\u002F\";</script>", 
+		@"<script>var a = '{{ x }}', b = \"{{ x }}\";</script>", kScriptValue, 
+			@"<script>var a = '\\u0027;alert(1)\\u002F\\u002F', b = \"\\u0027;alert(1)\\u002F\\u002F\";</script>", 
+		@"<script>var a = {{ x }};</script><p>{{ x }}</p>", @"</script>", 
+			@"<script>var a = \"\\u003C\\u002Fscript\\u003E\";</script><p>&lt;/script&gt;</p>", 
+		@"<script>var r = /'/; // it's\nvar a = {{ x }};</script>", @"v", 
+			@"<script>var r = /'/; // it's\nvar a = \"v\";</script>", 
+		@"<script>var n = a / 2, s = '/'; var a = {{ x }};</script>", @"v", 
+			@"<script>var n = a / 2, s = '/'; var a = \"v\";</script>", 
+		@"<script>var t = `${ {{ x }} } {{ x }}`;</script>", @"${v}", 
+			@"<script>var t = `${ \"\\u0024{v}\" } \\u0024{v}`;</script>", nil];
+	
+	int failed = failedEscapingCases(cases);
+	FRAssertTrue(failed == 0, @"%i script cases escaped incorrectly", failed);
+	FRPass(@"Escaped %i script cases", (int)[cases count] / 3);
+}
+
+- (void)test_eventHandlers {
+	NSArray* cases = [NSArray arrayWithObjects:
+		@"<button onclick=\"go({{ x }})\">", kScriptValue, 
+			@"<button onclick=\"go(&#34;\\u0027;alert(1)\\u002F\\u002F&#34;)\">", 
+		@"<button onclick=\"go('{{ x }}')\">", kScriptValue, 
+			@"<button onclick=\"go('\\u0027;alert(1)\\u002F\\u002F')\">", 
+		@"<button onclick=\"go(&quot;{{ x }}&quot;)\">", kScriptValue, 
+			@"<button onclick=\"go(&quot;\\u0027;alert(1)\\u002F\\u002F&quot;)\">", 
+		@"<button onclick=go({{ x }})>", @"a b", 
+			@"<button onclick=go(&#34;a\\u0020b&#34;)>", nil];
+	
+	int failed = failedEscapingCases(cases);
+	FRAssertTrue(failed == 0, @"%i event handler cases escaped incorrectly", failed);
+	FRPass(@"Escaped %i event handler cases", (int)[cases count] / 3);
+}
+
+@end
@@ -6,6 +6,7 @@
 //
 
 #import "MGTemplateStandardFilters.h"
+#import "MGTemplateEngine.h"
 
 
 #define UPPERCASE		@"uppercase"
@@ -13,6 +14,7 @@
 #define CAPITALIZED		@"capitalized"
 #define DATE_FORMAT		@"date_format"
 #define COLOR_FORMAT	@"color_format"
+#define RAW				RAW_FILTER
 
 
 @implementation MGTemplateStandardFilters
@@ -23,13 +25,18 @@
 	return [NSArray arrayWithObjects:
 			UPPERCASE, LOWERCASE, CAPITALIZED, 
 			DATE_FORMAT, COLOR_FORMAT, 
+			RAW, 
 			nil];
 }
 
 
 - (NSObject *)filterInvoked:(NSString *)filter withArguments:(NSArray *)args onValue:(NSObject *)value
 {
-	if ([filter isEqualToString:UPPERCASE]) {
+	if ([filter isEqualToString:RAW]) {
+		// The engine skips autoescaping for this filter, the value is unchanged.
+		return value;
+		
+	} else if ([filter isEqualToString:UPPERCASE]) {
 		return [[NSString stringWithFormat:@"%@", value] uppercaseString];
 		
 	} else if ([filter isEqualToString:LOWERCASE]) {
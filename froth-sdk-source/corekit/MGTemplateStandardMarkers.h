@@ -17,10 +17,12 @@
 	NSMutableArray *ifStack;
 	NSMutableArray *commentStack;
 	NSMutableDictionary *cycles;
+	NSMutableArray *cacheStack;
 }
 
 - (BOOL)currentBlock:(NSDictionary *)blockInfo matchesTopOfStack:(NSMutableArray *)stack;
 - (BOOL)argIsNumeric:(NSString *)arg intValue:(int *)val checkVariables:(BOOL)checkVars;
 - (BOOL)argIsTrue:(NSString *)arg;
+- (NSString *)cacheKeyForName:(NSString *)name;
 
 @end
@@ -16,16 +16,14 @@
 #define FOR_TYPE_ENUMERATOR				@"in"	// e.g. for thing in things
 #define FOR_TYPE_RANGE					@"to"	// e.g. for 1 to 5
 #define FOR_REVERSE						@"reversed"
+#define FOR_LIMIT						@"limit"	// e.g. for thing in things limit 10 offset 20
+#define FOR_OFFSET						@"offset"
 
-#define FOR_LOOP_VARS					@"currentLoop"
-#define FOR_LOOP_CURR_INDEX				@"currentIndex"
-#define FOR_LOOP_START_INDEX			@"startIndex"
-#define FOR_LOOP_END_INDEX				@"endIndex"
-#define FOR_PARENT_LOOP					@"parentLoop"
+#define FOR_LOOP_VARS					@"currentLoop"	// an MGTemplateLoopFrame
 
 #define STACK_START_MARKER_RANGE		@"markerRange"
 #define STACK_START_REMAINING_RANGE		@"remainingRange"
-#define FOR_STACK_ENUMERATOR			@"enumerator"
+#define FOR_STACK_LOOP					@"loop"
 #define FOR_STACK_ENUM_VAR				@"enumeratorVariable"
 #define FOR_STACK_DISABLED_OUTPUT		@"disabledOutput"
 
@@ -70,6 +68,94 @@
 
 //==============================================================================
 
+#define CACHE_START			@"cache"	// e.g. cache "sidebar-{user.id}" 300
+#define CACHE_END			@"/cache"
+
+#define CACHE_KEY			@"key"
+#define CACHE_NAME			@"name"
+#define CACHE_LIFETIME		@"lifetime"
+#define CACHE_OUTPUT_MARK	@"outputMark"
+
+//==============================================================================
+
+#define FLUSH				@"flush"	// sends the output so far to the client when streaming
+
+//==============================================================================
+
+
+// The currentLoop variable of a for block. One frame is made per loop and updated in place on each iteration, 
+// templates read currentIndex, startIndex, endIndex, reversed and parentLoop as before, plus index (from 0), count, 
+// first and last.
+@interface MGTemplateLoopFrame : NSObject {
+@public
+	NSArray *items;				// indexed collection, or nil
+	NSEnumerator *enumerator;	// other collections
+	int sliceStart;
+	int startIndex;
+	int endIndex;
+	int currentIndex;
+	int index;
+	int count;
+	BOOL reversed;
+	NSObject *parentLoop;
+}
+
+- (NSObject *)currentItem;	// once per iteration, as enumerated collections are consumed
+- (BOOL)advance;
+
+@end
+
+
+@implementation MGTemplateLoopFrame
+
+
+- (void)dealloc
+{
+	[items release];
+	[enumerator release];
+	[parentLoop release];
+	[super dealloc];
+}
+
+
+- (NSObject *)currentItem
+{
+	if (items) {
+		int position = (reversed) ? (count - 1 - index) : index;
+		return [items objectAtIndex:sliceStart + position];
+	}
+	return [enumerator nextObject];
+}
+
+
+- (BOOL)advance
+{
+	if (index + 1 >= count) {
+		return NO;
+	}
+	index++;
+	if (reversed) {
+		currentIndex--;
+	} else {
+		currentIndex++;
+	}
+	return YES;
+}
+
+
+- (NSNumber *)currentIndex	{ return [NSNumber numberWithInt:currentIndex]; }
+- (NSNumber *)startIndex	{ return [NSNumber numberWithInt:startIndex]; }
+- (NSNumber *)endIndex		{ return [NSNumber numberWithInt:endIndex]; }
+- (NSNumber *)reversed		{ return [NSNumber numberWithBool:reversed]; }
+- (NSNumber *)index			{ return [NSNumber numberWithInt:index]; }
+- (NSNumber *)count			{ return [NSNumber numberWithInt:count]; }
+- (NSNumber *)first			{ return [NSNumber numberWithBool:(index == 0)]; }
+- (NSNumber *)last			{ return [NSNumber numberWithBool:(index == count - 1)]; }
+- (NSObject *)parentLoop	{ return parentLoop; }
+
+
+@end
+
 
 @implementation MGTemplateStandardMarkers
 
@@ -83,6 +169,7 @@
 		ifStack = [[NSMutableArray alloc] init];
 		commentStack = [[NSMutableArray alloc] init];
 		cycles = [[NSMutableDictionary alloc] init];
+		cacheStack = [[NSMutableArray alloc] init];
 	}
 	return self;
 }
@@ -101,6 +188,8 @@
 	commentStack = nil;
 	[cycles release];
 	cycles = nil;
+	[cacheStack release];
+	cacheStack = nil;
 	
 	[super dealloc];
 }
@@ -117,6 +206,8 @@
 			LOAD, 
 			CYCLE, 
 			SET, 
+			CACHE_START, CACHE_END, 
+			FLUSH, 
 			nil];
 }
 
@@ -131,6 +222,8 @@
 		return [NSArray arrayWithObjects:IF_END, ELSE, nil];
 	} else if ([marker isEqualToString:COMMENT_START]) {
 		return [NSArray arrayWithObjects:COMMENT_END, nil];
+	} else if ([marker isEqualToString:CACHE_START]) {
+		return [NSArray arrayWithObjects:CACHE_END, nil];
 	}
 	return nil;
 }
@@ -148,13 +241,30 @@
 			if ([[args objectAtIndex:1] isEqualToString:FOR_TYPE_ENUMERATOR]) {
 				isRange = NO;
 			}
+			
+			// Options follow the collection, e.g. for item in items reversed limit 10 offset 20
 			BOOL reversed = NO;
-			if ([args count] == 4 && [[args objectAtIndex:3] isEqualToString:FOR_REVERSE]) {
-				reversed = YES;
+			int limit = -1;
+			int offset = 0;
+			int argCount = [args count];
+			for (int i = 3; i < argCount; i++) {
+				NSString *option = [args objectAtIndex:i];
+				if ([option isEqualToString:FOR_REVERSE]) {
+					reversed = YES;
+				} else if ([option isEqualToString:FOR_LIMIT] && i + 1 < argCount) {
+					if (![self argIsNumeric:[args objectAtIndex:++i] intValue:&limit checkVariables:YES] || limit < 0) {
+						limit = 0;
+					}
+				} else if ([option isEqualToString:FOR_OFFSET] && i + 1 < argCount) {
+					if (![self argIsNumeric:[args objectAtIndex:++i] intValue:&offset checkVariables:YES] || offset < 0) {
+						offset = 0;
+					}
+				}
 			}
 			
 			// Determine if we have acceptable parameters.
-			NSObject *loopEnumObject = nil;
+			MGTemplateLoopFrame *loop = [[[MGTemplateLoopFrame alloc] init] autorelease];
+			loop->reversed = reversed;
 			BOOL valid = NO;
 			NSString *startArg = [args objectAtIndex:0];
 			NSString *endArg = [args objectAtIndex:2];
@@ -165,8 +275,13 @@
 				if (valid) {
 					valid = [self argIsNumeric:endArg intValue:&endIndex checkVariables:YES];
 					if (valid) {
-						// Check startIndex and endIndex are sensible.
+						// Slice the range, then check startIndex and endIndex are sensible.
+						startIndex += offset;
+						if (limit >= 0 && endIndex > startIndex + limit - 1) {
+							endIndex = startIndex + limit - 1;
+						}
 						valid = (startIndex <= endIndex);
+						loop->count = endIndex - startIndex + 1;
 					}
 				}
 			} else {
@@ -175,10 +290,35 @@
 				// Check that endArg is a collection.
 				NSObject *obj = [engine resolveVariable:endArg];
 				if (obj && [obj respondsToSelector:@selector(objectEnumerator)] && [obj respondsToSelector:@selector(count)]) {
-					endIndex = [(NSArray *)obj count];
+					int total = [(NSArray *)obj count];
+					endIndex = (offset < total) ? total - offset : 0;
+					if (limit >= 0 && endIndex > limit) {
+						endIndex = limit;
+					}
 					if (endIndex > 0) {
-						loopEnumObject = obj;
 						valid = YES;
+						loop->count = endIndex;
+						
+						// Arrays are read by index so a slice needs no copy, other collections are enumerated.
+						if ([obj isKindOfClass:[NSArray class]]) {
+							loop->items = [(NSArray *)obj retain];
+							loop->sliceStart = offset;
+						} else {
+							// A reversed slice starts after the items past its end.
+							NSEnumerator *enumerator;
+							int skip;
+							if (reversed && [obj respondsToSelector:@selector(reverseObjectEnumerator)]) {
+								enumerator = [(NSArray *)obj reverseObjectEnumerator];
+								skip = total - offset - endIndex;
+							} else {
+								enumerator = [(NSArray *)obj objectEnumerator];
+								skip = offset;
+							}
+							for (int i = 0; i < skip; i++) {
+								[enumerator nextObject];
+							}
+							loop->enumerator = [enumerator retain];
+						}
 					}
 				}
 			}
@@ -186,44 +326,39 @@
 			if (valid) {
 				*blockStarted = YES;
 				
+				// Set up the loop. The frame is updated in place on each iteration.
+				loop->startIndex = startIndex;
+				loop->endIndex = endIndex;
+				loop->currentIndex = (reversed) ? endIndex : startIndex;
+				
 				// Set up for-stack frame for this loop.
 				NSMutableDictionary *stackFrame = [NSMutableDictionary dictionaryWithObjectsAndKeys:
 												   [NSValue valueWithRange:markerRange], STACK_START_MARKER_RANGE, 
 												   [NSValue valueWithRange:*nextRange], STACK_START_REMAINING_RANGE, 
+												   loop, FOR_STACK_LOOP, 
 												   nil];
 				[forStack addObject:stackFrame];
 				
 				// Set up variables for the block.
-				int currentIndex = (reversed) ? endIndex : startIndex;
-				NSMutableDictionary *loopVars = [NSMutableDictionary dictionaryWithObjectsAndKeys:
-												 [NSNumber numberWithInt:startIndex], FOR_LOOP_START_INDEX, 
-												 [NSNumber numberWithInt:endIndex], FOR_LOOP_END_INDEX, 
-												 [NSNumber numberWithInt:currentIndex], FOR_LOOP_CURR_INDEX, 
-												 [NSNumber numberWithBool:reversed], FOR_REVERSE, 
-												 nil];
 				NSMutableDictionary *blockVars = [NSMutableDictionary dictionaryWithObjectsAndKeys:
-												  loopVars, FOR_LOOP_VARS, 
+												  loop, FOR_LOOP_VARS, 
 												  nil];
 				
 				// Add enumerator variable if appropriate.
 				if (!isRange) {
-					NSEnumerator *enumerator;
-					if (reversed && [loopEnumObject respondsToSelector:@selector(reverseObjectEnumerator)]) {
-						enumerator = [(NSArray *)loopEnumObject reverseObjectEnumerator];
-					} else {
-						enumerator = [(NSArray *)loopEnumObject objectEnumerator];
-					}
-					[stackFrame setObject:enumerator forKey:FOR_STACK_ENUMERATOR];
 					[stackFrame setObject:startArg forKey:FOR_STACK_ENUM_VAR];
-					[blockVars setObject:[enumerator nextObject] forKey:startArg];
+					NSObject *item = [loop currentItem];
+					if (item) {
+						[blockVars setObject:item forKey:startArg];
+					}
 				}
 				
 				// Add parentLoop if it exists.
 				if (blockInfo) {
-					NSDictionary *parentLoop;
-					parentLoop = (NSDictionary *)[engine resolveVariable:FOR_LOOP_VARS]; // in case parent loop isn't in the first parent stack-frame.
+					NSObject *parentLoop;
+					parentLoop = [engine resolveVariable:FOR_LOOP_VARS]; // in case parent loop isn't in the first parent stack-frame.
 					if (parentLoop) {
-						[loopVars setObject:parentLoop forKey:FOR_PARENT_LOOP];
+						loop->parentLoop = [parentLoop retain];
 					}
 				}
 				
@@ -252,65 +387,29 @@
 				*outputEnabled = YES;
 				*blockEnded = YES;
 				[forStack removeLastObject];
-			}
-			
-			// This is the same loop that's on top of our stack. Check to see if we need to loop back.
-			BOOL loop = NO;
-			NSDictionary *blockVars = [blockInfo objectForKey:BLOCK_VARIABLES_KEY];
-			if ([blockVars count] == 0) {
-				*blockEnded = YES;
 				return nil;
 			}
-			NSMutableDictionary *loopVars = [[[blockVars objectForKey:FOR_LOOP_VARS] mutableCopy] autorelease];
-			BOOL reversed = [[loopVars objectForKey:FOR_REVERSE] boolValue];
-			NSEnumerator *loopEnum = [frame objectForKey:FOR_STACK_ENUMERATOR];
-			NSObject *newEnumValue = nil;
-			int currentIndex = [[loopVars objectForKey:FOR_LOOP_CURR_INDEX] intValue];
-			if (loopEnum) {
-				// Enumerator type.
-				newEnumValue = [loopEnum nextObject];
-				if (newEnumValue) {
-					loop = YES;
-				}
-			} else {
-				// Range type.
-				if (reversed) {
-					int minIndex = [[loopVars objectForKey:FOR_LOOP_START_INDEX] intValue];
-					if (currentIndex > minIndex) {
-						loop = YES;
-					}
-				} else {
-					int maxIndex = [[loopVars objectForKey:FOR_LOOP_END_INDEX] intValue];
-					if (currentIndex < maxIndex) {
-						loop = YES;
-					}
-				}
-			}
 			
-			if (loop) {
-				// Set remainingRange from stack dict
+			// This is the same loop that's on top of our stack. Check to see if we need to loop back.
+			MGTemplateLoopFrame *loop = [frame objectForKey:FOR_STACK_LOOP];
+			if (loop && [loop advance]) {
+				// Set remainingRange from stack dict, the engine carries on from the start of the body.
 				*nextRange = [[frame objectForKey:STACK_START_REMAINING_RANGE] rangeValue];
 				
-				// Set new currentIndex
-				if (reversed) {
-					currentIndex--;
-				} else {
-					currentIndex++;
-				}
-				[loopVars setObject:[NSNumber numberWithInt:currentIndex] forKey:FOR_LOOP_CURR_INDEX];
-				
-				// Set new val for enumVar if specified
-				NSMutableDictionary *newVars = [NSMutableDictionary dictionaryWithObjectsAndKeys:
-												loopVars, FOR_LOOP_VARS, 
-												nil];
-				if (newEnumValue) {
-					[newVars setObject:newEnumValue forKey:[frame objectForKey:FOR_STACK_ENUM_VAR]];
+				// Set new val for enumVar if specified, straight into this block's variables.
+				NSString *enumVar = [frame objectForKey:FOR_STACK_ENUM_VAR];
+				if (enumVar) {
+					NSObject *item = [loop currentItem];
+					NSMutableDictionary *blockVars = [blockInfo objectForKey:BLOCK_VARIABLES_KEY];
+					if (item && [blockVars isKindOfClass:[NSMutableDictionary class]]) {
+						[blockVars setObject:item forKey:enumVar];
+					} else if (item) {
+						*newVariables = [NSDictionary dictionaryWithObject:item forKey:enumVar];
+					}
 				}
-				
-				*newVariables = newVars;
 			} else {
 				// Don't need to do much here, since:
-				// 1. Each blockStack frame for a "for" has its own currentLoop dict.
+				// 1. Each blockStack frame for a "for" has its own loop frame.
 				// 2. Parent loop's enum-vars are still in place in the parent stack's vars.
 				
 				// End block.
@@ -538,12 +637,102 @@
 				*newVariables = newVar;
 			}
 		}
+		
+	} else if ([marker isEqualToString:CACHE_START]) {
+		if (args && ([args count] == 1 || [args count] == 2)) {
+			// Only look up fragments that would be output.
+			id <MGTemplateFragmentCache> cache = [MGTemplateEngine fragmentCache];
+			NSString *name = [args objectAtIndex:0];
+			NSString *key = (cache && *outputEnabled) ? [self cacheKeyForName:name] : nil;
+			
+			NSData *fragment = (key) ? [cache fragmentForKey:key name:name] : nil;
+			if (fragment) {
+				// Output the cached fragment and resume after the end of the block, without rendering it.
+				NSRange endRange = [engine rangeOfEndMarker:[NSArray arrayWithObject:CACHE_END] forBlock:CACHE_START 
+												 afterRange:markerRange];
+				if (endRange.location != NSNotFound) {
+					*nextRange = NSMakeRange(NSMaxRange(endRange), [[engine templateContents] length] - NSMaxRange(endRange));
+					return fragment;
+				}
+			}
+			
+			// Render the block, capturing its output if we have a key to store it under.
+			*blockStarted = YES;
+			int lifetime = 0;
+			if ([args count] == 2 && ![self argIsNumeric:[args objectAtIndex:1] intValue:&lifetime checkVariables:YES]) {
+				lifetime = 0;
+			}
+			NSMutableDictionary *stackFrame = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+											   [NSValue valueWithRange:markerRange], STACK_START_MARKER_RANGE, 
+											   name, CACHE_NAME, 
+											   [NSNumber numberWithInt:lifetime], CACHE_LIFETIME, 
+											   nil];
+			if (key) {
+				[stackFrame setObject:key forKey:CACHE_KEY];
+				[stackFrame setObject:[NSNumber numberWithUnsignedInteger:[engine beginOutputCapture]] forKey:CACHE_OUTPUT_MARK];
+			}
+			[cacheStack addObject:stackFrame];
+		}
+		
+	} else if ([marker isEqualToString:CACHE_END]) {
+		if ([self currentBlock:blockInfo matchesTopOfStack:cacheStack]) {
+			NSDictionary *frame = [cacheStack lastObject];
+			NSString *key = [frame objectForKey:CACHE_KEY];
+			if (key) {
+				NSData *fragment = [engine endOutputCaptureFromMark:[[frame objectForKey:CACHE_OUTPUT_MARK] unsignedIntegerValue]];
+				if (fragment && *outputEnabled) {
+					[[MGTemplateEngine fragmentCache] setFragment:fragment forKey:key name:[frame objectForKey:CACHE_NAME] 
+														 lifetime:[[frame objectForKey:CACHE_LIFETIME] intValue]];
+				}
+			}
+			
+			// End block.
+			[cacheStack removeLastObject];
+		}
+		*blockEnded = YES;
+		
+	} else if ([marker isEqualToString:FLUSH]) {
+		if (*outputEnabled) {
+			[engine flushOutput];
+		}
 	}
 	
 	return nil;
 }
 
 
+- (NSString *)cacheKeyForName:(NSString *)name
+{
+	// Substitute {variable} segments, ie "sidebar-{user.id}" becomes "sidebar-42".
+	NSRange open = [name rangeOfString:@"{"];
+	if (open.location == NSNotFound) {
+		return name;
+	}
+	
+	NSUInteger length = [name length];
+	NSUInteger location = 0;
+	NSMutableString *key = [NSMutableString stringWithCapacity:length + 16];
+	while (open.location != NSNotFound) {
+		NSRange close = [name rangeOfString:@"}" options:0 range:NSMakeRange(NSMaxRange(open), length - NSMaxRange(open))];
+		if (close.location == NSNotFound) {
+			break;
+		}
+		[key appendString:[name substringWithRange:NSMakeRange(location, open.location - location)]];
+		
+		NSString *var = [name substringWithRange:NSMakeRange(NSMaxRange(open), close.location - NSMaxRange(open))];
+		NSObject *value = [engine resolveVariable:[var stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]];
+		if (value) {
+			[key appendString:[value description]];
+		}
+		
+		location = NSMaxRange(close);
+		open = [name rangeOfString:@"{" options:0 range:NSMakeRange(location, length - location)];
+	}
+	[key appendString:[name substringFromIndex:location]];
+	return key;
+}
+
+
 - (BOOL)currentBlock:(NSDictionary *)blockInfo matchesTopOfStack:(NSMutableArray *)stack
 {
 	if (blockInfo && [stack count] > 0) { // end-tag should always have blockInfo, and correspond to a stack frame.
@@ -623,6 +812,10 @@
 	[cycles release];
 	cycles = nil;
 	cycles = [[NSMutableDictionary alloc] init];
+	
+	[cacheStack release];
+	cacheStack = nil;
+	cacheStack = [[NSMutableArray alloc] init];
 }
 
 
@@ -0,0 +1,15 @@
+//
+//  MGTemplateStandardMarkersTests.h
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "FrothTestCase.h"
+
+
+@interface MGTemplateStandardMarkersTests : FrothTestCase {
+
+}
+
+@end
@@ -0,0 +1,84 @@
+//
+//  MGTemplateStandardMarkersTests.m
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "MGTemplateStandardMarkersTests.h"
+#import "MGTemplateEngine.h"
+#import "AGRegexTemplateMatcher.h"
+
+/* An ordered collection that is not an NSArray, so for loops enumerate it */
+@interface MGTemplateTestOrderedCollection : NSObject {
+	NSArray* m_items;
+}
+- (id)initWithItems:(NSArray*)items;
+- (NSUInteger)count;
+- (NSEnumerator*)objectEnumerator;
+- (NSEnumerator*)reverseObjectEnumerator;
+@end
+
+@implementation MGTemplateTestOrderedCollection
+
+- (id)initWithItems:(NSArray*)items {
+	if(self = [super init]) {
+		m_items = [items copy];
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_items release];
+	[super dealloc];
+}
+
+- (NSUInteger)count {
+	return [m_items count];
+}
+
+- (NSEnumerator*)objectEnumerator {
+	return [m_items objectEnumerator];
+}
+
+- (NSEnumerator*)reverseObjectEnumerator {
+	return [m_items reverseObjectEnumerator];
+}
+
+@end
+
+static NSString* renderLoop(NSString* template, id items) {
+	MGTemplateEngine* engine = [MGTemplateEngine templateEngine];
+	[engine setMatcher:[AGRegexTemplateMatcher matcherWithTemplateEngine:engine]];
+	return [engine processTemplate:template withVariables:[NSDictionary dictionaryWithObject:items forKey:@"items"]];
+}
+
+@implementation MGTemplateStandardMarkersTests
+
+- (NSArray*)tests {
+	return [NSArray arrayWithObjects:@"test_reversedCollections", nil];
+}
+
+- (void)test_reversedCollections {
+	NSArray* array = [NSArray arrayWithObjects:@"a", @"b", @"c", @"d", @"e", nil];
+	MGTemplateTestOrderedCollection* collection = [[[MGTemplateTestOrderedCollection alloc] initWithItems:array] autorelease];
+	
+	NSArray* cases = [NSArray arrayWithObjects:
+		@"{% for x in items %}{{ x }}{% /for %}", @"abcde", 
+		@"{% for x in items reversed %}{{ x }}{% /for %}", @"edcba", 
+		@"{% for x in items reversed limit 2 offset 1 %}{{ x }}{% /for %}", @"cb", 
+		@"{% for x in items limit 2 offset 1 %}{{ x }}{% /for %}", @"bc", nil];
+	
+	for(NSUInteger i = 0; i + 1 < [cases count]; i += 2) {
+		NSString* template = [cases objectAtIndex:i];
+		NSString* expected = [cases objectAtIndex:i+1];
+		NSString* arrayResult = renderLoop(template, array);
+		NSString* collectionResult = renderLoop(template, collection);
+		FRAssertTrue([arrayResult isEqualToString:expected], @"Array loop [%@] rendered [%@], expected [%@]", template, arrayResult, expected);
+		FRAssertTrue([collectionResult isEqualToString:expected], @"Collection loop [%@] rendered [%@], expected [%@]", template, collectionResult, expected);
+	}
+	
+	FRPass(@"Reversed loops match for arrays and enumerated collections");
+}
+
+@end
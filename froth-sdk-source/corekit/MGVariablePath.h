@@ -0,0 +1,90 @@
+//
+//  MGVariablePath.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#include <pthread.h>
+
+typedef enum {
+	MGAccessKeyValueCoding = 0,	// -valueForKey:, the fallback for anything below
+	MGAccessDictionary,			// -objectForKey:
+	MGAccessArrayIndex,			// -objectAtIndex: for a numeric key
+	MGAccessGetter,				// The cached IMP of a -key method returning an object
+	MGAccessModelData			// A WebModelBase attribute, read from its -data dictionary
+} MGAccessKind;
+
+/* How to read one key of a path from objects of one class */
+typedef struct {
+	Class cls;
+	MGAccessKind kind;
+	IMP imp;
+} MGAccessorPlan;
+
+#define MG_PATH_PLAN_LIMIT 8
+
+typedef struct {
+	NSString* key;
+	SEL selector;
+	NSInteger index;						// -1 unless the key is all digits
+	MGAccessorPlan* volatile plan;			// The plan for the last receiver class
+	MGAccessorPlan* plans[MG_PATH_PLAN_LIMIT];
+	int planCount;
+} MGPathComponent;
+
+/*!
+	\brief	A template variable path (ie 'data.user.name') split once, with cached accessors for each key.
+ 
+	Each key remembers how it was last read (a dictionary lookup, an array index, an object's getter IMP or a WebModelBase
+	attribute) and the receiver's class, so the next evaluation with the same class skips key value coding. A new receiver
+	class replaces the plan. Keys that see more then MG_PATH_PLAN_LIMIT classes stop caching and pick the access per object.
+ 
+	Paths are immutable apart from their plan caches, which are safe to use from more then one thread, so compiled templates 
+	share them between engines. Keys from the first '@' on (key value coding operators, ie 'items.@count') are always read 
+	with -valueForKeyPath:.
+ */
+@interface MGVariablePath : NSObject {
+	NSString* m_string;
+	MGPathComponent* m_components;
+	NSUInteger m_count;
+	NSString* m_operatorPath;			// The rest of the path from the first '@' key, or nil
+	NSUInteger m_operatorIndex;
+	pthread_mutex_t m_planLock;
+}
+
++ (MGVariablePath*)pathWithString:(NSString*)string;
+- (id)initWithString:(NSString*)string;
+
+/*! \brief The path as written in the template */
+- (NSString*)string;
+
+/*! \brief The first key, used to find the variable scope (template variables, globals or block variables). */
+- (NSString*)firstKey;
+
+/*! \brief Reads the path from container, the dictionary that holds the first key. */
+- (id)valueInContainer:(id)container;
+
+@end
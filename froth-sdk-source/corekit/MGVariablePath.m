@@ -0,0 +1,229 @@
+//
+//  MGVariablePath.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "MGVariablePath.h"
+
+static inline BOOL isDigit(unichar c) {
+	return (c >= '0' && c <= '9');
+}
+
+static void fillPlanForClass(MGAccessorPlan* plan, Class cls, MGPathComponent* component) {
+	static Class modelBaseClass = Nil;
+	if(!modelBaseClass) {
+		modelBaseClass = NSClassFromString(@"WebModelBase");
+	}
+	
+	plan->cls = cls;
+	plan->imp = NULL;
+	plan->kind = MGAccessKeyValueCoding;
+	
+	if([cls isSubclassOfClass:[NSDictionary class]]) {
+		plan->kind = MGAccessDictionary;
+	} else if([cls isSubclassOfClass:[NSArray class]]) {
+		if(component->index >= 0) {
+			plan->kind = MGAccessArrayIndex;
+		}
+	} else if([cls instancesRespondToSelector:component->selector]) {
+		NSMethodSignature* signature = [cls instanceMethodSignatureForSelector:component->selector];
+		if([signature numberOfArguments] == 2 && *[signature methodReturnType] == '@') {
+			plan->kind = MGAccessGetter;
+			plan->imp = [cls instanceMethodForSelector:component->selector];
+		}
+	} else if(modelBaseClass && [cls isSubclassOfClass:modelBaseClass]) {
+		plan->kind = MGAccessModelData;
+	}
+}
+
+static id valueWithPlan(id object, MGAccessorPlan* plan, MGPathComponent* component) {
+	switch(plan->kind) {
+		case MGAccessDictionary:
+			return [(NSDictionary*)object objectForKey:component->key];
+		case MGAccessArrayIndex:
+			return ((NSUInteger)component->index < [(NSArray*)object count]) ? [(NSArray*)object objectAtIndex:component->index] : nil;
+		case MGAccessGetter:
+			return plan->imp(object, component->selector);
+		case MGAccessModelData: {
+			id value = [[object performSelector:@selector(data)] objectForKey:component->key];
+			if(value) return value;
+			break;	//Let key value coding decide (ie a static keys model without the attribute)
+		}
+		default:
+			break;
+	}
+	
+	id value = nil;
+	@try {
+		value = [object valueForKey:component->key];
+	}
+	@catch (NSException* e) {
+		//Unknown keys resolve to nil, as with the engine
+	}
+	
+	//Arrays are also indexed with leading digits (ie 'items.2')
+	if(!value && [object isKindOfClass:[NSArray class]]) {
+		NSInteger index = [component->key integerValue];
+		if([component->key length] > 0 && isDigit([component->key characterAtIndex:0]) && index < [(NSArray*)object count]) {
+			value = [(NSArray*)object objectAtIndex:index];
+		}
+	}
+	return value;
+}
+
+@interface MGVariablePath (Private)
+- (MGAccessorPlan*)_planForClass:(Class)cls component:(MGPathComponent*)component scratch:(MGAccessorPlan*)scratch;
+@end
+
+@implementation MGVariablePath
+
++ (MGVariablePath*)pathWithString:(NSString*)string {
+	return [[[MGVariablePath alloc] initWithString:string] autorelease];
+}
+
+- (id)initWithString:(NSString*)string {
+	if(self = [super init]) {
+		m_string = [string copy];
+		pthread_mutex_init(&m_planLock, NULL);
+		
+		NSArray* keys = [m_string componentsSeparatedByString:@"."];
+		m_count = [keys count];
+		m_operatorIndex = m_count;
+		m_components = calloc(m_count, sizeof(MGPathComponent));
+		
+		for(NSUInteger i = 0; i < m_count; i++) {
+			NSString* key = [keys objectAtIndex:i];
+			MGPathComponent* component = &m_components[i];
+			component->key = [key copy];
+			component->selector = NSSelectorFromString(key);
+			component->index = -1;
+			
+			NSUInteger length = [key length], c;
+			for(c = 0; c < length && isDigit([key characterAtIndex:c]); c++);
+			if(length > 0 && c == length) {
+				component->index = [key integerValue];
+			}
+			
+			if(i > 0 && m_operatorIndex == m_count && [key hasPrefix:@"@"]) {
+				m_operatorIndex = i;
+				m_operatorPath = [[[keys subarrayWithRange:NSMakeRange(i, m_count - i)] componentsJoinedByString:@"."] retain];
+			}
+		}
+	}
+	return self;
+}
+
+- (void)dealloc {
+	for(NSUInteger i = 0; i < m_count; i++) {
+		[m_components[i].key release];
+		for(int p = 0; p < m_components[i].planCount; p++) {
+			free(m_components[i].plans[p]);
+		}
+	}
+	free(m_components);
+	[m_string release];
+	[m_operatorPath release];
+	pthread_mutex_destroy(&m_planLock);
+	[super dealloc];
+}
+
+- (NSString*)string {
+	return m_string;
+}
+
+- (NSString*)firstKey {
+	return m_components[0].key;
+}
+
+- (id)valueInContainer:(id)container {
+	MGAccessorPlan scratch;
+	id value = container;
+	for(NSUInteger i = 0; i < m_operatorIndex && value; i++) {
+		MGPathComponent* component = &m_components[i];
+		Class cls = [value class];
+		
+		MGAccessorPlan* plan = component->plan;
+		if(!plan || plan->cls != cls) {
+			plan = [self _planForClass:cls component:component scratch:&scratch];
+		}
+		value = valueWithPlan(value, plan, component);
+	}
+	
+	if(value && m_operatorPath) {
+		@try {
+			value = [value valueForKeyPath:m_operatorPath];
+		}
+		@catch (NSException* e) {
+			value = nil;
+		}
+	}
+	return value;
+}
+
+- (NSString*)description {
+	return m_string;
+}
+
+@end
+
+@implementation MGVariablePath (Private)
+
+/*
+	Plans are only created under the lock, and are never freed before the path, so a reader on another thread
+	can still use the plan it read while it is being replaced.
+ */
+- (MGAccessorPlan*)_planForClass:(Class)cls component:(MGPathComponent*)component scratch:(MGAccessorPlan*)scratch {
+	pthread_mutex_lock(&m_planLock);
+	
+	MGAccessorPlan* plan = NULL;
+	for(int p = 0; p < component->planCount; p++) {
+		if(component->plans[p]->cls == cls) {
+			plan = component->plans[p];
+			break;
+		}
+	}
+	
+	if(!plan && component->planCount < MG_PATH_PLAN_LIMIT) {
+		plan = malloc(sizeof(MGAccessorPlan));
+		fillPlanForClass(plan, cls, component);
+		component->plans[component->planCount++] = plan;
+	}
+	
+	if(plan) {
+		__sync_synchronize();
+		component->plan = plan;
+	}
+	pthread_mutex_unlock(&m_planLock);
+	
+	if(!plan) {
+		//Too many classes for this key, work out the access for this object only.
+		fillPlanForClass(scratch, cls, component);
+		plan = scratch;
+	}
+	return plan;
+}
+
+@end
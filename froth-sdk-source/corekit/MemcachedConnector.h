@@ -32,6 +32,13 @@
 */
 + (id)sharedConnector;
 
+/*!
+	\brief Adds the servers listed in the app's Memcached.plist (or localhost if there is none), as done for the shared connector
+ 
+	Use this to set up a private connector. A connector is not thread safe, callers that share one between threads must lock around it.
+ */
+- (void)prepareServersFromConfigurationDictionary;
+
 /*!
 	\brief Adds a server to the pool of memcached servers for the connector
 	\return		If the server add was successfull
@@ -67,6 +74,17 @@
  */
 - (id)valueForKey:(NSString*)key;
 
+/*!
+	\brief Sets raw bytes for a key, stored as is with no seralization
+	\param interval An optional expiration, in seconds from now (up to 30 days) or since the unix epoch
+ */
+- (void)setData:(NSData*)data forKey:(NSString*)key expires:(NSTimeInterval)interval;
+
+/*!
+	\brief Returns the raw bytes for a key, or nil if the key is not set. A missing key is not logged as an error.
+ */
+- (NSData*)dataForKey:(NSString*)key;
+
 /*!
 	\brief Provides a multi get from memcached. 
  
@@ -225,6 +225,33 @@ static MemcachedConnector* _sharedServersConnector = nil;
 	return nil;
 }
 
+- (void)setData:(NSData*)data forKey:(NSString*)key expires:(NSTimeInterval)interval {
+	const char* ckey = [key UTF8String];
+	memcached_return_t rc = memcached_set(memc, ckey, strlen(ckey), [data bytes], [data length], (time_t)interval, (uint32_t)0);
+	if(rc) {
+		[self handleReturnError:rc forKey:key];
+	}
+}
+
+- (NSData*)dataForKey:(NSString*)key {
+	memcached_return_t rc;
+	size_t rl;
+	uint32_t flags;
+	
+	const char* ckey = [key UTF8String];
+	char* results = memcached_get(memc, ckey, strlen(ckey), &rl, &flags, &rc);
+	if(!rc && results) {
+		//memcached_get mallocs the value, hand it to the data rather than copying it
+		return [NSData dataWithBytesNoCopy:results length:rl freeWhenDone:YES];
+	} else if(rc && rc != MEMCACHED_NOTFOUND) {
+		[self handleReturnError:rc forKey:key];
+	}
+	if(results) {
+		free(results);
+	}
+	return nil;
+}
+
 /*!
  \brief Provides a multi get from memcached. 
  
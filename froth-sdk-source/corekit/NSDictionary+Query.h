@@ -30,11 +30,40 @@
 
 #import <Foundation/Foundation.h>
 
-/*! \brief provides methods to convert a url query string into a key/value dictionary. for nil values, a string value of {{nil}} is used */
+/*
+	Limits applied while decoding a query or form body. Pairs with keys or values longer then the limits are dropped,
+	and decoding stops once FROTH_QUERY_MAX_PARAMETERS pairs have been read. This keeps a hostile request from
+	filling the dictionary with thousands of colliding keys.
+ */
+#define FROTH_QUERY_MAX_PARAMETERS		1000
+#define FROTH_QUERY_MAX_KEY_LENGTH		256
+#define FROTH_QUERY_MAX_VALUE_LENGTH	(1024*1024)
+
+/*! 
+	\brief provides methods to convert a url query string into a key/value dictionary. for nil values, a string value of {{nil}} is used 
+	
+	Decoding is done in a single pass over the utf8 bytes of the query. Keys and values are percent decoded, every
+	value is a NSString and the last value wins for keys that are repeated. The multiValue methods keep every value 
+	of a repeated key (ie ?tag=a&tag=b) as a NSArray in the order received.
+ */
 @interface NSDictionary (Query)
 
+/*! \brief Decodes a url query (this=that&here=there). '+' characters are left as is. */
 + (NSDictionary*)dictionaryWithQuery:(NSString*)urlQuery;
+
+/*! \brief Decodes an application/x-www-form-urlencoded string, '+' characters are decoded as spaces. */
 + (NSDictionary*)dictionaryWithPostForm:(NSString*)postForm;
+
+/*! \brief Same as +dictionaryWithPostForm: but decodes directly from a request's body data. */
++ (NSDictionary*)dictionaryWithPostFormData:(NSData*)postFormData;
+
+/*! \brief Decodes a url query, repeated keys have a NSArray of their values, other keys a NSString. */
++ (NSDictionary*)multiValueDictionaryWithQuery:(NSString*)urlQuery;
+
+/*! \brief Decodes form body data, repeated keys have a NSArray of their values, other keys a NSString. */
++ (NSDictionary*)multiValueDictionaryWithPostFormData:(NSData*)postFormData;
+
+/*! \brief The inverse of +dictionaryWithQuery:, array values are written as repeated keys. */
 - (NSString*)queryString;
 
 @end
@@ -28,39 +28,209 @@
 //	OTHER DEALINGS IN THE SOFTWARE.
 
 #import "NSDictionary+Query.h"
-#import "NSString+Utilities.h"
+#import "WebRequestArena.h"
 
-@implementation NSDictionary (Query)
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-+ (NSDictionary*)dictionaryWithQuery:(NSString*)urlQuery {
-	if(!urlQuery || [urlQuery isEqualToString:@""]) return [NSDictionary dictionary];
+#define kQueryNilValue		@"{{nil}}"
+#define kQueryStackBuffer	1024
+
+/*
+	Bytes that stop the scanner, everything else is copied through in bulk.
+ */
+static const unsigned char kQuerySpecialChars[256] = {
+	['&'] = 1, ['='] = 1, ['%'] = 1, ['+'] = 1
+};
+
+static inline int queryHexValue(unsigned char c) {
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+/* Returns the first '&', '=', '%' or '+' in [p, end), or end. */
+static inline const unsigned char* queryScan(const unsigned char* p, const unsigned char* end) {
+#if defined(__SSE2__)
+	const __m128i amp = _mm_set1_epi8('&');
+	const __m128i eq = _mm_set1_epi8('=');
+	const __m128i pct = _mm_set1_epi8('%');
+	const __m128i plus = _mm_set1_epi8('+');
+	while(end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, eq)),
+									_mm_or_si128(_mm_cmpeq_epi8(chunk, pct), _mm_cmpeq_epi8(chunk, plus)));
+		int mask = _mm_movemask_epi8(hits);
+		if(mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	while(p < end && !kQuerySpecialChars[*p]) {
+		p++;
+	}
+	return p;
+}
+
+/* Returns a retained string, falling back to latin1 for bytes that are not valid utf8 so we never return nil. */
+static NSString* queryNewString(const unsigned char* bytes, size_t length) {
+	NSString* str = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+	if(!str) {
+		str = [[NSString alloc] initWithBytes:bytes length:length encoding:NSISOLatin1StringEncoding];
+	}
+	return str;
+}
+
+/* Repeated keys collect their values in a mutable array, made immutable once decoding is done. */
+static void querySetValue(NSMutableDictionary* dictionary, NSString* key, NSString* value, BOOL multipleValues) {
+	id existing = (multipleValues) ? [dictionary objectForKey:key] : nil;
+	if(!existing) {
+		[dictionary setObject:value forKey:key];
+	} else if([existing isKindOfClass:[NSMutableArray class]]) {
+		[(NSMutableArray*)existing addObject:value];
+	} else {
+		NSMutableArray* multi = [[NSMutableArray alloc] initWithObjects:existing, value, nil];
+		[dictionary setObject:multi forKey:key];
+		[multi release];
+	}
+}
+
+static void queryFreezeValues(NSMutableDictionary* dictionary) {
+	for(NSString* key in [dictionary allKeys]) {
+		id value = [dictionary objectForKey:key];
+		if([value isKindOfClass:[NSMutableArray class]]) {
+			[dictionary setObject:[NSArray arrayWithArray:value] forKey:key];
+		}
+	}
+}
+
+/*
+	Decodes key=value&key=value pairs from a utf8 buffer in one pass. Each pair is percent decoded into a
+	scratch buffer (key followed by value, decoding never grows the data) and only the final strings are allocated.
+ */
+static NSDictionary* queryDictionaryFromBytes(const char* bytes, NSUInteger length, BOOL decodePlus, BOOL multipleValues) {
+	if(!bytes || length == 0) {
+		return [NSDictionary dictionary];
+	}
+	
+	NSMutableDictionary* dictionary = [NSMutableDictionary dictionaryWithCapacity:MIN(length/8+1, 32)];
 	
-	NSMutableDictionary* dictionary = [NSMutableDictionary dictionary];
-	NSArray* kvs = [urlQuery componentsSeparatedByString:@"&"];
-	for(NSString*cmp in kvs) {
-		NSArray* kvcomps = [cmp componentsSeparatedByString:@"="];
-		if(kvcomps.count > 1) {
-			[dictionary setObject:[[kvcomps objectAtIndex:1] stringByReplacingPercentEscapesUsingEncoding:NSUTF8StringEncoding] forKey:[kvcomps objectAtIndex:0]];
-		} else {
-			[dictionary setObject:@"{{nil}}" forKey:cmp];
+	unsigned char stackBuffer[kQueryStackBuffer];
+	unsigned char* scratch = (length <= kQueryStackBuffer) ? stackBuffer : WebArenaMalloc(length);
+	if(!scratch) {
+		return dictionary;
+	}
+	
+	const unsigned char* p = (const unsigned char*)bytes;
+	const unsigned char* end = p + length;
+	NSUInteger count = 0;
+	
+	while(p < end) {
+		unsigned char* out = scratch;
+		unsigned char* keyEnd = NULL;
+		
+		for(;;) {
+			const unsigned char* hit = queryScan(p, end);
+			if(hit > p) {
+				memcpy(out, p, hit - p);
+				out += hit - p;
+				p = hit;
+			}
+			if(p == end) break;
+			
+			unsigned char c = *p;
+			if(c == '&') {
+				p++;
+				break;
+			} else if(c == '=') {
+				if(keyEnd) {
+					*out++ = '=';	//Only the first '=' seperates the key from the value
+				} else {
+					keyEnd = out;
+				}
+				p++;
+			} else if(c == '+') {
+				*out++ = decodePlus ? ' ' : '+';
+				p++;
+			} else {
+				int hi, lo;
+				if(end - p >= 3 && (hi = queryHexValue(p[1])) >= 0 && (lo = queryHexValue(p[2])) >= 0) {
+					*out++ = (unsigned char)((hi << 4) | lo);
+					p += 3;
+				} else {
+					*out++ = '%';
+					p++;
+				}
+			}
+		}
+		
+		size_t keyLength = (keyEnd ? keyEnd : out) - scratch;
+		size_t valueLength = keyEnd ? (size_t)(out - keyEnd) : 0;
+		
+		if(keyLength == 0 && valueLength == 0) {
+			continue; //Empty pair ie '&&'
 		}
+		
+		if(count >= FROTH_QUERY_MAX_PARAMETERS) {
+			NSLog(@"+++ [[WARNING]] NSDictionary+Query: parameter limit (%i) reached, ignoring the remaining query", FROTH_QUERY_MAX_PARAMETERS);
+			break;
+		}
+		
+		if(keyLength > FROTH_QUERY_MAX_KEY_LENGTH || valueLength > FROTH_QUERY_MAX_VALUE_LENGTH) {
+			NSLog(@"+++ [[WARNING]] NSDictionary+Query: dropping parameter exceeding length limits (key:%u value:%u)", (unsigned)keyLength, (unsigned)valueLength);
+			continue;
+		}
+		
+		NSString* key = queryNewString(scratch, keyLength);
+		NSString* value = keyEnd ? queryNewString(keyEnd, valueLength) : [kQueryNilValue retain];
+		querySetValue(dictionary, key, value, multipleValues);
+		[key release];
+		[value release];
+		count++;
+	}
+	
+	if(scratch != stackBuffer) {
+		WebArenaFree(scratch);
+	}
+	if(multipleValues) {
+		queryFreezeValues(dictionary);
 	}
 	return dictionary;
 }
 
+@implementation NSDictionary (Query)
+
++ (NSDictionary*)dictionaryWithQuery:(NSString*)urlQuery {
+	if(!urlQuery || [urlQuery length] == 0) return [NSDictionary dictionary];
+	
+	const char* bytes = [urlQuery UTF8String];
+	return queryDictionaryFromBytes(bytes, strlen(bytes), NO, NO);
+}
+
 + (NSDictionary*)dictionaryWithPostForm:(NSString*)postForm {
-	NSArray *kv = [postForm componentsSeparatedByString:@"&"];
-	NSMutableDictionary *p = [NSMutableDictionary dictionaryWithCapacity:[kv count]];
-	for(NSString *i in kv) {
-		NSArray *s = [i componentsSeparatedByString:@"="];
-		if([s count] != 2)
-			return nil;
-		NSString* value = [[s objectAtIndex:1] stringByReplacingOccurrencesOfString:@"+" withString:@" "];
-		value = [value postFormDecoded];
-		[p setObject:[value stringByReplacingPercentEscapesUsingEncoding:NSUTF8StringEncoding]
-			  forKey:[s objectAtIndex:0]];
-	}
-	return p;
+	if(!postForm || [postForm length] == 0) return [NSDictionary dictionary];
+	
+	const char* bytes = [postForm UTF8String];
+	return queryDictionaryFromBytes(bytes, strlen(bytes), YES, NO);
+}
+
++ (NSDictionary*)dictionaryWithPostFormData:(NSData*)postFormData {
+	return queryDictionaryFromBytes([postFormData bytes], [postFormData length], YES, NO);
+}
+
++ (NSDictionary*)multiValueDictionaryWithQuery:(NSString*)urlQuery {
+	if(!urlQuery || [urlQuery length] == 0) return [NSDictionary dictionary];
+	
+	const char* bytes = [urlQuery UTF8String];
+	return queryDictionaryFromBytes(bytes, strlen(bytes), NO, YES);
+}
+
++ (NSDictionary*)multiValueDictionaryWithPostFormData:(NSData*)postFormData {
+	return queryDictionaryFromBytes([postFormData bytes], [postFormData length], YES, YES);
 }
 
 - (NSString*)queryString {
@@ -69,11 +239,14 @@
 	
 	NSMutableArray* comps = [NSMutableArray array];
 	for(NSString* akey in allKeys) {
-		NSString* value = [self objectForKey:akey];
-		if([value isEqualToString:@"{{nil}}"]) {
-			[comps addObject:akey];
-		} else {
-			[comps addObject:[NSString stringWithFormat:@"%@=%@", akey, [value stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding]]];
+		id object = [self objectForKey:akey];
+		NSArray* values = [object isKindOfClass:[NSArray class]] ? object : [NSArray arrayWithObject:object];
+		for(NSString* value in values) {
+			if([value isEqualToString:kQueryNilValue]) {
+				[comps addObject:akey];
+			} else {
+				[comps addObject:[NSString stringWithFormat:@"%@=%@", akey, [value stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding]]];
+			}
 		}
 	}
 	return [comps componentsJoinedByString:@"&"];
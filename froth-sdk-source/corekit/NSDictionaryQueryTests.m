@@ -0,0 +1,75 @@
+//
+//  NSDictionaryQueryTests.m
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "NSDictionaryQueryTests.h"
+#import "NSDictionary+Query.h"
+
+@implementation NSDictionaryQueryTests
+
+- (NSArray*)tests {
+	return [NSArray arrayWithObjects:@"test_dictionaryWithQuery_", 
+			@"test_dictionaryWithPostForm_", 
+			@"test_repeatedKeys", 
+			@"test_limits", nil];
+}
+
+- (void)test_dictionaryWithQuery_ {
+	NSDictionary* q = [NSDictionary dictionaryWithQuery:@"name=J%C3%BCrgen&flag&expr=a=b&plus=a+b&&bad=%zz"];
+	
+	FRAssertTrue([[q objectForKey:@"name"] isEqualToString:@"Jürgen"], @"Percent encoded utf8 not decoded [%@]", [q objectForKey:@"name"]);
+	FRAssertTrue([[q objectForKey:@"flag"] isEqualToString:@"{{nil}}"], @"Key without value should be {{nil}} [%@]", [q objectForKey:@"flag"]);
+	FRAssertTrue([[q objectForKey:@"expr"] isEqualToString:@"a=b"], @"Only the first '=' should split the pair [%@]", [q objectForKey:@"expr"]);
+	FRAssertTrue([[q objectForKey:@"plus"] isEqualToString:@"a+b"], @"Query '+' should not be decoded [%@]", [q objectForKey:@"plus"]);
+	FRAssertTrue([[q objectForKey:@"bad"] isEqualToString:@"%zz"], @"Malformed escapes should be kept [%@]", [q objectForKey:@"bad"]);
+	FRAssertTrue(q.count == 5, @"Expected 5 parameters, got %i", (int)q.count);
+	
+	FRPass(@"Decoded query %@", q);
+}
+
+- (void)test_dictionaryWithPostForm_ {
+	NSDictionary* f = [NSDictionary dictionaryWithPostForm:@"title=Hello+World%21&body=line1%0D%0Aline2&empty=&broken"];
+	FRAssertNotNil(f, @"Malformed pairs should not fail the whole form");
+	FRAssertTrue([[f objectForKey:@"title"] isEqualToString:@"Hello World!"], @"'+' not decoded as space [%@]", [f objectForKey:@"title"]);
+	FRAssertTrue([[f objectForKey:@"body"] isEqualToString:@"line1\r\nline2"], @"Line breaks not decoded [%@]", [f objectForKey:@"body"]);
+	FRAssertTrue([[f objectForKey:@"empty"] isEqualToString:@""], @"Empty value should decode as empty string");
+	
+	NSData* data = [@"title=Hello+World%21" dataUsingEncoding:NSUTF8StringEncoding];
+	FRAssertTrue([[[NSDictionary dictionaryWithPostFormData:data] objectForKey:@"title"] isEqualToString:@"Hello World!"], @"Form data decoding differs from string decoding");
+	
+	FRPass(@"Decoded form %@", f);
+}
+
+- (void)test_repeatedKeys {
+	NSDictionary* q = [NSDictionary dictionaryWithQuery:@"tag=a&tag=b&tag=c&one=1"];
+	FRAssertTrue([[q objectForKey:@"tag"] isEqualToString:@"c"], @"The last value of a repeated key should win [%@]", [q objectForKey:@"tag"]);
+	
+	q = [NSDictionary multiValueDictionaryWithQuery:@"tag=a&tag=b&tag=c&one=1"];
+	id tags = [q objectForKey:@"tag"];
+	FRAssertTrue([tags isKindOfClass:[NSArray class]] && ![tags isKindOfClass:[NSMutableArray class]], @"Repeated keys should decode as an immutable array [%@]", [tags class]);
+	FRAssertTrue([tags isEqualToArray:[NSArray arrayWithObjects:@"a", @"b", @"c", nil]], @"Repeated values out of order [%@]", tags);
+	FRAssertTrue([[q objectForKey:@"one"] isEqualToString:@"1"], @"Single values should stay strings [%@]", [q objectForKey:@"one"]);
+	FRAssertTrue([[NSDictionary multiValueDictionaryWithQuery:[q queryString]] isEqualToDictionary:q], @"queryString does not round trip [%@]", [q queryString]);
+	
+	FRPass(@"Repeated keys %@", tags);
+}
+
+- (void)test_limits {
+	NSMutableString* flood = [NSMutableString string];
+	for(int i = 0; i < FROTH_QUERY_MAX_PARAMETERS + 50; i++) {
+		[flood appendFormat:@"k%i=v&", i];
+	}
+	NSDictionary* q = [NSDictionary dictionaryWithQuery:flood];
+	FRAssertTrue(q.count == FROTH_QUERY_MAX_PARAMETERS, @"Parameter limit not enforced, got %i", (int)q.count);
+	
+	NSString* longKey = [@"" stringByPaddingToLength:FROTH_QUERY_MAX_KEY_LENGTH+1 withString:@"k" startingAtIndex:0];
+	q = [NSDictionary dictionaryWithQuery:[NSString stringWithFormat:@"%@=1&ok=1", longKey]];
+	FRAssertTrue(q.count == 1 && [q objectForKey:@"ok"], @"Over long key should be dropped [%@]", [q allKeys]);
+	
+	FRPass(@"Limits enforced");
+}
+
+@end
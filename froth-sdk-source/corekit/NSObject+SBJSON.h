@@ -64,6 +64,11 @@
  */
 - (NSString *)JSONRepresentation;
 
+/*!
+ \brief Returns the receiver encoded in JSON as UTF-8 data, ie for a response body, without creating a string.
+ */
+- (NSData *)JSONData;
+
 /*!
  \brief Convienence method for JSONRepresention for building via templates, for arrays returns the ["one", "two"]...structure unwrapped
  */
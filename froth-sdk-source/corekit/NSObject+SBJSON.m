@@ -28,50 +28,52 @@
  */
 
 #import "NSObject+SBJSON.h"
-#import "SBJsonWriter.h"
-
-static const SBJsonWriter *jsonWriter;
+#import "WKJsonWriter.h"
 
+/* A WKJsonWriter per call, its key cache still helps within an array of models or dictionaries. */
 @implementation NSObject (NSObject_SBJSON)
 
 - (NSString *)JSONFragment {
-	if (!jsonWriter)
-		jsonWriter = [SBJsonWriter new];
+	WKJsonWriter *writer = [[WKJsonWriter alloc] init];
 	
-    NSString *json = [jsonWriter stringWithFragment:self];
-    if (json)
-        return json;
-
-    NSLog(@"-JSONFragment failed. Error trace is: %@", [jsonWriter errorTrace]);
-    return nil;
+    NSData *data = [writer dataWithObject:self];
+    NSString *json = (data) ? [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease] : nil;
+    if (!json)
+        NSLog(@"-JSONFragment failed. Error trace is: %@", [writer errorTrace]);
+    
+    [writer release];
+    return json;
 }
 
 - (NSString *)JSONRepresentation {
-	if (!jsonWriter)
-		jsonWriter = [SBJsonWriter new];
-		
-    NSString *json = [jsonWriter stringWithObject:self];
-    if (json)
-        return json;
+	WKJsonWriter *writer = [[WKJsonWriter alloc] init];
+	
+    NSString *json = [writer stringWithObject:self];
+    if (!json)
+        NSLog(@"-JSONRepresentation failed. Error trace is: %@", [writer errorTrace]);
     
-    NSLog(@"-JSONRepresentation failed. Error trace is: %@", [jsonWriter errorTrace]);
-    return nil;
+    [writer release];
+    return json;
+}
+
+- (NSData *)JSONData {
+	WKJsonWriter *writer = [[WKJsonWriter alloc] init];
+	
+    NSData *data = [writer dataWithObject:self];
+    if (!data)
+        NSLog(@"-JSONData failed. Error trace is: %@", [writer errorTrace]);
+    
+    [writer release];
+    return data;
 }
 
 - (NSString *)json {
-	NSString* rep = nil;
-	if([self isKindOfClass:[NSArray array]]) {
-		if(!jsonWriter)
-			jsonWriter = [SBJsonWriter new];
-		
-		NSMutableString* arrStr = [NSMutableString string];
-		if([jsonWriter appendArray:(NSArray*)self into:arrStr]) 
-			rep = [self JSONRepresentation];
-	} else if([self isKindOfClass:[NSString class]]) {
+	if([self isKindOfClass:[NSString class]]) {
 		return [NSString stringWithFormat:@"['%@']", (NSString*)self];
-	} else {
-		rep = [self JSONRepresentation];
 	}
+	
+	//Arrays that can not be written fail in -JSONRepresentation, like any other value
+	NSString* rep = [self JSONRepresentation];
 	if(!rep || !rep.length) 
 		return @"null";
 	return rep;
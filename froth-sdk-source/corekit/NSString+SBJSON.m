@@ -28,36 +28,37 @@
  */
 
 #import "NSString+SBJSON.h"
-#import "SBJsonParser.h"
-
-static const SBJsonParser *jsonParser;
+#import "WKJsonParser.h"
 
+/*
+	A parser per call, the parse state is on the stack so this is cheap, and unlike a shared parser it is safe to call
+	from request threads.
+ */
 @implementation NSString (NSString_SBJSON)
 
 - (id)JSONFragmentValue
 {
-	if (!jsonParser)
-		jsonParser = [SBJsonParser new];
+	WKJsonParser *jsonParser = [[WKJsonParser alloc] init];
+	const char *bytes = [self UTF8String];
     
-    id repr = [jsonParser fragmentWithString:self];
-    if (repr)
-        return repr;
+    id repr = [jsonParser fragmentWithUTF8String:bytes length:(bytes) ? strlen(bytes) : 0];
+    if (!repr)
+        NSLog(@"-JSONFragmentValue failed. Error trace is: %@", [jsonParser errorTrace]);
     
-    NSLog(@"-JSONFragmentValue failed. Error trace is: %@", [jsonParser errorTrace]);
-    return nil;
+    [jsonParser release];
+    return repr;
 }
 
 - (id)JSONValue
 {
-	if (!jsonParser)
-		jsonParser = [SBJsonParser new];
+	WKJsonParser *jsonParser = [[WKJsonParser alloc] init];
     
     id repr = [jsonParser objectWithString:self];
-    if (repr)
-        return repr;
+    //if (!repr)
+    //    NSLog(@"-JSONValue failed. Error trace is: %@", [jsonParser errorTrace]);
     
-    //NSLog(@"-JSONValue failed. Error trace is: %@", [jsonParser errorTrace]);
-    return nil;
+    [jsonParser release];
+    return repr;
 }
 
 @end
@@ -29,6 +29,7 @@
 
 #import "NSString+Utilities.h"
 #import "AGRegex.h"
+#import "MGTemplateEscaping.h"
 
 #ifndef __APPLE__
 #import <uuid/uuid.h>
@@ -137,11 +138,7 @@
 }
 
 - (NSString*)htmlSanatize {
-	NSString* save = [self stringByReplacingOccurrencesOfString:@"&" withString:@"&amp;"];
-	save = [save stringByReplacingOccurrencesOfString:@"<" withString:@"&lt;"];
-	save = [save stringByReplacingOccurrencesOfString:@">" withString:@"&gt;"];
-	save = [save stringByReplacingOccurrencesOfString:@"\"" withString:@"&quot;"];
-	return save;
+	return MGTemplateEscapeString(MGTemplateEscapeHTML, self);
 }
 
 - (NSString*)ejson {
@@ -0,0 +1,146 @@
+//
+//  SDBResponseTests.m
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "SDBResponseTests.h"
+#include "response.h"
+
+#define kSelectPage		"<?xml version=\"1.0\"?><SelectResponse xmlns=\"http://sdb.amazonaws.com/doc/2009-04-15/\"><SelectResult>" \
+						"<Item><Name>i1</Name><Attribute><Name>a</Name><Value>x &amp; y</Value></Attribute>" \
+						"<Attribute><Name>b</Name><Value></Value></Attribute></Item><Item><Name>i2</Name></Item>" \
+						"<NextToken>tok</NextToken></SelectResult><ResponseMetadata><RequestId>abc</RequestId>" \
+						"<BoxUsage>0.0000219907</BoxUsage></ResponseMetadata></SelectResponse>"
+
+/*
+	Parses xml into r, appending when r already holds a result as SDBDataConnector does for NextToken pages.
+ */
+static int parseResponse(struct sdb_response* r, const char* xml) {
+	if(r->type != SDB_R_NONE) {
+		sdb_response_prepare_append(r);
+	}
+	r->internal->errout = NULL;
+	return sdb_response_parse(r, xml, strlen(xml));
+}
+
+/*
+	Parses xml into a new response and returns the result code.
+ */
+static int parseSingleResponse(const char* xml) {
+	struct sdb_response r;
+	sdb_response_init(&r);
+	int rc = parseResponse(&r, xml);
+	sdb_response_cleanup(&r);
+	return rc;
+}
+
+@implementation SDBResponseTests
+
+- (NSArray*)tests {
+	return [NSArray arrayWithObjects:@"test_select", 
+			@"test_appendPages", 
+			@"test_errors", 
+			@"test_metadata", 
+			@"test_malformed", nil];
+}
+
+- (void)test_select {
+	struct sdb_response r;
+	sdb_response_init(&r);
+	
+	int rc = parseResponse(&r, kSelectPage);
+	FRAssertTrue(rc == SDB_OK, @"Select page failed with %i", rc);
+	FRAssertTrue(r.type == SDB_R_ITEM_LIST && r.size == 2, @"Select page has type %i and %i items", r.type, r.size);
+	FRAssertTrue(r.has_more && r.internal->next_token && strcmp(r.internal->next_token, "tok") == 0, @"Next token not kept");
+	FRAssertTrue(r.box_usage > 0.00002 && r.box_usage < 0.00003, @"Box usage is %f", r.box_usage);
+	
+	struct sdb_item* item = &r.items[0];
+	FRAssertTrue(strcmp(item->name, "i1") == 0 && item->size == 2, @"First item is %s with %i attributes", item->name, item->size);
+	FRAssertTrue(strcmp(item->attributes[0].value, "x & y") == 0, @"Entity not decoded: %s", item->attributes[0].value);
+	FRAssertTrue(strcmp(item->attributes[1].name, "b") == 0 && strcmp(item->attributes[1].value, "") == 0, @"Empty value not kept");
+	FRAssertTrue(strcmp(r.items[1].name, "i2") == 0 && r.items[1].size == 0, @"Item without attributes not kept");
+	
+	sdb_response_cleanup(&r);
+	FRPass(@"Parsed select page");
+}
+
+- (void)test_appendPages {
+	struct sdb_response r;
+	sdb_response_init(&r);
+	FRAssertTrue(parseResponse(&r, kSelectPage) == SDB_OK, @"First page failed");
+	
+	NSMutableString* page = [NSMutableString stringWithString:@"<SelectResponse><SelectResult>"];
+	for(int i = 0; i < 20; i++) {
+		[page appendFormat:@"<Item><Name>n%i</Name><Attribute><Name>k</Name><Value><![CDATA[v%i]]></Value></Attribute></Item>", i, i];
+	}
+	[page appendString:@"</SelectResult></SelectResponse>"];
+	
+	int rc = parseResponse(&r, [page UTF8String]);
+	FRAssertTrue(rc == SDB_OK, @"Second page failed with %i", rc);
+	FRAssertTrue(r.size == 22 && !r.has_more, @"Appended response has %i items, has more %i", r.size, r.has_more);
+	
+	//Items from the first page must survive the second page's strings
+	FRAssertTrue(strcmp(r.items[0].name, "i1") == 0 && strcmp(r.items[0].attributes[0].value, "x & y") == 0, @"First page item lost");
+	FRAssertTrue(strcmp(r.items[21].name, "n19") == 0 && strcmp(r.items[21].attributes[0].value, "v19") == 0, @"Last item is %s", r.items[21].name);
+	
+	sdb_response_cleanup(&r);
+	FRPass(@"Appended %i items", 22);
+}
+
+- (void)test_errors {
+	struct sdb_response r;
+	sdb_response_init(&r);
+	
+	int rc = parseResponse(&r, "<Response><Errors><Error><Code>AuthFailure</Code><Message>bad sig</Message>"
+						   "<BoxUsage>0.1</BoxUsage></Error></Errors><RequestID>x</RequestID></Response>");
+	FRAssertTrue(rc == SDB_OK, @"Error response failed with %i", rc);
+	FRAssertTrue(r.error > 0 && r.error < SDB_AWS_NUM_ERRORS && strcmp(SDB_AWS_ERRORS[r.error], "AuthFailure") == 0, @"Error code is %i", r.error);
+	FRAssertTrue(r.error_message && strcmp(r.error_message, "bad sig") == 0, @"Error message is %s", r.error_message);
+	
+	sdb_response_cleanup(&r);
+	FRPass(@"Parsed error response");
+}
+
+- (void)test_metadata {
+	struct sdb_response r;
+	sdb_response_init(&r);
+	
+	int rc = parseResponse(&r, "<DomainMetadataResponse><DomainMetadataResult><ItemCount>195078</ItemCount>"
+						   "<Timestamp>1225486466</Timestamp><AttributeNamesSizeBytes>12</AttributeNamesSizeBytes>"
+						   "</DomainMetadataResult></DomainMetadataResponse>");
+	FRAssertTrue(rc == SDB_OK && r.type == SDB_R_DOMAIN_METADATA, @"Metadata failed with %i", rc);
+	FRAssertTrue(r.domain_metadata->item_count == 195078 && r.domain_metadata->timestamp == 1225486466 && 
+				 r.domain_metadata->attr_names_size == 12, @"Metadata values not decoded");
+	sdb_response_cleanup(&r);
+	
+	sdb_response_init(&r);
+	rc = parseResponse(&r, "<ListDomainsResponse><ListDomainsResult><DomainName>d1</DomainName><DomainName>d2</DomainName>"
+					   "</ListDomainsResult></ListDomainsResponse>");
+	FRAssertTrue(rc == SDB_OK && r.type == SDB_R_DOMAIN_LIST && r.size == 2, @"Domain list failed with %i", rc);
+	FRAssertTrue(strcmp(r.domains[0], "d1") == 0 && strcmp(r.domains[1], "d2") == 0, @"Domain names not decoded");
+	sdb_response_cleanup(&r);
+	
+	FRPass(@"Parsed metadata and domain list");
+}
+
+- (void)test_malformed {
+	int rc = parseSingleResponse("<GetAttributesResponse><GetAttributesResult><Attribute><Name>a</Name></Attribute>"
+								 "</GetAttributesResult></GetAttributesResponse>");
+	FRAssertTrue(rc == SDB_E_INVALID_META_RESPONSE, @"Attribute without a value returned %i", rc);
+	
+	rc = parseSingleResponse("<GetAttributesResponse><GetAttributesResult><Attribute><Name>a</Name><Value>1</Value></Attribute>"
+							 "</GetAttributesResult><Bogus/></GetAttributesResponse>");
+	FRAssertTrue(rc == SDB_E_INVALID_ERR_RESPONSE, @"Unknown node returned %i", rc);
+	
+	rc = parseSingleResponse("<SelectResponse><SelectResult><Item>");
+	FRAssertTrue(rc == SDB_E_INVALID_XML_RESPONSE, @"Truncated response returned %i", rc);
+	
+	rc = parseSingleResponse("");
+	FRAssertTrue(rc != SDB_OK, @"Empty response returned %i", rc);
+	
+	FRPass(@"Malformed responses rejected");
+}
+
+@end
@@ -27,12 +27,9 @@
 
 #import "WKFunctionMarkers.h"
 #import "MGTemplateEngine.h"
-#import "AGRegexTemplateMatcher.h"
-
-//Load internal filters
-#import "WKValueComparisonFilters.h"
 
 #define VAR @"var"
+#define FUNCTION_VAR_PREFIX @"fvar."
 
 @implementation WKFunctionMarkers
 
@@ -60,40 +57,26 @@
 	
 	if ([marker isEqualToString:VAR]) {
 		if (args && [args count] > 3 && *outputEnabled) {
-			// Set variable arg1 to value seperatly parsed filter.
-			
-			//TODO: Make this much faster, possibly with "MGTemplateFunctions" protocal
-			
-			//NSLog(@"args %@", args);
-			NSArray* params = [args subarrayWithRange:NSMakeRange(4, [args count]-4)];
-			NSMutableArray* parsedParams = [NSMutableArray array];
-			for(NSString* prop in params) {
-				if([prop hasPrefix:@"fvar."]) {
-					[parsedParams addObject:[prop stringByReplacingOccurrencesOfString:@"fvar." withString:@""]];
+			// Set variable arg1 to the result of filter arg3 applied to variable arg4, evaluated in place with the engine's 
+			// own filters and variables (including those of enclosing blocks).
+			NSUInteger count = [args count];
+			NSMutableArray* params = [NSMutableArray arrayWithCapacity:count - 4];
+			for(NSUInteger i = 4; i < count; i++) {
+				NSString* param = [args objectAtIndex:i];
+				if([param hasPrefix:FUNCTION_VAR_PREFIX]) {
+					NSString* name = [param substringFromIndex:[FUNCTION_VAR_PREFIX length]];
+					NSObject* paramValue = [m_engine resolveVariable:name];
+					[params addObject:(paramValue) ? paramValue : (NSObject*)name];
 				} else {
-					[parsedParams addObject:[NSString stringWithFormat:@"\"%@\"", prop]];
+					[params addObject:param];
 				}
 			}
-		
-			NSString* filterString = [NSString stringWithFormat:@"{{ %@ | %@ %@ }}", 
-									  [args objectAtIndex:3], [args objectAtIndex:2], 
-									  [parsedParams componentsJoinedByString:@" "]];
-			//NSLog(@"filterString:%@", filterString);
 			
-			MGTemplateEngine* templateEngine = [MGTemplateEngine templateEngine];
-			[templateEngine setMatcher:[AGRegexTemplateMatcher matcherWithTemplateEngine:templateEngine]];
-			[templateEngine loadFilter:[[WKValueComparisonFilters alloc] init]];
+			NSObject* value = [m_engine resolveVariable:[args objectAtIndex:3]];
+			NSObject* result = (value) ? [m_engine applyFilter:[args objectAtIndex:2] withArguments:params onValue:value] : nil;
 			
-			//NSLog(@"existing vars:%@", [m_engine templateVariables]);
-			
-			NSString* results = [templateEngine processTemplate:filterString withVariables:[m_engine templateVariables]];
-			//NSLog(@"results-->%@", results);
-			
-			NSDictionary *newVar = [NSDictionary dictionaryWithObject:results
-															   forKey:[args objectAtIndex:0]];
-			if (newVar) {
-				*newVariables = newVar;
-			}
+			*newVariables = [NSDictionary dictionaryWithObject:(result) ? result : (NSObject*)@"" 
+														forKey:[args objectAtIndex:0]];
 		}
 	}
 	
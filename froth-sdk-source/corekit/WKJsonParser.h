@@ -0,0 +1,96 @@
+//
+//  WKJsonParser.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "SBJsonBase.h"
+#import "SBJsonParser.h"
+
+/*!
+	\brief	A JSON parser that works on UTF-8 bytes, a faster drop in replacement for SBJsonParser.
+ 
+	The input is scanned in place, it is never decoded to a NSString first. Where SSE2 is available string bodies 
+	are searched 16 bytes at a time for their closing quote, escapes and control characters, so each string is created 
+	with one copy of its bytes. Container members are collected on a value stack and each array and dictionary is created 
+	once at its full size when it closes.
+ 
+	Types map as they do with SBJsonParser, except strings are immutable NSStrings and integers that fit in 18 digits 
+	are NSNumbers (long long). Other numbers stay NSDecimalNumbers so no precision is lost. Arrays and dictionaries are 
+	mutable. When an object repeats a key the last value is kept. Object keys are interned for the parse, the keys 
+	repeated by an array of objects are one NSString each.
+ 
+	Parsing keeps its state on the stack, a parser can be reused but not shared between threads as the error trace is 
+	per instance. NSData -JSONValue and NSString -JSONValue use this parser.
+ 
+	\code
+	WKJsonParser* parser = [[WKJsonParser alloc] init];
+	NSDictionary* object = [parser objectWithData:[request bodyDataValue]];
+	if(!object) NSLog(@"%@", [parser errorTrace]);
+	[parser release];
+	\endcode
+ */
+@interface WKJsonParser : SBJsonBase <SBJsonParser> {
+
+}
+
+/*! \brief Returns the NSDictionary or NSArray represented by UTF-8 JSON data, or nil on error. */
+- (id)objectWithData:(NSData*)data;
+
+/*! \brief Returns the NSDictionary or NSArray represented by the UTF-8 bytes, or nil on error. */
+- (id)objectWithUTF8String:(const char*)bytes length:(NSUInteger)length;
+
+/*! \brief Returns any JSON value (including strings, numbers and null) represented by the UTF-8 bytes, or nil on error. */
+- (id)fragmentWithUTF8String:(const char*)bytes length:(NSUInteger)length;
+
+@end
+
+/*
+	Token functions, shared with WKJsonStreamParser which finds where each token ends before decoding it. The New functions 
+	return a retained object, or nil with the error set.
+ */
+typedef struct {
+	NSUInteger code;
+	const char* message;
+} WKJsonError;
+
+/*! \brief Returns the first '"', '\\' or control character at or after p, or end if there is none. */
+const char* WKJsonFindStringSpecial(const char* p, const char* end);
+
+/*! \brief Decodes a JSON string, bytes start after the opening quote and end with the closing quote. */
+NSString* WKJsonNewString(const char* bytes, NSUInteger length, WKJsonError* error);
+
+/*! \brief Decodes a complete JSON number token. */
+NSNumber* WKJsonNewNumber(const char* bytes, NSUInteger length, WKJsonError* error);
+
+/*! \brief Object keys by their bytes, so repeated keys share one NSString. Each parse has its own table. */
+typedef struct WKJsonKeyTable WKJsonKeyTable;
+
+WKJsonKeyTable* WKJsonKeyTableCreate(void);
+void WKJsonKeyTableFree(WKJsonKeyTable* table);
+
+/*! \brief Decodes a key like WKJsonNewString, returning the interned instance when the key has been seen before. */
+NSString* WKJsonKeyTableNewKey(WKJsonKeyTable* table, const char* bytes, NSUInteger length, WKJsonError* error);
@@ -0,0 +1,760 @@
+//
+//  WKJsonParser.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WKJsonParser.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define kInitialStackSize		64
+#define kInitialScratchSize		256
+#define kMaxFastIntegerDigits	18
+#define kKeyTableInitialSize	64
+#define kKeyTableMaxKeys		2048
+#define kMaxInternedKeyLength	128
+
+/*
+	Object keys seen in a parse, by their bytes in the input. Arrays of objects repeat the same keys, each repeat reuses 
+	the first NSString instead of creating another. Keys with escapes are not interned, and the table stops growing at 
+	kKeyTableMaxKeys so objects used as maps (ie keyed by id) do not fill it.
+ */
+typedef struct {
+	uint32_t hash;
+	NSUInteger length;
+	char* bytes;
+	NSString* key;
+} WKJsonKeyEntry;
+
+struct WKJsonKeyTable {
+	WKJsonKeyEntry* entries;
+	NSUInteger capacity;
+	NSUInteger count;
+};
+
+/* 
+	The state of one parse. Container members wait on the value stack, retained, until their container closes. For 
+	dictionary members the key is in the same slot of the key stack, array members have a nil key.
+ */
+typedef struct {
+	const uint8_t* start;
+	const uint8_t* p;
+	const uint8_t* end;
+	
+	NSUInteger depth;
+	NSUInteger maxDepth;
+	
+	id* values;
+	id* keys;
+	NSUInteger top;
+	NSUInteger capacity;
+	
+	uint8_t* scratch;
+	NSUInteger scratchSize;
+	
+	WKJsonKeyTable keyTable;
+	
+	NSUInteger errorCode;
+	const char* errorMessage;
+	NSUInteger errorOffset;
+} WKJsonScan;
+
+static const uint8_t kStringSpecial[256] = { [0 ... 0x1F] = 1, ['"'] = 1, ['\\'] = 1 };
+static NSNumber* kTrue = nil;
+static NSNumber* kFalse = nil;
+
+#pragma mark -
+#pragma mark Scan State
+
+static void WKJsonScanInit(WKJsonScan* s, const char* bytes, NSUInteger length, NSUInteger maxDepth) {
+	memset(s, 0, sizeof(WKJsonScan));
+	s->start = s->p = (const uint8_t*)bytes;
+	s->end = s->start + length;
+	s->maxDepth = maxDepth;
+}
+
+static void WKJsonScanPopTo(WKJsonScan* s, NSUInteger base) {
+	while(s->top > base) {
+		s->top--;
+		[s->keys[s->top] release];
+		[s->values[s->top] release];
+	}
+}
+
+static void WKJsonKeyTableClear(WKJsonKeyTable* table) {
+	for(NSUInteger i=0; i<table->capacity; i++) {
+		if(table->entries[i].key) {
+			[table->entries[i].key release];
+			free(table->entries[i].bytes);
+		}
+	}
+	free(table->entries);
+	memset(table, 0, sizeof(WKJsonKeyTable));
+}
+
+static void WKJsonScanFree(WKJsonScan* s) {
+	WKJsonScanPopTo(s, 0);
+	WKJsonKeyTableClear(&s->keyTable);
+	free(s->values);
+	free(s->keys);
+	free(s->scratch);
+}
+
+/* Records the first error only, callers further up the stack return through here without replacing it. */
+static id fail(WKJsonScan* s, NSUInteger code, const char* message) {
+	if(!s->errorCode) {
+		s->errorCode = code;
+		s->errorMessage = message;
+		s->errorOffset = s->p - s->start;
+	}
+	return nil;
+}
+
+/* Takes ownership of key and value */
+static inline void push(WKJsonScan* s, id key, id value) {
+	if(s->top == s->capacity) {
+		s->capacity = (s->capacity) ? s->capacity * 2 : kInitialStackSize;
+		s->values = realloc(s->values, s->capacity * sizeof(id));
+		s->keys = realloc(s->keys, s->capacity * sizeof(id));
+	}
+	s->keys[s->top] = key;
+	s->values[s->top] = value;
+	s->top++;
+}
+
+static inline void appendScratch(WKJsonScan* s, NSUInteger* length, const uint8_t* bytes, NSUInteger count) {
+	if(*length + count > s->scratchSize) {
+		NSUInteger size = (s->scratchSize) ? s->scratchSize : kInitialScratchSize;
+		while(size < *length + count) size *= 2;
+		s->scratch = realloc(s->scratch, size);
+		s->scratchSize = size;
+	}
+	memcpy(s->scratch + *length, bytes, count);
+	*length += count;
+}
+
+#pragma mark -
+#pragma mark Key Interning
+
+static inline NSString* newString(WKJsonScan* s, const uint8_t* bytes, NSUInteger length) {
+	if(length == 0) {
+		return [@"" retain];
+	}
+	NSString* string = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+	if(!string) {
+		fail(s, EUNICODE, "Invalid UTF-8 in string");
+	}
+	return string;
+}
+
+static inline uint32_t hashBytes(const uint8_t* bytes, NSUInteger length) {
+	uint32_t hash = 2166136261U;
+	for(NSUInteger i=0; i<length; i++) {
+		hash = (hash ^ bytes[i]) * 16777619U;
+	}
+	return hash;
+}
+
+/* Returns the entry for the bytes, or the empty slot they belong in. */
+static inline WKJsonKeyEntry* keyTableSlot(WKJsonKeyTable* table, const uint8_t* bytes, NSUInteger length, uint32_t hash) {
+	NSUInteger mask = table->capacity - 1;
+	NSUInteger i = hash & mask;
+	for(;;) {
+		WKJsonKeyEntry* entry = &table->entries[i];
+		if(!entry->key || (entry->hash == hash && entry->length == length && memcmp(entry->bytes, bytes, length) == 0)) {
+			return entry;
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+static void keyTableInsert(WKJsonKeyTable* table, const uint8_t* bytes, NSUInteger length, uint32_t hash, NSString* key) {
+	if(table->count >= kKeyTableMaxKeys) {
+		return;
+	}
+	
+	if((table->count + 1) * 2 > table->capacity) {
+		WKJsonKeyTable grown;
+		grown.capacity = (table->capacity) ? table->capacity * 2 : kKeyTableInitialSize;
+		grown.entries = calloc(grown.capacity, sizeof(WKJsonKeyEntry));
+		grown.count = table->count;
+		for(NSUInteger i=0; i<table->capacity; i++) {
+			WKJsonKeyEntry* entry = &table->entries[i];
+			if(entry->key) {
+				*keyTableSlot(&grown, (const uint8_t*)entry->bytes, entry->length, entry->hash) = *entry;
+			}
+		}
+		free(table->entries);
+		*table = grown;
+	}
+	
+	WKJsonKeyEntry* entry = keyTableSlot(table, bytes, length, hash);
+	entry->hash = hash;
+	entry->length = length;
+	entry->bytes = malloc(length ? length : 1);
+	memcpy(entry->bytes, bytes, length);
+	entry->key = [key retain];
+	table->count++;
+}
+
+/* Returns the retained key for an escape free key body, creating and interning it if it is new. */
+static NSString* internKey(WKJsonScan* s, WKJsonKeyTable* table, const uint8_t* bytes, NSUInteger length) {
+	if(length > kMaxInternedKeyLength) {
+		return newString(s, bytes, length);
+	}
+	
+	uint32_t hash = hashBytes(bytes, length);
+	if(table->capacity) {
+		WKJsonKeyEntry* entry = keyTableSlot(table, bytes, length, hash);
+		if(entry->key) {
+			return [entry->key retain];
+		}
+	}
+	
+	NSString* key = newString(s, bytes, length);
+	if(key) {
+		keyTableInsert(table, bytes, length, hash, key);
+	}
+	return key;
+}
+
+#pragma mark -
+#pragma mark Scanning
+
+static inline void skipSpace(WKJsonScan* s) {
+	const uint8_t* p = s->p;
+	while(p < s->end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+	s->p = p;
+}
+
+static inline BOOL isDigit(uint8_t c) {
+	return (c >= '0' && c <= '9');
+}
+
+/* Returns the first '"', '\\' or control character at or after p, or end. */
+static inline const uint8_t* findStringSpecial(const uint8_t* p, const uint8_t* end) {
+#if defined(__SSE2__)
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i control = _mm_set1_epi8(0x1F);
+	while(end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		//A byte is a control character when min(byte, 0x1F) is the byte itself, compared unsigned
+		__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)), 
+									   _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+		int mask = _mm_movemask_epi8(special);
+		if(mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+#else
+	while(end - p >= 4) {
+		if(kStringSpecial[p[0]]) return p;
+		if(kStringSpecial[p[1]]) return p + 1;
+		if(kStringSpecial[p[2]]) return p + 2;
+		if(kStringSpecial[p[3]]) return p + 3;
+		p += 4;
+	}
+#endif
+	while(p < end && !kStringSpecial[*p]) p++;
+	return p;
+}
+
+static inline int hexQuad(const uint8_t* p) {
+	int value = 0;
+	for(int i=0; i<4; i++) {
+		uint8_t c = p[i];
+		int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+		if(d < 0) return -1;
+		value = value * 16 + d;
+	}
+	return value;
+}
+
+static inline NSUInteger encodeUTF8(uint32_t cp, uint8_t* out) {
+	if(cp < 0x80) {
+		out[0] = cp;
+		return 1;
+	} else if(cp < 0x800) {
+		out[0] = 0xC0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3F);
+		return 2;
+	} else if(cp < 0x10000) {
+		out[0] = 0xE0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3F);
+		out[2] = 0x80 | (cp & 0x3F);
+		return 3;
+	}
+	out[0] = 0xF0 | (cp >> 18);
+	out[1] = 0x80 | ((cp >> 12) & 0x3F);
+	out[2] = 0x80 | ((cp >> 6) & 0x3F);
+	out[3] = 0x80 | (cp & 0x3F);
+	return 4;
+}
+
+
+/* s->p is after the opening quote. Strings without escapes are created straight from the input. */
+static NSString* scanString(WKJsonScan* s) {
+	const uint8_t* end = s->end;
+	const uint8_t* run = s->p;
+	const uint8_t* stop = findStringSpecial(run, end);
+	
+	if(stop < end && *stop == '"') {
+		s->p = stop + 1;
+		return newString(s, run, stop - run);
+	}
+	
+	NSUInteger length = 0;
+	for(;;) {
+		s->p = stop;
+		if(stop >= end) {
+			return fail(s, EEOF, "Unexpected end of input while parsing string");
+		}
+		appendScratch(s, &length, run, stop - run);
+		
+		if(*stop == '"') {
+			s->p = stop + 1;
+			return newString(s, s->scratch, length);
+		} else if(*stop != '\\') {
+			return fail(s, ECTRL, "Unescaped control character in string");
+		}
+		
+		if(++stop >= end) {
+			s->p = stop;
+			return fail(s, EEOF, "Unexpected end of input while parsing string");
+		}
+		
+		uint8_t decoded[4];
+		NSUInteger count = 1;
+		switch(*stop++) {
+			case '"':	decoded[0] = '"';	break;
+			case '\\':	decoded[0] = '\\';	break;
+			case '/':	decoded[0] = '/';	break;
+			case 'b':	decoded[0] = '\b';	break;
+			case 'f':	decoded[0] = '\f';	break;
+			case 'n':	decoded[0] = '\n';	break;
+			case 'r':	decoded[0] = '\r';	break;
+			case 't':	decoded[0] = '\t';	break;
+			case 'u': {
+				s->p = stop;
+				int hi = (end - stop >= 4) ? hexQuad(stop) : -1;
+				if(hi < 0) {
+					return fail(s, EUNICODE, "Missing hex digit in quad");
+				}
+				stop += 4;
+				uint32_t cp = hi;
+				if(hi >= 0xD800 && hi < 0xDC00) {
+					int lo = (end - stop >= 6 && stop[0] == '\\' && stop[1] == 'u') ? hexQuad(stop + 2) : -1;
+					if(lo < 0xDC00 || lo > 0xDFFF) {
+						s->p = stop;
+						return fail(s, EUNICODE, "Missing low character in surrogate pair");
+					}
+					stop += 6;
+					cp = 0x10000 + ((hi - 0xD800) << 10) + (lo - 0xDC00);
+				} else if(hi >= 0xDC00 && hi < 0xE000) {
+					return fail(s, EUNICODE, "Invalid high character in surrogate pair");
+				}
+				count = encodeUTF8(cp, decoded);
+				break;
+			}
+			default:
+				s->p = stop - 1;
+				return fail(s, EESCAPE, "Illegal escape sequence");
+		}
+		appendScratch(s, &length, decoded, count);
+		
+		run = stop;
+		stop = findStringSpecial(run, end);
+	}
+}
+
+/* Integers that fit in a long long are read directly, others go through NSDecimalNumber to keep their precision. */
+static NSNumber* scanNumber(WKJsonScan* s) {
+	const uint8_t* end = s->end;
+	const uint8_t* numberStart = s->p;
+	const uint8_t* p = s->p;
+	
+	BOOL negative = (*p == '-');
+	if(negative) p++;
+	
+	const uint8_t* digits = p;
+	if(p >= end || !isDigit(*p)) {
+		s->p = p;
+		return fail(s, EPARSENUM, "No digits after initial minus");
+	}
+	if(*p == '0') {
+		p++;
+		if(p < end && isDigit(*p)) {
+			s->p = p;
+			return fail(s, EPARSENUM, "Leading 0 disallowed in number");
+		}
+	} else {
+		while(p < end && isDigit(*p)) p++;
+	}
+	NSUInteger digitCount = p - digits;
+	
+	BOOL integer = YES;
+	if(p < end && *p == '.') {
+		integer = NO;
+		p++;
+		if(p >= end || !isDigit(*p)) {
+			s->p = p;
+			return fail(s, EPARSENUM, "No digits after decimal point");
+		}
+		while(p < end && isDigit(*p)) p++;
+	}
+	if(p < end && (*p == 'e' || *p == 'E')) {
+		integer = NO;
+		p++;
+		if(p < end && (*p == '-' || *p == '+')) p++;
+		if(p >= end || !isDigit(*p)) {
+			s->p = p;
+			return fail(s, EPARSENUM, "No digits after exponent");
+		}
+		while(p < end && isDigit(*p)) p++;
+	}
+	s->p = p;
+	
+	if(integer && digitCount <= kMaxFastIntegerDigits) {
+		long long value = 0;
+		for(const uint8_t* d = digits; d < p; d++) {
+			value = value * 10 + (*d - '0');
+		}
+		return [[NSNumber alloc] initWithLongLong:(negative) ? -value : value];
+	}
+	
+	NSString* string = [[NSString alloc] initWithBytes:numberStart length:p - numberStart encoding:NSASCIIStringEncoding];
+	NSDecimalNumber* number = [[NSDecimalNumber alloc] initWithString:string];
+	[string release];
+	if(!number) {
+		return fail(s, EPARSENUM, "Failed creating decimal instance");
+	}
+	return number;
+}
+
+static inline BOOL scanLiteral(WKJsonScan* s, const char* literal, NSUInteger length) {
+	if((NSUInteger)(s->end - s->p) >= length && memcmp(s->p, literal, length) == 0) {
+		s->p += length;
+		return YES;
+	}
+	return NO;
+}
+
+static id scanValue(WKJsonScan* s);
+
+static NSMutableArray* scanArray(WKJsonScan* s) {
+	if(s->maxDepth && ++s->depth > s->maxDepth) {
+		return fail(s, EDEPTH, "Nested too deep");
+	}
+	
+	NSUInteger base = s->top;
+	skipSpace(s);
+	if(s->p < s->end && *s->p == ']') {
+		s->p++;
+		s->depth--;
+		return [[NSMutableArray alloc] init];
+	}
+	
+	for(;;) {
+		id value = scanValue(s);
+		if(!value) {
+			return nil;
+		}
+		push(s, nil, value);
+		
+		skipSpace(s);
+		if(s->p >= s->end) {
+			return fail(s, EEOF, "End of input while parsing array");
+		}
+		if(*s->p == ']') {
+			s->p++;
+			break;
+		} else if(*s->p != ',') {
+			return fail(s, EPARSE, "Expected ',' or ']' while parsing array");
+		}
+		s->p++;
+		skipSpace(s);
+		if(s->p < s->end && *s->p == ']') {
+			return fail(s, ETRAILCOMMA, "Trailing comma disallowed in array");
+		}
+	}
+	
+	NSMutableArray* array = [[NSMutableArray alloc] initWithObjects:s->values + base count:s->top - base];
+	WKJsonScanPopTo(s, base);
+	s->depth--;
+	return array;
+}
+
+static NSMutableDictionary* scanDictionary(WKJsonScan* s) {
+	if(s->maxDepth && ++s->depth > s->maxDepth) {
+		return fail(s, EDEPTH, "Nested too deep");
+	}
+	
+	NSUInteger base = s->top;
+	skipSpace(s);
+	if(s->p < s->end && *s->p == '}') {
+		s->p++;
+		s->depth--;
+		return [[NSMutableDictionary alloc] init];
+	}
+	
+	for(;;) {
+		if(s->p >= s->end || *s->p != '"') {
+			return fail(s, EPARSE, "Object key string expected");
+		}
+		s->p++;
+		NSString* key = nil;
+		const uint8_t* close = findStringSpecial(s->p, s->end);
+		if(close < s->end && *close == '"') {
+			key = internKey(s, &s->keyTable, s->p, close - s->p);
+			s->p = close + 1;
+		} else {
+			key = scanString(s);
+		}
+		if(!key) {
+			return nil;
+		}
+		
+		skipSpace(s);
+		if(s->p >= s->end || *s->p != ':') {
+			[key release];
+			return fail(s, EPARSE, "Expected ':' separating key and value");
+		}
+		s->p++;
+		
+		id value = scanValue(s);
+		if(!value) {
+			[key release];
+			return nil;
+		}
+		push(s, key, value);
+		
+		skipSpace(s);
+		if(s->p >= s->end) {
+			return fail(s, EEOF, "End of input while parsing object");
+		}
+		if(*s->p == '}') {
+			s->p++;
+			break;
+		} else if(*s->p != ',') {
+			return fail(s, EPARSE, "Expected ',' or '}' while parsing object");
+		}
+		s->p++;
+		skipSpace(s);
+		if(s->p < s->end && *s->p == '}') {
+			return fail(s, ETRAILCOMMA, "Trailing comma disallowed in object");
+		}
+	}
+	
+	//Set in order so a repeated key keeps its last value, as with SBJsonParser
+	NSMutableDictionary* dictionary = [[NSMutableDictionary alloc] initWithCapacity:s->top - base];
+	for(NSUInteger i=base; i<s->top; i++) {
+		[dictionary setObject:s->values[i] forKey:s->keys[i]];
+	}
+	WKJsonScanPopTo(s, base);
+	s->depth--;
+	return dictionary;
+}
+
+/* Returns a retained value, or nil with the error set. */
+static id scanValue(WKJsonScan* s) {
+	skipSpace(s);
+	if(s->p >= s->end) {
+		return fail(s, EEOF, "Unexpected end of input");
+	}
+	
+	switch(*s->p) {
+		case '{':
+			s->p++;
+			return scanDictionary(s);
+		case '[':
+			s->p++;
+			return scanArray(s);
+		case '"':
+			s->p++;
+			return scanString(s);
+		case 't':
+			if(scanLiteral(s, "true", 4)) return [kTrue retain];
+			return fail(s, EPARSE, "Expected 'true'");
+		case 'f':
+			if(scanLiteral(s, "false", 5)) return [kFalse retain];
+			return fail(s, EPARSE, "Expected 'false'");
+		case 'n':
+			if(scanLiteral(s, "null", 4)) return [[NSNull null] retain];
+			return fail(s, EPARSE, "Expected 'null'");
+		case '-':
+		case '0'...'9':
+			return scanNumber(s);
+		case '+':
+			return fail(s, EPARSENUM, "Leading + disallowed in number");
+		default:
+			return fail(s, EPARSE, "Unrecognised leading character");
+	}
+}
+
+#pragma mark -
+#pragma mark Token Functions
+
+const char* WKJsonFindStringSpecial(const char* p, const char* end) {
+	return (const char*)findStringSpecial((const uint8_t*)p, (const uint8_t*)end);
+}
+
+static void WKJsonScanCopyError(WKJsonScan* s, WKJsonError* error) {
+	if(error) {
+		error->code = s->errorCode;
+		error->message = s->errorMessage;
+	}
+}
+
+NSString* WKJsonNewString(const char* bytes, NSUInteger length, WKJsonError* error) {
+	WKJsonScan scan;
+	WKJsonScanInit(&scan, bytes, length, 0);
+	
+	NSString* string = scanString(&scan);
+	if(string && scan.p != scan.end) {
+		[string release];
+		string = fail(&scan, EPARSE, "Unexpected characters after string");
+	}
+	if(!string) {
+		WKJsonScanCopyError(&scan, error);
+	}
+	WKJsonScanFree(&scan);
+	return string;
+}
+
+NSNumber* WKJsonNewNumber(const char* bytes, NSUInteger length, WKJsonError* error) {
+	WKJsonScan scan;
+	WKJsonScanInit(&scan, bytes, length, 0);
+	
+	NSNumber* number = (length) ? scanNumber(&scan) : fail(&scan, EPARSENUM, "Empty number");
+	if(number && scan.p != scan.end) {
+		[number release];
+		number = fail(&scan, EPARSENUM, "Unexpected characters in number");
+	}
+	if(!number) {
+		WKJsonScanCopyError(&scan, error);
+	}
+	WKJsonScanFree(&scan);
+	return number;
+}
+
+WKJsonKeyTable* WKJsonKeyTableCreate(void) {
+	return calloc(1, sizeof(WKJsonKeyTable));
+}
+
+void WKJsonKeyTableFree(WKJsonKeyTable* table) {
+	if(table) {
+		WKJsonKeyTableClear(table);
+		free(table);
+	}
+}
+
+NSString* WKJsonKeyTableNewKey(WKJsonKeyTable* table, const char* bytes, NSUInteger length, WKJsonError* error) {
+	NSUInteger bodyLength = (length) ? length - 1 : 0;
+	if(!length || bytes[bodyLength] != '"' || WKJsonFindStringSpecial(bytes, bytes + bodyLength) != bytes + bodyLength) {
+		return WKJsonNewString(bytes, length, error);
+	}
+	
+	WKJsonScan scan;
+	WKJsonScanInit(&scan, bytes, length, 0);
+	NSString* key = internKey(&scan, table, (const uint8_t*)bytes, bodyLength);
+	if(!key) {
+		WKJsonScanCopyError(&scan, error);
+	}
+	WKJsonScanFree(&scan);
+	return key;
+}
+
+#pragma mark -
+
+@implementation WKJsonParser
+
++ (void)initialize {
+	if(self == [WKJsonParser class]) {
+		kTrue = [[NSNumber numberWithBool:YES] retain];
+		kFalse = [[NSNumber numberWithBool:NO] retain];
+	}
+}
+
+- (id)fragmentWithUTF8String:(const char*)bytes length:(NSUInteger)length {
+	[self clearErrorTrace];
+	if(!bytes) {
+		[self addErrorWithCode:EINPUT description:@"Input was 'nil'"];
+		return nil;
+	}
+	
+	WKJsonScan scan;
+	WKJsonScanInit(&scan, bytes, length, maxDepth);
+	
+	//Skip a UTF-8 byte order mark
+	if(length >= 3 && scan.p[0] == 0xEF && scan.p[1] == 0xBB && scan.p[2] == 0xBF) {
+		scan.p += 3;
+	}
+	
+	id value = scanValue(&scan);
+	if(value) {
+		skipSpace(&scan);
+		if(scan.p < scan.end) {
+			fail(&scan, ETRAILGARBAGE, "Garbage after JSON");
+			[value release];
+			value = nil;
+		}
+	}
+	
+	if(!value) {
+		[self addErrorWithCode:scan.errorCode description:[NSString stringWithFormat:@"%s at byte %lu", scan.errorMessage, (unsigned long)scan.errorOffset]];
+	}
+	WKJsonScanFree(&scan);
+	return [value autorelease];
+}
+
+- (id)objectWithUTF8String:(const char*)bytes length:(NSUInteger)length {
+	id o = [self fragmentWithUTF8String:bytes length:length];
+	if(o && ![o isKindOfClass:[NSDictionary class]] && ![o isKindOfClass:[NSArray class]]) {
+		[self addErrorWithCode:EFRAGMENT description:@"Valid fragment, but not JSON"];
+		return nil;
+	}
+	return o;
+}
+
+- (id)objectWithData:(NSData*)data {
+	if(!data) {
+		[self clearErrorTrace];
+		[self addErrorWithCode:EINPUT description:@"Input was 'nil'"];
+		return nil;
+	}
+	return [self objectWithUTF8String:([data length]) ? [data bytes] : "" length:[data length]];
+}
+
+- (id)objectWithString:(NSString*)repr {
+	const char* bytes = [repr UTF8String];
+	return [self objectWithUTF8String:bytes length:(bytes) ? strlen(bytes) : 0];
+}
+
+@end
@@ -0,0 +1,156 @@
+//
+//  WKJsonParserTests.m
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "WKJsonParserTests.h"
+#import "WKJsonParser.h"
+#include <math.h>
+
+static id parseFragment(WKJsonParser* parser, const char* json) {
+	return [parser fragmentWithUTF8String:json length:strlen(json)];
+}
+
+/*
+	Each case is JSON that must fail to parse, returns the number that parsed.
+ */
+static int acceptedInvalidCases(WKJsonParser* parser, const char** cases, int count) {
+	int accepted = 0;
+	for(int i = 0; i < count; i++) {
+		id value = parseFragment(parser, cases[i]);
+		if(value || ![[parser errorTrace] count]) {
+			NSLog(@"+++ [[ERROR]] Invalid JSON [%s] parsed as %@", cases[i], value);
+			accepted++;
+		}
+	}
+	return accepted;
+}
+
+@implementation WKJsonParserTests
+
+- (NSArray*)tests {
+	return [NSArray arrayWithObjects:@"test_stringEscapes", 
+			@"test_numbers", 
+			@"test_trailingInput", 
+			@"test_maxDepth", 
+			@"test_duplicateKeys", nil];
+}
+
+- (void)test_stringEscapes {
+	WKJsonParser* parser = [[[WKJsonParser alloc] init] autorelease];
+	
+	NSString* s = parseFragment(parser, "\"a\\n\\t\\r\\b\\f\\\"\\\\\\/z\"");
+	FRAssertTrue([s isEqualToString:@"a\n\t\r\b\f\"\\/z"], @"Simple escapes decoded as [%@]", s);
+	
+	s = parseFragment(parser, "\"caf\\u00e9 \\u20AC\"");
+	FRAssertTrue([s isEqualToString:@"caf\u00e9 \u20ac"], @"\\u escapes decoded as [%@]", s);
+	
+	//U+1F600 as a surrogate pair, decoded to 4 UTF-8 bytes
+	s = parseFragment(parser, "\"\\ud83d\\ude00\"");
+	NSData* utf8 = [s dataUsingEncoding:NSUTF8StringEncoding];
+	FRAssertTrue([utf8 length] == 4 && memcmp([utf8 bytes], "\xF0\x9F\x98\x80", 4) == 0, @"Surrogate pair decoded as [%@]", s);
+	
+	s = parseFragment(parser, "\"long string with no escapes at all, scanned in blocks\"");
+	FRAssertTrue([s isEqualToString:@"long string with no escapes at all, scanned in blocks"], @"Plain string decoded as [%@]", s);
+	
+	const char* invalid[] = {
+		"\"\\ud83d\"",				//Lone high surrogate
+		"\"\\ud83dx\"",				//High surrogate followed by a character
+		"\"\\ud83d\\u0041\"",		//High surrogate followed by a non surrogate escape
+		"\"\\ude00\"",				//Lone low surrogate
+		"\"\\u12\"",				//Short quad
+		"\"\\x41\"",				//Unknown escape
+		"\"a\tb\"",					//Raw control character
+		"\"unterminated",
+		"\"\xC3\x28\"",				//Invalid UTF-8
+	};
+	int count = sizeof(invalid) / sizeof(invalid[0]);
+	int accepted = acceptedInvalidCases(parser, invalid, count);
+	FRAssertTrue(accepted == 0, @"%i invalid strings parsed", accepted);
+	
+	FRPass(@"Decoded string escapes and rejected %i invalid strings", count);
+}
+
+- (void)test_numbers {
+	WKJsonParser* parser = [[[WKJsonParser alloc] init] autorelease];
+	
+	NSNumber* n = parseFragment(parser, "123");
+	FRAssertTrue([n longLongValue] == 123 && ![n isKindOfClass:[NSDecimalNumber class]], @"Integer parsed as %@ [%@]", n, [n class]);
+	n = parseFragment(parser, "-0");
+	FRAssertTrue(n && [n longLongValue] == 0, @"-0 parsed as %@", n);
+	n = parseFragment(parser, "-123456789012345678");
+	FRAssertTrue([n longLongValue] == -123456789012345678LL, @"18 digit integer parsed as %@", n);
+	
+	//Longer integers keep their precision as decimals
+	n = parseFragment(parser, "12345678901234567890");
+	FRAssertTrue([n isKindOfClass:[NSDecimalNumber class]] && [[n description] isEqualToString:@"12345678901234567890"], @"20 digit integer parsed as %@", n);
+	
+	n = parseFragment(parser, "1.5");
+	FRAssertTrue([n isKindOfClass:[NSDecimalNumber class]] && fabs([n doubleValue] - 1.5) < 1e-12, @"Float parsed as %@", n);
+	n = parseFragment(parser, "-2.5E-1");
+	FRAssertTrue(fabs([n doubleValue] + 0.25) < 1e-12, @"Exponent parsed as %@", n);
+	n = parseFragment(parser, "1e3");
+	FRAssertTrue(fabs([n doubleValue] - 1000.0) < 1e-9, @"Integer exponent parsed as %@", n);
+	n = parseFragment(parser, "0.5e+2");
+	FRAssertTrue(fabs([n doubleValue] - 50.0) < 1e-9, @"Positive exponent parsed as %@", n);
+	
+	const char* invalid[] = { "0123", "-012", "00", "+1", "-", "1.", ".5", "1e", "1e+", "--1", "1.2.3", "0x10" };
+	int count = sizeof(invalid) / sizeof(invalid[0]);
+	int accepted = acceptedInvalidCases(parser, invalid, count);
+	FRAssertTrue(accepted == 0, @"%i invalid numbers parsed", accepted);
+	
+	FRPass(@"Parsed numbers and rejected %i invalid numbers", count);
+}
+
+- (void)test_trailingInput {
+	WKJsonParser* parser = [[[WKJsonParser alloc] init] autorelease];
+	
+	NSArray* a = parseFragment(parser, " [1, 2] \n\t");
+	FRAssertTrue([a count] == 2, @"Trailing whitespace rejected: %@", [parser errorTrace]);
+	
+	const char* invalid[] = { "[1,2,]", "[1,]", "[,]", "{\"a\":1,}", "{\"a\":1 , }", "[1] x", "{} {}", "[1]]", "\"a\" \"b\"", "true false", "nullx" };
+	int count = sizeof(invalid) / sizeof(invalid[0]);
+	int accepted = acceptedInvalidCases(parser, invalid, count);
+	FRAssertTrue(accepted == 0, @"%i documents with trailing commas or garbage parsed", accepted);
+	
+	FRAssertTrue([parser objectWithString:@"42"] == nil, @"A number is not a JSON document");
+	FRPass(@"Rejected %i documents with trailing commas or garbage", count);
+}
+
+- (void)test_maxDepth {
+	WKJsonParser* parser = [[[WKJsonParser alloc] init] autorelease];
+	parser.maxDepth = 3;
+	
+	FRAssertNotNil(parseFragment(parser, "[{\"a\":[1]}]"), @"Depth 3 rejected: %@", [parser errorTrace]);
+	FRAssertTrue(parseFragment(parser, "[{\"a\":[[1]]}]") == nil, @"Depth 4 parsed with maxDepth 3");
+	FRAssertTrue(parseFragment(parser, "{\"a\":{\"b\":{\"c\":{}}}}") == nil, @"Empty object at depth 4 parsed with maxDepth 3");
+	
+	//The default limit stops deeply nested input without exhausting the stack
+	parser.maxDepth = 512;
+	NSMutableData* deep = [NSMutableData data];
+	for(int i = 0; i < 10000; i++) [deep appendBytes:"[" length:1];
+	FRAssertTrue([parser objectWithData:deep] == nil, @"10000 nested arrays parsed");
+	
+	parser.maxDepth = 0;
+	FRAssertNotNil(parseFragment(parser, "[[[[[[1]]]]]]"), @"maxDepth 0 should not limit nesting");
+	
+	FRPass(@"Nesting limited by maxDepth");
+}
+
+- (void)test_duplicateKeys {
+	WKJsonParser* parser = [[[WKJsonParser alloc] init] autorelease];
+	
+	NSDictionary* d = parseFragment(parser, "{\"a\":1,\"b\":2,\"a\":3}");
+	FRAssertTrue([d count] == 2, @"Duplicate keys kept as %@", d);
+	FRAssertTrue([[d objectForKey:@"a"] intValue] == 3, @"The last value of a repeated key should win %@", d);
+	
+	//Escaped and plain spellings of a key are the same key
+	d = parseFragment(parser, "{\"ab\":1,\"a\\u0062\":2}");
+	FRAssertTrue([d count] == 1 && [[d objectForKey:@"ab"] intValue] == 2, @"Escaped duplicate key kept as %@", d);
+	
+	FRPass(@"Repeated keys keep their last value");
+}
+
+@end
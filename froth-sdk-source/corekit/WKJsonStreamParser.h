@@ -0,0 +1,148 @@
+//
+//  WKJsonStreamParser.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "SBJsonBase.h"
+
+@class WKJsonStreamParser;
+
+/*!
+	\brief	Events from WKJsonStreamParser, in document order.
+ 
+	Strings, numbers, booleans and null arrive through -parser:foundValue: as the same Foundation objects WKJsonParser 
+	creates. Object keys arrive through -parser:foundObjectKey: before their value.
+ */
+@protocol WKJsonStreamParserDelegate
+@optional
+- (void)parserStartedObject:(WKJsonStreamParser*)parser;
+- (void)parserEndedObject:(WKJsonStreamParser*)parser;
+- (void)parserStartedArray:(WKJsonStreamParser*)parser;
+- (void)parserEndedArray:(WKJsonStreamParser*)parser;
+- (void)parser:(WKJsonStreamParser*)parser foundObjectKey:(NSString*)key;
+- (void)parser:(WKJsonStreamParser*)parser foundValue:(id)value;
+@end
+
+/*!
+	\brief	An incremental, event based JSON parser for payloads too large to hold as one object graph.
+ 
+	Data is fed in chunks as it arrives, from a NSURLConnection, a curl write callback or a file, and events are sent to 
+	the delegate as soon as each token is complete. Only a token split between chunks is kept between calls, the rest 
+	of each chunk is parsed in place. Object keys are interned, so the keys of each record in a large array are the 
+	same NSString instances. Errors are reported through the -errorTrace, with the byte offset in the stream.
+ 
+	\code
+	WKJsonStreamParser* parser = [[WKJsonStreamParser alloc] init];
+	[parser setDelegate:self];
+	while((chunk = [file readDataOfLength:65536]) && [chunk length]) {
+		if(![parser parseData:chunk]) break;
+	}
+	if(![parser finish]) NSLog(@"%@", [parser errorTrace]);
+	[parser release];
+	\endcode
+ */
+@interface WKJsonStreamParser : SBJsonBase {
+	id <WKJsonStreamParserDelegate> m_delegate;
+	struct {
+		unsigned int startedObject:1;
+		unsigned int endedObject:1;
+		unsigned int startedArray:1;
+		unsigned int endedArray:1;
+		unsigned int foundObjectKey:1;
+		unsigned int foundValue:1;
+	} m_delegateFlags;
+	
+	char* m_buffer;
+	NSUInteger m_length;
+	NSUInteger m_capacity;
+	NSUInteger m_resume;
+	unsigned long long m_offset;
+	
+	struct WKJsonKeyTable* m_keyTable;
+	
+	char* m_containers;
+	NSUInteger m_containersCapacity;
+	int m_state;
+	BOOL m_failed;
+}
+
+@property(assign) id <WKJsonStreamParserDelegate> delegate; // weak ref
+
+/*! \brief Parses the next chunk of the document, returns NO once there has been an error. */
+- (BOOL)parseData:(NSData*)data;
+- (BOOL)parseBytes:(const char*)bytes length:(NSUInteger)length;
+
+/*! \brief Ends the input, a number at the end of the document is sent and it is an error if the document is incomplete. */
+- (BOOL)finish;
+
+/*! \brief Stops parsing from a delegate method, the error is added to the error trace. */
+- (void)abortParsingWithErrorCode:(NSUInteger)code description:(NSString*)description;
+
+/*! \brief Clears all state and errors to parse a new document. */
+- (void)reset;
+
+@end
+
+/*!
+	\brief	Reads the elements of a top level JSON array one at a time, as Foundation objects.
+ 
+	For bulk imports of arrays too large to parse whole. After each chunk any elements that completed can be taken with 
+	-nextElement, so only the elements not yet taken and the one being parsed are in memory. Elements are built as 
+	WKJsonParser builds them.
+ 
+	\code
+	WKJsonArrayReader* reader = [[WKJsonArrayReader alloc] init];
+	- (void)connection:(NSURLConnection*)connection didReceiveData:(NSData*)data {
+		[reader parseData:data];
+		id record;
+		while(record = [reader nextElement]) {
+			[self importRecord:record];
+		}
+	}
+	\endcode
+ */
+@interface WKJsonArrayReader : NSObject <WKJsonStreamParserDelegate> {
+	WKJsonStreamParser* m_parser;
+	NSMutableArray* m_elements;
+	NSUInteger m_nextElement;
+	
+	NSMutableArray* m_containers;
+	NSMutableArray* m_keys;
+	BOOL m_inArray;
+}
+
+- (BOOL)parseData:(NSData*)data;
+- (BOOL)parseBytes:(const char*)bytes length:(NSUInteger)length;
+- (BOOL)finish;
+
+/*! \brief Returns the next complete element, or nil if none are ready. */
+- (id)nextElement;
+
+/*! \brief The parser's error trace, or nil if there were no errors. */
+- (NSArray*)errorTrace;
+
+@end
@@ -0,0 +1,560 @@
+//
+//  WKJsonStreamParser.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WKJsonStreamParser.h"
+#import "WKJsonParser.h"
+
+#define kInitialBufferSize		4096
+#define kInitialContainers		32
+
+/* What the parser expects next */
+enum {
+	WKJsonStateValue = 0,			// At the top level or after ':'
+	WKJsonStateValueOrEndArray,		// After '['
+	WKJsonStateArrayValue,			// After ',' in an array
+	WKJsonStateKeyOrEndObject,		// After '{'
+	WKJsonStateKey,					// After ',' in an object
+	WKJsonStateColon,
+	WKJsonStateCommaOrEnd,
+	WKJsonStateDone
+};
+
+static inline BOOL isSpace(char c) {
+	return (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+}
+
+/* 
+	Returns the closing quote of a string whose body starts at p, or the control character that makes it invalid. Returns 
+	NULL if the string continues past end, with resume set to where to look again once there is more.
+ */
+static const char* findStringEnd(const char* p, const char* end, const char** resume) {
+	for(;;) {
+		p = WKJsonFindStringSpecial(p, end);
+		if(p >= end) {
+			*resume = p;
+			return NULL;
+		}
+		if(*p != '\\') {
+			return p;
+		}
+		if(p + 1 >= end) {
+			*resume = p;
+			return NULL;
+		}
+		p += 2;
+	}
+}
+
+static inline const char* findNumberEnd(const char* p, const char* end) {
+	while(p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) p++;
+	return p;
+}
+
+@interface WKJsonStreamParser (Private)
+- (NSUInteger)_parse:(const char*)start length:(NSUInteger)length final:(BOOL)final;
+- (void)_parseBuffer:(BOOL)final;
+- (void)_appendBytes:(const char*)bytes length:(NSUInteger)length;
+- (void)_failWithCode:(NSUInteger)code message:(const char*)message offset:(unsigned long long)offset;
+- (void)_foundValue:(id)value;
+- (BOOL)_startContainer:(char)type;
+- (void)_endContainer;
+@end
+
+@implementation WKJsonStreamParser
+
+- (id)init {
+	if(self = [super init]) {
+		m_state = WKJsonStateValue;
+		m_keyTable = WKJsonKeyTableCreate();
+	}
+	return self;
+}
+
+- (void)dealloc {
+	WKJsonKeyTableFree(m_keyTable);
+	free(m_buffer);
+	free(m_containers);
+	[super dealloc];
+}
+
+- (id <WKJsonStreamParserDelegate>)delegate {
+	return m_delegate;
+}
+
+- (void)setDelegate:(id <WKJsonStreamParserDelegate>)delegate {
+	m_delegate = delegate;
+	m_delegateFlags.startedObject = [(id)delegate respondsToSelector:@selector(parserStartedObject:)];
+	m_delegateFlags.endedObject = [(id)delegate respondsToSelector:@selector(parserEndedObject:)];
+	m_delegateFlags.startedArray = [(id)delegate respondsToSelector:@selector(parserStartedArray:)];
+	m_delegateFlags.endedArray = [(id)delegate respondsToSelector:@selector(parserEndedArray:)];
+	m_delegateFlags.foundObjectKey = [(id)delegate respondsToSelector:@selector(parser:foundObjectKey:)];
+	m_delegateFlags.foundValue = [(id)delegate respondsToSelector:@selector(parser:foundValue:)];
+}
+
+- (BOOL)parseData:(NSData*)data {
+	return [self parseBytes:[data bytes] length:[data length]];
+}
+
+- (BOOL)parseBytes:(const char*)bytes length:(NSUInteger)length {
+	if(m_failed) {
+		return NO;
+	}
+	
+	if(m_length == 0) {
+		//Parse the chunk in place, keeping only a token that continues in the next chunk
+		NSUInteger consumed = [self _parse:bytes length:length final:NO];
+		if(!m_failed) {
+			[self _appendBytes:bytes + consumed length:length - consumed];
+			m_offset += consumed;
+		}
+	} else {
+		[self _appendBytes:bytes length:length];
+		[self _parseBuffer:NO];
+	}
+	return !m_failed;
+}
+
+- (BOOL)finish {
+	if(m_failed) {
+		return NO;
+	}
+	
+	if(m_length) {
+		[self _parseBuffer:YES];
+	}
+	if(!m_failed && m_state != WKJsonStateDone) {
+		[self _failWithCode:EEOF message:"Unexpected end of input" offset:m_offset + m_length];
+	}
+	return !m_failed;
+}
+
+- (void)abortParsingWithErrorCode:(NSUInteger)code description:(NSString*)description {
+	if(!m_failed) {
+		[self addErrorWithCode:code description:description];
+		m_failed = YES;
+	}
+}
+
+- (void)reset {
+	[self clearErrorTrace];
+	m_length = 0;
+	m_resume = 0;
+	m_offset = 0;
+	depth = 0;
+	m_state = WKJsonStateValue;
+	m_failed = NO;
+	WKJsonKeyTableFree(m_keyTable);
+	m_keyTable = WKJsonKeyTableCreate();
+}
+
+@end
+
+@implementation WKJsonStreamParser (Private)
+
+/* Returns how many bytes were parsed, the rest are the start of a token that continues past the end. */
+- (NSUInteger)_parse:(const char*)start length:(NSUInteger)length final:(BOOL)final {
+	const char* end = start + length;
+	const char* p = start;
+	
+	while(!m_failed) {
+		while(p < end && isSpace(*p)) p++;
+		if(p >= end) {
+			break;
+		}
+		
+		const char* token = p;
+		char c = *p;
+		
+		switch(m_state) {
+			case WKJsonStateDone:
+				[self _failWithCode:ETRAILGARBAGE message:"Garbage after JSON" offset:m_offset + (p - start)];
+				return p - start;
+				
+			case WKJsonStateColon:
+				if(c != ':') {
+					[self _failWithCode:EPARSE message:"Expected ':' separating key and value" offset:m_offset + (p - start)];
+					return p - start;
+				}
+				p++;
+				m_state = WKJsonStateValue;
+				continue;
+				
+			case WKJsonStateCommaOrEnd:
+				if(c == ',') {
+					p++;
+					m_state = (m_containers[depth - 1] == '{') ? WKJsonStateKey : WKJsonStateArrayValue;
+				} else if((c == '}' || c == ']') && c == ((m_containers[depth - 1] == '{') ? '}' : ']')) {
+					p++;
+					[self _endContainer];
+				} else {
+					[self _failWithCode:EPARSE message:"Expected ',' or the end of the array or object" offset:m_offset + (p - start)];
+					return p - start;
+				}
+				continue;
+				
+			case WKJsonStateKeyOrEndObject:
+			case WKJsonStateKey:
+				if(c == '}') {
+					if(m_state == WKJsonStateKey) {
+						[self _failWithCode:ETRAILCOMMA message:"Trailing comma disallowed in object" offset:m_offset + (p - start)];
+						return p - start;
+					}
+					p++;
+					[self _endContainer];
+					continue;
+				}
+				if(c != '"') {
+					[self _failWithCode:EPARSE message:"Object key string expected" offset:m_offset + (p - start)];
+					return p - start;
+				}
+				break;
+				
+			case WKJsonStateValueOrEndArray:
+			case WKJsonStateArrayValue:
+				if(c == ']') {
+					if(m_state == WKJsonStateArrayValue) {
+						[self _failWithCode:ETRAILCOMMA message:"Trailing comma disallowed in array" offset:m_offset + (p - start)];
+						return p - start;
+					}
+					p++;
+					[self _endContainer];
+					continue;
+				}
+				break;
+		}
+		
+		//A key or value
+		if(c == '"') {
+			const char* resume = NULL;
+			const char* from = (token == start && m_resume) ? token + m_resume : token + 1;
+			const char* close = findStringEnd(from, end, &resume);
+			if(!close) {
+				if(final) {
+					[self _failWithCode:EEOF message:"Unexpected end of input while parsing string" offset:m_offset + length];
+					return token - start;
+				}
+				m_resume = resume - token;
+				return token - start;
+			}
+			
+			BOOL isKey = (m_state == WKJsonStateKeyOrEndObject || m_state == WKJsonStateKey);
+			WKJsonError error = { 0, NULL };
+			NSString* string = (isKey) ? WKJsonKeyTableNewKey(m_keyTable, token + 1, close - token, &error) : WKJsonNewString(token + 1, close - token, &error);
+			if(!string) {
+				[self _failWithCode:error.code message:error.message offset:m_offset + (token - start)];
+				return token - start;
+			}
+			m_resume = 0;
+			p = close + 1;
+			
+			if(isKey) {
+				if(m_delegateFlags.foundObjectKey) {
+					[m_delegate parser:self foundObjectKey:string];
+				}
+				[string release];
+				m_state = WKJsonStateColon;
+			} else {
+				[self _foundValue:string];
+			}
+			continue;
+		}
+		
+		switch(c) {
+			case '{':
+			case '[':
+				p++;
+				if(![self _startContainer:c]) {
+					[self _failWithCode:EDEPTH message:"Nested too deep" offset:m_offset + (token - start)];
+					return token - start;
+				}
+				break;
+				
+			case 't':
+			case 'f':
+			case 'n': {
+				const char* literal = (c == 't') ? "true" : (c == 'f') ? "false" : "null";
+				NSUInteger literalLength = strlen(literal);
+				NSUInteger available = end - p;
+				if(memcmp(p, literal, MIN(available, literalLength)) != 0) {
+					[self _failWithCode:EPARSE message:"Expected 'true', 'false' or 'null'" offset:m_offset + (p - start)];
+					return p - start;
+				}
+				if(available < literalLength) {
+					if(final) {
+						[self _failWithCode:EEOF message:"Unexpected end of input" offset:m_offset + length];
+					}
+					return token - start;
+				}
+				p += literalLength;
+				[self _foundValue:(c == 'n') ? [[NSNull null] retain] : [[NSNumber numberWithBool:(c == 't')] retain]];
+				break;
+			}
+				
+			case '-':
+			case '0'...'9': {
+				const char* numberEnd = findNumberEnd(p, end);
+				if(numberEnd == end && !final) {
+					return token - start;
+				}
+				WKJsonError error = { 0, NULL };
+				NSNumber* number = WKJsonNewNumber(p, numberEnd - p, &error);
+				if(!number) {
+					[self _failWithCode:error.code message:error.message offset:m_offset + (p - start)];
+					return p - start;
+				}
+				p = numberEnd;
+				[self _foundValue:number];
+				break;
+			}
+				
+			case '+':
+				[self _failWithCode:EPARSENUM message:"Leading + disallowed in number" offset:m_offset + (p - start)];
+				return p - start;
+				
+			default:
+				[self _failWithCode:EPARSE message:"Unrecognised leading character" offset:m_offset + (p - start)];
+				return p - start;
+		}
+	}
+	return p - start;
+}
+
+- (void)_parseBuffer:(BOOL)final {
+	NSUInteger consumed = [self _parse:m_buffer length:m_length final:final];
+	if(!m_failed && consumed) {
+		memmove(m_buffer, m_buffer + consumed, m_length - consumed);
+		m_length -= consumed;
+		m_offset += consumed;
+	}
+}
+
+- (void)_appendBytes:(const char*)bytes length:(NSUInteger)length {
+	if(m_length + length > m_capacity) {
+		NSUInteger capacity = (m_capacity) ? m_capacity : kInitialBufferSize;
+		while(capacity < m_length + length) capacity *= 2;
+		m_buffer = realloc(m_buffer, capacity);
+		m_capacity = capacity;
+	}
+	memcpy(m_buffer + m_length, bytes, length);
+	m_length += length;
+}
+
+- (void)_failWithCode:(NSUInteger)code message:(const char*)message offset:(unsigned long long)offset {
+	[self addErrorWithCode:code description:[NSString stringWithFormat:@"%s at byte %llu", message, offset]];
+	m_failed = YES;
+}
+
+/* Takes ownership of value */
+- (void)_foundValue:(id)value {
+	if(m_delegateFlags.foundValue) {
+		[m_delegate parser:self foundValue:value];
+	}
+	[value release];
+	m_state = (depth) ? WKJsonStateCommaOrEnd : WKJsonStateDone;
+}
+
+- (BOOL)_startContainer:(char)type {
+	if(maxDepth && depth >= maxDepth) {
+		return NO;
+	}
+	if(depth == m_containersCapacity) {
+		m_containersCapacity = (m_containersCapacity) ? m_containersCapacity * 2 : kInitialContainers;
+		m_containers = realloc(m_containers, m_containersCapacity);
+	}
+	m_containers[depth++] = type;
+	
+	if(type == '{') {
+		m_state = WKJsonStateKeyOrEndObject;
+		if(m_delegateFlags.startedObject) {
+			[m_delegate parserStartedObject:self];
+		}
+	} else {
+		m_state = WKJsonStateValueOrEndArray;
+		if(m_delegateFlags.startedArray) {
+			[m_delegate parserStartedArray:self];
+		}
+	}
+	return YES;
+}
+
+- (void)_endContainer {
+	char type = m_containers[--depth];
+	m_state = (depth) ? WKJsonStateCommaOrEnd : WKJsonStateDone;
+	
+	if(type == '{') {
+		if(m_delegateFlags.endedObject) {
+			[m_delegate parserEndedObject:self];
+		}
+	} else if(m_delegateFlags.endedArray) {
+		[m_delegate parserEndedArray:self];
+	}
+}
+
+@end
+
+#pragma mark -
+
+@interface WKJsonArrayReader (Private)
+- (void)_addValue:(id)value;
+- (void)_startContainer:(id)container key:(id)key;
+- (void)_endContainer;
+@end
+
+@implementation WKJsonArrayReader
+
+- (id)init {
+	if(self = [super init]) {
+		m_parser = [[WKJsonStreamParser alloc] init];
+		[m_parser setDelegate:self];
+		m_elements = [[NSMutableArray alloc] init];
+		m_containers = [[NSMutableArray alloc] init];
+		m_keys = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_parser setDelegate:nil];
+	[m_parser release];
+	[m_elements release];
+	[m_containers release];
+	[m_keys release];
+	[super dealloc];
+}
+
+- (BOOL)parseData:(NSData*)data {
+	return [m_parser parseData:data];
+}
+
+- (BOOL)parseBytes:(const char*)bytes length:(NSUInteger)length {
+	return [m_parser parseBytes:bytes length:length];
+}
+
+- (BOOL)finish {
+	return [m_parser finish];
+}
+
+- (id)nextElement {
+	if(m_nextElement >= [m_elements count]) {
+		return nil;
+	}
+	
+	id element = [[[m_elements objectAtIndex:m_nextElement++] retain] autorelease];
+	if(m_nextElement == [m_elements count]) {
+		[m_elements removeAllObjects];
+		m_nextElement = 0;
+	}
+	return element;
+}
+
+- (NSArray*)errorTrace {
+	return [m_parser errorTrace];
+}
+
+#pragma mark WKJsonStreamParserDelegate
+
+- (void)parserStartedObject:(WKJsonStreamParser*)parser {
+	NSMutableDictionary* object = [[NSMutableDictionary alloc] init];
+	[self _startContainer:object key:@""];
+	[object release];
+}
+
+- (void)parserEndedObject:(WKJsonStreamParser*)parser {
+	[self _endContainer];
+}
+
+- (void)parserStartedArray:(WKJsonStreamParser*)parser {
+	if(!m_inArray && ![m_containers count]) {
+		m_inArray = YES;
+		return;
+	}
+	NSMutableArray* array = [[NSMutableArray alloc] init];
+	[self _startContainer:array key:[NSNull null]];
+	[array release];
+}
+
+- (void)parserEndedArray:(WKJsonStreamParser*)parser {
+	//The end of the top level array has nothing to pop
+	if([m_containers count]) {
+		[self _endContainer];
+	}
+}
+
+- (void)parser:(WKJsonStreamParser*)parser foundObjectKey:(NSString*)key {
+	[m_keys replaceObjectAtIndex:[m_keys count] - 1 withObject:key];
+}
+
+- (void)parser:(WKJsonStreamParser*)parser foundValue:(id)value {
+	[self _addValue:value];
+}
+
+@end
+
+@implementation WKJsonArrayReader (Private)
+
+- (void)_addValue:(id)value {
+	if(![m_containers count]) {
+		if(!m_inArray) {
+			[m_parser abortParsingWithErrorCode:EFRAGMENT description:@"Top level value is not an array"];
+			return;
+		}
+		[m_elements addObject:value];
+		return;
+	}
+	
+	id key = [m_keys lastObject];
+	if(key == [NSNull null]) {
+		[[m_containers lastObject] addObject:value];
+	} else {
+		[[m_containers lastObject] setObject:value forKey:key];
+	}
+}
+
+/* Nested containers are added to their parent when they start, elements are only added to the queue once complete. */
+- (void)_startContainer:(id)container key:(id)key {
+	if([m_containers count]) {
+		[self _addValue:container];
+	} else if(!m_inArray) {
+		[m_parser abortParsingWithErrorCode:EFRAGMENT description:@"Top level value is not an array"];
+		return;
+	}
+	[m_containers addObject:container];
+	[m_keys addObject:key];
+}
+
+- (void)_endContainer {
+	id container = [[m_containers lastObject] retain];
+	[m_containers removeLastObject];
+	[m_keys removeLastObject];
+	if(![m_containers count]) {
+		[m_elements addObject:container];
+	}
+	[container release];
+}
+
+@end
@@ -0,0 +1,117 @@
+//
+//  WKJsonWriter.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "SBJsonBase.h"
+#import "SBJsonWriter.h"
+#import "MGTemplateEngine.h"
+
+@class WKJsonWriter;
+
+#define kWKJsonKeyCacheSize 64
+
+typedef struct {
+	NSString* key;
+	char* bytes;
+	NSUInteger length;
+} WKJsonKeyCacheEntry;
+
+/*!
+	\brief	Objects that write their own JSON, instead of being converted with -proxyForJson first.
+ 
+	Implementations write one value with the writer's -beginObject, -writeValue:forKey: and -endObject methods (or any
+	other single value). WebModelBase writes its fields straight from its data this way.
+ */
+@protocol WKJsonWriting
+- (BOOL)writeJsonWithWriter:(WKJsonWriter*)writer;
+@end
+
+/*!
+	\brief	A JSON writer that writes UTF-8 into a byte buffer, a faster replacement for SBJsonWriter.
+ 
+	Strings are encoded straight into the buffer and copied through when they have nothing to escape, which is most of 
+	them. The quoted form of recently written dictionary keys is cached by key instance, so the repeated keys of an 
+	array of models or dictionaries are only escaped once. With a sink, output is written to it about every 16KB 
+	instead of growing the buffer, ie to stream a large response to the client.
+ 
+	Types map as they do with SBJsonWriter. Objects that implement WKJsonWriting write themselves, otherwise -proxyForJson 
+	is used. Output is compact unless humanReadable is set. A writer can be reused, but not shared between threads.
+ 
+	\code
+	WKJsonWriter* writer = [[WKJsonWriter alloc] init];
+	NSData* json = [writer dataWithObject:models];
+	[writer release];
+	\endcode
+ */
+@interface WKJsonWriter : SBJsonBase <SBJsonWriter> {
+	char* m_bytes;
+	NSUInteger m_length;
+	NSUInteger m_capacity;
+	id <MGTemplateOutputSink> m_sink;
+	
+	BOOL m_needsComma;
+	BOOL m_afterKey;
+	BOOL sortKeys;
+	BOOL humanReadable;
+	
+	WKJsonKeyCacheEntry m_keyCache[kWKJsonKeyCacheSize];
+}
+
+@property BOOL sortKeys;
+@property BOOL humanReadable;
+
+/*! \brief Returns the UTF-8 JSON for a value, or nil on error. */
+- (NSData*)dataWithObject:(id)value;
+
+/*! \brief Returns the JSON for a NSDictionary or NSArray as a string, or nil on error. */
+- (NSString*)stringWithObject:(id)value;
+
+/*! \brief Writes the JSON for a value to sink in chunks, returns NO on error (after the output before it was written). */
+- (BOOL)writeObject:(id)value toSink:(id <MGTemplateOutputSink>)sink;
+
+/*
+	Writing values, for WKJsonWriting implementations. Each writes the separator needed before it, values in an 
+	object are written with -writeValue:forKey:. Return NO on error.
+ */
+- (BOOL)writeValue:(id)value;
+- (BOOL)writeValue:(id)value forKey:(NSString*)key;
+- (BOOL)beginObject;
+- (void)endObject;
+- (BOOL)beginArray;
+- (void)endArray;
+
+@end
+
+/*! \brief Renders a value as JSON, for a WebStreamingResponse. */
+@interface WKJsonRender : NSObject <MGTemplateRenderable> {
+	id m_object;
+}
+
++ (WKJsonRender*)renderWithObject:(id)object;
+
+@end
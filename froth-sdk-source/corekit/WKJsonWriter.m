@@ -0,0 +1,465 @@
+//
+//  WKJsonWriter.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WKJsonWriter.h"
+
+#define kInitialCapacity	1024
+#define kSinkFlushSize		(16*1024)
+#define kMaxCachedKeyLength	64
+
+/* Bytes that must be escaped in a JSON string */
+static const uint8_t kEscape[256] = { [0 ... 0x1F] = 1, ['"'] = 1, ['\\'] = 1 };
+static const char kHexDigits[] = "0123456789abcdef";
+
+@interface WKJsonWriter (Private)
+- (void)_reserve:(NSUInteger)count;
+- (void)_flushToSink;
+- (void)_reset;
+- (void)_separator;
+- (NSUInteger)_appendUTF8:(NSString*)string;
+- (void)_writeString:(NSString*)string;
+- (void)_writeKey:(NSString*)key;
+- (BOOL)_writeDictionary:(NSDictionary*)dictionary;
+- (BOOL)_writeArray:(NSArray*)array;
+- (void)_writeNumber:(NSNumber*)number;
+@end
+
+static inline void appendBytes(char* bytes, NSUInteger* length, const char* src, NSUInteger count) {
+	memcpy(bytes + *length, src, count);
+	*length += count;
+}
+
+/* Escapes count raw UTF-8 bytes into out, which must have room for count * 6 bytes. Returns the escaped length. */
+static NSUInteger escapeUTF8(const uint8_t* src, NSUInteger count, char* out) {
+	char* o = out;
+	const uint8_t* end = src + count;
+	while(src < end) {
+		const uint8_t* run = src;
+		while(src < end && !kEscape[*src]) src++;
+		memcpy(o, run, src - run);
+		o += src - run;
+		if(src == end) break;
+		
+		uint8_t c = *src++;
+		*o++ = '\\';
+		switch(c) {
+			case '"':	*o++ = '"';		break;
+			case '\\':	*o++ = '\\';	break;
+			case '\n':	*o++ = 'n';		break;
+			case '\r':	*o++ = 'r';		break;
+			case '\t':	*o++ = 't';		break;
+			case '\b':	*o++ = 'b';		break;
+			case '\f':	*o++ = 'f';		break;
+			default:
+				*o++ = 'u';
+				*o++ = '0';
+				*o++ = '0';
+				*o++ = kHexDigits[c >> 4];
+				*o++ = kHexDigits[c & 0xF];
+				break;
+		}
+	}
+	return o - out;
+}
+
+@implementation WKJsonWriter
+
+@synthesize sortKeys;
+@synthesize humanReadable;
+
+- (void)dealloc {
+	for(int i=0; i<kWKJsonKeyCacheSize; i++) {
+		[m_keyCache[i].key release];
+		free(m_keyCache[i].bytes);
+	}
+	free(m_bytes);
+	[super dealloc];
+}
+
+- (NSData*)dataWithObject:(id)value {
+	[self _reset];
+	if(![self writeValue:value]) {
+		return nil;
+	}
+	NSData* data = [NSData dataWithBytes:m_bytes length:m_length];
+	m_length = 0;
+	return data;
+}
+
+- (NSString*)stringWithObject:(id)value {
+	if(![value isKindOfClass:[NSDictionary class]] && ![value isKindOfClass:[NSArray class]] && ![value conformsToProtocol:@protocol(WKJsonWriting)]) {
+		[self clearErrorTrace];
+		[self addErrorWithCode:EFRAGMENT description:[NSString stringWithFormat:@"Not valid type for JSON of object [%@]", NSStringFromClass([value class])]];
+		return nil;
+	}
+	
+	[self _reset];
+	if(![self writeValue:value]) {
+		return nil;
+	}
+	NSString* string = [[NSString alloc] initWithBytes:m_bytes length:m_length encoding:NSUTF8StringEncoding];
+	m_length = 0;
+	return [string autorelease];
+}
+
+- (BOOL)writeObject:(id)value toSink:(id <MGTemplateOutputSink>)sink {
+	[self _reset];
+	m_sink = sink;
+	BOOL written = [self writeValue:value];
+	[self _flushToSink];
+	m_sink = nil;
+	return written;
+}
+
+#pragma mark -
+#pragma mark Writing Values
+
+- (BOOL)writeValue:(id)value {
+	if([value isKindOfClass:[NSString class]]) {
+		[self _separator];
+		[self _writeString:value];
+	} else if([value isKindOfClass:[NSNumber class]]) {
+		[self _separator];
+		[self _writeNumber:value];
+	} else if([value isKindOfClass:[NSDictionary class]]) {
+		return [self _writeDictionary:value];
+	} else if([value isKindOfClass:[NSArray class]]) {
+		return [self _writeArray:value];
+	} else if([value isKindOfClass:[NSNull class]]) {
+		[self _separator];
+		[self _reserve:4];
+		appendBytes(m_bytes, &m_length, "null", 4);
+	} else if([value conformsToProtocol:@protocol(WKJsonWriting)]) {
+		return [value writeJsonWithWriter:self];
+	} else if([value respondsToSelector:@selector(proxyForJson)]) {
+		return [self writeValue:[value proxyForJson]];
+	} else {
+		[self addErrorWithCode:EUNSUPPORTED description:[NSString stringWithFormat:@"JSON serialisation not supported for %@", [value class]]];
+		return NO;
+	}
+	m_needsComma = YES;
+	return YES;
+}
+
+- (BOOL)writeValue:(id)value forKey:(NSString*)key {
+	if(![key isKindOfClass:[NSString class]]) {
+		[self addErrorWithCode:EUNSUPPORTED description:@"JSON object key must be string"];
+		return NO;
+	}
+	
+	[self _separator];
+	[self _writeKey:key];
+	if(humanReadable) {
+		[self _reserve:3];
+		appendBytes(m_bytes, &m_length, " : ", 3);
+	} else {
+		[self _reserve:1];
+		m_bytes[m_length++] = ':';
+	}
+	m_needsComma = NO;
+	m_afterKey = YES;
+	
+	if(![self writeValue:value]) {
+		[self addErrorWithCode:EUNSUPPORTED description:[NSString stringWithFormat:@"Unsupported value for key %@ in object", key]];
+		return NO;
+	}
+	return YES;
+}
+
+- (BOOL)beginObject {
+	if(maxDepth && ++depth > maxDepth) {
+		[self addErrorWithCode:EDEPTH description:@"Nested too deep"];
+		return NO;
+	}
+	[self _separator];
+	[self _reserve:1];
+	m_bytes[m_length++] = '{';
+	m_needsComma = NO;
+	return YES;
+}
+
+- (void)endObject {
+	depth--;
+	[self _reserve:2];
+	if(humanReadable) {
+		m_bytes[m_length++] = '\n';
+	}
+	m_bytes[m_length++] = '}';
+	m_needsComma = YES;
+}
+
+- (BOOL)beginArray {
+	if(maxDepth && ++depth > maxDepth) {
+		[self addErrorWithCode:EDEPTH description:@"Nested too deep"];
+		return NO;
+	}
+	[self _separator];
+	[self _reserve:1];
+	m_bytes[m_length++] = '[';
+	m_needsComma = NO;
+	return YES;
+}
+
+- (void)endArray {
+	depth--;
+	[self _reserve:2];
+	if(humanReadable) {
+		m_bytes[m_length++] = '\n';
+	}
+	m_bytes[m_length++] = ']';
+	m_needsComma = YES;
+}
+
+@end
+
+@implementation WKJsonWriter (Private)
+
+- (void)_reserve:(NSUInteger)count {
+	if(m_length + count <= m_capacity) {
+		return;
+	}
+	
+	//With a sink, send what is written so far rather than growing past the flush size
+	if(m_sink && m_length >= kSinkFlushSize) {
+		[self _flushToSink];
+		if(count <= m_capacity) {
+			return;
+		}
+	}
+	
+	NSUInteger capacity = (m_capacity) ? m_capacity : kInitialCapacity;
+	while(capacity < m_length + count) capacity *= 2;
+	m_bytes = realloc(m_bytes, capacity);
+	m_capacity = capacity;
+}
+
+- (void)_flushToSink {
+	if(m_sink && m_length) {
+		[m_sink writeUTF8Bytes:m_bytes length:m_length];
+		m_length = 0;
+	}
+}
+
+- (void)_reset {
+	[self clearErrorTrace];
+	m_length = 0;
+	depth = 0;
+	m_needsComma = NO;
+	m_afterKey = NO;
+}
+
+- (void)_separator {
+	if(m_afterKey) {
+		m_afterKey = NO;
+	} else if(m_needsComma || humanReadable) {
+		[self _reserve:2];
+		if(m_needsComma) {
+			m_bytes[m_length++] = ',';
+		}
+		if(humanReadable && depth) {
+			m_bytes[m_length++] = '\n';
+		}
+	}
+}
+
+/* Encodes the string at the end of the buffer, reserve room for it first so the buffer is not flushed part way. */
+- (NSUInteger)_appendUTF8:(NSString*)string {
+	NSUInteger count = [string length];
+	NSUInteger maxBytes = [string maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+	[self _reserve:maxBytes];
+	
+	NSUInteger used = 0;
+	if(count && ![string getBytes:m_bytes + m_length maxLength:maxBytes usedLength:&used 
+						 encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, count) remainingRange:NULL]) {
+		used = 0;
+	}
+	m_length += used;
+	return used;
+}
+
+/* The string is encoded straight into the buffer, then escaped in a second copy only if it needs to be. */
+- (void)_writeString:(NSString*)string {
+	[self _reserve:[string maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding] + 2];
+	m_bytes[m_length++] = '"';
+	NSUInteger start = m_length;
+	NSUInteger used = [self _appendUTF8:string];
+	
+	const uint8_t* encoded = (const uint8_t*)m_bytes + start;
+	NSUInteger i = 0;
+	while(i < used && !kEscape[encoded[i]]) i++;
+	
+	if(i < used) {
+		//Move the unescaped bytes out of the way and escape them back into the buffer
+		char* raw = malloc(used - i);
+		memcpy(raw, encoded + i, used - i);
+		NSUInteger escapeLength = used - i;
+		m_length = start + i;
+		[self _reserve:escapeLength * 6 + 1];
+		m_length += escapeUTF8((const uint8_t*)raw, escapeLength, m_bytes + m_length);
+		free(raw);
+	}
+	[self _reserve:1];
+	m_bytes[m_length++] = '"';
+}
+
+/* Keys are cached in their quoted and escaped form by instance, the keys of models and parsed arrays repeat. */
+- (void)_writeKey:(NSString*)key {
+	WKJsonKeyCacheEntry* entry = &m_keyCache[((uintptr_t)key >> 4) % kWKJsonKeyCacheSize];
+	if(entry->key == key) {
+		[self _reserve:entry->length];
+		appendBytes(m_bytes, &m_length, entry->bytes, entry->length);
+		return;
+	}
+	
+	NSUInteger start = m_length;
+	[self _writeString:key];
+	NSUInteger length = m_length - start;
+	if(length <= kMaxCachedKeyLength && !m_sink) {
+		[entry->key release];
+		entry->key = [key retain];
+		entry->bytes = realloc(entry->bytes, length);
+		memcpy(entry->bytes, m_bytes + start, length);
+		entry->length = length;
+	}
+}
+
+- (BOOL)_writeDictionary:(NSDictionary*)dictionary {
+	if(![self beginObject]) {
+		return NO;
+	}
+	
+	if(sortKeys) {
+		for(NSString* key in [[dictionary allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+			if(![self writeValue:[dictionary objectForKey:key] forKey:key]) {
+				return NO;
+			}
+		}
+	} else {
+		NSEnumerator* keys = [dictionary keyEnumerator];
+		NSString* key;
+		while(key = [keys nextObject]) {
+			if(![self writeValue:[dictionary objectForKey:key] forKey:key]) {
+				return NO;
+			}
+		}
+	}
+	
+	[self endObject];
+	return YES;
+}
+
+- (BOOL)_writeArray:(NSArray*)array {
+	if(![self beginArray]) {
+		return NO;
+	}
+	for(id value in array) {
+		if(![self writeValue:value]) {
+			return NO;
+		}
+	}
+	[self endArray];
+	return YES;
+}
+
+/* Integers are formatted here, other numbers use -stringValue as SBJsonWriter does. */
+- (void)_writeNumber:(NSNumber*)number {
+	const char* type = [number objCType];
+	
+	if(*type == 'c') {
+		BOOL value = [number boolValue];
+		[self _reserve:5];
+		appendBytes(m_bytes, &m_length, (value) ? "true" : "false", (value) ? 4 : 5);
+		return;
+	}
+	
+	if(![number isKindOfClass:[NSDecimalNumber class]] && strchr("islqISLQ", *type)) {
+		char digits[24];
+		char* d = digits + sizeof(digits);
+		BOOL isUnsigned = (*type >= 'A' && *type <= 'Z');
+		unsigned long long magnitude;
+		BOOL negative = NO;
+		if(isUnsigned) {
+			magnitude = [number unsignedLongLongValue];
+		} else {
+			long long value = [number longLongValue];
+			negative = (value < 0);
+			magnitude = (negative) ? -(unsigned long long)value : (unsigned long long)value;
+		}
+		do {
+			*--d = '0' + (magnitude % 10);
+			magnitude /= 10;
+		} while(magnitude);
+		if(negative) {
+			*--d = '-';
+		}
+		
+		[self _reserve:sizeof(digits)];
+		appendBytes(m_bytes, &m_length, d, digits + sizeof(digits) - d);
+		return;
+	}
+	
+	[self _appendUTF8:[number stringValue]];
+}
+
+@end
+
+#pragma mark -
+
+@implementation WKJsonRender
+
++ (WKJsonRender*)renderWithObject:(id)object {
+	WKJsonRender* render = [[self alloc] init];
+	render->m_object = [object retain];
+	return [render autorelease];
+}
+
+- (void)dealloc {
+	[m_object release];
+	[super dealloc];
+}
+
+- (void)renderToSink:(id <MGTemplateOutputSink>)sink {
+	WKJsonWriter* writer = [[WKJsonWriter alloc] init];
+	if(![writer writeObject:m_object toSink:sink]) {
+		NSLog(@"+++ [[ERROR]] WKJsonRender: Unable to write JSON %@", [writer errorTrace]);
+	}
+	[sink flush];
+	[writer release];
+}
+
+- (NSData*)renderedUTF8Data {
+	WKJsonWriter* writer = [[WKJsonWriter alloc] init];
+	NSData* data = [writer dataWithObject:m_object];
+	if(!data) {
+		NSLog(@"+++ [[ERROR]] WKJsonRender: Unable to write JSON %@", [writer errorTrace]);
+	}
+	[writer release];
+	return data;
+}
+
+@end
@@ -0,0 +1,68 @@
+//
+//  WKScanningTemplateMatcher.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "MGTemplateEngine.h"
+
+typedef struct {
+	unichar* chars;
+	NSUInteger length;
+} WKDelimiter;
+
+/*!
+	\brief	A template matcher that scans for the delimiters by hand, a faster drop in replacement for AGRegexTemplateMatcher.
+ 
+	The template is copied to a character buffer once, then each marker is found and split into its name, arguments and 
+	filter in one pass, without building or running regular expressions. Markers are matched exactly as AGRegexTemplateMatcher 
+	matches them, including quoted arguments with \\-escaped quotes, filter arguments after ':' and the rule that marker text 
+	can not span lines (the space around it can).
+ 
+	\code
+	MGTemplateEngine* engine = [MGTemplateEngine templateEngine];
+	[engine setMatcher:[WKScanningTemplateMatcher matcherWithTemplateEngine:engine]];
+	\endcode
+ */
+@interface WKScanningTemplateMatcher : NSObject <MGTemplateEngineMatcher> {
+	MGTemplateEngine* m_engine;
+	NSString* m_templateString;
+	unichar* m_chars;
+	NSUInteger m_length;
+	
+	WKDelimiter m_markerStart;
+	WKDelimiter m_markerEnd;
+	WKDelimiter m_exprStart;
+	WKDelimiter m_exprEnd;
+	WKDelimiter m_filter;
+}
+
++ (WKScanningTemplateMatcher*)matcherWithTemplateEngine:(MGTemplateEngine*)engine;
+
+/*! \brief Splits a marker's text into arguments, the same as -[AGRegexTemplateMatcher argumentsFromString:] */
+- (NSArray*)argumentsFromString:(NSString*)argString;
+
+@end
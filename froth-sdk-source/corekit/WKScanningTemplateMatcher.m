@@ -0,0 +1,283 @@
+//
+//  WKScanningTemplateMatcher.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WKScanningTemplateMatcher.h"
+
+/* A marker found by scanMarkerAt, as positions in the character buffer */
+typedef struct {
+	NSUInteger start;			// Of the start delimiter
+	NSUInteger end;				// After the end delimiter
+	NSUInteger contentStart;
+	NSUInteger contentEnd;
+	NSUInteger filterStart;		// NSNotFound without a filter
+	NSUInteger filterEnd;
+} WKScanMatch;
+
+/* The same characters as \s in the regex matcher */
+static inline BOOL isSpace(unichar c) {
+	return (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f');
+}
+
+static inline BOOL hasDelimiterAt(const unichar* chars, NSUInteger pos, NSUInteger limit, WKDelimiter d) {
+	return (d.length > 0 && pos + d.length <= limit && memcmp(chars + pos, d.chars, d.length * sizeof(unichar)) == 0);
+}
+
+static inline NSUInteger skipSpaces(const unichar* chars, NSUInteger pos, NSUInteger limit) {
+	while(pos < limit && isSpace(chars[pos])) pos++;
+	return pos;
+}
+
+/*
+	Content (and filter) text can not span lines, but the space around it can. The content ends at the first 
+	position that is followed (after spaces) by the filter delimiter with a complete filter, or by the end delimiter.
+ */
+static BOOL scanFilter(const unichar* chars, NSUInteger pos, NSUInteger limit, WKDelimiter end, WKScanMatch* match) {
+	NSUInteger p = skipSpaces(chars, pos, limit);
+	NSUInteger filterStart = p;
+	for(;;) {
+		NSUInteger q = skipSpaces(chars, p, limit);
+		if(hasDelimiterAt(chars, q, limit, end)) {
+			match->filterStart = filterStart;
+			match->filterEnd = p;
+			match->end = q + end.length;
+			return YES;
+		}
+		if(p >= limit || chars[p] == '\n') return NO;
+		p++;
+	}
+}
+
+static BOOL scanMarkerAt(const unichar* chars, NSUInteger pos, NSUInteger limit, 
+						 WKDelimiter start, WKDelimiter end, WKDelimiter filter, WKScanMatch* match) {
+	if(!hasDelimiterAt(chars, pos, limit, start)) return NO;
+	
+	match->start = pos;
+	match->filterStart = NSNotFound;
+	match->filterEnd = NSNotFound;
+	
+	NSUInteger p = skipSpaces(chars, pos + start.length, limit);
+	match->contentStart = p;
+	for(;;) {
+		NSUInteger q = skipSpaces(chars, p, limit);
+		if(hasDelimiterAt(chars, q, limit, filter) && scanFilter(chars, q + filter.length, limit, end, match)) {
+			match->contentEnd = p;
+			return YES;
+		}
+		if(hasDelimiterAt(chars, q, limit, end)) {
+			match->contentEnd = p;
+			match->end = q + end.length;
+			return YES;
+		}
+		if(p >= limit || chars[p] == '\n') return NO;
+		p++;
+	}
+}
+
+/* An argument, or NO if there are none left. Mirrors "(.*?)(?<!\\)"|'(.*?)(?<!\\)'|(\S+) */
+static BOOL scanArgument(const unichar* chars, NSUInteger* pos, NSUInteger limit, NSUInteger* argStart, NSUInteger* argEnd) {
+	NSUInteger p = skipSpaces(chars, *pos, limit);
+	if(p >= limit) return NO;
+	
+	unichar quote = chars[p];
+	if(quote == '"' || quote == '\'') {
+		NSUInteger q = p + 1;
+		while(q < limit && chars[q] != '\n') {
+			if(chars[q] == quote && chars[q-1] != '\\') {
+				*argStart = p + 1;
+				*argEnd = q;
+				*pos = q + 1;
+				return (q > p + 1);		//An empty quoted argument ends the arguments
+			}
+			q++;
+		}
+	}
+	
+	NSUInteger q = p;
+	while(q < limit && !isSpace(chars[q])) q++;
+	*argStart = p;
+	*argEnd = q;
+	*pos = q;
+	return YES;
+}
+
+static void setDelimiter(WKDelimiter* delimiter, NSString* string) {
+	free(delimiter->chars);
+	delimiter->length = [string length];
+	delimiter->chars = malloc(sizeof(unichar) * (delimiter->length + 1));
+	[string getCharacters:delimiter->chars range:NSMakeRange(0, delimiter->length)];
+}
+
+@interface WKScanningTemplateMatcher (Private)
+- (NSArray*)_argumentsFromCharacters:(const unichar*)chars start:(NSUInteger)start end:(NSUInteger)end;
+- (NSArray*)_filterComponentsFromStart:(NSUInteger)start end:(NSUInteger)end;
+@end
+
+@implementation WKScanningTemplateMatcher
+
++ (WKScanningTemplateMatcher*)matcherWithTemplateEngine:(MGTemplateEngine*)engine {
+	return [[[WKScanningTemplateMatcher alloc] initWithTemplateEngine:engine] autorelease];
+}
+
+- (id)initWithTemplateEngine:(MGTemplateEngine*)engine {
+	if(self = [super init]) {
+		m_engine = engine;	//weak
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_templateString release];
+	free(m_chars);
+	free(m_markerStart.chars);
+	free(m_markerEnd.chars);
+	free(m_exprStart.chars);
+	free(m_exprEnd.chars);
+	free(m_filter.chars);
+	[super dealloc];
+}
+
+- (void)engineSettingsChanged {
+	setDelimiter(&m_markerStart, m_engine.markerStartDelimiter);
+	setDelimiter(&m_markerEnd, m_engine.markerEndDelimiter);
+	setDelimiter(&m_exprStart, m_engine.expressionStartDelimiter);
+	setDelimiter(&m_exprEnd, m_engine.expressionEndDelimiter);
+	setDelimiter(&m_filter, m_engine.filterDelimiter);
+	
+	//The same template is often set again (ie compile then render), only copy the characters when it changes
+	NSString* templateString = m_engine.templateContents;
+	if(templateString != m_templateString || [templateString length] != m_length) {
+		[m_templateString release];
+		m_templateString = [templateString retain];
+		
+		free(m_chars);
+		m_length = [templateString length];
+		m_chars = malloc(sizeof(unichar) * (m_length + 1));
+		[templateString getCharacters:m_chars range:NSMakeRange(0, m_length)];
+	}
+}
+
+- (NSDictionary*)firstMarkerWithinRange:(NSRange)range {
+	NSUInteger limit = MIN(NSMaxRange(range), m_length);
+	if(range.location >= limit || !m_markerStart.length || !m_exprStart.length) {
+		return nil;
+	}
+	
+	unichar markerFirst = m_markerStart.chars[0];
+	unichar exprFirst = m_exprStart.chars[0];
+	
+	WKScanMatch match;
+	BOOL isMarker = NO;
+	BOOL found = NO;
+	for(NSUInteger i = range.location; i < limit && !found; i++) {
+		unichar c = m_chars[i];
+		if(c != markerFirst && c != exprFirst) continue;
+		
+		if(scanMarkerAt(m_chars, i, limit, m_markerStart, m_markerEnd, m_filter, &match)) {
+			isMarker = found = YES;
+		} else if(scanMarkerAt(m_chars, i, limit, m_exprStart, m_exprEnd, m_filter, &match)) {
+			found = YES;
+		}
+	}
+	if(!found) {
+		return nil;
+	}
+	
+	NSMutableDictionary* markerInfo = [NSMutableDictionary dictionaryWithCapacity:6];
+	[markerInfo setObject:[NSValue valueWithRange:NSMakeRange(match.start, match.end - match.start)] forKey:MARKER_RANGE_KEY];
+	[markerInfo setObject:(isMarker) ? MARKER_TYPE_MARKER : MARKER_TYPE_EXPRESSION forKey:MARKER_TYPE_KEY];
+	
+	if(match.contentEnd > match.contentStart) {
+		NSArray* markerComponents = [self _argumentsFromCharacters:m_chars start:match.contentStart end:match.contentEnd];
+		NSUInteger count = [markerComponents count];
+		if(count > 0) {
+			[markerInfo setObject:[markerComponents objectAtIndex:0] forKey:MARKER_NAME_KEY];
+			if(count > 1) {
+				[markerInfo setObject:[markerComponents subarrayWithRange:NSMakeRange(1, count - 1)] forKey:MARKER_ARGUMENTS_KEY];
+			}
+		}
+		
+		if(match.filterStart != NSNotFound && match.filterEnd > match.filterStart) {
+			NSArray* filterComponents = [self _filterComponentsFromStart:match.filterStart end:match.filterEnd];
+			count = [filterComponents count];
+			if(count > 0) {
+				[markerInfo setObject:[filterComponents objectAtIndex:0] forKey:MARKER_FILTER_KEY];
+				if(count > 1) {
+					[markerInfo setObject:[filterComponents subarrayWithRange:NSMakeRange(1, count - 1)] forKey:MARKER_FILTER_ARGUMENTS_KEY];
+				}
+			}
+		}
+	}
+	return markerInfo;
+}
+
+- (NSArray*)argumentsFromString:(NSString*)argString {
+	NSUInteger length = [argString length];
+	unichar* chars = malloc(sizeof(unichar) * (length + 1));
+	[argString getCharacters:chars range:NSMakeRange(0, length)];
+	NSArray* arguments = [self _argumentsFromCharacters:chars start:0 end:length];
+	free(chars);
+	return arguments;
+}
+
+@end
+
+@implementation WKScanningTemplateMatcher (Private)
+
+- (NSArray*)_argumentsFromCharacters:(const unichar*)chars start:(NSUInteger)start end:(NSUInteger)end {
+	NSMutableArray* arguments = [NSMutableArray array];
+	NSUInteger pos = start, argStart, argEnd;
+	while(scanArgument(chars, &pos, end, &argStart, &argEnd)) {
+		[arguments addObject:[NSString stringWithCharacters:chars + argStart length:argEnd - argStart]];
+	}
+	return arguments;
+}
+
+/*
+	As with the regex matcher, the first ':' and any space after it become a single space before splitting,
+	so {{ value | default: "none" }} and {{ value | default "none" }} are the same filter.
+ */
+- (NSArray*)_filterComponentsFromStart:(NSUInteger)start end:(NSUInteger)end {
+	NSUInteger colon = start;
+	while(colon < end && m_chars[colon] != ':') colon++;
+	if(colon == end) {
+		return [self _argumentsFromCharacters:m_chars start:start end:end];
+	}
+	
+	NSUInteger rest = skipSpaces(m_chars, colon + 1, end);
+	NSUInteger length = (colon - start) + 1 + (end - rest);
+	unichar* chars = malloc(sizeof(unichar) * (length + 1));
+	memcpy(chars, m_chars + start, sizeof(unichar) * (colon - start));
+	chars[colon - start] = ' ';
+	memcpy(chars + (colon - start) + 1, m_chars + rest, sizeof(unichar) * (end - rest));
+	
+	NSArray* components = [self _argumentsFromCharacters:chars start:0 end:length];
+	free(chars);
+	return components;
+}
+
+@end
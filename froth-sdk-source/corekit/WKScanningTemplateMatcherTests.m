@@ -0,0 +1,100 @@
+//
+//  WKScanningTemplateMatcherTests.m
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "WKScanningTemplateMatcherTests.h"
+#import "WKScanningTemplateMatcher.h"
+#import "AGRegexTemplateMatcher.h"
+
+/*
+	The sample templates plus the application's own view and layout templates.
+ */
+static NSArray* matcherTestTemplates() {
+	NSMutableArray* templates = [NSMutableArray arrayWithObjects:
+		@"<h1>{{ data.title }}</h1>{% for item in data.items %}<li>{{ item.name | uppercase }}</li>{% /for %}",
+		@"{% if data.count > 1 %}many{% else %}{{data.count}}{% /if %}",
+		@"{{ value | date_format: \"yyyy-MM-dd\" }} {{ value|default:'none' }}",
+		@"{% set greeting \"Hello \\\"World\\\"\" %}{{ greeting }} {% literal %}{{ raw }}{% /literal %}",
+		@"{{\n  spaced  \n}} {{ split\nline }} {{ }} {{ | filter }} {% \"\" empty %}",
+		@"unterminated {{ marker and {% another | one %} {{ a | b | c }}",
+		@"{ single } {% %} %} }} {{ x|y }}", nil];
+	
+	NSString* resourcePath = [[NSBundle mainBundle] resourcePath];
+	for(NSString* resource in [[NSFileManager defaultManager] directoryContentsAtPath:resourcePath]) {
+		NSString* name = [resource stringByDeletingPathExtension];
+		if([name hasSuffix:@"View"] || [name isEqualToString:@"Layout"]) {
+			NSString* template = [NSString stringWithContentsOfFile:[resourcePath stringByAppendingPathComponent:resource] 
+														   encoding:NSUTF8StringEncoding error:nil];
+			if(template) [templates addObject:template];
+		}
+	}
+	return templates;
+}
+
+static NSArray* allMarkers(id <MGTemplateEngineMatcher> matcher, MGTemplateEngine* engine, NSString* template) {
+	[engine setMatcher:matcher];
+	MGCompiledTemplate* compiled = [engine compileTemplate:template];
+	
+	NSMutableArray* markers = [NSMutableArray array];
+	for(NSUInteger i = 0; i < [compiled markerCount]; i++) {
+		[markers addObject:[compiled markerAtIndex:i]];
+	}
+	return markers;
+}
+
+@implementation WKScanningTemplateMatcherTests
+
+- (NSArray*)tests {
+	return [NSArray arrayWithObjects:@"test_parity", 
+			@"test_benchmark", nil];
+}
+
+- (void)test_parity {
+	MGTemplateEngine* engine = [MGTemplateEngine templateEngine];
+	AGRegexTemplateMatcher* regexMatcher = [AGRegexTemplateMatcher matcherWithTemplateEngine:engine];
+	WKScanningTemplateMatcher* scanningMatcher = [WKScanningTemplateMatcher matcherWithTemplateEngine:engine];
+	
+	NSArray* templates = matcherTestTemplates();
+	for(NSString* template in templates) {
+		NSArray* expected = allMarkers(regexMatcher, engine, template);
+		NSArray* markers = allMarkers(scanningMatcher, engine, template);
+		FRAssertTrue([markers isEqualToArray:expected], @"Scanning matcher differs for template [%@]\nregex:%@\nscanning:%@", template, expected, markers);
+	}
+	
+	FRPass(@"Scanning matcher matches the regex matcher on %i templates", (int)[templates count]);
+}
+
+- (void)test_benchmark {
+	MGTemplateEngine* engine = [MGTemplateEngine templateEngine];
+	NSArray* matchers = [NSArray arrayWithObjects:[AGRegexTemplateMatcher matcherWithTemplateEngine:engine], 
+						 [WKScanningTemplateMatcher matcherWithTemplateEngine:engine], nil];
+	NSArray* templates = matcherTestTemplates();
+	NSTimeInterval times[2] = {0, 0};
+	
+	//The best of alternating rounds, so a busy machine slows both matchers alike
+	for(int round = 0; round < 3; round++) {
+		for(int m = 0; m < 2; m++) {
+			NSDate* start = [NSDate date];
+			for(int i = 0; i < 200; i++) {
+				NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+				for(NSString* template in templates) {
+					allMarkers([matchers objectAtIndex:m], engine, template);
+				}
+				[pool drain];
+			}
+			NSTimeInterval time = -[start timeIntervalSinceNow];
+			if(round == 0 || time < times[m]) {
+				times[m] = time;
+			}
+		}
+	}
+	
+	//Only a loose bound, the scanning matcher is expected to be several times faster
+	FRAssertTrue(times[1] <= times[0], @"Scanning matcher [%.4f] slower than the regex matcher [%.4f]", times[1], times[0]);
+	FRPass(@"200 passes over %i templates, regex [%.4f] scanning [%.4f] speedup [%.1fx]", (int)[templates count], times[0], times[1], times[0] / times[1]);
+}
+
+@end
@@ -0,0 +1,75 @@
+//
+//  WKXmlParser.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+	\brief	Decodes XML to Foundation objects from libxml2 SAX events, without building a document tree.
+ 
+	An element with only text becomes a NSString. An element with child elements or attributes becomes a 
+	NSMutableDictionary, child elements by name, attributes by name prefixed with "@" and any text other than 
+	whitespace as "#text". Children with the same name are collected in a NSMutableArray. The result is the value 
+	of the root element, its name is available from -rootName.
+ 
+	\code
+	<auth><user>ben</user><pass>secret</pass><role>a</role><role>b</role></auth>
+	{user = ben; pass = secret; role = (a, b);}
+	\endcode
+ 
+	Data can be fed in chunks as it arrives, only the open elements and their text are held between calls. Element 
+	names are converted once per document, so the keys of repeated records are the same NSString instances. 
+	The network is never accessed and entities other than the predefined ones are not substituted.
+ */
+@interface WKXmlParser : NSObject {
+	void* m_context;
+	struct WKXmlBuild* m_build;
+	NSString* m_rootName;
+	NSString* m_errorDescription;
+}
+
+/*! \brief Parses a whole document, returns nil if the XML is not well formed. */
+- (id)objectWithData:(NSData*)data;
+
+/*! \brief Parses the next chunk of the document, returns NO once there has been an error. */
+- (BOOL)parseData:(NSData*)data;
+- (BOOL)parseBytes:(const char*)bytes length:(NSUInteger)length;
+
+/*! \brief Ends the input and returns the decoded root element, or nil if the document is incomplete or invalid. */
+- (id)finish;
+
+/*! \brief Clears all state to parse a new document. */
+- (void)reset;
+
+/*! \brief The name of the root element from the last document. */
+- (NSString*)rootName;
+
+/*! \brief Describes the first error with its line, nil if there was none. */
+- (NSString*)errorDescription;
+
+@end
@@ -0,0 +1,327 @@
+//
+//  WKXmlParser.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#import "WKXmlParser.h"
+#import <libxml/parser.h>
+
+#define kInitialTextSize	1024
+#define kInitialFrames		16
+#define kMaxDepth			512
+#define kNameCacheSize		64
+
+/* An open element */
+typedef struct {
+	NSString* name;						// Retained, the name cache can replace its entry while the element is open
+	NSMutableDictionary* children;		// Created for the first child or attribute
+	NSUInteger textStart;				// The element's text runs from here to the end of the text buffer
+} WKXmlFrame;
+
+/* libxml keeps one copy of each name per document, so names are cached by the pointer it passes */
+typedef struct {
+	const xmlChar* bytes;
+	NSString* name;
+} WKXmlName;
+
+struct WKXmlBuild {
+	WKXmlFrame* frames;
+	NSUInteger depth;
+	NSUInteger capacity;
+	
+	char* text;
+	NSUInteger textLength;
+	NSUInteger textCapacity;
+	
+	WKXmlName names[kNameCacheSize];
+	
+	xmlParserCtxtPtr context;
+	id result;
+	NSString* rootName;
+	NSString* error;
+};
+
+static xmlSAXHandler kHandler;
+
+static void failBuild(struct WKXmlBuild* build, NSString* error) {
+	if(!build->error) {
+		build->error = [error retain];
+	}
+	xmlStopParser(build->context);
+}
+
+static NSString* nameForBytes(struct WKXmlBuild* build, const xmlChar* bytes) {
+	WKXmlName* entry = &build->names[((uintptr_t)bytes >> 3) & (kNameCacheSize - 1)];
+	if(entry->bytes != bytes) {
+		[entry->name release];
+		entry->bytes = bytes;
+		entry->name = [[NSString alloc] initWithUTF8String:(const char*)bytes];
+	}
+	return entry->name;
+}
+
+static BOOL isBlank(const char* bytes, NSUInteger length) {
+	for(NSUInteger i=0; i<length; i++) {
+		if(bytes[i] != ' ' && bytes[i] != '\n' && bytes[i] != '\r' && bytes[i] != '\t') {
+			return NO;
+		}
+	}
+	return YES;
+}
+
+/* Adds a value to an element's children, a second child with the same name makes an array */
+static void addChild(WKXmlFrame* frame, NSString* name, id value) {
+	if(!frame->children) {
+		frame->children = [[NSMutableDictionary alloc] init];
+	}
+	
+	id existing = [frame->children objectForKey:name];
+	if(!existing) {
+		[frame->children setObject:value forKey:name];
+	} else if([existing isKindOfClass:[NSMutableArray class]]) {
+		[existing addObject:value];
+	} else {
+		NSMutableArray* values = [[NSMutableArray alloc] initWithObjects:existing, value, nil];
+		[frame->children setObject:values forKey:name];
+		[values release];
+	}
+}
+
+static void clearBuild(struct WKXmlBuild* build) {
+	for(NSUInteger i=0; i<build->depth; i++) {
+		[build->frames[i].name release];
+		[build->frames[i].children release];
+	}
+	build->depth = 0;
+	build->textLength = 0;
+	
+	for(int i=0; i<kNameCacheSize; i++) {
+		[build->names[i].name release];
+		build->names[i].name = nil;
+		build->names[i].bytes = NULL;
+	}
+	
+	if(build->context) {
+		xmlFreeParserCtxt(build->context);
+		build->context = NULL;
+	}
+	
+	[build->result release]; build->result = nil;
+	[build->rootName release]; build->rootName = nil;
+	[build->error release]; build->error = nil;
+}
+
+#pragma mark -
+#pragma mark SAX Callbacks
+
+static void startElement(void* ctx, const xmlChar* localname, const xmlChar* prefix, const xmlChar* URI, int namespaceCount, 
+						 const xmlChar** namespaces, int attributeCount, int defaultedCount, const xmlChar** attributes) {
+	struct WKXmlBuild* build = (struct WKXmlBuild*)ctx;
+	if(build->depth >= kMaxDepth) {
+		failBuild(build, [NSString stringWithFormat:@"Elements nested deeper than %d", kMaxDepth]);
+		return;
+	}
+	
+	if(build->depth == build->capacity) {
+		build->capacity *= 2;
+		build->frames = realloc(build->frames, build->capacity * sizeof(WKXmlFrame));
+	}
+	
+	WKXmlFrame* frame = &build->frames[build->depth++];
+	frame->name = [nameForBytes(build, localname) retain];
+	frame->children = nil;
+	frame->textStart = build->textLength;
+	
+	//Each attribute is localname, prefix, URI, value and value end
+	for(int i=0; i<attributeCount; i++) {
+		const xmlChar** attribute = &attributes[i * 5];
+		NSString* value = [[NSString alloc] initWithBytes:attribute[3] length:(attribute[4] - attribute[3]) encoding:NSUTF8StringEncoding];
+		addChild(frame, [@"@" stringByAppendingString:nameForBytes(build, attribute[0])], value);
+		[value release];
+	}
+}
+
+static void endElement(void* ctx, const xmlChar* localname, const xmlChar* prefix, const xmlChar* URI) {
+	struct WKXmlBuild* build = (struct WKXmlBuild*)ctx;
+	WKXmlFrame* frame = &build->frames[--build->depth];
+	
+	const char* text = build->text + frame->textStart;
+	NSUInteger textLength = build->textLength - frame->textStart;
+	id value;
+	
+	if(!frame->children) {
+		value = [[NSString alloc] initWithBytes:text length:textLength encoding:NSUTF8StringEncoding];
+	} else {
+		if(!isBlank(text, textLength)) {
+			NSString* string = [[NSString alloc] initWithBytes:text length:textLength encoding:NSUTF8StringEncoding];
+			[frame->children setObject:string forKey:@"#text"];
+			[string release];
+		}
+		value = frame->children;
+	}
+	build->textLength = frame->textStart;
+	
+	if(build->depth) {
+		addChild(&build->frames[build->depth - 1], frame->name, value);
+		[value release];
+	} else {
+		build->result = value;
+		build->rootName = [frame->name retain];
+	}
+	[frame->name release];
+}
+
+static void characters(void* ctx, const xmlChar* bytes, int length) {
+	struct WKXmlBuild* build = (struct WKXmlBuild*)ctx;
+	if(!build->depth) {
+		return;
+	}
+	
+	if(build->textLength + length > build->textCapacity) {
+		while(build->textLength + length > build->textCapacity) {
+			build->textCapacity *= 2;
+		}
+		build->text = realloc(build->text, build->textCapacity);
+	}
+	memcpy(build->text + build->textLength, bytes, length);
+	build->textLength += length;
+}
+
+static void structuredError(void* ctx, xmlErrorPtr error) {
+	struct WKXmlBuild* build = (struct WKXmlBuild*)ctx;
+	if(!build->error && error->level >= XML_ERR_ERROR) {
+		//libxml2 may report an error without a message, or one that is not utf8
+		NSString* message = (error->message) ? [NSString stringWithUTF8String:error->message] : nil;
+		message = (message) ? [message stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] : 
+							  [NSString stringWithFormat:@"XML error %d", error->code];
+		build->error = [[NSString alloc] initWithFormat:@"%@ at line %d", message, error->line];
+	}
+}
+
+#pragma mark -
+
+@implementation WKXmlParser
+
++ (void)initialize {
+	if(self == [WKXmlParser class]) {
+		xmlInitParser();
+		
+		memset(&kHandler, 0, sizeof(xmlSAXHandler));
+		kHandler.initialized = XML_SAX2_MAGIC;
+		kHandler.startElementNs = startElement;
+		kHandler.endElementNs = endElement;
+		kHandler.characters = characters;
+		kHandler.cdataBlock = characters;
+		kHandler.serror = structuredError;
+	}
+}
+
+- (id)init {
+	if(self = [super init]) {
+		m_build = calloc(1, sizeof(struct WKXmlBuild));
+		m_build->capacity = kInitialFrames;
+		m_build->frames = malloc(kInitialFrames * sizeof(WKXmlFrame));
+		m_build->textCapacity = kInitialTextSize;
+		m_build->text = malloc(kInitialTextSize);
+	}
+	return self;
+}
+
+- (void)dealloc {
+	clearBuild(m_build);
+	free(m_build->frames);
+	free(m_build->text);
+	free(m_build);
+	
+	[m_rootName release];
+	[m_errorDescription release];
+	[super dealloc];
+}
+
+- (id)objectWithData:(NSData*)data {
+	[self reset];
+	[self parseBytes:[data bytes] length:[data length]];
+	return [self finish];
+}
+
+- (BOOL)parseData:(NSData*)data {
+	return [self parseBytes:[data bytes] length:[data length]];
+}
+
+- (BOOL)parseBytes:(const char*)bytes length:(NSUInteger)length {
+	if(!m_build->context) {
+		m_build->context = xmlCreatePushParserCtxt(&kHandler, m_build, NULL, 0, NULL);
+		xmlCtxtUseOptions(m_build->context, XML_PARSE_NONET);
+	}
+	
+	//xmlParseChunk takes an int length
+	while(length && !m_build->error) {
+		int chunk = (int)MIN(length, (NSUInteger)INT_MAX);
+		xmlParseChunk(m_build->context, bytes, chunk, 0);
+		bytes += chunk;
+		length -= chunk;
+	}
+	return (m_build->error == nil);
+}
+
+- (id)finish {
+	if(!m_build->context) {
+		[self parseBytes:NULL length:0];
+	}
+	if(!m_build->error) {
+		xmlParseChunk(m_build->context, NULL, 0, 1);
+	}
+	if(!m_build->error && (!m_build->context->wellFormed || !m_build->result)) {
+		m_build->error = @"Incomplete XML document";
+	}
+	
+	id result = (m_build->error) ? nil : [[m_build->result retain] autorelease];
+	
+	[m_rootName release];
+	m_rootName = [m_build->rootName retain];
+	[m_errorDescription release];
+	m_errorDescription = [m_build->error retain];
+	
+	clearBuild(m_build);
+	return result;
+}
+
+- (void)reset {
+	clearBuild(m_build);
+	[m_rootName release]; m_rootName = nil;
+	[m_errorDescription release]; m_errorDescription = nil;
+}
+
+- (NSString*)rootName {
+	return m_rootName;
+}
+
+- (NSString*)errorDescription {
+	return m_errorDescription;
+}
+
+@end
@@ -0,0 +1,103 @@
+//
+//  WKXmlParserTests.m
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "WKXmlParserTests.h"
+#import "WKXmlParser.h"
+
+#define kFeedXML	"<?xml version=\"1.0\"?>\n<feed version=\"2\">\n<entry id=\"1\">one &amp; only</entry>\n" \
+					"<entry id=\"2\"><title><![CDATA[<two>]]></title></entry>\nnote\n<empty/></feed>"
+
+static NSData* dataWithString(const char* xml) {
+	return [NSData dataWithBytes:xml length:strlen(xml)];
+}
+
+@implementation WKXmlParserTests
+
+- (NSArray*)tests {
+	return [NSArray arrayWithObjects:@"test_document", 
+			@"test_chunks", 
+			@"test_malformed", nil];
+}
+
+- (void)test_document {
+	WKXmlParser* parser = [[[WKXmlParser alloc] init] autorelease];
+	NSDictionary* feed = [parser objectWithData:dataWithString(kFeedXML)];
+	FRAssertNotNil(feed, @"Feed not parsed: %@", [parser errorDescription]);
+	FRAssertTrue([[parser rootName] isEqualToString:@"feed"], @"Root name is %@", [parser rootName]);
+	FRAssertTrue([[feed objectForKey:@"@version"] isEqualToString:@"2"], @"Attribute not decoded: %@", feed);
+	NSString* text = [[feed objectForKey:@"#text"] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+	FRAssertTrue([text isEqualToString:@"note"], @"Mixed text not kept: %@", feed);
+	FRAssertTrue([[feed objectForKey:@"empty"] isEqualToString:@""], @"Empty element not a string: %@", feed);
+	
+	NSArray* entries = [feed objectForKey:@"entry"];
+	FRAssertTrue([entries isKindOfClass:[NSArray class]] && [entries count] == 2, @"Repeated elements not collected: %@", feed);
+	
+	NSDictionary* first = [entries objectAtIndex:0];
+	FRAssertTrue([[first objectForKey:@"@id"] isEqualToString:@"1"], @"First entry id: %@", first);
+	FRAssertTrue([[first objectForKey:@"#text"] isEqualToString:@"one & only"], @"First entry text: %@", first);
+	
+	NSDictionary* second = [entries objectAtIndex:1];
+	FRAssertTrue([[second objectForKey:@"title"] isEqualToString:@"<two>"], @"CDATA not decoded: %@", second);
+	FRAssertTrue([second objectForKey:@"#text"] == nil, @"Whitespace kept as text: %@", second);
+	
+	FRAssertTrue([parser errorDescription] == nil, @"Error for a valid document: %@", [parser errorDescription]);
+	FRPass(@"Decoded %@", feed);
+}
+
+- (void)test_chunks {
+	WKXmlParser* parser = [[[WKXmlParser alloc] init] autorelease];
+	NSDictionary* whole = [parser objectWithData:dataWithString(kFeedXML)];
+	
+	//Each chunk size splits names, entities and the CDATA section differently
+	const char* xml = kFeedXML;
+	NSUInteger length = strlen(xml);
+	for(NSUInteger size = 1; size < 16; size++) {
+		[parser reset];
+		for(NSUInteger i = 0; i < length; i += size) {
+			FRAssertTrue([parser parseBytes:xml + i length:MIN(size, length - i)], @"Chunk at %i failed: %@", (int)i, [parser errorDescription]);
+		}
+		NSDictionary* chunked = [parser finish];
+		FRAssertTrue([chunked isEqual:whole], @"Chunks of %i decoded %@, expected %@", (int)size, chunked, whole);
+	}
+	
+	//The parser starts a new document after finish
+	FRAssertTrue([parser parseData:dataWithString("<a><b>1</b>")], @"Second document failed: %@", [parser errorDescription]);
+	FRAssertTrue([parser parseData:dataWithString("<b>2</b></a>")], @"Second document failed: %@", [parser errorDescription]);
+	NSDictionary* second = [parser finish];
+	FRAssertTrue([[second objectForKey:@"b"] count] == 2 && [[parser rootName] isEqualToString:@"a"], @"Second document decoded %@", second);
+	
+	FRPass(@"Chunked documents match the whole document");
+}
+
+- (void)test_malformed {
+	WKXmlParser* parser = [[[WKXmlParser alloc] init] autorelease];
+	
+	FRAssertTrue([parser objectWithData:dataWithString("<a><b></a>")] == nil, @"Mismatched tags decoded");
+	FRAssertTrue([[parser errorDescription] rangeOfString:@"line 1"].location != NSNotFound, @"Error has no line: %@", [parser errorDescription]);
+	
+	FRAssertTrue([parser objectWithData:dataWithString("<a>\n<b>1</b>\n<c x=1/></a>")] == nil, @"Unquoted attribute decoded");
+	FRAssertTrue([[parser errorDescription] rangeOfString:@"line 3"].location != NSNotFound, @"Error has the wrong line: %@", [parser errorDescription]);
+	
+	FRAssertTrue([parser objectWithData:dataWithString("<a><b>1</b>")] == nil, @"Truncated document decoded");
+	FRAssertNotNil([parser errorDescription], @"No error for a truncated document");
+	
+	FRAssertTrue([parser objectWithData:[NSData data]] == nil, @"Empty document decoded");
+	FRAssertNotNil([parser errorDescription], @"No error for an empty document");
+	
+	//Chunks after an error are refused until the next document
+	[parser reset];
+	FRAssertTrue(![parser parseData:dataWithString("<a></b>")], @"Mismatched chunk accepted");
+	FRAssertTrue(![parser parseData:dataWithString("<c/></a>")], @"Chunk accepted after an error");
+	FRAssertTrue([parser finish] == nil && [parser errorDescription], @"Chunked error not reported");
+	
+	NSDictionary* valid = [parser objectWithData:dataWithString("<a x=\"1\"/>")];
+	FRAssertTrue([[valid objectForKey:@"@x"] isEqualToString:@"1"] && ![parser errorDescription], @"Parser not reusable after an error: %@", [parser errorDescription]);
+	
+	FRPass(@"Malformed documents rejected");
+}
+
+@end
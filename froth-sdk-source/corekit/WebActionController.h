@@ -91,6 +91,7 @@
 				<br><br>
 			6. Else a class with name <ActionName><ControllerName>View is looked up and initialized if found. <br>
 			7. WebApplicationController calls - (id)<actionName>Action:(WebRequest*)request <br>
+				If this returns a WebDeferredResponse the following steps happen when it is completed (see WebDeferredResponse). <br>
 			8. If the above call returns a WebResponse object, then it is rendered, else... <br>
 			9. A WebResponse is returned from [controller.view displayWithData:(above response)] //typically a NSDictionary <br>
 			10. WebApplication calls - (void)postProcessResponse:(FOWResponse*)response fromRequest:(WebRequest*)request on controller if implemented <br>
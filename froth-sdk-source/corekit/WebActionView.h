@@ -140,6 +140,16 @@
 						 request:(WebRequest*)req 
 					 application:(id)app;
 
+/*!
+	\brief Renders as -processedTemplateData:withControllerResponse:controller:request:application: does, streaming the output to sink.
+ */
+- (void)renderTemplateData:(NSData*)data 
+	withControllerResponse:(id)object 
+				controller:(id)controller 
+				   request:(WebRequest*)req 
+			   application:(id)app 
+					toSink:(id <MGTemplateOutputSink>)sink;
+
 /*!
 	\brief Subclasses that wish to provide a complete custom output from the data can overide this, all of the above methods are called
 			from this method, so implementors need to take that into consideration.
@@ -31,29 +31,30 @@
 
 #import "Froth.h"
 
-#import "AGRegexTemplateMatcher.h"
+#import "WebTemplateEnginePool.h"
 
 
 //Built In Temlating Markers and Filters
 #import "WKValueComparisonFilters.h"
 #import "WKFunctionMarkers.h"
 
-static NSMutableDictionary* m_staticTemplateCache = nil;
+@interface WebActionView (Private)
+- (NSData*)_processTemplateData:(NSData*)data 
+		 withControllerResponse:(id)object 
+					 controller:(id)controller 
+						request:(WebRequest*)req 
+					application:(id)app 
+						 toSink:(id <MGTemplateOutputSink>)sink;
+@end
+
+static BOOL usesPooledEngines(WebActionView* view) {
+	SEL prepareSelector = @selector(prepareDefualtMarkersAndFiltersForTemplateEngine:);
+	return [view methodForSelector:prepareSelector] == [WebActionView instanceMethodForSelector:prepareSelector];
+}
 
 @implementation WebActionView
 @synthesize templateName, extention;
 
-+ (void)initialize {
-	/*
-		Currently cocotron does not implement +initialize in a thread safe manner. In such casses static values
-		as the on below never work. We need to do this differently.
-	 */
-	if(!m_staticTemplateCache) {
-		NSLog(@"WebActionView: Action Template Memrory Cache Initialized");
-		m_staticTemplateCache = [[NSMutableDictionary alloc] init];
-	}
-}
-
 - (id)init {
 	if(self = [super init]) {
 	}
@@ -72,9 +73,10 @@ static NSMutableDictionary* m_staticTemplateCache = nil;
 }
 
 - (NSData*)templateDataForController:(id)controller {
-	NSData* cachedTemplate = [m_staticTemplateCache objectForKey:self.templateName];
-	//NSLog(@"cached template:%@", [[NSString alloc] initWithData:cachedTemplate encoding:NSUTF8StringEncoding]);
-	if(!cachedTemplate) {
+	WebTemplateRegistry* registry = [WebTemplateRegistry sharedRegistry];
+	WebTemplateEntry* entry = [registry entryForName:self.templateName];
+	//NSLog(@"cached template:%@", [entry string]);
+	if(!entry) {
 #ifdef __APPLE__
 		NSBundle* bundle =		[NSBundle bundleForClass:[controller class]];
 #else
@@ -92,23 +94,23 @@ static NSMutableDictionary* m_staticTemplateCache = nil;
 		if([templateName hasSuffix:@".*nil*"])
 			templateName = [[templateName stringByReplacingOccurrencesOfString:@".*nil*" withString:@".html"] retain];
 #endif
-			
-		NSString* path =		[bundle pathForResource:templateName ofType:nil];
-		cachedTemplate =		[NSData dataWithContentsOfFile:path];
-		if(cachedTemplate) {
-			[m_staticTemplateCache setObject:cachedTemplate forKey:templateName];
-		} else {
-			//Now try with .html as defualt
-			path = [bundle pathForResource:[[templateName componentsSeparatedByString:@"."] objectAtIndex:0] ofType:@"html"];
-			cachedTemplate = [NSData dataWithContentsOfFile:path];
-			if(!cachedTemplate) {
-				froth_exception(@"ActionTemplateException", @"Unable to find action template resource for name %@ at path %@", templateName, path);
-			} else {
-				[m_staticTemplateCache setObject:cachedTemplate forKey:templateName];
+		
+		//The fixed up name may already be loaded
+		entry = [registry entryForName:templateName];
+		if(!entry) {
+			NSString* path =		[bundle pathForResource:templateName ofType:nil];
+			entry =					[registry loadTemplateNamed:templateName atPath:path];
+			if(!entry) {
+				//Now try with .html as defualt
+				path = [bundle pathForResource:[[templateName componentsSeparatedByString:@"."] objectAtIndex:0] ofType:@"html"];
+				entry = [registry loadTemplateNamed:templateName atPath:path];
+				if(!entry) {
+					froth_exception(@"ActionTemplateException", @"Unable to find action template resource for name %@ at path %@", templateName, path);
+				}
 			}
 		}
 	}
-	return cachedTemplate;
+	return [entry data];
 }
 
 - (NSData*)processedTemplateData:(NSData*)data 
@@ -116,14 +118,58 @@ static NSMutableDictionary* m_staticTemplateCache = nil;
 					 controller:(id)controller 
 						 request:(WebRequest*)req 
 					 application:(id)app {
-	MGTemplateEngine * engine = [MGTemplateEngine templateEngine];
-	//TODO: move this to a global configureation utility
-	[self prepareDefualtMarkersAndFiltersForTemplateEngine:engine];
+	return [self _processTemplateData:data withControllerResponse:object controller:controller request:req application:app toSink:nil];
+}
 
+- (void)renderTemplateData:(NSData*)data 
+	withControllerResponse:(id)object 
+				controller:(id)controller 
+				   request:(WebRequest*)req 
+			   application:(id)app 
+					toSink:(id <MGTemplateOutputSink>)sink {
+	[self _processTemplateData:data withControllerResponse:object controller:controller request:req application:app toSink:sink];
+}
+
+/*
+	Returns the utf8 output, or nil when streaming it to sink.
+ */
+- (NSData*)_processTemplateData:(NSData*)data 
+		 withControllerResponse:(id)object 
+					 controller:(id)controller 
+						request:(WebRequest*)req 
+					application:(id)app 
+						 toSink:(id <MGTemplateOutputSink>)sink {
+	/*
+		Engines come from the per thread pool, unless a subclass loads its own markers and filters into a new engine for each render.
+	 */
+	BOOL pooled = usesPooledEngines(self);
+	MGTemplateEngine* engine;
+	if(pooled) {
+		engine = [WebTemplateEnginePool checkoutEngine];
+	} else {
+		engine = [MGTemplateEngine templateEngine];
+		[self prepareDefualtMarkersAndFiltersForTemplateEngine:engine];
+		[engine setMatcher:[[[[WebTemplateEnginePool matcherClass] alloc] initWithTemplateEngine:engine] autorelease]];
+	}
 	[engine setDelegate:self];
-	[engine setMatcher:[AGRegexTemplateMatcher matcherWithTemplateEngine:engine]];
+	[engine setAutoescape:[WebTemplateEnginePool autoescapeForTemplateNamed:templateName]];
+	
+	/*
+		Templates from the registry are compiled once and shared, data from elsewhere (ie a subclass) is compiled for this render only.
+	 */
+	MGCompiledTemplate* compiled = nil;
+	WebTemplateRegistry* registry = [WebTemplateRegistry sharedRegistry];
+	WebTemplateEntry* entry = [registry entryForName:templateName];
+	if(entry && [entry data] == data) {
+		compiled = [registry compiledTemplateForEntry:entry engine:engine];
+	}
+	
+	if(!compiled) {
+		NSString* template = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+		compiled = [engine compileTemplate:template];
+		[template release];
+	}
 	
-	NSString* template = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
 	NSDictionary* variables = [NSDictionary dictionaryWithObjectsAndKeys:(object!=nil)?object:[NSNull null], @"data", 
 							   controller, @"controller", 
 							   req, @"request", 
@@ -131,10 +177,16 @@ static NSMutableDictionary* m_staticTemplateCache = nil;
 							   self, @"view", nil];
 	
 	//TODO: Causeing crash with cf version.
-	NSString* result = [engine processTemplate:template withVariables:variables];
-	[template release];
-	
-	return [result dataUsingEncoding:NSUTF8StringEncoding];
+	NSData* result = nil;
+	if(sink) {
+		[engine processCompiledTemplate:compiled withVariables:variables toSink:sink];
+	} else {
+		result = [engine processCompiledTemplateToUTF8Data:compiled withVariables:variables];
+	}
+	if(pooled) {
+		[WebTemplateEnginePool checkinEngine:engine];
+	}
+	return result;
 }
 
 - (NSData*)displayWithData:(id)data 
@@ -51,6 +51,7 @@
 	id delegate;
 	
 	NSMutableDictionary* m_componentInstances;
+	NSDictionary* m_viewClasses;
 }
 
 /*!
@@ -118,6 +119,16 @@
  */
 + (NSDictionary*)deploymentConfigDictionary;
 
+/*!
+	\brief	Loads and compiles the bundle's view and layout templates, and resolves view classes, before requests are served.
+	
+	Connectors call this before they start accepting requests, so the first request after a restart does not pay for
+	bundle lookups, disk reads and template compiling. Every html, json and xml resource is loaded into the 
+	WebTemplateRegistry and compiled, view classes are resolved for [Name]View templates, and the time for each is logged. Set the Info.plist froth_warm_up key to NO to 
+	skip this and load templates on first use.
+ */
+- (void)warmUp;
+
 /*!
 	\brief	Called from a httpd connector or other httpd server object when a request is received.
 	\param  req A WebRequest instance initalized from httpd HTTP request data.
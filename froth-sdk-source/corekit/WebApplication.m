@@ -31,11 +31,44 @@
 #import "Froth.h"
 
 #import "WebMutableRequest.h"
+#import "WebDeferredResponse.h"
+#import "WebStreamingResponse.h"
 
 #define kParamsUriRootKey		@"com.cocoa-web.uri-root"
 #define kParamsUriDebugEnabled	@"com.cocoa-web.debug-enabled"
 #define kWebAppBundleLocation	@"~/WebApps"
 
+@interface WebApplication (Private)
+- (WebResponse*)_responseForActionResponse:(id)actionResponse 
+								   request:(WebRequest*)request 
+							withController:(id <WebActionController>)controller 
+								components:(NSArray*)components 
+				   componentConfigurations:(NSArray*)componentConfigurations 
+							 fromComponent:(BOOL)responseFromComponent;
+@end
+
+static BOOL overridesMethod(id object, Class baseClass, SEL selector) {
+	return [object methodForSelector:selector] != [baseClass instanceMethodForSelector:selector];
+}
+
+/*
+	Only views and layouts that render with the standard templates can be streamed, customized output is left to the subclass.
+ */
+static BOOL canStreamTemplates(WebActionView* view, WebLayoutView* layout) {
+	if(![view isKindOfClass:[WebActionView class]] || ![layout isKindOfClass:[WebLayoutView class]]) return NO;
+	
+	if(overridesMethod(view, [WebActionView class], @selector(displayWithData:controller:request:application:)) ||
+	   overridesMethod(view, [WebActionView class], @selector(processedTemplateData:withControllerResponse:controller:request:application:))) {
+		return NO;
+	}
+	if(overridesMethod(layout, [WebLayoutView class], @selector(displayWithTemplateData:forExtention:request:controller:application:)) ||
+	   overridesMethod(layout, [WebLayoutView class], @selector(processedActionResultString:controller:request:application:)) ||
+	   overridesMethod(layout, [WebLayoutView class], @selector(processedActionResultData:controller:request:application:))) {
+		return NO;
+	}
+	return YES;
+}
+
 @implementation WebApplication
 
 + (int)workerThreads {
@@ -100,6 +133,9 @@
 		if(delegateClassName) {
 			m_delegateClass = NSClassFromString(delegateClassName);
 		}
+		
+		//Backs the {% cache %} template marker
+		[MGTemplateEngine setFragmentCache:[WebFragmentCache sharedCache]];
 	}
 	return self;
 }
@@ -110,11 +146,78 @@
 	[m_app_path release], m_app_path = nil;
 	[m_cachedWebActionControllerClasses release], m_cachedWebActionControllerClasses = nil;
 	[m_componentInstances release], m_componentInstances = nil;
+	[m_viewClasses release], m_viewClasses = nil;
 	[delegate release], delegate = nil;
 	
 	[super dealloc];
 }
 
+#pragma mark -
+#pragma mark Warm Up
+
+- (void)warmUp {
+	id warmUp = [[[NSBundle mainBundle] infoDictionary] valueForKey:@"froth_warm_up"];
+	if(warmUp && ![warmUp boolValue]) {
+		return;
+	}
+	
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	NSDate* start = [NSDate date];
+	
+	NSString* resourcePath = [[NSBundle mainBundle] resourcePath];
+	NSError* error = nil;
+	NSArray* resources = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:resourcePath error:&error];
+	if(!resources) {
+		NSLog(@"+++ [[ERROR]] WebApplication: Unable to list resources for warm up, templates load on first use [%@]", [error localizedDescription]);
+		[pool drain];
+		return;
+	}
+	
+	//Compiling only needs the matcher and delimiters, which are the same for all views.
+	MGTemplateEngine* engine = [WebTemplateEnginePool checkoutEngine];
+	
+	WebTemplateRegistry* registry = [WebTemplateRegistry sharedRegistry];
+	NSMutableDictionary* viewClasses = [NSMutableDictionary dictionary];
+	int templateCount = 0;
+	
+	for(NSString* resource in resources) {
+		if(![WebTemplateRegistry isTemplateResource:resource]) {
+			continue;
+		}
+		NSString* name = [resource stringByDeletingPathExtension];
+		
+		NSDate* templateStart = [NSDate date];
+		WebTemplateEntry* entry = [registry entryForName:resource];
+		if(!entry) {
+			entry = [registry loadTemplateNamed:resource atPath:[resourcePath stringByAppendingPathComponent:resource]];
+		}
+		MGCompiledTemplate* compiled = [registry compiledTemplateForEntry:entry engine:engine];
+		if(!compiled) {
+			NSLog(@"+++ [[ERROR]] WebApplication: Unable to load template [%@]", resource);
+			continue;
+		}
+		templateCount++;
+		
+		if([name hasSuffix:@"View"] && ![viewClasses objectForKey:name]) {
+			Class viewClass = NSClassFromString(name);
+			if(viewClass && [viewClass isSubclassOfClass:[WebActionView class]]) {
+				[viewClasses setObject:viewClass forKey:name];
+			}
+		}
+		
+		NSLog(@"WebApplication: Warmed up template [%@] [%u markers] in [%.4f]", resource, (unsigned)[compiled markerCount], -[templateStart timeIntervalSinceNow]);
+	}
+	
+	[WebTemplateEnginePool checkinEngine:engine];
+	
+	//Only read from here on, so the request threads do not need a lock
+	[m_viewClasses release];
+	m_viewClasses = [viewClasses copy];
+	
+	NSLog(@"WebApplication: Warmed up [%i] templates and [%u] view classes in [%.4f]", templateCount, (unsigned)[m_viewClasses count], -[start timeIntervalSinceNow]);
+	[pool drain];
+}
+
 #pragma mark -
 #pragma mark For Views
 
@@ -186,7 +289,8 @@
 }
 
 - (WebActionView*)_webViewForName:(NSString*)className {
-	Class theClass = NSClassFromString(className);
+	Class theClass = [m_viewClasses objectForKey:className];
+	if(!theClass) theClass = NSClassFromString(className);
 	
 	//Try a streightAccross class id MyClass
 	
@@ -410,13 +514,42 @@
 		actionResponse = [controller performSelector:selector withObject:request];
 	else
 		responseFromComponent = YES;
+	
+	/*
+		The action will complete later (see WebDeferredResponse), post processing and rendering is done
+		when it does, on the thread that completes it.
+	 */
+	if(!responseFromComponent && [actionResponse isKindOfClass:[WebDeferredResponse class]]) {
+		[(WebDeferredResponse*)actionResponse _attachToApplication:self 
+														   request:request 
+														controller:controller 
+														components:components 
+										   componentConfigurations:componentConfigurations];
+		return actionResponse;
+	}
+	
+	return [self _responseForActionResponse:actionResponse 
+									request:request 
+							 withController:controller 
+								 components:components 
+					componentConfigurations:componentConfigurations 
+							  fromComponent:responseFromComponent];
+}
 
+- (WebResponse*)_responseForActionResponse:(id)actionResponse 
+								   request:(WebRequest*)request 
+							withController:(id <WebActionController>)controller 
+								components:(NSArray*)components 
+				   componentConfigurations:(NSArray*)componentConfigurations 
+							 fromComponent:(BOOL)responseFromComponent {
+	WebResponse* response = nil;
+	
 	if([controller respondsToSelector:@selector(postProcessResponse:fromRequest:)] && !responseFromComponent)
 		actionResponse = [controller postProcessResponse:actionResponse fromRequest:request];
 	
 	//Now provide any controller components the ability to post process the response.
 	//The any of the components my substatue the layout or template for the action, the can do it via the controller.
-	i = 0;
+	int i = 0;
 	for(id <WebComponent> nComp in components) {
 		actionResponse = [nComp postProcessResponse:actionResponse 
 										fromRequest:request 
@@ -437,6 +570,27 @@
 		WebResponse* stringHtmlResponse = [WebResponse htmlResponse];
 		stringHtmlResponse.bodyString = actionResponse;
 		response = stringHtmlResponse;
+	} else if([WebStreamingResponse isEnabled] && canStreamTemplates(controller.view, controller.layout) && 
+			  [controller.view templateDataForController:controller] != nil) {
+		/*
+			Rendered when the connector writes the response. The layout template is loaded now so that a missing template
+			still raises here and not part way through the response.
+		 */
+		WebActionView* view = controller.view;
+		WebLayoutView* layout = controller.layout;
+		[layout templateStringForController:controller];
+		
+		WebTemplateRender* actionRender = [WebTemplateRender renderWithActionView:view 
+																	 templateData:[view templateDataForController:controller] 
+																   actionResponse:actionResponse 
+																	   controller:controller 
+																		  request:request 
+																	  application:self];
+		response = [WebStreamingResponse streamingResponseWithRenderer:[WebTemplateRender renderWithLayoutView:layout 
+																								  actionRender:actionRender 
+																									controller:controller 
+																									   request:request 
+																								   application:self]];
 	} else {
 
 		/* 
@@ -0,0 +1,120 @@
+//
+//  WebDeferredResponse.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "WebResponse.h"
+
+@class WebApplication;
+@protocol WebActionController;
+
+/*!
+	\brief	A response that an action returns when its result is not available yet.
+ 
+	Actions that wait on slow upstream services (SDBDataConnector, S3DataConnector, http calls) can return a deferred response
+	instead of blocking. The connector parks the http request and its worker thread goes back to accepting requests. 
+	When the deferred response is completed, the object it was completed with is handled exactly like an action's return value
+	(post processing, components, the controller's view and layout) and then sent by the connector.
+ 
+	The simplest way is to have the slow work run on the shared I/O queue.
+	\code
+	- (id)profileAction:(WebRequest*)req {
+		return [WebDeferredResponse deferredResponseWithTarget:self selector:@selector(loadProfile:) object:req];
+	}
+ 
+	//Called on an I/O queue thread, returns what the action would have returned.
+	- (id)loadProfile:(WebRequest*)req {
+		return froth_dic([[SDBDataConnector sharedDataConnectorForAccount:a secret:s] getAttributesForItem:[req.params objectAtIndex:0] inDomain:@"profiles"], @"profile");
+	}
+	\endcode
+ 
+	Or keep the deferred response and call -completeWithActionResponse: from any thread when the result is ready.
+	
+	<b>Note:</b> The application delegate is not available when the response is completed, and a deferred response
+	that is never completed keeps its connection open.
+ */
+@interface WebDeferredResponse : WebResponse {
+	id m_actionResponse;
+	WebResponse* m_finalResponse;
+	BOOL m_hasActionResponse;
+	BOOL m_attached;
+	
+	WebApplication* m_application;
+	WebRequest* m_request;
+	id <WebActionController> m_controller;
+	NSArray* m_components;
+	NSArray* m_componentConfigurations;
+	
+	id m_continuationTarget;
+	SEL m_continuationSelector;
+}
+
+/*! \brief A new deferred response, the caller is responsible for completing it. */
++ (WebDeferredResponse*)deferredResponse;
+
+/*!
+	\brief	A deferred response that is completed with the return value of [target selector:object] run on the I/O queue.
+			Exceptions complete the response with a 500 response. Selectors that do not return an object complete it 
+			with nil, as an action returning nil.
+ */
++ (WebDeferredResponse*)deferredResponseWithTarget:(id)target selector:(SEL)selector object:(id)object;
+
+/*!
+	\brief	The shared queue for blocking upstream calls. 
+	
+	Its width is the Info.plist key <i>froth_io_threads</i>, defualt 16.
+ */
++ (NSOperationQueue*)ioQueue;
+
+/*!
+	\brief	Completes the response with an object that an action would return (WebResponse, NSString, or data for the view).
+			Thread safe, only the first call has any effect.
+ */
+- (void)completeWithActionResponse:(id)actionResponse;
+
+/*! \brief If -completeWithActionResponse: has been called. */
+- (BOOL)isCompleted;
+
+/*! \brief The response to send, nil until completed and rendered. */
+- (WebResponse*)finalResponse;
+
+/*!
+	\brief	Used by connectors, [target selector:finalResponse] is called once the final response is ready. 
+	
+	This may be called right away on the calling thread if the response is already complete, otherwise it is 
+	called on the thread that completes the response. The target is retained until then.
+ */
+- (void)setContinuationTarget:(id)target selector:(SEL)selector;
+
+/*! \brief Used by WebApplication to provide the request state needed to render the response when completed. */
+- (void)_attachToApplication:(WebApplication*)application 
+					 request:(WebRequest*)request 
+				  controller:(id <WebActionController>)controller 
+				  components:(NSArray*)components 
+	 componentConfigurations:(NSArray*)componentConfigurations;
+
+@end
@@ -0,0 +1,229 @@
+//
+//  WebDeferredResponse.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WebDeferredResponse.h"
+#import "WebApplication.h"
+#import "WebActionController.h"
+#import "WebMutableRequest.h"
+
+#define kDefaultIOThreads 16
+
+@interface WebApplication (DeferredResponses)
+- (WebResponse*)_responseForActionResponse:(id)actionResponse 
+								   request:(WebRequest*)request 
+							withController:(id <WebActionController>)controller 
+								components:(NSArray*)components 
+				   componentConfigurations:(NSArray*)componentConfigurations 
+							 fromComponent:(BOOL)responseFromComponent;
+@end
+
+@interface WebDeferredResponse (Private)
+- (void)_performInvocation:(NSInvocation*)invocation;
+- (void)_finish;
+@end
+
+@implementation WebDeferredResponse
+
++ (WebDeferredResponse*)deferredResponse {
+	return [[[self alloc] initWithCode:200 contentType:nil] autorelease];
+}
+
++ (WebDeferredResponse*)deferredResponseWithTarget:(id)target selector:(SEL)selector object:(id)object {
+	WebDeferredResponse* deferred = [self deferredResponse];
+	
+	NSMethodSignature* signature = [target methodSignatureForSelector:selector];
+	NSInvocation* invocation = [NSInvocation invocationWithMethodSignature:signature];
+	[invocation setTarget:target];
+	[invocation setSelector:selector];
+	if([signature numberOfArguments] > 2) {
+		[invocation setArgument:&object atIndex:2];
+	}
+	[invocation retainArguments];
+	
+	NSInvocationOperation* operation = [[NSInvocationOperation alloc] initWithTarget:deferred 
+																			selector:@selector(_performInvocation:) 
+																			  object:invocation];
+	[[self ioQueue] addOperation:operation];
+	[operation release];
+	
+	return deferred;
+}
+
++ (NSOperationQueue*)ioQueue {
+	static NSOperationQueue* ioQueue = nil;
+	@synchronized(self) {
+		if(!ioQueue) {
+			NSInteger threads = [[[[NSBundle mainBundle] infoDictionary] valueForKey:@"froth_io_threads"] intValue];
+			
+			ioQueue = [[NSOperationQueue alloc] init];
+			[ioQueue setMaxConcurrentOperationCount:(threads > 0) ? threads : kDefaultIOThreads];
+		}
+	}
+	return ioQueue;
+}
+
+- (void)dealloc {
+	[m_actionResponse release];
+	[m_finalResponse release];
+	[m_request release];
+	[(id)m_controller release];
+	[m_components release];
+	[m_componentConfigurations release];
+	[m_continuationTarget release];
+	[super dealloc];
+}
+
+#pragma mark -
+#pragma mark Completion
+
+- (void)_performInvocation:(NSInvocation*)invocation {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	
+	id result = nil;
+	@try {
+		[invocation invoke];
+		
+		//Only an object return is a response, void and scalar returns complete with no action response
+		NSMethodSignature* signature = [invocation methodSignature];
+		if([signature methodReturnLength] == sizeof(id) && [signature methodReturnType][0] == '@') {
+			[invocation getReturnValue:&result];
+		}
+	} @catch (NSException * e) {
+		NSLog(@"+++ [[ERROR]] WebDeferredResponse: exception [%@] [%@] in %@", [e name], [e reason], NSStringFromSelector([invocation selector]));
+		result = [WebResponse responseWithCode:500];
+	}
+	[self completeWithActionResponse:result];
+	
+	[pool drain];
+}
+
+- (void)completeWithActionResponse:(id)actionResponse {
+	BOOL finish = NO;
+	@synchronized(self) {
+		if(m_hasActionResponse) return;
+		
+		m_actionResponse = [actionResponse retain];
+		m_hasActionResponse = YES;
+		finish = m_attached;
+	}
+	
+	if(finish) {
+		[self _finish];
+	}
+}
+
+- (void)_attachToApplication:(WebApplication*)application 
+					 request:(WebRequest*)request 
+				  controller:(id <WebActionController>)controller 
+				  components:(NSArray*)components 
+	 componentConfigurations:(NSArray*)componentConfigurations {
+	BOOL finish = NO;
+	@synchronized(self) {
+		m_application = application;
+		m_request = [request retain];
+		m_controller = [(id)controller retain];
+		m_components = [components retain];
+		m_componentConfigurations = [componentConfigurations retain];
+		
+		m_attached = YES;
+		finish = m_hasActionResponse;
+	}
+	
+	if(finish) {
+		[self _finish];
+	}
+}
+
+- (void)_finish {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	
+	WebResponse* response = nil;
+	@try {
+		response = [m_application _responseForActionResponse:m_actionResponse 
+													 request:m_request 
+											  withController:m_controller 
+												  components:m_components 
+									 componentConfigurations:m_componentConfigurations 
+											   fromComponent:NO];
+	} @catch (NSException * e) {
+		NSLog(@"+++ [[ERROR]] WebDeferredResponse: exception [%@] [%@] rendering response for [%@]", [e name], [e reason], [m_request uri]);
+		response = nil;
+	}
+	
+	if(!response || [response isKindOfClass:[WebDeferredResponse class]]) {
+		response = [WebResponse responseWithCode:500];
+	}
+	[(WebMutableRequest*)m_request setResponse:response];
+	
+	id target = nil;
+	SEL selector = NULL;
+	@synchronized(self) {
+		m_finalResponse = [response retain];
+		target = m_continuationTarget, m_continuationTarget = nil;
+		selector = m_continuationSelector;
+	}
+	
+	if(target) {
+		[target performSelector:selector withObject:response];
+		[target release];
+	}
+	
+	[pool drain];
+}
+
+- (BOOL)isCompleted {
+	@synchronized(self) {
+		return m_hasActionResponse;
+	}
+	return NO;
+}
+
+- (WebResponse*)finalResponse {
+	@synchronized(self) {
+		return [[m_finalResponse retain] autorelease];
+	}
+	return nil;
+}
+
+- (void)setContinuationTarget:(id)target selector:(SEL)selector {
+	WebResponse* response = nil;
+	@synchronized(self) {
+		if(m_finalResponse) {
+			response = [[m_finalResponse retain] autorelease];
+		} else {
+			m_continuationTarget = [target retain];
+			m_continuationSelector = selector;
+		}
+	}
+	
+	if(response) {
+		[target performSelector:selector withObject:response];
+	}
+}
+
+@end
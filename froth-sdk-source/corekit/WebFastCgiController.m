@@ -26,6 +26,7 @@
 #import "WebFastCgiController.h"
 #import "WebRequest+FastCGI.h"
 #import "WebResponse.h"
+#import "WebRequestArena.h"
 
 #import <stdlib.h>
 #include <pthread.h>
@@ -35,6 +36,133 @@
 #include <unistd.h>
 
 #import "Froth+Defines.h"
+#import "WebDeferredResponse.h"
+#import "WebStreamingResponse.h"
+
+/* Requests are allocated per accept so a deferred request can be parked while the worker accepts the next one. */
+static FCGX_Request* newFCGXRequest(int sock) {
+	FCGX_Request* request = malloc(sizeof(FCGX_Request));
+	assert(request);
+	FCGX_InitRequest(request, sock, 0);
+	return request;
+}
+
+/*
+	Writes template output for a WebStreamingResponse straight to the request's output stream.
+ */
+@interface WebFastCgiOutputSink : NSObject <MGTemplateOutputSink> {
+	FCGX_Stream* m_stream;
+}
+- (id)initWithStream:(FCGX_Stream*)stream;
+@end
+
+@implementation WebFastCgiOutputSink
+
+- (id)initWithStream:(FCGX_Stream*)stream {
+	if(self = [super init]) {
+		m_stream = stream;
+	}
+	return self;
+}
+
+- (void)writeUTF8Bytes:(const void*)bytes length:(NSUInteger)length {
+	FCGX_PutStr((const char*)bytes, (int)length, m_stream);
+}
+
+- (void)flush {
+	FCGX_FFlush(m_stream);
+}
+
+@end
+
+/*
+	Each request has its own streams, so responses are written without a lock and a slow client only holds up its own worker.
+ */
+static void writeResponse(FCGX_Request* request, WebResponse* rs) {
+	FCGX_SetExitStatus(rs.code, request->out);
+	
+	struct iovec iov[2];
+	
+	if([rs isKindOfClass:[WebStreamingResponse class]] && ![(WebStreamingResponse*)rs isRendered]) {
+		[rs getIOVectors:iov count:1];
+		FCGX_PutStr((const char*)iov[0].iov_base, (int)iov[0].iov_len, request->out);
+		
+		//The headers are gone, so a failure part way through can only be logged.
+		WebFastCgiOutputSink* sink = [[WebFastCgiOutputSink alloc] initWithStream:request->out];
+		@try {
+			[(WebStreamingResponse*)rs writeBodyToSink:sink];
+		} @catch (NSException* exception) {
+			NSLog(@"+++ [[ERROR]] FOWFastCgiController: Exception while streaming response [%@] [%@]", [exception name], [exception reason]);
+		} @finally {
+			[sink release];
+		}
+		return;
+	}
+	
+	int iovCount = [rs getIOVectors:iov count:2];
+	
+	for(int i=0; i<iovCount; i++) {
+		FCGX_PutStr((const char*)iov[i].iov_base, (int)iov[i].iov_len, request->out);
+	}
+}
+
+static void logTrace(WebRequest* rq) {
+	NSArray* trace = [rq trace];
+	if([trace count] > 0) {
+		NSMutableString* s = [NSMutableString string];
+		for(NSDictionary* entry in trace) {
+			[s appendFormat:@" %@ [%.4f]", [entry objectForKey:@"name"], [[entry objectForKey:@"duration"] doubleValue]];
+		}
+		NSLog(@"FOWResolver: request [%@] trace%@", rq.uri, s);
+	}
+}
+
+/*
+	A request whose action returned a WebDeferredResponse. Its written and finished on the thread
+	that completes the response.
+ */
+@interface WebFastCgiParkedRequest : NSObject {
+	FCGX_Request* m_request;
+	WebRequest* m_webRequest;
+	NSDate* m_start;
+}
+- (id)initWithRequest:(FCGX_Request*)request webRequest:(WebRequest*)webRequest start:(NSDate*)start;
+- (void)deferredResponseCompleted:(WebResponse*)response;
+@end
+
+@implementation WebFastCgiParkedRequest
+
+- (id)initWithRequest:(FCGX_Request*)request webRequest:(WebRequest*)webRequest start:(NSDate*)start {
+	if(self = [super init]) {
+		m_request = request;
+		m_webRequest = [webRequest retain];
+		m_start = [start retain];
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_webRequest release];
+	[m_start release];
+	[super dealloc];
+}
+
+- (void)deferredResponseCompleted:(WebResponse*)response {
+	//Remove body from HEAD requests
+	if([m_webRequest.method isEqualToString:@"HEAD"]) {
+		[response setBody:nil];
+	}
+	
+	writeResponse(m_request, response);
+	FCGX_Finish_r(m_request);
+	free(m_request), m_request = NULL;
+	
+	float t = -[m_start timeIntervalSinceNow];
+	NSLog(@"FOWResolver: deferred request [%@][%@] completed in [%.4f]", m_webRequest.method, m_webRequest.uri, t);
+	logTrace(m_webRequest);
+}
+
+@end
 
 void* r_thread_accept(void* initDict) {
 	NSAutoreleasePool *gpool = [[NSAutoreleasePool alloc] init];
@@ -43,29 +171,30 @@ void* r_thread_accept(void* initDict) {
 	NSNumber* threadIndex = [(NSDictionary*)initDict valueForKey:@"threadIndex"];
 	
 	int rc;
-	FCGX_Request request;
-	FCGX_InitRequest(&request, 0, 0);
+	FCGX_Request* request = newFCGXRequest(0);
 	
 	for(;;) {
 		static pthread_mutex_t accept_mutex = PTHREAD_MUTEX_INITIALIZER;
-		static pthread_mutex_t counts_mutex = PTHREAD_MUTEX_INITIALIZER;
 		
 		/* Some platforms require accept() serialization, some don't.. */
 		pthread_mutex_lock(&accept_mutex);
-		rc = FCGX_Accept_r(&request);
+		rc = FCGX_Accept_r(request);
 		pthread_mutex_unlock(&accept_mutex);
 		
 		if(rc < 0) break; //No new connection to accept...
 		
+		//Scratch buffers for decoding the request come from the arena
+		[WebRequestArena beginRequest];
 		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
 		
 		WebMutableRequest *rq = [[WebMutableRequest alloc] init];	
+		BOOL deferred = NO;
 		
 		@try {
 			//Timer for stats
 			NSDate *start = [NSDate dateWithTimeIntervalSinceNow:0];
 			
-			[rq setHTTPRequestPointer:request.envp];
+			[rq setHTTPRequestPointer:request->envp];
 			NSString* method = [rq method];
 			
 			NSData* reqBodyData = nil;
@@ -76,7 +205,7 @@ void* r_thread_accept(void* initDict) {
 			   [method isEqualToString:@"DELETE"]) {
 				void *buf = malloc(dataLen+1);
 				assert(buf);
-				while (FCGX_GetStr(buf, dataLen, request.in) < dataLen) {
+				while (FCGX_GetStr(buf, dataLen, request->in) < dataLen) {
 					///Do something meaningfull??...
 				}
 				
@@ -99,6 +228,14 @@ void* r_thread_accept(void* initDict) {
 			
 			if(!rs) {
 				[NSException raise:@"InvalidWebResponseObject" format:@"Probably becouse an action was defined, but returned a nil WebResponse instance", nil];
+			} else if([rs isKindOfClass:[WebDeferredResponse class]]) {
+				//Park the request, the worker goes back to accepting while the response completes.
+				WebFastCgiParkedRequest* parked = [[WebFastCgiParkedRequest alloc] initWithRequest:request webRequest:rq start:start];
+				request = newFCGXRequest(request->listen_sock);
+				deferred = YES;
+				
+				[(WebDeferredResponse*)rs setContinuationTarget:parked selector:@selector(deferredResponseCompleted:)];
+				[parked release];
 			} else {
 				//Remove body from HEAD requests
 				if([method isEqualToString:@"HEAD"]) {
@@ -106,16 +243,17 @@ void* r_thread_accept(void* initDict) {
 				}
 			}
 			
-			FCGX_SetExitStatus(rs.code, request.out);
-			
-			pthread_mutex_lock(&counts_mutex);
-			FCGX_FPrintF(request.out, "%s", [[rs dump] bytes]);
-			pthread_mutex_unlock(&counts_mutex);
-			
-			float t = -[start timeIntervalSinceNow];			
-			NSLog(@"FOWResolver: request [%@][%@] completed in [%.4f] on thread [%@]", rq.method, rq.uri,  t, threadIndex);
+			if(!deferred) {
+				writeResponse(request, rs);
+				
+				float t = -[start timeIntervalSinceNow];			
+				NSLog(@"FOWResolver: request [%@][%@] completed in [%.4f] on thread [%@]", rq.method, rq.uri,  t, threadIndex);
+				logTrace(rq);
+			}
+			if([WebRequestArena currentArena]) {
+				NSLog(@"FOWResolver: request [%@] %@", rq.uri, [[WebRequestArena currentArena] statsDescription]);
+			}
 		} @catch (NSException *exception) {
-			FCGX_SetExitStatus(500, request.out);
 			NSMutableString *err = [NSMutableString stringWithFormat:
 									@"Content-type: text/html\n\n\
 									<html><head><title>Froth Exception</title></head> \
@@ -125,18 +263,24 @@ void* r_thread_accept(void* initDict) {
 			
 			NSLog(@"******** FOWFastCgiController: Recovery from exception [%@] [%@]", [exception name], [exception description]);
 			
-			pthread_mutex_lock(&counts_mutex);
-			FCGX_FPrintF(request.out, "%s", [err UTF8String]);
-			pthread_mutex_unlock(&counts_mutex);
+			//A parked request is owned by its deferred response
+			if(!deferred) {
+				FCGX_SetExitStatus(500, request->out);
+				FCGX_FPrintF(request->out, "%s", [err UTF8String]);
+			}
 		} @finally {
 			[rq release];
 		}
 		
-		FCGX_Finish_r(&request);
+		if(!deferred) {
+			FCGX_Finish_r(request);
+		}
 		
 		[pool drain];
+		[WebRequestArena endRequest];
 	}
 	
+	free(request);
 	[gpool drain];	
 	return NULL;
 }
@@ -187,6 +331,9 @@ void* r_thread_accept(void* initDict) {
 }
 
 - (void)processRequests {
+	//Load templates before the first request is accepted
+	[webApp warmUp];
+	
 	int i;
 	for(i=0; i<threadCount-1; ++i) {
 		[NSThread detachNewThreadSelector:@selector(threadTask:)
@@ -206,30 +353,31 @@ void* r_thread_accept(void* initDict) {
 	//self.threadCount = [unused intValue];
 	
 	int rc;
-	FCGX_Request request;
-	FCGX_InitRequest(&request, sock, 0);
+	FCGX_Request* request = newFCGXRequest(sock);
 
 	//NSLog(@"Starting thread task");
 	for(;;) {
 		static pthread_mutex_t accept_mutex = PTHREAD_MUTEX_INITIALIZER;
-		static pthread_mutex_t counts_mutex = PTHREAD_MUTEX_INITIALIZER;
 		
 		/* Some platforms require accept() serialization, some don't.. */
 		pthread_mutex_lock(&accept_mutex);
-		rc = FCGX_Accept_r(&request);
+		rc = FCGX_Accept_r(request);
 		pthread_mutex_unlock(&accept_mutex);
 		
 		if(rc < 0) break; //No new connection to accept...
 		
+		//Scratch buffers for decoding the request come from the arena
+		[WebRequestArena beginRequest];
 		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
 		
 		WebMutableRequest *rq = [[WebMutableRequest alloc] init];	
+		BOOL deferred = NO;
 		
 		@try {
 			//Timer for stats
 			NSDate *start = [NSDate dateWithTimeIntervalSinceNow:0];
 			
-			[rq setHTTPRequestPointer:request.envp];
+			[rq setHTTPRequestPointer:request->envp];
 			NSString* method = [rq method];
 			
 			NSData* reqBodyData = nil;
@@ -240,7 +388,7 @@ void* r_thread_accept(void* initDict) {
 			   [method isEqualToString:@"DELETE"]) {
 				void *buf = malloc(dataLen+1);
 				assert(buf);
-				while (FCGX_GetStr(buf, dataLen, request.in) < dataLen) {
+				while (FCGX_GetStr(buf, dataLen, request->in) < dataLen) {
 					///Do something meaningfull??...
 				}
 				
@@ -263,23 +411,32 @@ void* r_thread_accept(void* initDict) {
 			
 			if(!rs) {
 				[NSException raise:@"InvalidWebResponseObject" format:@"Probably becouse an action was defined, but returned a nil WebResponse instance", nil];
+			} else if([rs isKindOfClass:[WebDeferredResponse class]]) {
+				//Park the request, the worker goes back to accepting while the response completes.
+				WebFastCgiParkedRequest* parked = [[WebFastCgiParkedRequest alloc] initWithRequest:request webRequest:rq start:start];
+				request = newFCGXRequest(request->listen_sock);
+				deferred = YES;
+				
+				[(WebDeferredResponse*)rs setContinuationTarget:parked selector:@selector(deferredResponseCompleted:)];
+				[parked release];
 			} else {
 				//Remove body from HEAD requests
 				if([method isEqualToString:@"HEAD"]) {
 					[rs setBody:nil];
 				}
 			}
-						
-			FCGX_SetExitStatus(rs.code, request.out);
-			
-			pthread_mutex_lock(&counts_mutex);
-			FCGX_FPrintF(request.out, "%s", [[rs dump] bytes]);
-			pthread_mutex_unlock(&counts_mutex);
 			
-			float t = -[start timeIntervalSinceNow];			
-			NSLog(@"FOWResolver: request [%@][%@] completed in [%.4f] on thread [%@]", rq.method, rq.uri,  t, [[[NSThread currentThread] threadDictionary] valueForKey:@"location"]);
+			if(!deferred) {
+				writeResponse(request, rs);
+				
+				float t = -[start timeIntervalSinceNow];			
+				NSLog(@"FOWResolver: request [%@][%@] completed in [%.4f] on thread [%@]", rq.method, rq.uri,  t, [[[NSThread currentThread] threadDictionary] valueForKey:@"location"]);
+				logTrace(rq);
+			}
+			if([WebRequestArena currentArena]) {
+				NSLog(@"FOWResolver: request [%@] %@", rq.uri, [[WebRequestArena currentArena] statsDescription]);
+			}
 		} @catch (NSException *exception) {
-			FCGX_SetExitStatus(500, request.out);
 			NSMutableString *err = [NSMutableString stringWithFormat:
 					@"Content-type: text/html\n\n\
 									<html><head><title>Froth Exception</title></head> \
@@ -289,19 +446,25 @@ void* r_thread_accept(void* initDict) {
 			
 			NSLog(@"******** FOWFastCgiController: Recovery from exception [%@] [%@]", [exception name], [exception description]);
 			
-			pthread_mutex_lock(&counts_mutex);
-			FCGX_FPrintF(request.out, "%s", [err UTF8String]);
-			pthread_mutex_unlock(&counts_mutex);
+			//A parked request is owned by its deferred response
+			if(!deferred) {
+				FCGX_SetExitStatus(500, request->out);
+				FCGX_FPrintF(request->out, "%s", [err UTF8String]);
+			}
 		} @finally {
 			[rq release];
 		}
 		
-		FCGX_Finish_r(&request);
+		if(!deferred) {
+			FCGX_Finish_r(request);
+		}
 		//Unlocking the thread hear causes mutli-threading to be locked!
 		
 		[pool drain];
+		[WebRequestArena endRequest];
 	}
 	
+	free(request);
 	[gpool drain];
 }
 
@@ -309,6 +472,9 @@ void* r_thread_accept(void* initDict) {
 #pragma mark PureC
 
 - (void)processRequests_c {
+	//Load templates before the first request is accepted
+	[webApp warmUp];
+	
 	int i;
 	int res;
 	pthread_t thr[threadCount];
@@ -0,0 +1,84 @@
+//
+//  WebFragmentCache.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#include <pthread.h>
+#include <time.h>
+
+#import "MGTemplateEngine.h"
+
+@class MemcachedConnector;
+@class WebFragmentCacheNode;
+
+/*!
+	\brief	The store behind the template {% cache %} marker, a process local LRU of rendered fragments with memcached as an optional shared second tier.
+ 
+	A fragment is cached with the cache marker, the key may include template variables in braces and the lifetime (in seconds) is optional.
+	With no lifetime the fragment is kept until it is evicted.
+ 
+	\code
+	{% cache "sidebar-{user.uid}" 300 %}
+		...
+	{% /cache %}
+	\endcode
+ 
+	The local tier holds froth_fragment_cache_size fragments (Info.plist, default 512, 0 to turn off the local tier). When the 
+	Info.plist froth_fragment_cache_memcached boolean is set, local misses are looked up in memcached (with the servers from 
+	Memcached.plist) and new fragments are stored there, so all the application's processes share rendered fragments.
+ 
+	Hits and misses are counted for each fragment by the key as written in the template, see -statistics.
+ */
+@interface WebFragmentCache : NSObject <MGTemplateFragmentCache> {
+	NSMutableDictionary* m_nodes;
+	WebFragmentCacheNode* m_head;
+	WebFragmentCacheNode* m_tail;
+	NSUInteger m_capacity;
+	NSMutableDictionary* m_counters;
+	pthread_mutex_t m_lock;
+	
+	MemcachedConnector* m_memcached;
+	pthread_mutex_t m_memcachedLock;
+}
+
+/*! \brief The application's fragment cache, installed as the template engine's fragment cache by WebApplication */
++ (WebFragmentCache*)sharedCache;
+
+/*! \brief If fragments are shared through memcached */
+- (BOOL)usesMemcached;
+
+/*! 
+	\brief	Hit and miss counts for each fragment name
+ 
+	Returns a dictionary keyed by the fragment key as written in the template, each value is a dictionary with 'hits' and 'misses' numbers.
+ */
+- (NSDictionary*)statistics;
+
+/*! \brief Drops all locally cached fragments, fragments in memcached are left to expire. */
+- (void)removeAllFragments;
+
+@end
@@ -0,0 +1,334 @@
+//
+//  WebFragmentCache.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WebFragmentCache.h"
+#import "MemcachedConnector.h"
+#import "NSData+Utilities.h"
+
+#include <arpa/inet.h>
+
+#define kDefaultCapacity		512
+#define kMemcachedKeyPrefix		@"froth.fragment."
+#define kMemcachedMaxKeyLength	250
+#define kMemcachedMaxRelative	2592000		//Memcached reads larger expirations as unix times
+
+/*
+	A fragment in the local LRU list, owned by the nodes dictionary.
+ */
+@interface WebFragmentCacheNode : NSObject {
+@public
+	NSString* key;
+	NSData* data;
+	time_t expires;			//0 for never
+	WebFragmentCacheNode* prev;	//weak
+	WebFragmentCacheNode* next;	//weak
+}
+@end
+
+@implementation WebFragmentCacheNode
+
+- (void)dealloc {
+	[key release];
+	[data release];
+	[super dealloc];
+}
+
+@end
+
+@interface WebFragmentCounter : NSObject {
+@public
+	unsigned long long hits;
+	unsigned long long misses;
+}
+@end
+
+@implementation WebFragmentCounter
+@end
+
+#pragma mark -
+
+@interface WebFragmentCache (Private)
+- (void)_unlinkNode:(WebFragmentCacheNode*)node;
+- (void)_pushNode:(WebFragmentCacheNode*)node;
+- (void)_setData:(NSData*)data forKey:(NSString*)key expires:(time_t)expires;
+- (void)_countHit:(BOOL)hit forName:(NSString*)name;
+- (NSString*)_memcachedKeyForKey:(NSString*)key;
+- (NSData*)_memcachedDataForKey:(NSString*)key expires:(time_t*)expires;
+- (void)_setMemcachedData:(NSData*)data forKey:(NSString*)key expires:(time_t)expires lifetime:(NSTimeInterval)seconds;
+@end
+
+static pthread_once_t kFragmentCacheSetupOnce = PTHREAD_ONCE_INIT;
+static WebFragmentCache* kSharedFragmentCache = nil;
+
+static void fragmentCacheSetup(void) {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	kSharedFragmentCache = [[WebFragmentCache alloc] init];
+	[pool drain];
+}
+
+@implementation WebFragmentCache
+
++ (WebFragmentCache*)sharedCache {
+	pthread_once(&kFragmentCacheSetupOnce, fragmentCacheSetup);
+	return kSharedFragmentCache;
+}
+
+- (id)init {
+	if(self = [super init]) {
+		m_nodes = [[NSMutableDictionary alloc] init];
+		m_counters = [[NSMutableDictionary alloc] init];
+		pthread_mutex_init(&m_lock, NULL);
+		pthread_mutex_init(&m_memcachedLock, NULL);
+		
+		NSDictionary* info = [[NSBundle mainBundle] infoDictionary];
+		id capacity = [info valueForKey:@"froth_fragment_cache_size"];
+		m_capacity = (capacity) ? (NSUInteger)MAX([capacity intValue], 0) : kDefaultCapacity;
+		
+		//A private connector, so our lock covers every use of it
+		if([[info valueForKey:@"froth_fragment_cache_memcached"] boolValue]) {
+			m_memcached = [[MemcachedConnector alloc] init];
+			[m_memcached prepareServersFromConfigurationDictionary];
+		}
+		
+		NSLog(@"WebFragmentCache: Caching up to [%u] fragments locally%@", (unsigned)m_capacity, (m_memcached) ? @", shared through memcached" : @"");
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_nodes release];
+	[m_counters release];
+	[m_memcached release];
+	pthread_mutex_destroy(&m_lock);
+	pthread_mutex_destroy(&m_memcachedLock);
+	[super dealloc];
+}
+
+- (BOOL)usesMemcached {
+	return (m_memcached != nil);
+}
+
+#pragma mark -
+#pragma mark MGTemplateFragmentCache
+
+- (NSData*)fragmentForKey:(NSString*)key name:(NSString*)name {
+	if(!key) return nil;
+	
+	NSData* data = nil;
+	time_t now = time(NULL);
+	
+	pthread_mutex_lock(&m_lock);
+	WebFragmentCacheNode* node = [m_nodes objectForKey:key];
+	if(node && node->expires != 0 && node->expires <= now) {
+		[self _unlinkNode:node];
+		[m_nodes removeObjectForKey:key];
+		node = nil;
+	}
+	if(node) {
+		//Most recently used to the front
+		[self _unlinkNode:node];
+		[self _pushNode:node];
+		data = [[node->data retain] autorelease];
+	}
+	pthread_mutex_unlock(&m_lock);
+	
+	if(!data && m_memcached) {
+		time_t expires = 0;
+		data = [self _memcachedDataForKey:key expires:&expires];
+		if(data) {
+			pthread_mutex_lock(&m_lock);
+			[self _setData:data forKey:key expires:expires];
+			pthread_mutex_unlock(&m_lock);
+		}
+	}
+	
+	[self _countHit:(data != nil) forName:name];
+	return data;
+}
+
+- (void)setFragment:(NSData*)fragment forKey:(NSString*)key name:(NSString*)name lifetime:(NSTimeInterval)seconds {
+	if(!fragment || !key) return;
+	
+	time_t expires = (seconds > 0) ? time(NULL) + (time_t)seconds : 0;
+	pthread_mutex_lock(&m_lock);
+	[self _setData:fragment forKey:key expires:expires];
+	pthread_mutex_unlock(&m_lock);
+	
+	if(m_memcached) {
+		[self _setMemcachedData:fragment forKey:key expires:expires lifetime:seconds];
+	}
+}
+
+#pragma mark -
+#pragma mark Statistics
+
+- (NSDictionary*)statistics {
+	NSMutableDictionary* statistics = [NSMutableDictionary dictionary];
+	
+	pthread_mutex_lock(&m_lock);
+	for(NSString* name in m_counters) {
+		WebFragmentCounter* counter = [m_counters objectForKey:name];
+		[statistics setObject:[NSDictionary dictionaryWithObjectsAndKeys:
+							   [NSNumber numberWithUnsignedLongLong:counter->hits], @"hits", 
+							   [NSNumber numberWithUnsignedLongLong:counter->misses], @"misses", 
+							   nil] 
+					   forKey:name];
+	}
+	pthread_mutex_unlock(&m_lock);
+	
+	return statistics;
+}
+
+- (void)removeAllFragments {
+	pthread_mutex_lock(&m_lock);
+	[m_nodes removeAllObjects];
+	m_head = nil;
+	m_tail = nil;
+	pthread_mutex_unlock(&m_lock);
+}
+
+#pragma mark -
+#pragma mark Private
+
+/* All of the list methods expect m_lock to be held */
+
+- (void)_unlinkNode:(WebFragmentCacheNode*)node {
+	if(node->prev) node->prev->next = node->next;
+	else m_head = node->next;
+	if(node->next) node->next->prev = node->prev;
+	else m_tail = node->prev;
+	node->prev = nil;
+	node->next = nil;
+}
+
+- (void)_pushNode:(WebFragmentCacheNode*)node {
+	node->next = m_head;
+	if(m_head) m_head->prev = node;
+	m_head = node;
+	if(!m_tail) m_tail = node;
+}
+
+- (void)_setData:(NSData*)data forKey:(NSString*)key expires:(time_t)expires {
+	if(m_capacity == 0) return;
+	
+	WebFragmentCacheNode* node = [m_nodes objectForKey:key];
+	if(node) {
+		[self _unlinkNode:node];
+	} else {
+		node = [[[WebFragmentCacheNode alloc] init] autorelease];
+		node->key = [key copy];
+		[m_nodes setObject:node forKey:node->key];
+	}
+	[node->data release];
+	node->data = [data retain];
+	node->expires = expires;
+	[self _pushNode:node];
+	
+	//Evict the least recently used
+	while([m_nodes count] > m_capacity && m_tail) {
+		WebFragmentCacheNode* last = [[m_tail retain] autorelease];
+		[self _unlinkNode:last];
+		[m_nodes removeObjectForKey:last->key];
+	}
+}
+
+- (void)_countHit:(BOOL)hit forName:(NSString*)name {
+	if(!name) return;
+	
+	pthread_mutex_lock(&m_lock);
+	WebFragmentCounter* counter = [m_counters objectForKey:name];
+	if(!counter) {
+		counter = [[[WebFragmentCounter alloc] init] autorelease];
+		[m_counters setObject:counter forKey:name];
+	}
+	if(hit) counter->hits++;
+	else counter->misses++;
+	pthread_mutex_unlock(&m_lock);
+}
+
+/*
+	Memcached keys are limited to 250 bytes with no spaces or control characters, other keys (ie with a variable holding a title) 
+	are stored under the sha1 of the key.
+ */
+- (NSString*)_memcachedKeyForKey:(NSString*)key {
+	NSString* mkey = [kMemcachedKeyPrefix stringByAppendingString:key];
+	const char* bytes = [mkey UTF8String];
+	size_t length = strlen(bytes);
+	BOOL valid = (length <= kMemcachedMaxKeyLength);
+	for(size_t i = 0; valid && i < length; i++) {
+		if((unsigned char)bytes[i] <= ' ' || bytes[i] == 0x7f) {
+			valid = NO;
+		}
+	}
+	if(!valid) {
+		NSString* digest = [[key dataUsingEncoding:NSUTF8StringEncoding] sha1DigestString];
+		return [NSString stringWithFormat:@"%@sha1.%@", kMemcachedKeyPrefix, digest];
+	}
+	return mkey;
+}
+
+/*
+	Fragments are stored in memcached behind a 4 byte (network order) expiry time, so a fragment copied into the local tier 
+	from memcached expires when the original does.
+ */
+- (NSData*)_memcachedDataForKey:(NSString*)key expires:(time_t*)expires {
+	NSString* mkey = [self _memcachedKeyForKey:key];
+	if(!mkey) return nil;
+	
+	pthread_mutex_lock(&m_memcachedLock);
+	NSData* stored = [m_memcached dataForKey:mkey];
+	pthread_mutex_unlock(&m_memcachedLock);
+	
+	if([stored length] < sizeof(uint32_t)) {
+		return nil;
+	}
+	uint32_t header;
+	memcpy(&header, [stored bytes], sizeof(uint32_t));
+	*expires = (time_t)ntohl(header);
+	if(*expires != 0 && *expires <= time(NULL)) {
+		return nil;
+	}
+	return [stored subdataWithRange:NSMakeRange(sizeof(uint32_t), [stored length] - sizeof(uint32_t))];
+}
+
+- (void)_setMemcachedData:(NSData*)data forKey:(NSString*)key expires:(time_t)expires lifetime:(NSTimeInterval)seconds {
+	NSString* mkey = [self _memcachedKeyForKey:key];
+	if(!mkey) return;
+	
+	uint32_t header = htonl((uint32_t)expires);
+	NSMutableData* stored = [NSMutableData dataWithCapacity:[data length] + sizeof(uint32_t)];
+	[stored appendBytes:&header length:sizeof(uint32_t)];
+	[stored appendData:data];
+	
+	NSTimeInterval memcachedExpires = (seconds > kMemcachedMaxRelative) ? (NSTimeInterval)expires : seconds;
+	pthread_mutex_lock(&m_memcachedLock);
+	[m_memcached setData:stored forKey:mkey expires:memcachedExpires];
+	pthread_mutex_unlock(&m_memcachedLock);
+}
+
+@end
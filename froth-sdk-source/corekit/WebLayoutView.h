@@ -32,6 +32,7 @@
 @class WebRequest;
 @class WebActionController;
 @protocol WebActionController;
+@protocol MGTemplateOutputSink;
 
 
 /*!
@@ -44,11 +45,11 @@
 				the Template file name, and to do so, must do it in the - [methodName]Action: method block, allong with the same for changeing
 				the Action view's template file.
  
-				The default layout view is cached for the life of the application. This provides faster loading as a round-trip to the
-				data does not have to occur, only template parsing.
+				Layout templates are loaded once into the shared WebTemplateRegistry and compiled once, so a request does not read
+				or parse the layout again.
  
 				Layout templates are provided with the following values.
-				- result The actual string result from the action.
+				- TemplateResult The utf8 result from the action, as data so it is inserted as is and never autoescaped.
 				- controller The controller that called the action
 				- request The request object for the action
 				- app The main application
@@ -58,7 +59,6 @@
  */
 @interface WebLayoutView : NSObject {
 	NSString* templateName;
-	NSMutableDictionary* m_cachedTemplates;
 }
 
 /*
@@ -72,6 +72,26 @@
  */
 - (NSString*)templateStringForController:(id)controller;
 
+/*!
+	\brief	Renders the layout around the action's utf8 output, TemplateResult is the action data itself.
+	
+	The result is the utf8 body of the response. The action data is copied into the output as is, it is never decoded to a string.
+ */
+- (NSData*)processedActionResultData:(NSData*)actionResult 
+						  controller:(id)controller 
+							 request:(WebRequest*)req 
+						 application:(id)app;
+
+/*!
+	\brief	Renders the layout streaming its output to sink. TemplateResult is the action's utf8 data or, to stream the action 
+			as well, an object conforming to MGTemplateRenderable (see WebTemplateRender).
+ */
+- (void)renderActionResult:(id)actionResult 
+				controller:(id)controller 
+				   request:(WebRequest*)req 
+			   application:(id)app 
+					toSink:(id <MGTemplateOutputSink>)sink;
+
 /*! 
 	\brief	Subclasses can overide this to provide custom data parsing of the templates. 
 	\detail	The primary purpose of receiveing the templateData as NSData instead of NSString, as template subclasses
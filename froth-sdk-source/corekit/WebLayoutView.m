@@ -31,25 +31,24 @@
 
 #import "Froth.h"
 
-#import "AGRegexTemplateMatcher.h"
+#import "WebTemplateEnginePool.h"
 
 //Built In Temlating Markers and Filters
 #import "WKValueComparisonFilters.h"
 #import "WKFunctionMarkers.h"
 
+static BOOL usesPooledEngines(WebLayoutView* view) {
+	SEL prepareSelector = @selector(prepareDefualtMarkersAndFiltersForTemplateEngine:);
+	return [view methodForSelector:prepareSelector] == [WebLayoutView instanceMethodForSelector:prepareSelector];
+}
+
 @implementation WebLayoutView
 @synthesize templateName;
 
-- (id)init {
-	if(self = [super init]) {
-		m_cachedTemplates = [[NSMutableDictionary alloc] init];
-	}
-	return self;
-}
-
 - (NSString*)templateStringForController:(id)controller {
-	NSString* cachedTemplate = [m_cachedTemplates objectForKey:self.templateName];
-	if(!cachedTemplate) {
+	WebTemplateRegistry* registry = [WebTemplateRegistry sharedRegistry];
+	WebTemplateEntry* entry = [registry entryForName:self.templateName];
+	if(!entry) {
 #ifndef __APPLE__
 		NSBundle* bundle = [NSBundle mainBundle];
 #else
@@ -66,25 +65,23 @@
 		if([templateName hasSuffix:@".*nil*"])
 			templateName = [[templateName stringByReplacingOccurrencesOfString:@".*nil*" withString:@".html"] retain];
 #endif
-							 
-		NSString* path = [[bundle resourcePath] stringByAppendingPathComponent:templateName];	//[bundle pathForResource:self.templateName ofType:nil];
 		
-		cachedTemplate = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
-		if(cachedTemplate) {
-			//cache the template...
-			[m_cachedTemplates setObject:cachedTemplate forKey:self.templateName];
-		} else {
-			//No try .html as defualt
-			path = [bundle pathForResource:self.templateName ofType:@"html"];
-			cachedTemplate = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
-			if(!cachedTemplate) {
-				froth_exception(@"LayoutViewTemplateException", @"Unable to find layout template resource for name %@", templateName);
-			} else {
-				[m_cachedTemplates setObject:cachedTemplate forKey:self.templateName];
+		entry = [registry entryForName:self.templateName];
+		if(!entry) {
+			NSString* path = [[bundle resourcePath] stringByAppendingPathComponent:templateName];	//[bundle pathForResource:self.templateName ofType:nil];
+			
+			entry = [registry loadTemplateNamed:self.templateName atPath:path];
+			if(!entry) {
+				//No try .html as defualt
+				path = [bundle pathForResource:self.templateName ofType:@"html"];
+				entry = [registry loadTemplateNamed:self.templateName atPath:path];
+				if(!entry) {
+					froth_exception(@"LayoutViewTemplateException", @"Unable to find layout template resource for name %@", templateName);
+				}
 			}
-		}		
+		}
 	}
-	return cachedTemplate;
+	return [entry string];
 }
 
 - (void)prepareDefualtMarkersAndFiltersForTemplateEngine:(MGTemplateEngine*)engine {
@@ -92,46 +89,121 @@
 	[engine loadMarker:[[[WKFunctionMarkers alloc] initWithTemplateEngine:engine] autorelease]];
 }
 
+/*
+	Engines come from the per thread pool, unless a subclass loads its own markers and filters into a new engine for each render.
+ */
+- (MGTemplateEngine*)_templateEngine {
+	if(usesPooledEngines(self)) {
+		MGTemplateEngine* engine = [WebTemplateEnginePool checkoutEngine];
+		[engine setDelegate:self];
+		[engine setAutoescape:[WebTemplateEnginePool autoescapeForTemplateNamed:templateName]];
+		return engine;
+	}
+	
+	MGTemplateEngine * engine = [MGTemplateEngine templateEngine];
+	[self prepareDefualtMarkersAndFiltersForTemplateEngine:engine];
+	
+	[engine setDelegate:self];
+	[engine setAutoescape:[WebTemplateEnginePool autoescapeForTemplateNamed:templateName]];
+	[engine setMatcher:[[[[WebTemplateEnginePool matcherClass] alloc] initWithTemplateEngine:engine] autorelease]];
+	return engine;
+}
+
+- (void)_returnTemplateEngine:(MGTemplateEngine*)engine {
+	if(usesPooledEngines(self)) {
+		[WebTemplateEnginePool checkinEngine:engine];
+	}
+}
+
+- (MGCompiledTemplate*)_compiledTemplateForController:(id)controller engine:(MGTemplateEngine*)engine {
+	NSString* template = [self templateStringForController:controller];
+	
+	WebTemplateRegistry* registry = [WebTemplateRegistry sharedRegistry];
+	WebTemplateEntry* entry = [registry entryForName:templateName];
+	if(entry && [entry string] == template) {
+		MGCompiledTemplate* compiled = [registry compiledTemplateForEntry:entry engine:engine];
+		if(compiled) return compiled;
+	}
+	return [engine compileTemplate:template];
+}
+
+- (NSDictionary*)_variablesWithActionResult:(id)actionResult controller:(id)controller request:(WebRequest*)req application:(id)app {
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			(actionResult!=nil)?actionResult:@"", @"TemplateResult",
+			controller, @"controller", 
+			req, @"request", 
+			app, @"app", 
+			self, @"layout", 
+			([controller flash])?[controller flash]:@"", @"flash", 
+			nil];
+}
+
 //We use strings as, a custom actionview could return binary images or data by overideing  -displayWithTemplateData....
 - (NSString*)processedActionResultString:(NSString*)actionResult 
 							controller:(id)controller 
 							   request:(WebRequest*)req 
 						   application:(id)app {
-	MGTemplateEngine * engine = [MGTemplateEngine templateEngine];
-	//TODO: move this to a global configureation utility
-	[self prepareDefualtMarkersAndFiltersForTemplateEngine:engine];
+	MGTemplateEngine* engine = [self _templateEngine];
+	MGCompiledTemplate* compiled = [self _compiledTemplateForController:controller engine:engine];
 	
-	[engine setDelegate:self];
-	[engine setMatcher:[AGRegexTemplateMatcher matcherWithTemplateEngine:engine]];
+	//The action result is already rendered, as data it is spliced in as is and not autoescaped
+	NSData* actionData = [actionResult dataUsingEncoding:NSUTF8StringEncoding];
+	NSDictionary* variables = [self _variablesWithActionResult:actionData controller:controller request:req application:app];
 	
-	NSString* template = [self templateStringForController:controller];
-	NSDictionary* variables = [NSDictionary dictionaryWithObjectsAndKeys:
-							   actionResult, @"TemplateResult",
-							   controller, @"controller", 
-							   req, @"request", 
-							   app, @"app", 
-							   self, @"layout", 
-							   ([controller flash])?[controller flash]:@"", @"flash", 
-							   nil];
+	NSString* result = [engine processCompiledTemplate:compiled withVariables:variables];	
+	[self _returnTemplateEngine:engine];
+	return result;
+}
+
+- (NSData*)processedActionResultData:(NSData*)actionResult 
+						  controller:(id)controller 
+							 request:(WebRequest*)req 
+						 application:(id)app {
+	MGTemplateEngine* engine = [self _templateEngine];
+	MGCompiledTemplate* compiled = [self _compiledTemplateForController:controller engine:engine];
+	NSDictionary* variables = [self _variablesWithActionResult:actionResult controller:controller request:req application:app];
 	
-	NSString* result = [engine processTemplate:template withVariables:variables];	
+	NSData* result = [engine processCompiledTemplateToUTF8Data:compiled withVariables:variables];
+	[self _returnTemplateEngine:engine];
 	return result;
 }
 
+- (void)renderActionResult:(id)actionResult 
+				controller:(id)controller 
+				   request:(WebRequest*)req 
+			   application:(id)app 
+					toSink:(id <MGTemplateOutputSink>)sink {
+	MGTemplateEngine* engine = [self _templateEngine];
+	MGCompiledTemplate* compiled = [self _compiledTemplateForController:controller engine:engine];
+	NSDictionary* variables = [self _variablesWithActionResult:actionResult controller:controller request:req application:app];
+	
+	[engine processCompiledTemplate:compiled withVariables:variables toSink:sink];
+	[self _returnTemplateEngine:engine];
+}
+
 - (WebResponse*)displayWithTemplateData:(NSData*)templateData 
 						   forExtention:(NSString*)extention 
 								request:(WebRequest*)request 
 							 controller:(id <WebActionController>)controller
 							application:(id)app {
-	NSString* actionResults =	[[NSString alloc] initWithData:templateData encoding:NSUTF8StringEncoding];
-	//return [WebResponse htmlResponseWithBody:actionResults];
-	NSString* resBody = [self processedActionResultString:actionResults controller:controller request:request application:app];
-	[actionResults release];
-	return [WebResponse htmlResponseWithBody:resBody];
+	/*
+		Subclasses that customize the string rendering still get a string, otherwise the action's utf8 data is
+		spliced into the layout as is and the result becomes the body, with no decoding or encoding.
+	 */
+	SEL stringSelector = @selector(processedActionResultString:controller:request:application:);
+	if([self methodForSelector:stringSelector] != [WebLayoutView instanceMethodForSelector:stringSelector]) {
+		NSString* actionResults =	[[NSString alloc] initWithData:templateData encoding:NSUTF8StringEncoding];
+		NSString* resBody = [self processedActionResultString:actionResults controller:controller request:request application:app];
+		[actionResults release];
+		return [WebResponse htmlResponseWithBody:resBody];
+	}
+	
+	WebResponse* response = [WebResponse htmlResponse];
+	response.body = [self processedActionResultData:templateData controller:controller request:request application:app];
+	return response;
 }
 
 - (void)dealloc {
-	[m_cachedTemplates release];
 	[templateName release];
 	[super dealloc];
 }
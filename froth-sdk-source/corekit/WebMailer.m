@@ -37,6 +37,29 @@
 #include <Python/Python.h>
 #endif
 
+/*
+	Email templates are kept in the shared template registry under their file name (ie 'Welcome.email')
+ */
+static WebTemplateEntry* emailTemplateEntry(NSString* templateName, NSString* templatePath) {
+	WebTemplateRegistry* registry = [WebTemplateRegistry sharedRegistry];
+	NSString* name = froth_str(@"%@.email", templateName);
+	WebTemplateEntry* entry = [registry entryForName:name];
+	if(!entry) {
+		entry = [registry loadTemplateNamed:name atPath:templatePath];
+	}
+	return entry;
+}
+
+/*
+	Email templates use the application's matcher like views, so the compiled templates in the registry match it
+ */
+static MGTemplateEngine* emailTemplateEngine() {
+	MGTemplateEngine* engine = [MGTemplateEngine templateEngine];
+	[engine setDelegate:engine];
+	[engine setMatcher:[[[[WebTemplateEnginePool matcherClass] alloc] initWithTemplateEngine:engine] autorelease]];
+	return engine;
+}
+
 @implementation WebMailer
 
 + (void)sendEmailWithTemplate:(NSString*)templateName 
@@ -88,16 +111,15 @@
 	if(!templatePath) {
 		froth_exception(@"WebMailerException", froth_str(@"No template with name %@[.email] found in webApp bundle", templateName));
 	}
-	NSString* template = [NSString stringWithContentsOfFile:templatePath encoding:NSUTF8StringEncoding error:nil];
-	if(!template) {
+	WebTemplateEntry* template = emailTemplateEntry(templateName, templatePath);
+	if(![template string]) {
 		froth_exception(@"WebMailerException", froth_str(@"Unable to load email template %@[.email] - with unknown reason", templateName));
 	}
 	
-	MGTemplateEngine* engine = [MGTemplateEngine templateEngine];
-	[engine setDelegate:engine];
-	[engine setMatcher:[AGRegexTemplateMatcher matcherWithTemplateEngine:engine]];
+	MGTemplateEngine* engine = emailTemplateEngine();
 	
-	NSString* bodyStr = [engine processTemplate:template withVariables:templData];
+	MGCompiledTemplate* compiled = [[WebTemplateRegistry sharedRegistry] compiledTemplateForEntry:template engine:engine];
+	NSString* bodyStr = [engine processCompiledTemplate:compiled withVariables:templData];
 	if(!bodyStr) {
 		froth_exception(@"WebMailerException", @"And error occred processing the email template");
 	}
@@ -187,16 +209,15 @@
 	if(!templatePath) {
 		froth_exception(@"WebMailerException", froth_str(@"No template with name %@.email found in webApp bundle", templateName));
 	}
-	NSString* template = [NSString stringWithContentsOfFile:templatePath encoding:NSUTF8StringEncoding error:nil];
-	if(!template) {
+	WebTemplateEntry* template = emailTemplateEntry(templateName, templatePath);
+	if(![template string]) {
 		froth_exception(@"WebMailerException", froth_str(@"Unable to load email template %@.email - with unknown reason", templateName));
 	}
 	
-	MGTemplateEngine* engine = [MGTemplateEngine templateEngine];
-	[engine setDelegate:engine];
-	[engine setMatcher:[AGRegexTemplateMatcher matcherWithTemplateEngine:engine]];
+	MGTemplateEngine* engine = emailTemplateEngine();
 	
-	NSString* bodyStr = [engine processTemplate:template withVariables:templData];
+	MGCompiledTemplate* compiled = [[WebTemplateRegistry sharedRegistry] compiledTemplateForEntry:template engine:engine];
+	NSString* bodyStr = [engine processCompiledTemplate:compiled withVariables:templData];
 	if(!bodyStr) {
 		froth_exception(@"WebMailerException", @"And error occred processing the email template");
 	}
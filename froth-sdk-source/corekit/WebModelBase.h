@@ -28,6 +28,7 @@
 //	OTHER DEALINGS IN THE SOFTWARE.
 
 #import <Foundation/Foundation.h>
+#import "WKJsonWriter.h"
 
 @class WebRequest;
 
@@ -334,6 +335,14 @@
 
 @end
 
+/*!
+	\brief	JSON serialization. Models write their fields straight to a WKJsonWriter, values without a custom accessor are
+			read from the model's data without building the -dictionaryRepresentation. Subclasses that override 
+			-dictionaryRepresentation or -proxyForJson are written from those instead.
+ */
+@interface WebModelBase (JSON) <WKJsonWriting>
+@end
+
 /*!
 	\brief Provides a WebModelBase proxy object for doing isEqual:other object based on uids
 	\detail
@@ -44,6 +44,8 @@
 #import <objc/objc.h>
 #endif
 
+#include <pthread.h>
+
 
 
 @implementation WebModelBase
@@ -626,11 +628,98 @@ static id findFirstByMethodImp(id self, SEL _cmd, id value1) {
 
 @end
 
+static pthread_mutex_t kJsonKeysLock = PTHREAD_MUTEX_INITIALIZER;
+static NSMutableDictionary* kJsonDirectKeys = nil;
+
+/* 
+	The persistable keys that key value coding reads from m_data, those without an accessor method or instance variable
+	in the model class. Cached per class.
+ */
+static NSSet* jsonDirectKeysForClass(Class modelClass) {
+	NSString* className = NSStringFromClass(modelClass);
+	
+	pthread_mutex_lock(&kJsonKeysLock);
+	NSSet* directKeys = [[kJsonDirectKeys objectForKey:className] retain];
+	pthread_mutex_unlock(&kJsonKeysLock);
+	if(directKeys) {
+		return [directKeys autorelease];
+	}
+	
+	NSMutableSet* keys = [NSMutableSet set];
+	for(NSString* key in [modelClass allPersistableKeys]) {
+		NSString* capitalized = [key firstLetterCaptialized];
+		if([modelClass instancesRespondToSelector:NSSelectorFromString(key)] ||
+		   [modelClass instancesRespondToSelector:NSSelectorFromString(froth_str(@"get%@", capitalized))] ||
+		   [modelClass instancesRespondToSelector:NSSelectorFromString(froth_str(@"is%@", capitalized))] ||
+		   [modelClass instancesRespondToSelector:NSSelectorFromString(froth_str(@"_%@", key))] ||
+		   class_getInstanceVariable(modelClass, [key UTF8String]) ||
+		   class_getInstanceVariable(modelClass, [froth_str(@"_%@", key) UTF8String])) {
+			continue;
+		}
+		[keys addObject:key];
+	}
+	
+	pthread_mutex_lock(&kJsonKeysLock);
+	if(!kJsonDirectKeys) {
+		kJsonDirectKeys = [[NSMutableDictionary alloc] init];
+	}
+	[kJsonDirectKeys setObject:keys forKey:className];
+	pthread_mutex_unlock(&kJsonKeysLock);
+	return keys;
+}
+
 @implementation WebModelBase (JSON)
 
 #pragma mark -
 #pragma mark JSON and Serailization
 
+/* Writes what -dictionaryRepresentation would contain */
+- (BOOL)writeJsonWithWriter:(WKJsonWriter*)writer {
+	Class modelClass = [self class];
+	if([modelClass instanceMethodForSelector:@selector(dictionaryRepresentation)] != [WebModelBase instanceMethodForSelector:@selector(dictionaryRepresentation)] ||
+	   [modelClass instanceMethodForSelector:@selector(proxyForJson)] != [WebModelBase instanceMethodForSelector:@selector(proxyForJson)]) {
+		return [writer writeValue:[self proxyForJson]];
+	}
+	
+	if(![writer beginObject]) {
+		return NO;
+	}
+	
+	NSArray* keys = [modelClass allPersistableKeys];
+	if(!keys.count) {
+		NSString* uidValue = self.uid;
+		for(NSString* key in m_data) {
+			if(uidValue && [key isEqualToString:@"uid"]) continue;
+			if(![writer writeValue:[m_data objectForKey:key] forKey:key]) {
+				return NO;
+			}
+		}
+		if(uidValue && ![writer writeValue:uidValue forKey:@"uid"]) {
+			return NO;
+		}
+		[writer endObject];
+		return YES;
+	}
+	
+	NSSet* directKeys = jsonDirectKeysForClass(modelClass);
+	NSString* identName = [modelClass identifierName];
+	for(NSString* key in keys) {
+		if([key isEqualToString:identName]) continue;
+		
+		id value = ([directKeys containsObject:key]) ? [m_data objectForKey:key] : [self valueForKey:key];
+		if(value && ![writer writeValue:value forKey:key]) {
+			return NO;
+		}
+	}
+	id identValue = [self valueForKey:identName];
+	if(identValue && ![writer writeValue:identValue forKey:identName]) {
+		return NO;
+	}
+	
+	[writer endObject];
+	return YES;
+}
+
 - (NSDictionary*)dictionaryRepresentation {
 	NSArray* keys = [[self class] allPersistableKeys];
 	
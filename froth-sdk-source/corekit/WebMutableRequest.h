@@ -42,4 +42,7 @@
 //Used by httpd connectors if needed
 - (void)setInternalRequestPointer:(void*)reqPointer;
 
+//Set by connectors when the connection closes before the response is sent
+- (void)setConnectionClosed:(BOOL)closed;
+
 @end
@@ -120,4 +120,8 @@ NSDictionary* cookiesFromHeaders(NSDictionary* headers) {
 	req_p = reqPointer;
 }
 
+- (void)setConnectionClosed:(BOOL)closed {
+	connectionClosed = closed;
+}
+
 @end
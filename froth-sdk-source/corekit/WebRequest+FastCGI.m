@@ -35,56 +35,77 @@
 
 @implementation WebMutableRequest (FastCGI)
 
+/* Returns a retained string, falling back to latin1 for bytes that are not valid utf8 so we never return nil. */
+static NSString* headerNewString(const char* bytes, size_t length) {
+	NSString* str = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+	if(!str) {
+		str = [[NSString alloc] initWithBytes:bytes length:length encoding:NSISOLatin1StringEncoding];
+	}
+	return str;
+}
+
+static NSDictionary* cookiesFromHeader(const char* value) {
+	NSMutableDictionary* c = [NSMutableDictionary dictionary];
+	
+	const char* p = value;
+	while(*p) {
+		while(*p == ' ' || *p == ';') p++;
+		
+		const char* end = strchr(p, ';');
+		if(!end) end = p + strlen(p);
+		
+		const char* sep = memchr(p, '=', end - p);
+		if(sep) {
+			NSString* k = [[NSString alloc] initWithBytes:p length:sep-p encoding:NSUTF8StringEncoding];
+			NSString* v = [[NSString alloc] initWithBytes:sep+1 length:end-(sep+1) encoding:NSUTF8StringEncoding];
+			if(k && v) {
+				//Duplicate cookie names are kept as an array, same as the httpd connector
+				id existing = [c objectForKey:k];
+				if(!existing) {
+					[c setObject:v forKey:k];
+				} else if([existing isKindOfClass:[NSMutableArray class]]) {
+					[(NSMutableArray*)existing addObject:v];
+				} else {
+					[c setObject:[NSMutableArray arrayWithObjects:existing, v, nil] forKey:k];
+				}
+			}
+			[k release];
+			[v release];
+		}
+		p = end;
+	}
+	return c;
+}
+
 - (void)setHTTPRequestPointer:(char**)env {
 	char **p;
 	
-	NSMutableDictionary* e = [[NSMutableDictionary alloc] init];
-	NSMutableDictionary* c = [[NSMutableDictionary alloc] init];
+	NSMutableDictionary* e = [[NSMutableDictionary alloc] initWithCapacity:48];
 	
 	for(p=env; *p!=NULL; ++p) {
-		NSString *s = [[NSString alloc] initWithUTF8String:*p];
+		const char* option = *p;
 		
 		//For security purposes
-		NSRange sp = [s rangeOfString:@"="];
-		if(sp.location == NSNotFound) {
-			[e release], [c release];
-			froth_exception(@"BadEnvironmentException", [NSString stringWithFormat:@"Option \"%@\" does not contain field separator", [s autorelease]]);
+		const char* sep = strchr(option, '=');
+		if(sep == NULL) {
+			[e release];
+			froth_exception(@"BadEnvironmentException", [NSString stringWithFormat:@"Option \"%s\" does not contain field separator", option]);
 		}
 		
+		NSString* key = headerNewString(option, sep - option);
+		NSString* value = headerNewString(sep + 1, strlen(sep + 1));
+		[e setObject:value forKey:key];
+		[key release];
+		[value release];
+		
 		//Parse header values
-		NSString* value = nil;
-		if([s hasPrefix:@"HTTP_COOKIE="]) {
-			value = [s stringByReplacingOccurrencesOfString:@"HTTP_COOKIE=" withString:@""];
-			[e setObject:value forKey:@"HTTP_COOKIE"];
-			
-			NSArray* keyValues = [value componentsSeparatedByString:@"; "];
-			for(NSString* kv in keyValues) {
-				NSArray* parts = [kv componentsSeparatedByString:@"="];
-				[c setObject:[parts objectAtIndex:1] forKey:[parts objectAtIndex:0]];
-			}
-			cookies = [c retain];
-		} else {
-			
-			/*
-			 TODO: Apple Memory Leak Fix
-			 For some reason their is a leak in Apple's implemention of substringFromIndex: to
-			 Fix that we will do array spliting instead as it appears to have no leak... not ideal by any means...
-				
-			 [e setObject:[s substringFromIndex:sp.location+1] forKey:[s substringToIndex:sp.location]];
-			 */
-			
-			NSArray* parts = [s componentsSeparatedByString:@"="];
-			NSString* key = [parts objectAtIndex:0];
-			value = [s stringByReplacingOccurrencesOfString:[NSString stringWithFormat:@"%@=", key] withString:@""];
-			[e setObject:value forKey:key];
+		if(strncmp(option, "HTTP_COOKIE=", 12) == 0) {
+			[cookies release];
+			cookies = [cookiesFromHeader(sep + 1) retain];
 		}
-		[s release];
 	}
 	
-	headers = [e retain];
-	
-	[e release];
-	[c release];
+	headers = e;
 }
 
 @end
@@ -44,8 +44,9 @@
 				
 				<h3>POST/PUT Requests</h3>
 				For POST requests, -objectValue returns an object automatically decoded from the http request's body, be it xml,
-				json, html, x-www-form-urlencoded, etc. For post content the object returned from -objectValue will be a NSXMLElement, 
-				for json the result will be a NSDictionary. Text content will return as a NSString from the -objectValue method. 
+				json, html, x-www-form-urlencoded, etc. For xml content the object returned from -objectValue will be a NSDictionary 
+				decoded by WKXmlParser, for json the result will be a NSDictionary. Text content will return as a NSString from the 
+				-objectValue method. 
 				
 				WebRequest parses the data useing the following logic.<br>
 				- Checks the http contentType header with application/json or text/json, application/xml or text/xml and x-www-form-urlencoded.<br>
@@ -56,6 +57,7 @@
  
 				CHANGES:
 				- V0.5.0 -url is depreciated, use -uri instead
+				- xml bodies are decoded to Foundation objects by WKXmlParser instead of a NSXMLDocument
  */
 @interface WebRequest : NSObject {
 	NSString* uri;
@@ -72,6 +74,7 @@
 	NSDictionary* headers;
 	NSDictionary* cookies;
 	NSDictionary* query;
+	NSDictionary* queryValues;
 		
 	NSData* bodyDataValue;
 	id objectValue;
@@ -80,6 +83,10 @@
 	WebResponse* response;
 	
 	BOOL keepAlive;
+	BOOL connectionClosed;
+	
+	//Timing entries for the request, see -addTraceEntry:duration:
+	NSMutableArray* trace;
 	
 	//pointer to c request structure (Only currently HTTPd)
 	void* req_p;
@@ -151,6 +158,9 @@
 /*! \brief The request query ?this=that&here=their as a dictionary*/
 - (NSDictionary*)query;
 
+/*! \brief The request query with every value of repeated keys, ?tag=a&tag=b gives a NSArray for tag. */
+- (NSDictionary*)queryValues;
+
 /*! \brief Convenience method for accessing a cookie value with given key name, (uses request.cookies dictionary storage) */
 - (NSString*)valueForCookie:(NSString*)cookieName;
 
@@ -160,12 +170,27 @@
 /*! \brief Convenience method for returning environment variable for requestors ip address. */
 - (NSString*)ip;
 
+/*! 
+	\brief	Records a named timing for work done for the request, (ie each task in a WebTaskGroup). Thread safe.
+ */
+- (void)addTraceEntry:(NSString*)name duration:(NSTimeInterval)seconds;
+
+/*! \brief The timing entries for the request, each a dictionary with "name" and "duration" (NSNumber seconds) keys. */
+- (NSArray*)trace;
+
 /*! \brief Returns a generated response for the request. */
 - (WebResponse*)response;
 
 /*! \brief The internal request pointer */
 - (void*)internalRequestPointer;
 
+/*! 
+	\brief	If the client disconnected, or the connector timed out the connection, before the response was sent. 
+ 
+	Work for a deferred response can check this to stop early, the response will be discarded.
+ */
+- (BOOL)isConnectionClosed;
+
 /*!
 	\brief	[Not Implemented] If the request should be kept alive for asynchronous communications.
  
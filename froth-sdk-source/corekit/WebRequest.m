@@ -27,7 +27,7 @@
 //	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 //	OTHER DEALINGS IN THE SOFTWARE.
 #import "WebRequest.h"
-#import "DDXML.h"
+#import "WKXmlParser.h"
 #import "JSON.h"
 #import "NSDictionary+Query.h"
 #import "Froth+Defines.h"
@@ -62,6 +62,7 @@
 	[method release]; method = nil;
 	[cookies release]; cookies = nil;
 	[query release]; query = nil;
+	[queryValues release]; queryValues = nil;
 	[headers release]; headers = nil;
 	[extension release]; extension = nil;
 	
@@ -75,6 +76,7 @@
 	[params release]; params = nil;
 	[session release]; session = nil;
 	[response release]; response = nil;
+	[trace release]; trace = nil;
 	
 	[super dealloc];
 }
@@ -204,6 +206,17 @@
 	return query;
 }
 
+- (NSDictionary*)queryValues {
+	if(queryValues == nil) {
+		NSString* qStr = [self queryString];
+		if(!qStr) {
+			qStr = [self.headers valueForKey:@"QUERY_STRING"];
+		}
+		queryValues = [[NSDictionary multiValueDictionaryWithQuery:qStr] retain];
+	}
+	return queryValues;
+}
+
 #pragma mark -
 #pragma mark Body and Deseralization
 
@@ -223,25 +236,24 @@
 		NSString* contentType = [self contentType];
 		NSString* ext = [self extension];
 
-		NSString* bodyString = [[NSString alloc] initWithData:self.bodyDataValue encoding:NSUTF8StringEncoding];
+		//JSON and XML are parsed from the body's bytes, the other types need it as a string
+		NSString* bodyString = nil;
 		
 		if([ext isEqualToString:@"json"] || [contentType hasPrefix:@"application/json"] || [contentType hasPrefix:@"text/json"]) {
-			objectValue = [[bodyString JSONValue] retain];
+			objectValue = [[self.bodyDataValue JSONValue] retain];
 		} else if([ext isEqualToString:@"xml"] || [contentType hasPrefix:@"application/xml"] || [contentType hasPrefix:@"text/xml"]) {
-			
-			NSError* error = nil;
-			objectValue = [[NSXMLDocument alloc] initWithXMLString:bodyString options:0 error:&error];
-			if(error) {
-				objectValue = [[NSXMLElement alloc] initWithXMLString:bodyString error:nil];
-				[error release];
+			WKXmlParser* parser = [[WKXmlParser alloc] init];
+			objectValue = [[parser objectWithData:self.bodyDataValue] retain];
+			if(!objectValue) {
+				NSLog(@"+++ [[ERROR]] WebRequest -objectValue could not parse the xml body: %@", [parser errorDescription]);
 			}
-			
+			[parser release];
 		} else if([contentType hasPrefix:@"application/x-www-form-urlencoded"] || 
 				  [contentType hasPrefix:@"text/x-www-form-urlencoded"] ||
 				  [contentType hasPrefix:@"x-www-form-urlencoded"]) {
-			//TODO: parse into dictionary
-			objectValue = [[NSDictionary dictionaryWithPostForm:bodyString] retain];
+			objectValue = [[NSDictionary dictionaryWithPostFormData:self.bodyDataValue] retain];
 		} else if([contentType hasPrefix:@"text/plain"] || [contentType hasPrefix:@"text/html"] || [contentType hasPrefix:@"text/richtext"]) {
+			bodyString = [[NSString alloc] initWithData:self.bodyDataValue encoding:NSUTF8StringEncoding];
 			objectValue = [bodyString retain];
 		} else {
 			objectValue = nil;
@@ -336,6 +348,26 @@
 	return ip;
 }
 
+#pragma mark -
+#pragma mark Tracing
+
+- (void)addTraceEntry:(NSString*)name duration:(NSTimeInterval)seconds {
+	NSDictionary* entry = [NSDictionary dictionaryWithObjectsAndKeys:name, @"name", [NSNumber numberWithDouble:seconds], @"duration", nil];
+	@synchronized(self) {
+		if(!trace) {
+			trace = [[NSMutableArray alloc] init];
+		}
+		[trace addObject:entry];
+	}
+}
+
+- (NSArray*)trace {
+	@synchronized(self) {
+		return [NSArray arrayWithArray:trace];
+	}
+	return nil;
+}
+
 #pragma mark -
 
 - (WebResponse*)response {
@@ -346,6 +378,10 @@
 	return req_p;
 }
 
+- (BOOL)isConnectionClosed {
+	return connectionClosed;
+}
+
 - (BOOL)keepAlive {
 	return keepAlive;
 }
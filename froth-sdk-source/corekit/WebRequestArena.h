@@ -0,0 +1,94 @@
+//
+//  WebRequestArena.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+
+/*! \brief Allocation counters for a single request, see -[WebRequestArena stats] */
+typedef struct {
+	NSUInteger allocations;	//Blocks handed out by the arena
+	NSUInteger bytes;		//Bytes handed out by the arena
+	NSUInteger chunks;		//Calls to malloc made by the arena to grow
+} WebArenaStats;
+
+/*!
+	\brief	A per-request bump allocator for scratch buffers used while the framework decodes a request.
+ 
+	When enabled, connectors create an arena for each worker thread and call +beginRequest and +endRequest around each
+	request. Memory from the arena is never freed individually, the whole arena is reset when the request ends. The first 
+	chunk is kept between requests, so in the common case a request makes no mallocs for its arena allocations at all.
+ 
+	The arena is opt-in with the Info.plist key <i>froth_request_arena</i> (BOOL).
+ 
+	Only query and form decoding takes its scratch buffers (those too large for the stack) from the arena, through 
+	WebArenaMalloc(). No objects are backed by arena memory, strings and other objects handed to application code are 
+	normal objects that can be retained past the request.
+ */
+@interface WebRequestArena : NSObject {
+	struct WebArenaChunk* m_first;
+	struct WebArenaChunk* m_current;
+	WebArenaStats m_stats;
+	BOOL m_inRequest;
+}
+
+/*! \brief If the request arena is enabled for the application (Info.plist froth_request_arena) */
++ (BOOL)isEnabled;
+
+/*! 
+	\brief	The arena for the request in progress on the current thread.
+	\return nil if arenas are disabled or the thread is not handling a request. 
+ */
++ (WebRequestArena*)currentArena;
+
+/*! \brief Called by connectors before a request is handled, does nothing if arenas are disabled. */
++ (void)beginRequest;
+
+/*! \brief Called by connectors once the request has been handled. Releases all memory allocated during the request. */
++ (void)endRequest;
+
+/*! \brief Returns size bytes of 8 byte aligned memory that is valid until the request ends. */
+- (void*)allocate:(size_t)size;
+
+/*! \brief Copies length bytes into the arena with a terminating NULL. */
+- (char*)copyBytes:(const void*)bytes length:(size_t)length;
+
+/*! \brief Counters since the last +beginRequest */
+- (WebArenaStats)stats;
+
+/*! \brief The stats as a short string for request logging */
+- (NSString*)statsDescription;
+
+@end
+
+/*!
+	\brief	Returns size bytes of temporary memory from the current request arena, or malloc if there is no arena.
+			Memory must be released with WebArenaFree().
+ */
+void* WebArenaMalloc(size_t size);
+
+/*! \brief Releases memory from WebArenaMalloc(), does nothing for memory owned by the request arena. */
+void WebArenaFree(void* ptr);
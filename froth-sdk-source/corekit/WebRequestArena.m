@@ -0,0 +1,216 @@
+//
+//  WebRequestArena.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WebRequestArena.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define kArenaFirstChunkSize	(16*1024)
+#define kArenaAlignment			8
+
+struct WebArenaChunk {
+	struct WebArenaChunk* next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+static struct WebArenaChunk* arenaChunkCreate(size_t size) {
+	struct WebArenaChunk* chunk = malloc(sizeof(struct WebArenaChunk) + size);
+	if(!chunk) {
+		[NSException raise:NSMallocException format:@"WebRequestArena unable to allocate chunk of size [%lu]", (unsigned long)size];
+	}
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
+
+static BOOL arenaOwnsPointer(struct WebArenaChunk* chunk, void* ptr) {
+	for(; chunk != NULL; chunk = chunk->next) {
+		if((char*)ptr >= chunk->data && (char*)ptr < chunk->data + chunk->size) {
+			return YES;
+		}
+	}
+	return NO;
+}
+
+@interface WebRequestArena (Private)
+- (BOOL)_ownsPointer:(void*)ptr;
+@end
+
+#pragma mark -
+#pragma mark Thread Arenas
+
+static pthread_once_t kArenaSetupOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t kArenaThreadKey;
+static BOOL kArenaEnabled = NO;
+
+static void arenaThreadDestructor(void* arena) {
+	[(WebRequestArena*)arena release];
+}
+
+static void arenaSetup(void) {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	kArenaEnabled = [[[[NSBundle mainBundle] infoDictionary] valueForKey:@"froth_request_arena"] boolValue];
+	pthread_key_create(&kArenaThreadKey, arenaThreadDestructor);
+	[pool drain];
+}
+
+@implementation WebRequestArena
+
++ (BOOL)isEnabled {
+	pthread_once(&kArenaSetupOnce, arenaSetup);
+	return kArenaEnabled;
+}
+
++ (WebRequestArena*)currentArena {
+	if(![self isEnabled]) return nil;
+	
+	WebRequestArena* arena = pthread_getspecific(kArenaThreadKey);
+	return (arena && arena->m_inRequest) ? arena : nil;
+}
+
++ (void)beginRequest {
+	if(![self isEnabled]) return;
+	
+	WebRequestArena* arena = pthread_getspecific(kArenaThreadKey);
+	if(!arena) {
+		arena = [[WebRequestArena alloc] init];	//Released by the thread destructor
+		pthread_setspecific(kArenaThreadKey, arena);
+	}
+	memset(&arena->m_stats, 0, sizeof(WebArenaStats));
+	arena->m_inRequest = YES;
+}
+
++ (void)endRequest {
+	if(![self isEnabled]) return;
+	
+	WebRequestArena* arena = pthread_getspecific(kArenaThreadKey);
+	if(!arena) return;
+	
+	//Keep the first chunk for the next request
+	struct WebArenaChunk* chunk = arena->m_first->next;
+	while(chunk) {
+		struct WebArenaChunk* next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	arena->m_first->next = NULL;
+	arena->m_first->used = 0;
+	arena->m_current = arena->m_first;
+	arena->m_inRequest = NO;
+}
+
+- (id)init {
+	if(self = [super init]) {
+		m_first = arenaChunkCreate(kArenaFirstChunkSize);
+		m_current = m_first;
+	}
+	return self;
+}
+
+- (void)dealloc {
+	struct WebArenaChunk* chunk = m_first;
+	while(chunk) {
+		struct WebArenaChunk* next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	[super dealloc];
+}
+
+#pragma mark -
+#pragma mark Allocation
+
+- (void*)allocate:(size_t)size {
+	size_t aligned = (size + (kArenaAlignment-1)) & ~(size_t)(kArenaAlignment-1);
+	
+	if(m_current->size - m_current->used < aligned) {
+		size_t chunkSize = m_current->size * 2;
+		if(chunkSize < aligned) {
+			chunkSize = aligned;
+		}
+		struct WebArenaChunk* chunk = arenaChunkCreate(chunkSize);
+		m_current->next = chunk;
+		m_current = chunk;
+		m_stats.chunks++;
+	}
+	
+	void* ptr = m_current->data + m_current->used;
+	m_current->used += aligned;
+	
+	m_stats.allocations++;
+	m_stats.bytes += size;
+	return ptr;
+}
+
+- (char*)copyBytes:(const void*)bytes length:(size_t)length {
+	char* ptr = [self allocate:length+1];
+	memcpy(ptr, bytes, length);
+	ptr[length] = '\0';
+	return ptr;
+}
+
+- (BOOL)_ownsPointer:(void*)ptr {
+	return arenaOwnsPointer(m_first, ptr);
+}
+
+- (WebArenaStats)stats {
+	return m_stats;
+}
+
+- (NSString*)statsDescription {
+	return [NSString stringWithFormat:@"arena allocs [%lu] bytes [%lu] mallocs [%lu]", 
+			(unsigned long)m_stats.allocations, (unsigned long)m_stats.bytes, (unsigned long)m_stats.chunks];
+}
+
+@end
+
+#pragma mark -
+#pragma mark C Helpers
+
+void* WebArenaMalloc(size_t size) {
+	WebRequestArena* arena = [WebRequestArena currentArena];
+	if(arena) {
+		return [arena allocate:size];
+	}
+	return malloc(size);
+}
+
+void WebArenaFree(void* ptr) {
+	if(!ptr) return;
+	
+	WebRequestArena* arena = [WebRequestArena currentArena];
+	if(arena && [arena _ownsPointer:ptr]) {
+		return;
+	}
+	free(ptr);
+}
@@ -28,9 +28,18 @@
 //	OTHER DEALINGS IN THE SOFTWARE.
 
 #import <Foundation/Foundation.h>
+#import <sys/uio.h>
 
 @class WebRequest;
 
+/*!
+	\brief	Writes the current time as an rfc1123 http date (ie "Sun, 06 Nov 1994 08:49:37 GMT") into buf.
+	
+	The string is only formatted once per second and shared between threads. buf must be at least 32 bytes.
+	\return The length of the date string written, not including the terminating NULL.
+ */
+size_t WebResponseCopyHTTPDate(char* buf);
+
 /*!
 	\brief Provides a final wrapper on an http response 
  */
@@ -38,6 +47,9 @@
 	NSUInteger code;
 	NSMutableDictionary* headers;
 	NSData* body;
+	
+	//Serialized header lines, rebuilt by -getIOVectors:count:
+	NSMutableData* m_headerBlock;
 }
 @property (nonatomic, assign) NSUInteger code;
 @property (nonatomic, retain) NSMutableDictionary* headers;
@@ -62,6 +74,12 @@
 */				
 + (WebResponse*)jsonResponseWithBody:(NSString*)bodyString;
 
+/*!
+	\brief		A json response with the object written straight to the body by WKJsonWriter.
+	\param		object Any object WKJsonWriter can write, ie a NSDictionary, NSArray or WebModelBase.
+ */
++ (WebResponse*)jsonResponseWithObject:(id)object;
+
 + (WebResponse*)xmlResponse;
 
 /*!
@@ -109,6 +127,19 @@
 				domain:(NSString*)domain
 				  path:(NSString*)path;
 
+/*!
+	\brief		Serializes the response for a gathered write to the connection.
+ 
+				iov is filled with the encoded header block followed by the body, the body is referenced and not copied.
+				The memory referenced is owned by the response and is valid until the response is released or this is called again.
+	\param		iov Array of at least 2 vectors.
+	\return		The number of vectors filled.
+ */
+- (int)getIOVectors:(struct iovec*)iov count:(int)count;
+
+/*!
+	\brief		The complete header block and body as a single NULL terminated buffer. Connectors should prefer -getIOVectors:count:
+ */
 - (NSData *)dump;
 
 @end
@@ -29,6 +29,99 @@
 
 #import "WebResponse.h"
 #import "WebRequest.h"
+#import "WKJsonWriter.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#pragma mark -
+#pragma mark Http Dates
+
+static const char* kHTTPDateDays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static const char* kHTTPDateMonths[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+/* Locale independent, so we do not need a date formatter. Cookies use the older dashed (Netscape) form. */
+static size_t formatHTTPDate(time_t time, char* buf, size_t length, BOOL cookieStyle) {
+	struct tm tm;
+	gmtime_r(&time, &tm);
+	int written = snprintf(buf, length, cookieStyle ? "%s, %02d-%s-%04d %02d:%02d:%02d GMT" : "%s, %02d %s %04d %02d:%02d:%02d GMT",
+						   kHTTPDateDays[tm.tm_wday], tm.tm_mday, kHTTPDateMonths[tm.tm_mon], tm.tm_year + 1900,
+						   tm.tm_hour, tm.tm_min, tm.tm_sec);
+	return (written > 0) ? (size_t)written : 0;
+}
+
+static pthread_mutex_t kHTTPDateLock = PTHREAD_MUTEX_INITIALIZER;
+static time_t kHTTPDateSecond = 0;
+static char kHTTPDateString[32];
+static size_t kHTTPDateLength = 0;
+
+size_t WebResponseCopyHTTPDate(char* buf) {
+	time_t now = time(NULL);
+	
+	pthread_mutex_lock(&kHTTPDateLock);
+	if(now != kHTTPDateSecond) {
+		kHTTPDateLength = formatHTTPDate(now, kHTTPDateString, sizeof(kHTTPDateString), NO);
+		kHTTPDateSecond = now;
+	}
+	memcpy(buf, kHTTPDateString, kHTTPDateLength + 1);
+	size_t length = kHTTPDateLength;
+	pthread_mutex_unlock(&kHTTPDateLock);
+	
+	return length;
+}
+
+#pragma mark -
+#pragma mark Header Encoding
+
+/* 
+	The "Name: " prefixes for headers we send on almost every response are encoded once for the life of the app.
+ */
+static pthread_once_t kEncodedHeaderNamesOnce = PTHREAD_ONCE_INIT;
+static NSDictionary* kEncodedHeaderNames = nil;
+
+static void initEncodedHeaderNames(void) {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	
+	const char* names[] = { "Content-Type", "Set-Cookie", "Location", "Cache-Control", "Content-Length", 
+							"Content-Encoding", "Expires", "Last-Modified", "ETag", "Pragma", "Status", NULL };
+	NSMutableDictionary* encoded = [NSMutableDictionary dictionary];
+	for(int i=0; names[i] != NULL; i++) {
+		char prefix[64];
+		int length = snprintf(prefix, sizeof(prefix), "%s: ", names[i]);
+		[encoded setObject:[NSData dataWithBytes:prefix length:length] forKey:[NSString stringWithUTF8String:names[i]]];
+	}
+	kEncodedHeaderNames = [encoded copy];
+	
+	[pool drain];
+}
+
+static void appendUTF8(NSMutableData* data, NSString* string) {
+	NSUInteger maxLength = [string maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+	NSUInteger offset = [data length];
+	NSUInteger used = 0;
+	
+	[data setLength:offset + maxLength];
+	[string getBytes:(char*)[data mutableBytes] + offset 
+		   maxLength:maxLength 
+		  usedLength:&used 
+			encoding:NSUTF8StringEncoding 
+			 options:0 
+			   range:NSMakeRange(0, [string length]) 
+	  remainingRange:NULL];
+	[data setLength:offset + used];
+}
+
+static void appendHeaderLine(NSMutableData* data, NSString* key, NSString* value) {
+	NSData* encodedName = [kEncodedHeaderNames objectForKey:key];
+	if(encodedName) {
+		[data appendData:encodedName];
+	} else {
+		appendUTF8(data, key);
+		[data appendBytes:": " length:2];
+	}
+	appendUTF8(data, value);
+	[data appendBytes:"\n" length:1];
+}
 
 @implementation WebResponse
 @synthesize code;
@@ -38,6 +131,7 @@
 - (void)dealloc {
 	[headers release];
 	[body release];
+	[m_headerBlock release];
 	[super dealloc];
 }
 
@@ -101,6 +195,17 @@
 	return [res autorelease];
 }
 
++ (WebResponse*)jsonResponseWithObject:(id)object {
+	WebResponse* res = [[self alloc] initWithCode:200 contentType:@"text/x-json"];
+	WKJsonWriter* writer = [[WKJsonWriter alloc] init];
+	res.body = [writer dataWithObject:object];
+	if(!res.body) {
+		NSLog(@"+++ [[ERROR]] WebResponse: Unable to write JSON response %@", [writer errorTrace]);
+	}
+	[writer release];
+	return [res autorelease];
+}
+
 + (WebResponse*)xmlResponse {
 	return [[[self alloc] initWithCode:200 contentType:@"text/xml"] autorelease];
 }
@@ -133,16 +238,11 @@
 	NSMutableString* cs = [NSMutableString string];
 	[cs appendFormat:@"%@=%@", key, value];
 	
-#ifdef __APPLE__
 	if(expireDate) {
-		NSDateFormatter* formatter = [[NSDateFormatter alloc] init];
-		[formatter setDateFormat:@"EEE, dd-MM-yyyy HH:mm:ss zzz"];
-		[formatter setTimeZone:[NSTimeZone timeZoneForSecondsFromGMT:0.0]];
-		NSString* dateStr = [formatter stringFromDate:expireDate];
-		[cs appendFormat:@"; expires=%@", dateStr];
-		[formatter release];
+		char dateStr[32];
+		formatHTTPDate((time_t)[expireDate timeIntervalSince1970], dateStr, sizeof(dateStr), YES);
+		[cs appendFormat:@"; expires=%s", dateStr];
 	}
-#endif
 	
 	if(domain) {
 		[cs appendFormat:@"; domain=%@", domain];
@@ -158,7 +258,7 @@
 	
 	NSArray* array = nil;
 	id cookies = [[self headers] objectForKey:@"Set-Cookie"];
-	if(cookies && [cookies isKindOfClass:[NSArray array]]) {
+	if(cookies && [cookies isKindOfClass:[NSArray class]]) {
 		array = [(NSArray*)cookies arrayByAddingObject:cs];
 	} else if(cookies) {
 		array = [NSArray arrayWithObjects:cookies, cs, nil];
@@ -178,42 +278,65 @@
 	}
 }
 
-- (NSData *)dump {
+- (int)getIOVectors:(struct iovec*)iov count:(int)count {
+	if(count < 1) return 0;
+	
+	pthread_once(&kEncodedHeaderNamesOnce, initEncodedHeaderNames);
 	[self _prepareHeaders];
-	NSMutableData *d = [[NSMutableData alloc] init];
+	
+	if(!m_headerBlock) {
+		m_headerBlock = [[NSMutableData alloc] initWithCapacity:512];
+	} else {
+		[m_headerBlock setLength:0];
+	}
+	
 	for(NSString *k in headers) {
 		id headerObject = [headers objectForKey:k];
 		
 		//Provides support for multiple header with same header name (ie Set-Cookie: headers)
 		if([headerObject isKindOfClass:[NSArray class]]) {
 			for(NSString* nValue in headerObject) {
-				const char *ck = [k UTF8String];
-				[d appendBytes:ck length:strlen(ck)];
-				[d appendBytes:": " length:2];
-				const char *cv = [nValue UTF8String];
-				[d appendBytes:cv length:strlen(cv)];
-				[d appendBytes:"\n" length:1];
+				appendHeaderLine(m_headerBlock, k, nValue);
 			}
 		} else {
-			const char *ck = [k UTF8String];
-			[d appendBytes:ck length:strlen(ck)];
-			[d appendBytes:": " length:2];
-			const char *cv = [[headers objectForKey:k] UTF8String];
-			[d appendBytes:cv length:strlen(cv)];
-			[d appendBytes:"\n" length:1];
+			appendHeaderLine(m_headerBlock, k, headerObject);
 		}
 	}
-	[d appendBytes:"\n" length:1];
-	//const char *cb = [body UTF8String];
-	//if(cb) {
-	//	[d appendBytes:cb length:strlen(cb)];
-	//}
+	
+	if(![headers objectForKey:@"Date"]) {
+		char date[32];
+		size_t length = WebResponseCopyHTTPDate(date);
+		[m_headerBlock appendBytes:"Date: " length:6];
+		[m_headerBlock appendBytes:date length:length];
+		[m_headerBlock appendBytes:"\n" length:1];
+	}
+	[m_headerBlock appendBytes:"\n" length:1];
+	
+	iov[0].iov_base = [m_headerBlock mutableBytes];
+	iov[0].iov_len = [m_headerBlock length];
 	
 	//HEAD requests do not return request body.
-	if([self body] != nil) {
-		[d appendData:body];
+	if(count > 1 && [body length] > 0) {
+		iov[1].iov_base = (void*)[body bytes];
+		iov[1].iov_len = [body length];
+		return 2;
+	}
+	return 1;
+}
+
+- (NSData *)dump {
+	struct iovec iov[2];
+	int count = [self getIOVectors:iov count:2];
+	
+	size_t total = 1;
+	for(int i=0; i<count; i++) {
+		total += iov[i].iov_len;
+	}
+	
+	NSMutableData *d = [[NSMutableData alloc] initWithCapacity:total];
+	for(int i=0; i<count; i++) {
+		[d appendBytes:iov[i].iov_base length:iov[i].iov_len];
 	}
-		
 	[d appendBytes:"\0" length:1];
 	return [d autorelease];
 }
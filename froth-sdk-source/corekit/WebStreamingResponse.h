@@ -0,0 +1,103 @@
+//
+//  WebStreamingResponse.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "WebResponse.h"
+#import "MGTemplateEngine.h"
+
+@class WebActionView;
+@class WebLayoutView;
+
+/*!
+	\brief	Renders an action view, or a layout wrapping an action view, into a template sink or to utf8 data.
+ 
+	When a layout's <i>TemplateResult</i> is a WebTemplateRender the action's output is streamed in place, after the layout
+	output that comes before it (ie the &lt;head&gt;) has been flushed to the client.
+ */
+@interface WebTemplateRender : NSObject <MGTemplateRenderable> {
+	WebActionView* m_view;
+	WebLayoutView* m_layout;
+	WebTemplateRender* m_actionRender;
+	
+	NSData* m_templateData;
+	id m_actionResponse;
+	id m_controller;
+	WebRequest* m_request;
+	id m_application;
+}
+
+/*! \brief Renders templateData, from -[WebActionView templateDataForController:], with the action's response. */
++ (WebTemplateRender*)renderWithActionView:(WebActionView*)view 
+							  templateData:(NSData*)templateData 
+							actionResponse:(id)actionResponse 
+								controller:(id)controller 
+								   request:(WebRequest*)request 
+							   application:(id)application;
+
+/*! \brief Renders the layout with actionRender as its TemplateResult. */
++ (WebTemplateRender*)renderWithLayoutView:(WebLayoutView*)layout 
+							  actionRender:(WebTemplateRender*)actionRender 
+								controller:(id)controller 
+								   request:(WebRequest*)request 
+							   application:(id)application;
+
+@end
+
+/*!
+	\brief	A response whose body is rendered when the connector writes it.
+ 
+	Connectors that support streaming (WebFastCgiController) write the headers first and then have the renderer write 
+	straight to the connection, so the client receives the start of the page while the rest of it is still rendering. 
+	Template output is sent in chunks of about 16KB, or sooner at a <i>{% flush %}</i> marker or when the layout reaches 
+	the action's output. Other connectors get the fully rendered body from -body.
+ 
+	WebApplication returns a streaming response for template rendered actions when the Info.plist key 
+	<i>froth_stream_templates</i> is YES (defualt NO) and neither the view or layout customize their output. Since the headers 
+	are sent before the body is rendered, a streamed response has no Content-Length and headers set from templates have no effect.
+ */
+@interface WebStreamingResponse : WebResponse {
+	id <MGTemplateRenderable> m_renderer;
+	BOOL m_rendered;
+}
+
+/*! \brief If WebApplication should stream template rendered responses, Info.plist key <i>froth_stream_templates</i>. */
++ (BOOL)isEnabled;
+
+/*! \brief An html response rendered by renderer. */
++ (WebStreamingResponse*)streamingResponseWithRenderer:(id <MGTemplateRenderable>)renderer;
+
+/*! \brief A json response, object is written to the client by WKJsonWriter as it is serialized. */
++ (WebStreamingResponse*)jsonStreamingResponseWithObject:(id)object;
+
+/*! \brief If the body has been rendered (or set), once rendered -writeBodyToSink: has no effect. */
+- (BOOL)isRendered;
+
+/*! \brief Used by connectors after writing the headers, renders the body into sink. */
+- (void)writeBodyToSink:(id <MGTemplateOutputSink>)sink;
+
+@end
@@ -0,0 +1,177 @@
+//
+//  WebStreamingResponse.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WebStreamingResponse.h"
+#import "WebActionView.h"
+#import "WebLayoutView.h"
+#import "WKJsonWriter.h"
+
+@implementation WebTemplateRender
+
++ (WebTemplateRender*)renderWithActionView:(WebActionView*)view 
+							  templateData:(NSData*)templateData 
+							actionResponse:(id)actionResponse 
+								controller:(id)controller 
+								   request:(WebRequest*)request 
+							   application:(id)application {
+	WebTemplateRender* render = [[self alloc] init];
+	render->m_view = [view retain];
+	render->m_templateData = [templateData retain];
+	render->m_actionResponse = [actionResponse retain];
+	render->m_controller = [controller retain];
+	render->m_request = [request retain];
+	render->m_application = [application retain];
+	return [render autorelease];
+}
+
++ (WebTemplateRender*)renderWithLayoutView:(WebLayoutView*)layout 
+							  actionRender:(WebTemplateRender*)actionRender 
+								controller:(id)controller 
+								   request:(WebRequest*)request 
+							   application:(id)application {
+	WebTemplateRender* render = [[self alloc] init];
+	render->m_layout = [layout retain];
+	render->m_actionRender = [actionRender retain];
+	render->m_controller = [controller retain];
+	render->m_request = [request retain];
+	render->m_application = [application retain];
+	return [render autorelease];
+}
+
+- (void)dealloc {
+	[m_view release];
+	[m_layout release];
+	[m_actionRender release];
+	[m_templateData release];
+	[m_actionResponse release];
+	[m_controller release];
+	[m_request release];
+	[m_application release];
+	[super dealloc];
+}
+
+- (void)renderToSink:(id <MGTemplateOutputSink>)sink {
+	if(m_layout) {
+		[m_layout renderActionResult:m_actionRender controller:m_controller request:m_request application:m_application toSink:sink];
+	} else {
+		[m_view renderTemplateData:m_templateData 
+			withControllerResponse:m_actionResponse 
+						controller:m_controller 
+						   request:m_request 
+					   application:m_application 
+							toSink:sink];
+	}
+}
+
+- (NSData*)renderedUTF8Data {
+	if(m_layout) {
+		return [m_layout processedActionResultData:[m_actionRender renderedUTF8Data] 
+										controller:m_controller 
+										   request:m_request 
+									   application:m_application];
+	}
+	return [m_view processedTemplateData:m_templateData 
+				  withControllerResponse:m_actionResponse 
+							  controller:m_controller 
+								 request:m_request 
+							 application:m_application];
+}
+
+@end
+
+@implementation WebStreamingResponse
+
++ (BOOL)isEnabled {
+	static BOOL enabled = NO;
+	static BOOL loaded = NO;
+	if(!loaded) {
+		enabled = [[[[NSBundle mainBundle] infoDictionary] valueForKey:@"froth_stream_templates"] boolValue];
+		loaded = YES;
+	}
+	return enabled;
+}
+
++ (WebStreamingResponse*)streamingResponseWithRenderer:(id <MGTemplateRenderable>)renderer {
+	WebStreamingResponse* response = [[self alloc] initWithCode:200 contentType:@"text/html"];
+	response->m_renderer = [renderer retain];
+	return [response autorelease];
+}
+
++ (WebStreamingResponse*)jsonStreamingResponseWithObject:(id)object {
+	WebStreamingResponse* response = [[self alloc] initWithCode:200 contentType:@"text/x-json"];
+	response->m_renderer = [[WKJsonRender renderWithObject:object] retain];
+	return [response autorelease];
+}
+
+- (void)dealloc {
+	[m_renderer release];
+	[super dealloc];
+}
+
+- (BOOL)isRendered {
+	return m_rendered;
+}
+
+- (void)_render {
+	if(!m_rendered) {
+		m_rendered = YES;
+		[super setBody:[m_renderer renderedUTF8Data]];
+		[m_renderer release], m_renderer = nil;
+	}
+}
+
+- (NSData*)body {
+	[self _render];
+	return [super body];
+}
+
+- (void)setBody:(NSData*)aBody {
+	m_rendered = YES;
+	[m_renderer release], m_renderer = nil;
+	[super setBody:aBody];
+}
+
+- (int)getIOVectors:(struct iovec*)iov count:(int)count {
+	//Connectors asking for the body get it rendered, streaming connectors only ask for the headers.
+	if(count > 1) {
+		[self _render];
+	}
+	return [super getIOVectors:iov count:count];
+}
+
+- (void)writeBodyToSink:(id <MGTemplateOutputSink>)sink {
+	if(m_rendered) return;
+	m_rendered = YES;
+	
+	id <MGTemplateRenderable> renderer = [m_renderer autorelease];
+	m_renderer = nil;
+	[renderer renderToSink:sink];
+	[sink flush];
+}
+
+@end
@@ -0,0 +1,101 @@
+//
+//  WebTaskGroup.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+
+@class WebRequest;
+
+/*!
+	\brief	Runs independent calls for a request concurrently and waits for them together.
+ 
+	Actions that need data from several backends (MySQL, SimpleDB, S3...) can add each call as a task, the tasks run on
+	a shared task queue and the action waits for all of them, so the time spent is close to the slowest call rather
+	than the sum. Each task's run time is added to the request's trace.
+ 
+	\code
+	- (id)profileAction:(WebRequest*)req {
+		WebTaskGroup* group = [WebTaskGroup taskGroupForRequest:req];
+		NSUInteger user = [group addTaskWithTarget:[WAUser class] selector:@selector(userWithUid:) object:uid name:@"user"];
+		NSUInteger photo = [group addTaskWithTarget:self selector:@selector(photoForUid:) object:uid name:@"photo"];
+	
+		if(![group waitWithTimeout:2.0]) {
+			NSLog(@"Profile data timed out");
+		}
+		return froth_dic([group resultAtIndex:user], @"user", [group resultAtIndex:photo], @"photo");
+	}
+	\endcode
+ 
+	Tasks run on other threads, so the models and data sources they use must be safe to use from more then one thread. 
+	Tasks that have not finished by the deadline keep running, but their results are ignored.
+ */
+@interface WebTaskGroup : NSObject {
+	WebRequest* m_request;
+	NSMutableArray* m_tasks;
+	NSCondition* m_condition;
+	NSUInteger m_pending;
+}
+
+/*! \brief A new task group that records task timings in request's trace. request may be nil. */
++ (WebTaskGroup*)taskGroupForRequest:(WebRequest*)request;
+
+/*!
+	\brief	The shared queue tasks run on. Its width is the Info.plist key <i>froth_task_threads</i>, defualt 16.
+	
+	This is seperate from the WebDeferredResponse I/O queue, so deferred work can use task groups without waiting
+	on its own queue.
+ */
++ (NSOperationQueue*)taskQueue;
+
+- (id)initWithRequest:(WebRequest*)request;
+
+/*!
+	\brief	Starts [target selector:object] on the task queue.
+	\param	name Used for the request trace, may be nil.
+	\return	The index of the task for -resultAtIndex:
+ */
+- (NSUInteger)addTaskWithTarget:(id)target selector:(SEL)selector object:(id)object name:(NSString*)name;
+
+/*! \brief Blocks until all tasks are finished, or deadline. Returns YES if all finished. */
+- (BOOL)waitUntilDate:(NSDate*)deadline;
+
+/*! \brief Blocks until all tasks are finished, or timeout seconds. Returns YES if all finished. */
+- (BOOL)waitWithTimeout:(NSTimeInterval)timeout;
+
+/*! \brief Blocks until all tasks are finished. */
+- (void)waitUntilAllTasksAreFinished;
+
+/*! \brief The return value of the task, nil if it has not finished, raised an exception or its selector does not return an object. */
+- (id)resultAtIndex:(NSUInteger)index;
+
+/*! \brief The exception raised by the task, if any. */
+- (NSException*)exceptionAtIndex:(NSUInteger)index;
+
+/*! \brief The time the task took to run, or 0 if it has not finished. */
+- (NSTimeInterval)durationAtIndex:(NSUInteger)index;
+
+@end
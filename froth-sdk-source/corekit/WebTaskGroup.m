@@ -0,0 +1,218 @@
+//
+//  WebTaskGroup.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WebTaskGroup.h"
+#import "WebRequest.h"
+
+#define kDefaultTaskThreads 16
+
+/* The state of a single task, only read by the group once finished is set. */
+@interface WebTaskGroupTask : NSObject {
+	@public
+	NSInvocation* invocation;
+	NSString* name;
+	id result;
+	NSException* exception;
+	NSTimeInterval duration;
+	BOOL finished;
+}
+@end
+
+@implementation WebTaskGroupTask
+
+- (void)dealloc {
+	[invocation release];
+	[name release];
+	[result release];
+	[exception release];
+	[super dealloc];
+}
+
+@end
+
+@interface WebTaskGroup (Private)
+- (void)_runTask:(WebTaskGroupTask*)task;
+- (WebTaskGroupTask*)_finishedTaskAtIndex:(NSUInteger)index;
+@end
+
+@implementation WebTaskGroup
+
++ (WebTaskGroup*)taskGroupForRequest:(WebRequest*)request {
+	return [[[self alloc] initWithRequest:request] autorelease];
+}
+
++ (NSOperationQueue*)taskQueue {
+	static NSOperationQueue* taskQueue = nil;
+	@synchronized(self) {
+		if(!taskQueue) {
+			NSInteger threads = [[[[NSBundle mainBundle] infoDictionary] valueForKey:@"froth_task_threads"] intValue];
+			
+			taskQueue = [[NSOperationQueue alloc] init];
+			[taskQueue setMaxConcurrentOperationCount:(threads > 0) ? threads : kDefaultTaskThreads];
+		}
+	}
+	return taskQueue;
+}
+
+- (id)initWithRequest:(WebRequest*)request {
+	if(self = [super init]) {
+		m_request = [request retain];
+		m_tasks = [[NSMutableArray alloc] init];
+		m_condition = [[NSCondition alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_request release];
+	[m_tasks release];
+	[m_condition release];
+	[super dealloc];
+}
+
+- (NSUInteger)addTaskWithTarget:(id)target selector:(SEL)selector object:(id)object name:(NSString*)name {
+	NSMethodSignature* signature = [target methodSignatureForSelector:selector];
+	NSInvocation* invocation = [NSInvocation invocationWithMethodSignature:signature];
+	[invocation setTarget:target];
+	[invocation setSelector:selector];
+	if([signature numberOfArguments] > 2) {
+		[invocation setArgument:&object atIndex:2];
+	}
+	[invocation retainArguments];
+	
+	WebTaskGroupTask* task = [[WebTaskGroupTask alloc] init];
+	task->invocation = [invocation retain];
+	task->name = [(name ? name : NSStringFromSelector(selector)) copy];
+	
+	NSUInteger index;
+	[m_condition lock];
+	index = [m_tasks count];
+	[m_tasks addObject:task];
+	m_pending++;
+	[m_condition unlock];
+	
+	NSInvocationOperation* operation = [[NSInvocationOperation alloc] initWithTarget:self selector:@selector(_runTask:) object:task];
+	[[[self class] taskQueue] addOperation:operation];
+	[operation release];
+	[task release];
+	
+	return index;
+}
+
+- (void)_runTask:(WebTaskGroupTask*)task {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	
+	id result = nil;
+	NSException* exception = nil;
+	NSDate* start = [NSDate date];
+	@try {
+		[task->invocation invoke];
+		
+		//Only an object return is a result, void and scalar returns finish with a nil result
+		NSMethodSignature* signature = [task->invocation methodSignature];
+		if([signature methodReturnLength] == sizeof(id) && [signature methodReturnType][0] == '@') {
+			[task->invocation getReturnValue:&result];
+		}
+	} @catch (NSException * e) {
+		NSLog(@"+++ [[ERROR]] WebTaskGroup: task [%@] raised [%@] [%@]", task->name, [e name], [e reason]);
+		exception = e;
+	}
+	NSTimeInterval duration = -[start timeIntervalSinceNow];
+	
+	[m_request addTraceEntry:task->name duration:duration];
+	
+	[m_condition lock];
+	task->result = [result retain];
+	task->exception = [exception retain];
+	task->duration = duration;
+	task->finished = YES;
+	m_pending--;
+	[m_condition broadcast];
+	[m_condition unlock];
+	
+	[pool drain];
+}
+
+#pragma mark -
+#pragma mark Waiting
+
+- (BOOL)waitUntilDate:(NSDate*)deadline {
+	BOOL finished = YES;
+	
+	[m_condition lock];
+	while(m_pending > 0) {
+		if(![m_condition waitUntilDate:deadline]) {
+			finished = (m_pending == 0);
+			break;
+		}
+	}
+	[m_condition unlock];
+	
+	return finished;
+}
+
+- (BOOL)waitWithTimeout:(NSTimeInterval)timeout {
+	return [self waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:timeout]];
+}
+
+- (void)waitUntilAllTasksAreFinished {
+	[self waitUntilDate:[NSDate distantFuture]];
+}
+
+#pragma mark -
+#pragma mark Results
+
+- (WebTaskGroupTask*)_finishedTaskAtIndex:(NSUInteger)index {
+	WebTaskGroupTask* task = nil;
+	[m_condition lock];
+	if(index < [m_tasks count]) {
+		task = [m_tasks objectAtIndex:index];
+		if(!task->finished) {
+			task = nil;
+		}
+	}
+	[m_condition unlock];
+	return task;
+}
+
+- (id)resultAtIndex:(NSUInteger)index {
+	WebTaskGroupTask* task = [self _finishedTaskAtIndex:index];
+	return task ? task->result : nil;
+}
+
+- (NSException*)exceptionAtIndex:(NSUInteger)index {
+	WebTaskGroupTask* task = [self _finishedTaskAtIndex:index];
+	return task ? task->exception : nil;
+}
+
+- (NSTimeInterval)durationAtIndex:(NSUInteger)index {
+	WebTaskGroupTask* task = [self _finishedTaskAtIndex:index];
+	return task ? task->duration : 0;
+}
+
+@end
@@ -0,0 +1,15 @@
+//
+//  WebTaskGroupTests.h
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "FrothTestCase.h"
+
+
+@interface WebTaskGroupTests : FrothTestCase {
+
+}
+
+@end
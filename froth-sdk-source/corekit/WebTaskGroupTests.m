@@ -0,0 +1,73 @@
+//
+//  WebTaskGroupTests.m
+//  FrothKit
+//
+//  Copyright 2010 Thinking Code Software Inc. All rights reserved.
+//
+
+#import "WebTaskGroupTests.h"
+#import "WebTaskGroup.h"
+
+/* Task targets with object, void and scalar returns */
+@interface WebTaskGroupTestTarget : NSObject {
+	@public
+	NSString* m_touched;
+}
+- (NSString*)uppercase:(NSString*)value;
+- (void)touch:(NSString*)value;
+- (BOOL)isEmpty:(NSString*)value;
+@end
+
+@implementation WebTaskGroupTestTarget
+
+- (void)dealloc {
+	[m_touched release];
+	[super dealloc];
+}
+
+- (NSString*)uppercase:(NSString*)value {
+	return [value uppercaseString];
+}
+
+- (void)touch:(NSString*)value {
+	[m_touched release];
+	m_touched = [value copy];
+}
+
+- (BOOL)isEmpty:(NSString*)value {
+	return ([value length] == 0);
+}
+
+@end
+
+@implementation WebTaskGroupTests
+
+- (NSArray*)tests {
+	return [NSArray arrayWithObjects:@"test_objectResult", 
+			@"test_nonObjectResults", nil];
+}
+
+- (void)test_objectResult {
+	WebTaskGroupTestTarget* target = [[[WebTaskGroupTestTarget alloc] init] autorelease];
+	WebTaskGroup* group = [WebTaskGroup taskGroupForRequest:nil];
+	NSUInteger index = [group addTaskWithTarget:target selector:@selector(uppercase:) object:@"froth" name:nil];
+	
+	FRAssertTrue([group waitWithTimeout:10.0], @"Task did not finish");
+	FRAssertTrue([[group resultAtIndex:index] isEqualToString:@"FROTH"], @"Object result is %@", [group resultAtIndex:index]);
+	FRPass(@"Object result returned");
+}
+
+- (void)test_nonObjectResults {
+	WebTaskGroupTestTarget* target = [[[WebTaskGroupTestTarget alloc] init] autorelease];
+	WebTaskGroup* group = [WebTaskGroup taskGroupForRequest:nil];
+	NSUInteger touch = [group addTaskWithTarget:target selector:@selector(touch:) object:@"touched" name:@"void"];
+	NSUInteger empty = [group addTaskWithTarget:target selector:@selector(isEmpty:) object:@"" name:@"BOOL"];
+	
+	FRAssertTrue([group waitWithTimeout:10.0], @"Tasks did not finish");
+	FRAssertTrue([target->m_touched isEqualToString:@"touched"], @"Void task did not run");
+	FRAssertTrue([group resultAtIndex:touch] == nil && [group exceptionAtIndex:touch] == nil, @"Void task has a result");
+	FRAssertTrue([group resultAtIndex:empty] == nil && [group exceptionAtIndex:empty] == nil, @"BOOL task has a result");
+	FRPass(@"Void and BOOL tasks finished with nil results");
+}
+
+@end
@@ -0,0 +1,93 @@
+//
+//  WebTemplateEnginePool.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "MGTemplateEscaping.h"
+
+@class MGTemplateEngine;
+
+/*!
+	\brief	Hands out template engines that are kept per thread, with the application's markers, filters and matcher loaded once.
+ 
+	Creating an engine loads every marker and filter into its dictionaries, the pool does this once per thread (and again 
+	only if the registrations change) instead of for each render. Engines are checked out for a render and checked back in 
+	when it is done. A render that checks out a second engine on the same thread (ie a template that renders another view) 
+	gets its own engine. An engine that is not checked in, ie after an exception, is simply dropped as its markers may have 
+	been left mid block.
+ 
+	The WKValueComparisonFilters and WKFunctionMarkers are registered by default. Applications register their own markers 
+	and filters once, before the first render (ie from the application delegate's init), and they are then available to 
+	every view and layout.
+ 
+	\code
+	[WebTemplateEnginePool registerMarkerClass:[MyMarkers class]];
+	[WebTemplateEnginePool registerFilterClass:[MyFilters class]];
+	\endcode
+ 
+	The matcher is set with the Info.plist froth_template_matcher key as a class name (ie WKScanningTemplateMatcher), 
+	the default is AGRegexTemplateMatcher.
+ 
+	Views and layouts autoescape their templates' expressions when the Info.plist froth_template_autoescape boolean is 
+	YES (defualt NO), see +autoescapeForTemplateNamed:. Values that are already html are output with the raw filter.
+	\code
+	<a href="/users/{{ user.id }}" title="{{ user.name }}">{{ user.bio | raw }}</a>
+	\endcode
+	In scripts and event handlers an expression inside a string is escaped for the string, anywhere else it is output as 
+	a quoted javascript string.
+	\code
+	<script>var name = {{ user.name }}, greeting = "Hello {{ user.name }}";</script>
+	\endcode
+ */
+@interface WebTemplateEnginePool : NSObject {
+}
+
+/*! \brief Registers a class conforming to MGTemplateMarker, an instance is loaded into every engine */
++ (void)registerMarkerClass:(Class)markerClass;
+
+/*! \brief Registers a class conforming to MGTemplateFilter, an instance is loaded into every engine */
++ (void)registerFilterClass:(Class)filterClass;
+
+/*! \brief Sets the class of the matcher for engines, a class conforming to MGTemplateEngineMatcher */
++ (void)setMatcherClass:(Class)matcherClass;
+
+/*! \brief The class of the matcher for engines */
++ (Class)matcherClass;
+
+/*! \brief An engine for the current thread, ready for a render. The engine has no delegate. */
++ (MGTemplateEngine*)checkoutEngine;
+
+/*! \brief Returns an engine from +checkoutEngine to the current thread's pool, once its render has finished. Engines built before a registration changed are dropped. */
++ (void)checkinEngine:(MGTemplateEngine*)engine;
+
+/*!
+	\brief	The autoescape mode for a template by its extention, html, htm and xml templates are escaped as html and json
+			templates as json. MGTemplateEscapeNone when froth_template_autoescape is off, or for other templates.
+ */
++ (MGTemplateEscapeContext)autoescapeForTemplateNamed:(NSString*)name;
+
+@end
@@ -0,0 +1,261 @@
+//
+//  WebTemplateEnginePool.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WebTemplateEnginePool.h"
+#import "Froth+Exceptions.h"
+#import "MGTemplateEngine.h"
+#import "AGRegexTemplateMatcher.h"
+#import "WKValueComparisonFilters.h"
+#import "WKFunctionMarkers.h"
+
+#include <pthread.h>
+
+#define kMaxIdleEnginesPerThread 4
+
+/*
+	The engines idle on one thread, built for a generation of the registrations.
+ */
+@interface WebThreadEngines : NSObject {
+@public
+	NSMutableArray* engines;
+	unsigned int generation;
+}
+@end
+
+@implementation WebThreadEngines
+
+- (void)dealloc {
+	[engines release];
+	[super dealloc];
+}
+
+@end
+
+/*
+	An engine made by the pool, with the generation of the registrations it was built from.
+ */
+@interface WebPooledTemplateEngine : MGTemplateEngine {
+@public
+	unsigned int generation;
+}
+@end
+
+@implementation WebPooledTemplateEngine
+@end
+
+static pthread_once_t kPoolSetupOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t kPoolThreadKey;
+static pthread_mutex_t kPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static NSMutableArray* kMarkerClasses = nil;
+static NSMutableArray* kFilterClasses = nil;
+static Class kMatcherClass = Nil;
+static volatile unsigned int kGeneration = 0;	// Changed under kPoolLock with an atomic increment
+static BOOL kAutoescape = NO;
+
+/* Read without the lock on every checkout and checkin, registrations only change at startup */
+static unsigned int poolGeneration(void) {
+	unsigned int generation = kGeneration;
+	__sync_synchronize();
+	return generation;
+}
+
+static void poolChangeGeneration(void) {
+	__sync_fetch_and_add(&kGeneration, 1);
+}
+
+static void poolThreadDestructor(void* threadEngines) {
+	[(WebThreadEngines*)threadEngines release];
+}
+
+static void poolSetup(void) {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	pthread_key_create(&kPoolThreadKey, poolThreadDestructor);
+	
+	kMarkerClasses = [[NSMutableArray alloc] initWithObjects:[WKFunctionMarkers class], nil];
+	kFilterClasses = [[NSMutableArray alloc] initWithObjects:[WKValueComparisonFilters class], nil];
+	
+	NSString* matcherClassName = [[[NSBundle mainBundle] infoDictionary] valueForKey:@"froth_template_matcher"];
+	if(matcherClassName) {
+		kMatcherClass = NSClassFromString(matcherClassName);
+		if(!kMatcherClass) {
+			NSLog(@"+++ [[ERROR]] WebTemplateEnginePool: Unknown froth_template_matcher class [%@], using AGRegexTemplateMatcher", matcherClassName);
+		}
+	}
+	if(!kMatcherClass) {
+		kMatcherClass = [AGRegexTemplateMatcher class];
+	}
+	
+	kAutoescape = [[[[NSBundle mainBundle] infoDictionary] valueForKey:@"froth_template_autoescape"] boolValue];
+	[pool drain];
+}
+
+@interface WebTemplateEnginePool (Private)
++ (MGTemplateEngine*)_newEngine;
+@end
+
+@implementation WebTemplateEnginePool
+
++ (void)registerMarkerClass:(Class)markerClass {
+	pthread_once(&kPoolSetupOnce, poolSetup);
+	if(![markerClass conformsToProtocol:@protocol(MGTemplateMarker)]) {
+		froth_exception(@"TemplateEnginePoolException", @"%@ does not conform to MGTemplateMarker", NSStringFromClass(markerClass));
+	}
+	
+	pthread_mutex_lock(&kPoolLock);
+	if(![kMarkerClasses containsObject:markerClass]) {
+		[kMarkerClasses addObject:markerClass];
+		poolChangeGeneration();
+	}
+	pthread_mutex_unlock(&kPoolLock);
+}
+
++ (void)registerFilterClass:(Class)filterClass {
+	pthread_once(&kPoolSetupOnce, poolSetup);
+	if(![filterClass conformsToProtocol:@protocol(MGTemplateFilter)]) {
+		froth_exception(@"TemplateEnginePoolException", @"%@ does not conform to MGTemplateFilter", NSStringFromClass(filterClass));
+	}
+	
+	pthread_mutex_lock(&kPoolLock);
+	if(![kFilterClasses containsObject:filterClass]) {
+		[kFilterClasses addObject:filterClass];
+		poolChangeGeneration();
+	}
+	pthread_mutex_unlock(&kPoolLock);
+}
+
++ (void)setMatcherClass:(Class)matcherClass {
+	pthread_once(&kPoolSetupOnce, poolSetup);
+	if(![matcherClass conformsToProtocol:@protocol(MGTemplateEngineMatcher)]) {
+		froth_exception(@"TemplateEnginePoolException", @"%@ does not conform to MGTemplateEngineMatcher", NSStringFromClass(matcherClass));
+	}
+	
+	pthread_mutex_lock(&kPoolLock);
+	if(matcherClass != kMatcherClass) {
+		kMatcherClass = matcherClass;
+		poolChangeGeneration();
+	}
+	pthread_mutex_unlock(&kPoolLock);
+}
+
++ (Class)matcherClass {
+	pthread_once(&kPoolSetupOnce, poolSetup);
+	pthread_mutex_lock(&kPoolLock);
+	Class matcherClass = kMatcherClass;
+	pthread_mutex_unlock(&kPoolLock);
+	return matcherClass;
+}
+
++ (MGTemplateEngine*)checkoutEngine {
+	pthread_once(&kPoolSetupOnce, poolSetup);
+	
+	WebThreadEngines* threadEngines = pthread_getspecific(kPoolThreadKey);
+	if(threadEngines) {
+		//Drop engines built before a registration changed
+		unsigned int generation = poolGeneration();
+		if(threadEngines->generation != generation) {
+			[threadEngines->engines removeAllObjects];
+			threadEngines->generation = generation;
+		}
+		
+		MGTemplateEngine* engine = [threadEngines->engines lastObject];
+		if(engine) {
+			[[engine retain] autorelease];
+			[threadEngines->engines removeLastObject];
+			return engine;
+		}
+	}
+	return [[self _newEngine] autorelease];
+}
+
++ (void)checkinEngine:(MGTemplateEngine*)engine {
+	if(!engine) return;
+	pthread_once(&kPoolSetupOnce, poolSetup);
+	
+	//Only engines built by the pool for the current registrations are kept
+	if(![engine isKindOfClass:[WebPooledTemplateEngine class]]) return;
+	unsigned int generation = poolGeneration();
+	if(((WebPooledTemplateEngine*)engine)->generation != generation) return;
+	
+	WebThreadEngines* threadEngines = pthread_getspecific(kPoolThreadKey);
+	if(!threadEngines) {
+		threadEngines = [[WebThreadEngines alloc] init];	//Released by the thread destructor
+		threadEngines->engines = [[NSMutableArray alloc] initWithCapacity:2];
+		threadEngines->generation = generation;
+		pthread_setspecific(kPoolThreadKey, threadEngines);
+	} else if(threadEngines->generation != generation) {
+		[threadEngines->engines removeAllObjects];
+		threadEngines->generation = generation;
+	}
+	
+	[engine setDelegate:nil];
+	[engine releaseTemplateState];
+	if([threadEngines->engines count] < kMaxIdleEnginesPerThread) {
+		[threadEngines->engines addObject:engine];
+	}
+}
+
++ (MGTemplateEscapeContext)autoescapeForTemplateNamed:(NSString*)name {
+	pthread_once(&kPoolSetupOnce, poolSetup);
+	if(!kAutoescape) return MGTemplateEscapeNone;
+	
+	NSString* extention = [[name pathExtension] lowercaseString];
+	if([extention isEqualToString:@"html"] || [extention isEqualToString:@"htm"] || [extention isEqualToString:@"xml"]) {
+		return MGTemplateEscapeHTML;
+	} else if([extention isEqualToString:@"json"]) {
+		return MGTemplateEscapeJSON;
+	}
+	return MGTemplateEscapeNone;
+}
+
+#pragma mark -
+#pragma mark Private
+
++ (MGTemplateEngine*)_newEngine {
+	pthread_mutex_lock(&kPoolLock);
+	NSArray* markerClasses = [kMarkerClasses copy];
+	NSArray* filterClasses = [kFilterClasses copy];
+	Class matcherClass = kMatcherClass;
+	unsigned int generation = kGeneration;
+	pthread_mutex_unlock(&kPoolLock);
+	
+	WebPooledTemplateEngine* engine = [[WebPooledTemplateEngine alloc] init];
+	engine->generation = generation;
+	for(Class filterClass in filterClasses) {
+		[engine loadFilter:[[[filterClass alloc] init] autorelease]];
+	}
+	for(Class markerClass in markerClasses) {
+		[engine loadMarker:[[[markerClass alloc] initWithTemplateEngine:engine] autorelease]];
+	}
+	[engine setMatcher:[[[matcherClass alloc] initWithTemplateEngine:engine] autorelease]];
+	
+	[markerClasses release];
+	[filterClasses release];
+	return engine;
+}
+
+@end
@@ -0,0 +1,154 @@
+//
+//  WebTemplateRegistry.h
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#include <pthread.h>
+#include <time.h>
+
+@class MGTemplateEngine;
+@class MGCompiledTemplate;
+
+/*! \brief The file name of the compiled template archive in an application's Resources, written by fmtool -t */
+#define WebTemplateArchiveFileName @"CompiledTemplates.bin"
+
+/*!
+	\brief	An immutable template held by the WebTemplateRegistry.
+ 
+	Entries are never changed once published, a reload or a compile publishes a new entry for the name. An entry returned
+	from the registry is retained and autoreleased, so it stays valid until the caller's pool drains even if it is replaced.
+ */
+@interface WebTemplateEntry : NSObject {
+	NSString* m_name;
+	NSString* m_path;
+	NSData* m_data;
+	NSString* m_string;
+	MGCompiledTemplate* m_compiledTemplate;
+	time_t m_modified;
+	off_t m_size;
+}
+
+/*! \brief The registry name, typically the resource file name (ie 'Layout.html') */
+- (NSString*)name;
+
+/*! \brief The file the template was loaded from */
+- (NSString*)path;
+
+/*! \brief The raw template bytes */
+- (NSData*)data;
+
+/*! \brief The template decoded as utf8 (nil if the data is not utf8) */
+- (NSString*)string;
+
+/*! \brief The compiled template, if compiled with -[WebTemplateRegistry compiledTemplateForEntry:engine:] */
+- (MGCompiledTemplate*)compiledTemplate;
+
+@end
+
+/*!
+	\brief	A process wide registry of the application's templates, shared by action views, layouts and WebMailer.
+ 
+	Entries are kept in a dictionary behind a read-write lock. Lookups take the shared read lock, so they only wait while 
+	an entry is being published, and publishing replaces a single entry in place. Replaced entries are released once 
+	the last caller using them is done.
+ 
+	Lookups are not lock-free. A lock-free read of a swapped dictionary snapshot can not tell when a replaced snapshot 
+	is no longer being read, so it would either have to keep every snapshot or release one under a reader. Publishing 
+	is rare once templates are loaded, so readers rarely wait on the lock while serving requests.
+ 
+	When the application bundle has a compiled template archive (see +writeArchiveOfTemplatesAtPaths:engine:toPath:errors:) 
+	and reloading is off, the registry maps it at startup and publishes its templates already compiled, so templates are 
+	neither read or parsed while serving requests. Archived templates whose file has changed since the archive was written, 
+	or an archive made with a different matcher than WebTemplateEnginePool's, are ignored and loaded as usual.
+ 
+	When template reloading is on, lookups stat the template's file and return nil if it has changed so the caller loads it 
+	again. Reloading is set with the Info.plist froth_template_reload boolean, and defaults to on for the 'Debug' and 
+	'Development' deployment modes only, so production lookups never touch the file system.
+ 
+	\code
+	WebTemplateRegistry* registry = [WebTemplateRegistry sharedRegistry];
+	WebTemplateEntry* entry = [registry entryForName:name];
+	if(!entry) {
+		entry = [registry loadTemplateNamed:name atPath:path];
+	}
+	\endcode
+ */
+@interface WebTemplateRegistry : NSObject {
+	NSMutableDictionary* m_entries;
+	NSMutableArray* m_archives;
+	pthread_rwlock_t m_lock;
+	BOOL m_reloads;
+}
+
+/*! \brief The application's template registry */
++ (WebTemplateRegistry*)sharedRegistry;
+
+/*! \brief If a resource file is a template the registry serves (.html, .json or .xml), for warm up and fmtool -t */
++ (BOOL)isTemplateResource:(NSString*)fileName;
+
+/*! \brief If lookups check template files for changes */
+- (BOOL)reloadsTemplates;
+
+/*! \brief The entry for name, or nil if not loaded (or changed on disk when reloading) */
+- (WebTemplateEntry*)entryForName:(NSString*)name;
+
+/*! \brief Loads the file at path as the template for name, returns nil if the file can not be read */
+- (WebTemplateEntry*)loadTemplateNamed:(NSString*)name atPath:(NSString*)path;
+
+/*! 
+	\brief	Returns the compiled template for entry, compiling it with engine the first time.
+	
+	The compiled template is published with a copy of the entry, so other threads and engines reuse it. If the entry has been 
+	replaced (ie reloaded) the template is compiled but not published.
+ */
+- (MGCompiledTemplate*)compiledTemplateForEntry:(WebTemplateEntry*)entry engine:(MGTemplateEngine*)engine;
+
+/*!
+	\brief	Loads the compiled templates of the archive at path, returns the number of templates published.
+			Called at startup with the application's archive, when reloading is off.
+ */
+- (NSUInteger)loadArchiveAtPath:(NSString*)path;
+
+/*!
+	\brief	Compiles the templates at paths with engine and writes them to an archive at archivePath, used by fmtool -t.
+	
+	Templates are registered by their file name. Each template's blocks are checked with -[MGTemplateEngine blockErrorsInCompiledTemplate:],
+	problems are added to errors (prefixed with the file name) and no archive is written if there are any.
+	\return	If the archive was written.
+ */
++ (BOOL)writeArchiveOfTemplatesAtPaths:(NSArray*)paths 
+								engine:(MGTemplateEngine*)engine 
+								toPath:(NSString*)archivePath 
+								errors:(NSMutableArray*)errors;
+
+/*! \brief The names of all loaded templates */
+- (NSArray*)templateNames;
+
+/*! \brief Drops all templates, they are loaded again on next use. */
+- (void)removeAllTemplates;
+
+@end
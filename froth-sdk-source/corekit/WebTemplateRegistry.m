@@ -0,0 +1,455 @@
+//
+//  WebTemplateRegistry.m
+//  Froth
+//
+//  Copyright (c) 2010 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+
+#import "WebTemplateRegistry.h"
+#import "WebApplication.h"
+#import "MGTemplateEngine.h"
+#import "WebTemplateEnginePool.h"
+#import "Froth+Defines.h"
+
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+/*
+	A compiled template archive is kArchiveMagic, kArchiveVersion, the matcher class name and the template count. Followed by 
+	each template's name, source file modification time and size, source bytes and archived markers. Numbers are 32bit in 
+	network order, names and byte blocks are preceded by their length.
+ */
+#define kArchiveMagic	"FTPA"
+#define kArchiveVersion	1
+
+static void archiveAppendUInt32(NSMutableData* data, uint32_t value) {
+	uint32_t v = htonl(value);
+	[data appendBytes:&v length:sizeof(v)];
+}
+
+static void archiveAppendBytes(NSMutableData* data, const void* bytes, uint32_t length) {
+	archiveAppendUInt32(data, length);
+	[data appendBytes:bytes length:length];
+}
+
+static void archiveAppendString(NSMutableData* data, NSString* string) {
+	const char* utf8 = [string UTF8String];
+	archiveAppendBytes(data, utf8, (uint32_t)strlen(utf8));
+}
+
+static BOOL archiveReadUInt32(const uint8_t** bytes, const uint8_t* end, uint32_t* value) {
+	if(end - *bytes < (ptrdiff_t)sizeof(uint32_t)) return NO;
+	uint32_t v;
+	memcpy(&v, *bytes, sizeof(v));
+	*value = ntohl(v);
+	*bytes += sizeof(v);
+	return YES;
+}
+
+/* Points block at the next length prefixed bytes, which are not copied. */
+static BOOL archiveReadBytes(const uint8_t** bytes, const uint8_t* end, const uint8_t** block, uint32_t* length) {
+	if(!archiveReadUInt32(bytes, end, length) || end - *bytes < (ptrdiff_t)*length) return NO;
+	*block = *bytes;
+	*bytes += *length;
+	return YES;
+}
+
+@interface WebTemplateEntry (Private)
+- (id)_initWithName:(NSString*)name path:(NSString*)path data:(NSData*)data modified:(time_t)modified size:(off_t)size;
+- (id)_initWithName:(NSString*)name path:(NSString*)path data:(NSData*)data compiledTemplate:(MGCompiledTemplate*)compiled 
+		   modified:(time_t)modified size:(off_t)size;
+- (WebTemplateEntry*)_entryWithCompiledTemplate:(MGCompiledTemplate*)compiled;
+- (BOOL)_isModified;
+@end
+
+@implementation WebTemplateEntry
+
+- (id)_initWithName:(NSString*)name path:(NSString*)path data:(NSData*)data modified:(time_t)modified size:(off_t)size {
+	if(self = [super init]) {
+		m_name = [name copy];
+		m_path = [path copy];
+		m_data = [data retain];
+		m_string = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+		m_modified = modified;
+		m_size = size;
+	}
+	return self;
+}
+
+/* The compiled template's contents are used as the string, so they are only decoded once. */
+- (id)_initWithName:(NSString*)name path:(NSString*)path data:(NSData*)data compiledTemplate:(MGCompiledTemplate*)compiled 
+		   modified:(time_t)modified size:(off_t)size {
+	if(self = [super init]) {
+		m_name = [name copy];
+		m_path = [path copy];
+		m_data = [data retain];
+		m_string = [[compiled templateContents] retain];
+		m_compiledTemplate = [compiled retain];
+		m_modified = modified;
+		m_size = size;
+	}
+	return self;
+}
+
+- (WebTemplateEntry*)_entryWithCompiledTemplate:(MGCompiledTemplate*)compiled {
+	WebTemplateEntry* entry = [[WebTemplateEntry alloc] init];
+	entry->m_name = [m_name retain];
+	entry->m_path = [m_path retain];
+	entry->m_data = [m_data retain];
+	entry->m_string = [m_string retain];
+	entry->m_compiledTemplate = [compiled retain];
+	entry->m_modified = m_modified;
+	entry->m_size = m_size;
+	return [entry autorelease];
+}
+
+- (BOOL)_isModified {
+	struct stat st;
+	if(stat([m_path fileSystemRepresentation], &st) != 0) {
+		return YES;
+	}
+	return (st.st_mtime != m_modified || st.st_size != m_size);
+}
+
+- (void)dealloc {
+	[m_name release];
+	[m_path release];
+	[m_data release];
+	[m_string release];
+	[m_compiledTemplate release];
+	[super dealloc];
+}
+
+- (NSString*)name {
+	return m_name;
+}
+
+- (NSString*)path {
+	return m_path;
+}
+
+- (NSData*)data {
+	return m_data;
+}
+
+- (NSString*)string {
+	return m_string;
+}
+
+- (MGCompiledTemplate*)compiledTemplate {
+	return m_compiledTemplate;
+}
+
+@end
+
+#pragma mark -
+
+@interface WebTemplateRegistry (Private)
+- (void)_publishEntry:(WebTemplateEntry*)entry;
+@end
+
+static pthread_once_t kRegistrySetupOnce = PTHREAD_ONCE_INIT;
+static WebTemplateRegistry* kSharedRegistry = nil;
+
+static void registrySetup(void) {
+	NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+	kSharedRegistry = [[WebTemplateRegistry alloc] init];
+	[pool drain];
+}
+
+@implementation WebTemplateRegistry
+
++ (WebTemplateRegistry*)sharedRegistry {
+	pthread_once(&kRegistrySetupOnce, registrySetup);
+	return kSharedRegistry;
+}
+
++ (BOOL)isTemplateResource:(NSString*)fileName {
+	NSString* extension = [[fileName pathExtension] lowercaseString];
+	return ([extension isEqualToString:@"html"] || [extension isEqualToString:@"json"] || [extension isEqualToString:@"xml"]);
+}
+
+- (id)init {
+	if(self = [super init]) {
+		m_entries = [[NSMutableDictionary alloc] init];
+		m_archives = [[NSMutableArray alloc] init];
+		pthread_rwlock_init(&m_lock, NULL);
+		
+		id reload = [[[NSBundle mainBundle] infoDictionary] valueForKey:@"froth_template_reload"];
+		if(reload) {
+			m_reloads = [reload boolValue];
+		} else {
+			NSString* mode = [WebApplication deploymentMode];
+			m_reloads = ([mode caseInsensitiveCompare:@"Debug"] == NSOrderedSame || 
+						 [mode caseInsensitiveCompare:@"Development"] == NSOrderedSame);
+		}
+		
+		if(m_reloads) {
+			NSLog(@"WebTemplateRegistry: Template reloading is on, templates are checked for changes on each use");
+		} else {
+			NSString* archivePath = [[[NSBundle mainBundle] resourcePath] stringByAppendingPathComponent:WebTemplateArchiveFileName];
+			if([[NSFileManager defaultManager] fileExistsAtPath:archivePath]) {
+				NSUInteger count = [self loadArchiveAtPath:archivePath];
+				NSLog(@"WebTemplateRegistry: Loaded %d compiled templates from %@", (int)count, WebTemplateArchiveFileName);
+			}
+		}
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_entries release];
+	[m_archives release];
+	pthread_rwlock_destroy(&m_lock);
+	[super dealloc];
+}
+
+- (BOOL)reloadsTemplates {
+	return m_reloads;
+}
+
+- (WebTemplateEntry*)entryForName:(NSString*)name {
+	if(!name) return nil;
+	
+	pthread_rwlock_rdlock(&m_lock);
+	WebTemplateEntry* entry = [[[m_entries objectForKey:name] retain] autorelease];
+	pthread_rwlock_unlock(&m_lock);
+	
+	if(entry && m_reloads && [entry _isModified]) {
+		NSLog(@"WebTemplateRegistry: Reloading modified template %@", name);
+		return nil;
+	}
+	return entry;
+}
+
+- (WebTemplateEntry*)loadTemplateNamed:(NSString*)name atPath:(NSString*)path {
+	if(!name || !path) return nil;
+	
+	struct stat st;
+	if(stat([path fileSystemRepresentation], &st) != 0) {
+		return nil;
+	}
+	
+	NSData* data = [NSData dataWithContentsOfFile:path];
+	if(!data) {
+		return nil;
+	}
+	
+	WebTemplateEntry* entry = [[[WebTemplateEntry alloc] _initWithName:name 
+																  path:path 
+																  data:data 
+															  modified:st.st_mtime 
+																  size:st.st_size] autorelease];
+	[self _publishEntry:entry];
+	return entry;
+}
+
+- (MGCompiledTemplate*)compiledTemplateForEntry:(WebTemplateEntry*)entry engine:(MGTemplateEngine*)engine {
+	MGCompiledTemplate* compiled = [entry compiledTemplate];
+	if(compiled && [compiled matchesDelimitersOfEngine:engine]) {
+		return compiled;
+	}
+	
+	if(![entry string]) {
+		return nil;
+	}
+	
+	compiled = [engine compileTemplate:[entry string]];
+	if(!compiled) {
+		return nil;
+	}
+	
+	//Only published if the entry has not been replaced (ie reloaded) meanwhile
+	WebTemplateEntry* compiledEntry = [entry _entryWithCompiledTemplate:compiled];
+	pthread_rwlock_wrlock(&m_lock);
+	if([m_entries objectForKey:[entry name]] == entry) {
+		[m_entries setObject:compiledEntry forKey:[entry name]];
+	}
+	pthread_rwlock_unlock(&m_lock);
+	return compiled;
+}
+
+- (NSUInteger)loadArchiveAtPath:(NSString*)path {
+	NSData* archive = [NSData dataWithContentsOfMappedFile:path];
+	if(!archive) {
+		NSLog(@"+++ [[ERROR]] WebTemplateRegistry: Unable to map template archive %@", path);
+		return 0;
+	}
+	
+	const uint8_t* bytes = [archive bytes];
+	const uint8_t* end = bytes + [archive length];
+	const uint8_t* block;
+	uint32_t length, version, count;
+	
+	if([archive length] < 4 || memcmp(bytes, kArchiveMagic, 4) != 0) {
+		NSLog(@"+++ [[ERROR]] WebTemplateRegistry: %@ is not a template archive", path);
+		return 0;
+	}
+	bytes += 4;
+	if(!archiveReadUInt32(&bytes, end, &version) || version != kArchiveVersion) {
+		NSLog(@"+++ [[ERROR]] WebTemplateRegistry: Unsupported template archive version in %@, rebuild it with fmtool -t", path);
+		return 0;
+	}
+	
+	//Matchers may split markers differently, so the archive is only used with the matcher it was made with.
+	if(!archiveReadBytes(&bytes, end, &block, &length)) return 0;
+	NSString* matcherName = [[[NSString alloc] initWithBytes:block length:length encoding:NSUTF8StringEncoding] autorelease];
+	if(![matcherName isEqualToString:NSStringFromClass([WebTemplateEnginePool matcherClass])]) {
+		NSLog(@"WebTemplateRegistry: Ignoring %@, compiled with %@ but the application uses %@", 
+			  path, matcherName, NSStringFromClass([WebTemplateEnginePool matcherClass]));
+		return 0;
+	}
+	
+	if(!archiveReadUInt32(&bytes, end, &count)) return 0;
+	
+	NSString* resourcePath = [path stringByDeletingLastPathComponent];
+	NSUInteger loaded = 0;
+	for(uint32_t i=0; i<count; i++) {
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		
+		const uint8_t* sourceBytes, *markerBytes;
+		uint32_t modified, size, sourceLength, markerLength;
+		if(!archiveReadBytes(&bytes, end, &block, &length) || 
+		   !archiveReadUInt32(&bytes, end, &modified) || !archiveReadUInt32(&bytes, end, &size) ||
+		   !archiveReadBytes(&bytes, end, &sourceBytes, &sourceLength) || !archiveReadBytes(&bytes, end, &markerBytes, &markerLength)) {
+			NSLog(@"+++ [[ERROR]] WebTemplateRegistry: Template archive %@ is truncated", path);
+			[pool drain];
+			break;
+		}
+		
+		NSString* name = [[[NSString alloc] initWithBytes:block length:length encoding:NSUTF8StringEncoding] autorelease];
+		NSString* templatePath = [resourcePath stringByAppendingPathComponent:name];
+		
+		//A template changed after the archive was built is loaded from its file instead
+		struct stat st;
+		if(stat([templatePath fileSystemRepresentation], &st) == 0 && ((uint32_t)st.st_mtime != modified || (uint32_t)st.st_size != size)) {
+			NSLog(@"WebTemplateRegistry: %@ has changed since it was archived, it will be loaded from its file", name);
+			[pool drain];
+			continue;
+		}
+		
+		//The template bytes stay in the mapped archive
+		NSData* data = [NSData dataWithBytesNoCopy:(void*)sourceBytes length:sourceLength freeWhenDone:NO];
+		NSString* string = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+		NSData* markers = [NSData dataWithBytesNoCopy:(void*)markerBytes length:markerLength freeWhenDone:NO];
+		MGCompiledTemplate* compiled = [[[MGCompiledTemplate alloc] initWithTemplate:string archivedMarkers:markers] autorelease];
+		
+		if(!compiled) {
+			NSLog(@"+++ [[ERROR]] WebTemplateRegistry: Archived template %@ is invalid, it will be loaded from its file", name);
+		} else {
+			WebTemplateEntry* entry = [[WebTemplateEntry alloc] _initWithName:name 
+																		 path:templatePath 
+																		 data:data 
+															 compiledTemplate:compiled 
+																	 modified:modified 
+																		 size:size];
+			[self _publishEntry:entry];
+			[entry release];
+			loaded++;
+		}
+		[pool drain];
+	}
+	
+	//Entries reference the mapped bytes, so the mapping lives as long as the registry
+	pthread_rwlock_wrlock(&m_lock);
+	[m_archives addObject:archive];
+	pthread_rwlock_unlock(&m_lock);
+	
+	return loaded;
+}
+
++ (BOOL)writeArchiveOfTemplatesAtPaths:(NSArray*)paths 
+								engine:(MGTemplateEngine*)engine 
+								toPath:(NSString*)archivePath 
+								errors:(NSMutableArray*)errors {
+	NSMutableData* archive = [NSMutableData dataWithCapacity:64 * 1024];
+	[archive appendBytes:kArchiveMagic length:4];
+	archiveAppendUInt32(archive, kArchiveVersion);
+	archiveAppendString(archive, NSStringFromClass([[engine matcher] class]));
+	archiveAppendUInt32(archive, (uint32_t)[paths count]);
+	
+	NSUInteger errorCount = [errors count];
+	for(NSString* path in paths) {
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		NSString* name = [path lastPathComponent];
+		
+		struct stat st;
+		NSData* data = [NSData dataWithContentsOfFile:path];
+		NSString* string = (data) ? [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease] : nil;
+		if(stat([path fileSystemRepresentation], &st) != 0 || !string) {
+			[errors addObject:froth_str(@"%@: unable to read the template as utf8", name)];
+			[pool drain];
+			continue;
+		}
+		
+		MGCompiledTemplate* compiled = [engine compileTemplate:string];
+		if(!compiled) {
+			[errors addObject:froth_str(@"%@: unable to compile the template", name)];
+			[pool drain];
+			continue;
+		}
+		NSArray* blockErrors = [engine blockErrorsInCompiledTemplate:compiled];
+		for(NSString* blockError in blockErrors) {
+			[errors addObject:froth_str(@"%@: %@", name, blockError)];
+		}
+		
+		NSData* markers = [compiled archivedMarkers];
+		archiveAppendString(archive, name);
+		archiveAppendUInt32(archive, (uint32_t)st.st_mtime);
+		archiveAppendUInt32(archive, (uint32_t)st.st_size);
+		archiveAppendBytes(archive, [data bytes], (uint32_t)[data length]);
+		archiveAppendBytes(archive, [markers bytes], (uint32_t)[markers length]);
+		[pool drain];
+	}
+	
+	if([errors count] > errorCount) {
+		return NO;
+	}
+	return [archive writeToFile:archivePath atomically:YES];
+}
+
+- (NSArray*)templateNames {
+	pthread_rwlock_rdlock(&m_lock);
+	NSArray* names = [m_entries allKeys];
+	pthread_rwlock_unlock(&m_lock);
+	return names;
+}
+
+- (void)removeAllTemplates {
+	pthread_rwlock_wrlock(&m_lock);
+	[m_entries removeAllObjects];
+	pthread_rwlock_unlock(&m_lock);
+}
+
+@end
+
+@implementation WebTemplateRegistry (Private)
+
+- (void)_publishEntry:(WebTemplateEntry*)entry {
+	pthread_rwlock_wrlock(&m_lock);
+	[m_entries setObject:entry forKey:[entry name]];
+	pthread_rwlock_unlock(&m_lock);
+}
+
+@end
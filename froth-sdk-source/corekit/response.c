@@ -38,7 +38,10 @@
 #include "sdb.h"
 
 #include <libxml/parser.h>
-#include <libxml/tree.h>
+
+
+#define SDB_RESPONSE_BLOCK_SIZE		8192
+#define SDB_RESPONSE_MIN_CAPACITY	16
 
 
 /**
@@ -72,7 +75,7 @@ void sdb_response_init(struct sdb_response* r)
 struct sdb_response_internal* sdb_response_internal_allocate(void)
 {
 	struct sdb_response_internal* r = (struct sdb_response_internal*) malloc(sizeof(struct sdb_response_internal));
-	r->doc = NULL;
+	r->strings = NULL;
 	r->next_token = NULL;
 	r->errout = NULL;
 	r->next = NULL;
@@ -91,6 +94,8 @@ void sdb_response_cleanup(struct sdb_response* r)
 	int i;
 	struct sdb_response_internal* p;
 	struct sdb_response_internal* next = NULL;
+	struct sdb_response_block* b;
+	struct sdb_response_block* next_block = NULL;
 	
 	
 	// Free the response
@@ -113,8 +118,9 @@ void sdb_response_cleanup(struct sdb_response* r)
 	for (p = r->internal; p != NULL; p = next) {
 		next = p->next;
 		
-		if (p->doc != NULL) {
-			xmlFreeDoc(p->doc);
+		for (b = p->strings; b != NULL; b = next_block) {
+			next_block = b->next;
+			free(b);
 		}
 		
 		free(p);
@@ -210,788 +216,612 @@ void sdb_response_print(FILE* f, struct sdb_response* r)
 }
 
 
+
+
 /**
- * Parse the response
- * 
- * @param response the response data structure
- * @param buffer the buffer to parse
- * @param length the length of the data in the buffer
- * @return SDB_OK if no errors occurred
+ * The result node being parsed
  */
-int sdb_response_parse(struct sdb_response* response, const char* buffer, size_t length)
+enum sdb_response_section
 {
-	// Parse the XML
+	SDB_S_NONE,
+	SDB_S_ERRORS,
+	SDB_S_METADATA,
+	SDB_S_DOMAINS,
+	SDB_S_DOMAIN_METADATA,
+	SDB_S_ATTRIBUTES,
+	SDB_S_ITEMS
+};
+
+
+/**
+ * What the text of the current node is collected for
+ */
+enum sdb_response_collect
+{
+	SDB_C_NONE,
+	SDB_C_ERROR_CODE,
+	SDB_C_ERROR_MESSAGE,
+	SDB_C_BOX_USAGE,
+	SDB_C_NEXT_TOKEN,
+	SDB_C_DOMAIN_NAME,
+	SDB_C_LONG,
+	SDB_C_ATTRIBUTE_NAME,
+	SDB_C_ATTRIBUTE_VALUE,
+	SDB_C_ITEM_NAME
+};
+
+
+/**
+ * The state of the SAX parser
+ */
+struct sdb_response_parser
+{
+	struct sdb_response* response;
+	xmlParserCtxtPtr context;
+	int result;
 	
-	response->internal->doc = xmlReadMemory(buffer, length, "response.xml", NULL, 0);
-	if (response->internal->doc == NULL) return SDB_E_INVALID_XML_RESPONSE;
 	
+	// Position
 	
-	// Get the root node
+	int depth;
+	int section;
+	int ignore_depth;
 	
-	xmlNodePtr root = xmlDocGetRootElement(response->internal->doc);
 	
+	// The text of the current node
 	
-	// Iterate over the root node
+	int collect;
+	long* collect_long;
+	char* text;
+	size_t text_size;
+	size_t text_capacity;
 	
-	xmlNodePtr cur;
-	for (cur = root->children; cur != NULL; cur = cur->next) {
-		
-		
-		// Error node
-		
-		if (strcmp(cur->name, "Errors") == 0) {
-			SDB_SAFE(sdb_response_parse_errors(response, cur));
-			continue;
-		}
-		
-		
-		// Response metadata
-		
-		if (strcmp(cur->name, "ResponseMetadata") == 0) {
-			SDB_SAFE(sdb_response_parse_metadata(response, cur));
-			continue;
-		}
-		
-		
-		// List domains result
-		
-		if (strcmp(cur->name, "ListDomainsResult") == 0) {
-			SDB_SAFE(sdb_response_parse_domains(response, cur));
-			continue;
-		}
-		
-		
-		// Domain metadata result
-		
-		if (strcmp(cur->name, "DomainMetadataResult") == 0) {
-			SDB_SAFE(sdb_response_parse_domain_metadata(response, cur));
-			continue;
-		}
-		
-		
-		// Get attributes result
-		
-		if (strcmp(cur->name, "GetAttributesResult") == 0) {
-			SDB_SAFE(sdb_response_parse_attributes(response, cur));
-			continue;
-		}
-		
-		
-		// Get the items with attributes result
-		
-		if (strcmp(cur->name, "QueryResult") == 0 || strcmp(cur->name, "QueryWithAttributesResult") == 0 || strcmp(cur->name, "SelectResult") == 0) {
-			SDB_SAFE(sdb_response_parse_items(response, cur));
-			continue;
-		}
-		
-		
-		// The list of response nodes to ignore
-		
-		if (strcmp(cur->name, "RequestID") == 0) continue;
-		if (strcmp(cur->name, "RequestId") == 0) continue;
-		
-		
-		// Deal with errors here
-		
-		if (response->internal->errout != NULL) {
-			fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS response\n", cur->name);
-		}
-		return SDB_E_INVALID_ERR_RESPONSE;
-	}
 	
+	// Allocated size of the response array and of the attributes of the last item
 	
-	return SDB_OK;
-}
+	int capacity;
+	int item_capacity;
+};
 
 
 /**
- * Parse the errors section of a response
+ * Copy a string into the response's string blocks
  * 
- * @param response the response data structure (must be initalized)
- * @param errors the errors node
- * @return SDB_OK if no errors occurred
+ * @param r the internal response structure
+ * @param s the string
+ * @param length the length of the string
+ * @return the copy, valid until the response is cleaned up
  */
-int sdb_response_parse_errors(struct sdb_response* response, xmlNodePtr errors)
+static char* sdb_response_copy(struct sdb_response_internal* r, const char* s, size_t length)
 {
-	xmlNodePtr topcur, cur, content; int i;
-	for (topcur = errors->children; topcur != NULL; topcur = topcur->next) {
-		
-		
-		// Handle an error node
-		
-		if (strcmp(topcur->name, "Error") == 0) {
-			response->num_errors++;
-			
-			for (cur = topcur->children; cur != NULL; cur = cur->next) {
-				
-				// Parse the error code
-				
-				if (strcmp(cur->name, "Code") == 0) {
-					assert(cur->children != NULL);
-					content = cur->children;
-					assert(XML_GET_CONTENT(content) != NULL);
-					
-					if (response->error == 0) {
-						for (i = 0; i < SDB_AWS_NUM_ERRORS; i++) {
-							if (strcmp(SDB_AWS_ERRORS[i], XML_GET_CONTENT(content)) == 0) {
-								response->error = i;
-							}
-						}
-						
-						if (response->error == 0) {
-							response->error = SDB_AWS_NUM_ERRORS;
-							if (response->internal->errout != NULL) {
-								fprintf(response->internal->errout, "SimpleDB ERROR: Unknown error code \"%s\"\n", XML_GET_CONTENT(content));
-							}
-						}
-					}
-					
-					continue;
-				}
-				
-				
-				// Parse the error message
-				
-				if (strcmp(cur->name, "Message") == 0) {
-					assert(cur->children != NULL);
-					content = cur->children;
-					assert(XML_GET_CONTENT(content) != NULL);
-					
-					if (response->error_message == NULL) response->error_message = XML_GET_CONTENT(content);
-					
-					if (response->internal->errout != NULL) {
-						fprintf(response->internal->errout, "SimpleDB ERROR: %s\n", XML_GET_CONTENT(content));
-					}
-					continue;
-				}
-				
-				
-				// The list of nodes to ignore
-				
-				if (strcmp(cur->name, "BoxUsage") == 0) continue;
-				
-				
-				// Invalid Amazon response
-				
-				if (response->internal->errout != NULL) {
-					fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS error response\n", cur->name);
-				}
-				return SDB_E_INVALID_ERR_RESPONSE;
-			}
-			
-			continue;
-		}
-		
-		
-		// The list of nodes to ignore
-		
-		if (strcmp(cur->name, "BoxUsage") == 0) continue;
-		
-				
-		// Handle errors
-		
-		if (response->internal->errout != NULL) {
-			fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS error response\n", topcur->name);
-		}
-		return SDB_E_INVALID_ERR_RESPONSE;
+	struct sdb_response_block* b = r->strings;
+	
+	if (b == NULL || b->size + length + 1 > b->capacity) {
+		size_t capacity = length + 1 > SDB_RESPONSE_BLOCK_SIZE ? length + 1 : SDB_RESPONSE_BLOCK_SIZE;
+		b = (struct sdb_response_block*) malloc(sizeof(struct sdb_response_block) + capacity);
+		assert(b);
+		b->size = 0;
+		b->capacity = capacity;
+		b->next = r->strings;
+		r->strings = b;
 	}
 	
-	return SDB_OK;
+	char* c = b->data + b->size;
+	memcpy(c, s, length);
+	c[length] = '\0';
+	b->size += length + 1;
+	return c;
 }
 
 
 /**
- * Parse the metadata section of a response
+ * Make room for one more element in an array of the response
  * 
- * @param response the response data structure (must be initalized)
- * @param metadata the metadata node
- * @return SDB_OK if no errors occurred
+ * @param array the array
+ * @param size the number of elements in use
+ * @param capacity the allocated number of elements
+ * @param element the size of an element
+ * @return the array, possibly moved
  */
-int sdb_response_parse_metadata(struct sdb_response* response, xmlNodePtr metadata)
+static void* sdb_response_grow(void* array, int size, int* capacity, size_t element)
 {
-	xmlNodePtr cur, content;
-	for (cur = metadata->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The box usage statistic
-		
-		if (strcmp(cur->name, "BoxUsage") == 0) {
-			assert(cur->children != NULL);
-			content = cur->children;
-			assert(XML_GET_CONTENT(content) != NULL);
-			
-			char* e = NULL;
-			response->box_usage = strtod(XML_GET_CONTENT(content), &e);
-			if (response->box_usage < 0 || e == NULL || *e != '\0') {
-				response->box_usage = 0;
-				if (response->internal->errout != NULL) {
-					fprintf(response->internal->errout, "SimpleDB ERROR: Invalid box usage \"%s\" in the AWS meta-data response\n", XML_GET_CONTENT(content));
-				}
-				return SDB_E_INVALID_META_RESPONSE;
-			}
-			continue;
-		}
-		
-		
-		// The list of nodes to ignore
-		
-		if (strcmp(cur->name, "RequestID") == 0) continue;
-		if (strcmp(cur->name, "RequestId") == 0) continue;
-		
-		
-		// Handle errors
-		
-		if (response->internal->errout != NULL) {
-			fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS meta-data response\n", cur->name);
-		}
-		return SDB_E_INVALID_META_RESPONSE;
-	}
+	if (size < *capacity) return array;
 	
-	return SDB_OK;
+	*capacity = *capacity < SDB_RESPONSE_MIN_CAPACITY ? SDB_RESPONSE_MIN_CAPACITY : 2 * *capacity;
+	array = realloc(array, *capacity * element);
+	assert(array);
+	return array;
 }
 
 
 /**
- * Parse the list of domains
+ * Stop parsing with an error
  * 
- * @param response the response data structure (must be initalized)
- * @param domains the list of domains
- * @return SDB_OK if no errors occurred
+ * @param p the parser state
+ * @param code the error code
  */
-int sdb_response_parse_domains(struct sdb_response* response, xmlNodePtr domains)
+static void sdb_response_fail(struct sdb_response_parser* p, int code)
 {
-	xmlNodePtr cur, content;
-	int size = 0;
-	
-	
-	// Count the domains and determine whether we have more incoming data
-	 
-	response->has_more = FALSE;
-	
-	for (cur = domains->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The domain name
-		
-		if (strcmp(cur->name, "DomainName") == 0) {
-			size++;
-			continue;
-		}
-		
-		
-		// The next token
-		
-		if (strcmp(cur->name, "NextToken") == 0) {
-			assert(cur->children != NULL);
-			content = cur->children;
-			response->internal->next_token = XML_GET_CONTENT(content); 
-			assert(response->internal->next_token != NULL);
-			response->has_more = TRUE;
-			continue;
-		}
-		
-		
-		// The list of nodes to ignore
-		
-		if (strcmp(cur->name, "RequestID") == 0) continue;
-		if (strcmp(cur->name, "RequestId") == 0) continue;
-		
-		
-		// Handle errors
-		
-		if (response->internal->errout != NULL) {
-			fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS list of domains\n", cur->name);
-		}
-		return SDB_E_INVALID_META_RESPONSE;
+	if (p->result == SDB_OK) p->result = code;
+	xmlStopParser(p->context);
+}
+
+
+/**
+ * Stop parsing because of an unexpected node
+ * 
+ * @param p the parser state
+ * @param name the node name
+ * @param where the part of the response it is in
+ * @param code the error code
+ */
+static void sdb_response_invalid_node(struct sdb_response_parser* p, const char* name, const char* where, int code)
+{
+	if (p->response->internal->errout != NULL) {
+		fprintf(p->response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS %s\n", name, where);
 	}
-	
-	
-	// Allocate the memory if this is a new result set, otherwise prepare to append
-	
-	int start = 0;
+	sdb_response_fail(p, code);
+}
+
+
+/**
+ * Start collecting the text of the current node
+ * 
+ * @param p the parser state
+ * @param collect what the text is for
+ */
+static void sdb_response_collect(struct sdb_response_parser* p, int collect)
+{
+	p->collect = collect;
+	p->text_size = 0;
+}
+
+
+/**
+ * Start a list result, or prepare to append to the result of a previous request
+ * 
+ * @param p the parser state
+ * @param type the result type
+ */
+static void sdb_response_start_list(struct sdb_response_parser* p, int type)
+{
+	struct sdb_response* response = p->response;
+	response->has_more = FALSE;
 	
 	if (response->type == SDB_R_NONE) {
-		
-		response->size = size;
-		response->type = SDB_R_DOMAIN_LIST;
-		response->domains = (char**) malloc(size * sizeof(char*));  
+		response->size = 0;
+		response->type = type;
+		response->items = NULL;
+		p->capacity = 0;
 	}
-	else if (response->type == SDB_R_DOMAIN_LIST) {
-		
-		char** old = response->domains;
-		int newsize = response->size + size;
-		start = response->size;
-		
-		response->domains = (char**) malloc(newsize * sizeof(char*));
-		memcpy(response->domains, old, response->size * sizeof(char*));
-		free(old);
-		
-		response->size = newsize;
+	else if (response->type == type) {
+		p->capacity = response->size;
 	}
 	else assert(0);
+}
+
+
+/**
+ * Check whether a node is in the list of nodes to ignore
+ * 
+ * @param name the node name
+ * @return TRUE if it should be ignored
+ */
+static int sdb_response_is_ignored(const char* name)
+{
+	return strcmp(name, "RequestID") == 0 || strcmp(name, "RequestId") == 0;
+}
+
+
+/**
+ * Handle a node directly under the root
+ * 
+ * @param p the parser state
+ * @param name the node name
+ */
+static void sdb_response_start_section(struct sdb_response_parser* p, const char* name)
+{
+	struct sdb_response* response = p->response;
 	
-	
-	
-	// Pull out the domain names 
-	
-	int index = start;
-	for (cur = domains->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The domain name
-		
-		if (strcmp(cur->name, "DomainName") == 0) {
-			assert(cur->children != NULL);
-			content = cur->children;
-			assert(XML_GET_CONTENT(content) != NULL);
-			response->domains[index++] = XML_GET_CONTENT(content); 
-		}
+	if (strcmp(name, "Errors") == 0) {
+		p->section = SDB_S_ERRORS;
+	}
+	else if (strcmp(name, "ResponseMetadata") == 0) {
+		p->section = SDB_S_METADATA;
+	}
+	else if (strcmp(name, "ListDomainsResult") == 0) {
+		p->section = SDB_S_DOMAINS;
+		sdb_response_start_list(p, SDB_R_DOMAIN_LIST);
+	}
+	else if (strcmp(name, "DomainMetadataResult") == 0) {
+		assert(response->type == SDB_R_NONE);
+		p->section = SDB_S_DOMAIN_METADATA;
+		response->type = SDB_R_DOMAIN_METADATA;
+		response->domain_metadata = (struct sdb_domain_metadata*) malloc(sizeof(struct sdb_domain_metadata));
+		memset(response->domain_metadata, 0, sizeof(struct sdb_domain_metadata));
+	}
+	else if (strcmp(name, "GetAttributesResult") == 0) {
+		p->section = SDB_S_ATTRIBUTES;
+		sdb_response_start_list(p, SDB_R_ATTRIBUTE_LIST);
+	}
+	else if (strcmp(name, "QueryResult") == 0 || strcmp(name, "QueryWithAttributesResult") == 0 || strcmp(name, "SelectResult") == 0) {
+		p->section = SDB_S_ITEMS;
+		sdb_response_start_list(p, SDB_R_ITEM_LIST);
+	}
+	else if (sdb_response_is_ignored(name)) {
+		p->ignore_depth = p->depth;
+	}
+	else {
+		sdb_response_invalid_node(p, name, "response", SDB_E_INVALID_ERR_RESPONSE);
 	}
-	
-	assert(index - start == size);
-	
-	return SDB_OK;
 }
 
 
-#define SDB_RESPONSE_GET_LONG(variable)																	\
-	{																									\
-		assert(cur->children != NULL);																	\
-		content = cur->children;																		\
-		assert(XML_GET_CONTENT(content) != NULL);														\
-																										\
-		char* e = NULL;																					\
-		response->variable = strtol(XML_GET_CONTENT(content), &e, 10);									\
-		if (e == NULL || *e != '\0') {																	\
-			if (!(e[0] == '.' && e[1] == '0' && e[2] == '\0')) { 										\
-				response->variable = 0;																	\
-				if (response->internal->errout != NULL) {												\
-					fprintf(response->internal->errout, "SimpleDB ERROR: Invalid integer value "		\
-							"\"%s\" in the AWS response\n", XML_GET_CONTENT(content));					\
-				}																						\
-				return SDB_E_INVALID_META_RESPONSE;														\
-			}																							\
-		}																								\
-		continue;																						\
-	}
+/**
+ * Append an attribute to an array of attributes
+ * 
+ * @param attributes the array
+ * @param size the number of attributes
+ * @param capacity the allocated number of attributes
+ */
+static void sdb_response_add_attribute(struct sdb_attribute** attributes, int* size, int* capacity)
+{
+	*attributes = (struct sdb_attribute*) sdb_response_grow(*attributes, *size, capacity, sizeof(struct sdb_attribute));
+	(*attributes)[*size].name = NULL;
+	(*attributes)[*size].value = NULL;
+	(*size)++;
+}
+
 
 /**
- * Parse the domain metadata
+ * Handle a node in the result nodes
  * 
- * @param response the response data structure (must be initalized)
- * @param domain_metadata the domain metadata
- * @return SDB_OK if no errors occurred
+ * @param p the parser state
+ * @param name the node name
  */
-int sdb_response_parse_domain_metadata(struct sdb_response* response, xmlNodePtr domain_metadata)
+static void sdb_response_start_node(struct sdb_response_parser* p, const char* name)
 {
-	// Allocate the memory
-	
-	assert(response->type == SDB_R_NONE);
-	response->type = SDB_R_DOMAIN_METADATA;
-	response->domain_metadata = (struct sdb_domain_metadata*) malloc(sizeof(struct sdb_domain_metadata));
-	
-	
-	// Parse the response
-	
-	xmlNodePtr cur, content;
-	for (cur = domain_metadata->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The metadata
-		
-		if (strcmp(cur->name, "Timestamp") == 0) SDB_RESPONSE_GET_LONG(domain_metadata->timestamp);
-		if (strcmp(cur->name, "ItemCount") == 0) SDB_RESPONSE_GET_LONG(domain_metadata->item_count);
-		if (strcmp(cur->name, "AttributeValueCount") == 0) SDB_RESPONSE_GET_LONG(domain_metadata->attr_value_count);
-		if (strcmp(cur->name, "AttributeNameCount") == 0) SDB_RESPONSE_GET_LONG(domain_metadata->attr_name_count);
-		if (strcmp(cur->name, "ItemNamesSizeBytes") == 0) SDB_RESPONSE_GET_LONG(domain_metadata->item_names_size);
-		if (strcmp(cur->name, "AttributeValuesSizeBytes") == 0) SDB_RESPONSE_GET_LONG(domain_metadata->attr_values_size);
-		if (strcmp(cur->name, "AttributeNamesSizeBytes") == 0) SDB_RESPONSE_GET_LONG(domain_metadata->attr_names_size);
-		
-		
-		// The list of nodes to ignore
-		
-		if (strcmp(cur->name, "RequestID") == 0) continue;
-		if (strcmp(cur->name, "RequestId") == 0) continue;
-		
+	struct sdb_response* response = p->response;
+	struct sdb_item* item;
+	
+	switch (p->section) {
+		
+		case SDB_S_ERRORS:
+			if (p->depth == 3 && strcmp(name, "Error") == 0) { response->num_errors++; return; }
+			if (p->depth == 4 && strcmp(name, "Code") == 0) { sdb_response_collect(p, SDB_C_ERROR_CODE); return; }
+			if (p->depth == 4 && strcmp(name, "Message") == 0) { sdb_response_collect(p, SDB_C_ERROR_MESSAGE); return; }
+			if (strcmp(name, "BoxUsage") == 0) { p->ignore_depth = p->depth; return; }
+			sdb_response_invalid_node(p, name, "error response", SDB_E_INVALID_ERR_RESPONSE);
+			return;
+		
+		case SDB_S_METADATA:
+			if (p->depth == 3 && strcmp(name, "BoxUsage") == 0) { sdb_response_collect(p, SDB_C_BOX_USAGE); return; }
+			if (p->depth == 3 && sdb_response_is_ignored(name)) { p->ignore_depth = p->depth; return; }
+			sdb_response_invalid_node(p, name, "meta-data response", SDB_E_INVALID_META_RESPONSE);
+			return;
+		
+		case SDB_S_DOMAINS:
+			if (p->depth == 3 && strcmp(name, "DomainName") == 0) {
+				response->domains = (char**) sdb_response_grow(response->domains, response->size, &p->capacity, sizeof(char*));
+				sdb_response_collect(p, SDB_C_DOMAIN_NAME);
+				return;
+			}
+			if (p->depth == 3 && strcmp(name, "NextToken") == 0) { sdb_response_collect(p, SDB_C_NEXT_TOKEN); return; }
+			if (p->depth == 3 && sdb_response_is_ignored(name)) { p->ignore_depth = p->depth; return; }
+			sdb_response_invalid_node(p, name, "list of domains", SDB_E_INVALID_META_RESPONSE);
+			return;
+		
+		case SDB_S_DOMAIN_METADATA:
+			if (p->depth == 3) {
+				struct sdb_domain_metadata* m = response->domain_metadata;
+				p->collect_long = NULL;
+				
+				if (strcmp(name, "Timestamp") == 0) p->collect_long = &m->timestamp;
+				else if (strcmp(name, "ItemCount") == 0) p->collect_long = &m->item_count;
+				else if (strcmp(name, "AttributeValueCount") == 0) p->collect_long = &m->attr_value_count;
+				else if (strcmp(name, "AttributeNameCount") == 0) p->collect_long = &m->attr_name_count;
+				else if (strcmp(name, "ItemNamesSizeBytes") == 0) p->collect_long = &m->item_names_size;
+				else if (strcmp(name, "AttributeValuesSizeBytes") == 0) p->collect_long = &m->attr_values_size;
+				else if (strcmp(name, "AttributeNamesSizeBytes") == 0) p->collect_long = &m->attr_names_size;
+				
+				if (p->collect_long != NULL) { sdb_response_collect(p, SDB_C_LONG); return; }
+				if (sdb_response_is_ignored(name)) { p->ignore_depth = p->depth; return; }
+			}
+			sdb_response_invalid_node(p, name, "domain meta-data response", SDB_E_INVALID_META_RESPONSE);
+			return;
 		
-		// Handle errors
+		case SDB_S_ATTRIBUTES:
+			if (p->depth == 3 && strcmp(name, "Attribute") == 0) {
+				sdb_response_add_attribute(&response->attributes, &response->size, &p->capacity);
+				return;
+			}
+			if (p->depth == 3 && strcmp(name, "NextToken") == 0) { sdb_response_collect(p, SDB_C_NEXT_TOKEN); return; }
+			if (p->depth == 3 && sdb_response_is_ignored(name)) { p->ignore_depth = p->depth; return; }
+			if (p->depth == 4 && strcmp(name, "Name") == 0) { sdb_response_collect(p, SDB_C_ATTRIBUTE_NAME); return; }
+			if (p->depth == 4 && strcmp(name, "Value") == 0) { sdb_response_collect(p, SDB_C_ATTRIBUTE_VALUE); return; }
+			sdb_response_invalid_node(p, name, p->depth == 4 ? "attribute" : "list of attributes", SDB_E_INVALID_META_RESPONSE);
+			return;
+		
+		case SDB_S_ITEMS:
+			if (p->depth == 3 && (strcmp(name, "Item") == 0 || strcmp(name, "ItemName") == 0)) {
+				response->items = (struct sdb_item*) sdb_response_grow(response->items, response->size, &p->capacity, sizeof(struct sdb_item));
+				item = &response->items[response->size++];
+				item->name = NULL;
+				item->size = 0;
+				item->attributes = NULL;
+				p->item_capacity = 0;
+				
+				if (strcmp(name, "ItemName") == 0) sdb_response_collect(p, SDB_C_ITEM_NAME);
+				return;
+			}
+			if (p->depth == 3 && strcmp(name, "NextToken") == 0) { sdb_response_collect(p, SDB_C_NEXT_TOKEN); return; }
+			if (p->depth == 3 && sdb_response_is_ignored(name)) { p->ignore_depth = p->depth; return; }
+			if (p->depth == 4 && strcmp(name, "Name") == 0) { sdb_response_collect(p, SDB_C_ITEM_NAME); return; }
+			if (p->depth == 4 && strcmp(name, "Attribute") == 0) {
+				item = &response->items[response->size - 1];
+				sdb_response_add_attribute(&item->attributes, &item->size, &p->item_capacity);
+				return;
+			}
+			if (p->depth == 5 && strcmp(name, "Name") == 0) { sdb_response_collect(p, SDB_C_ATTRIBUTE_NAME); return; }
+			if (p->depth == 5 && strcmp(name, "Value") == 0) { sdb_response_collect(p, SDB_C_ATTRIBUTE_VALUE); return; }
+			sdb_response_invalid_node(p, name, "list of items", SDB_E_INVALID_META_RESPONSE);
+			return;
 		
-		if (response->internal->errout != NULL) {
-			fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS domain meta-data response\n", cur->name);
-		}
-		return SDB_E_INVALID_META_RESPONSE;
+		default: assert(0);
 	}
-	
-	return SDB_OK;
 }
 
 
 /**
- * Parse the list of attributes
+ * Get the attribute being parsed
  * 
- * @param response the response data structure (must be initalized)
- * @param attributes the list of attributes
- * @return SDB_OK if no errors occurred
+ * @param p the parser state
+ * @return the attribute
  */
-int sdb_response_parse_attributes(struct sdb_response* response, xmlNodePtr attributes)
+static struct sdb_attribute* sdb_response_current_attribute(struct sdb_response_parser* p)
 {
-	xmlNodePtr cur, cur2, content;
-	int size = 0;
+	struct sdb_response* response = p->response;
 	
+	if (p->section == SDB_S_ATTRIBUTES) return &response->attributes[response->size - 1];
 	
-	// Count the attributes and determine whether we have more incoming data
-	 
-	response->has_more = FALSE;
+	struct sdb_item* item = &response->items[response->size - 1];
+	return &item->attributes[item->size - 1];
+}
+
+
+/**
+ * Use the collected text of a node
+ * 
+ * @param p the parser state
+ */
+static void sdb_response_collected(struct sdb_response_parser* p)
+{
+	struct sdb_response* response = p->response;
+	struct sdb_response_internal* internal = response->internal;
+	char* text = p->text;
+	char* e = NULL;
+	int i;
 	
-	for (cur = attributes->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The attribute
+	text[p->text_size] = '\0';
+	
+	switch (p->collect) {
 		
-		if (strcmp(cur->name, "Attribute") == 0) {
-			size++;
-			continue;
-		}
+		case SDB_C_ERROR_CODE:
+			if (response->error == 0) {
+				for (i = 0; i < SDB_AWS_NUM_ERRORS; i++) {
+					if (strcmp(SDB_AWS_ERRORS[i], text) == 0) {
+						response->error = i;
+					}
+				}
+				
+				if (response->error == 0) {
+					response->error = SDB_AWS_NUM_ERRORS;
+					if (internal->errout != NULL) {
+						fprintf(internal->errout, "SimpleDB ERROR: Unknown error code \"%s\"\n", text);
+					}
+				}
+			}
+			break;
 		
+		case SDB_C_ERROR_MESSAGE:
+			if (response->error_message == NULL) response->error_message = sdb_response_copy(internal, text, p->text_size);
+			
+			if (internal->errout != NULL) {
+				fprintf(internal->errout, "SimpleDB ERROR: %s\n", text);
+			}
+			break;
 		
-		// The next token
+		case SDB_C_BOX_USAGE:
+			response->box_usage = strtod(text, &e);
+			if (response->box_usage < 0 || e == NULL || *e != '\0') {
+				response->box_usage = 0;
+				if (internal->errout != NULL) {
+					fprintf(internal->errout, "SimpleDB ERROR: Invalid box usage \"%s\" in the AWS meta-data response\n", text);
+				}
+				sdb_response_fail(p, SDB_E_INVALID_META_RESPONSE);
+			}
+			break;
 		
-		if (strcmp(cur->name, "NextToken") == 0) {
-			assert(cur->children != NULL);
-			content = cur->children;
-			response->internal->next_token = XML_GET_CONTENT(content); 
-			assert(response->internal->next_token != NULL);
+		case SDB_C_NEXT_TOKEN:
+			internal->next_token = sdb_response_copy(internal, text, p->text_size);
 			response->has_more = TRUE;
-			continue;
-		}
-		
-		
-		// The list of nodes to ignore
+			break;
+		
+		case SDB_C_DOMAIN_NAME:
+			response->domains[response->size++] = sdb_response_copy(internal, text, p->text_size);
+			break;
+		
+		case SDB_C_LONG:
+			*p->collect_long = strtol(text, &e, 10);
+			if (e == NULL || *e != '\0') {
+				if (!(e[0] == '.' && e[1] == '0' && e[2] == '\0')) {
+					*p->collect_long = 0;
+					if (internal->errout != NULL) {
+						fprintf(internal->errout, "SimpleDB ERROR: Invalid integer value \"%s\" in the AWS response\n", text);
+					}
+					sdb_response_fail(p, SDB_E_INVALID_META_RESPONSE);
+				}
+			}
+			break;
 		
-		if (strcmp(cur->name, "RequestID") == 0) continue;
-		if (strcmp(cur->name, "RequestId") == 0) continue;
+		case SDB_C_ATTRIBUTE_NAME:
+			sdb_response_current_attribute(p)->name = sdb_response_copy(internal, text, p->text_size);
+			break;
 		
+		case SDB_C_ATTRIBUTE_VALUE:
+			sdb_response_current_attribute(p)->value = p->text_size == 0 ? internal->empty_string : sdb_response_copy(internal, text, p->text_size);
+			break;
 		
-		// Handle errors
+		case SDB_C_ITEM_NAME:
+			response->items[response->size - 1].name = sdb_response_copy(internal, text, p->text_size);
+			break;
 		
-		if (response->internal->errout != NULL) {
-			fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS list of attributes\n", cur->name);
-		}
-		return SDB_E_INVALID_META_RESPONSE;
+		default: assert(0);
 	}
+}
+
+
+/**
+ * SAX callback for the start of an element
+ */
+static void sdb_response_start_element(void* ctx, const xmlChar* localname, const xmlChar* prefix, const xmlChar* URI, 
+									   int nb_namespaces, const xmlChar** namespaces, int nb_attributes, int nb_defaulted, const xmlChar** attributes)
+{
+	struct sdb_response_parser* p = (struct sdb_response_parser*) ctx;
+	const char* name = (const char*) localname;
 	
+	p->depth++;
+	if (p->result != SDB_OK || p->ignore_depth > 0 || p->depth == 1) return;
 	
-	// Allocate the memory if this is a new result set, otherwise prepare to append
 	
-	int start = 0;
+	// Nodes with text have no children
 	
-	if (response->type == SDB_R_NONE) {
-		
-		response->size = size;
-		response->type = SDB_R_ATTRIBUTE_LIST;
-		response->attributes = (struct sdb_attribute*) malloc(size * sizeof(struct sdb_attribute));  
-	}
-	else if (response->type == SDB_R_ATTRIBUTE_LIST) {
-		
-		struct sdb_attribute* old = response->attributes;
-		int newsize = response->size + size;
-		start = response->size;
-		
-		response->attributes = (struct sdb_attribute*) malloc(newsize * sizeof(struct sdb_attribute));
-		memcpy(response->attributes, old, response->size * sizeof(struct sdb_attribute));
-		free(old);
-		
-		response->size = newsize;
+	if (p->collect != SDB_C_NONE) {
+		sdb_response_invalid_node(p, name, "response", p->section == SDB_S_ERRORS ? SDB_E_INVALID_ERR_RESPONSE : SDB_E_INVALID_META_RESPONSE);
+		return;
 	}
-	else assert(0);
 	
-	
-	
-	// Pull out the attributes 
-	
-	int index = start;
-	for (cur = attributes->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The attribute name
-		
-		if (strcmp(cur->name, "Attribute") == 0) {
-			struct sdb_attribute* a = &(response->attributes[index++]);
-			a->name = a->value = NULL;
-			
-			for (cur2 = cur->children; cur2 != NULL; cur2 = cur2->next) {
-				
-				if (strcmp(cur2->name, "Name") == 0) { 
-					assert(cur2->children != NULL);
-					content = cur2->children;
-					assert(XML_GET_CONTENT(content) != NULL);
-					a->name = XML_GET_CONTENT(content);
-					continue;
-				} 
-				
-				if (strcmp(cur2->name, "Value") == 0) { 
-					if (cur2->children == NULL) {
-						a->value = response->internal->empty_string;
-						continue;
-					}
-					else {
-						content = cur2->children;
-						assert(XML_GET_CONTENT(content) != NULL);
-						a->value = XML_GET_CONTENT(content);
-						continue;
-					}
-				} 
-				
-				
-				// Handle errors
-		
-				if (response->internal->errout != NULL) {
-					fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS attribute\n", cur2->name);
-				}
-				return SDB_E_INVALID_META_RESPONSE;
-			}
-			
-			
-			// Check for incomplete attributes
-			
-			if (a->name == NULL || a->value == NULL) {
-				if (response->internal->errout != NULL) {
-					fprintf(response->internal->errout, "SimpleDB ERROR: Incomplete attribute in the AWS response\n");
-				}
-				return SDB_E_INVALID_META_RESPONSE;
-			}
-		}
+	if (p->depth == 2) {
+		sdb_response_start_section(p, name);
+	}
+	else {
+		sdb_response_start_node(p, name);
 	}
-	
-	assert(index - start == size);
-	
-	return SDB_OK;
 }
 
 
 /**
- * Parse a single item
- * 
- * @param response the response data structure
- * @param item the item data structure
- * @param node the item node
- * @return SDB_OK if no errors occurred
+ * SAX callback for the end of an element
  */
-int sdb_response_parse_item(struct sdb_response* response, struct sdb_item* item, xmlNodePtr node)
+static void sdb_response_end_element(void* ctx, const xmlChar* localname, const xmlChar* prefix, const xmlChar* URI)
 {
-	xmlNodePtr cur, cur2, content;
-	int size = 0;
-	
+	struct sdb_response_parser* p = (struct sdb_response_parser*) ctx;
+	struct sdb_response* response = p->response;
+	const char* name = (const char*) localname;
+	int depth = p->depth--;
 	
-	// Count the attributes and determine whether we have more incoming data
+	if (p->result != SDB_OK) return;
 	
-	for (cur = node->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The attribute
-		
-		if (strcmp(cur->name, "Attribute") == 0) {
-			size++;
-			continue;
-		}
-		
-		
-		// The item name
-		
-		if (strcmp(cur->name, "Name") == 0) continue;
-		
-		
-		// Handle errors
-		
-		return SDB_E_INVALID_META_RESPONSE;
+	if (p->ignore_depth > 0) {
+		if (depth == p->ignore_depth) p->ignore_depth = 0;
+		return;
 	}
 	
+	if (p->collect != SDB_C_NONE) {
+		sdb_response_collected(p);
+		p->collect = SDB_C_NONE;
+		return;
+	}
 	
-	// Allocate the memory if this is a new result set, otherwise prepare to append
-	
-	item->size = size;
-	item->attributes = (struct sdb_attribute*) malloc(size * sizeof(struct sdb_attribute));  
-	
+	if (depth == 2) {
+		p->section = SDB_S_NONE;
+		return;
+	}
 	
-	// Pull out the attributes and the item name 
 	
-	int index = 0;
-	item->name = NULL;
+	// Check for incomplete attributes and items
 	
-	for (cur = node->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The item name
-		
-		if (strcmp(cur->name, "Name") == 0) { 
-			assert(cur->children != NULL);
-			content = cur->children;
-			assert(XML_GET_CONTENT(content) != NULL);
-			item->name = XML_GET_CONTENT(content);
-			continue;
-		} 
-		
-		
-		// The attribute
-		
-		if (strcmp(cur->name, "Attribute") == 0) {
-			struct sdb_attribute* a = &(item->attributes[index++]);
-			a->name = a->value = NULL;
-			
-			for (cur2 = cur->children; cur2 != NULL; cur2 = cur2->next) {
-				
-				if (strcmp(cur2->name, "Name") == 0) { 
-					assert(cur2->children != NULL);
-					content = cur2->children;
-					assert(XML_GET_CONTENT(content) != NULL);
-					a->name = XML_GET_CONTENT(content);
-					continue;
-				} 
-				
-				if (strcmp(cur2->name, "Value") == 0) { 
-					if (cur2->children == NULL) {
-						a->value = response->internal->empty_string;
-						continue;
-					}
-					else {
-						content = cur2->children;
-						assert(XML_GET_CONTENT(content) != NULL);
-						a->value = XML_GET_CONTENT(content);
-						continue;
-					}
-				} 
-				
-				
-				// Handle errors
-		
-				return SDB_E_INVALID_META_RESPONSE;
-			}
-			
-			
-			// Check for incomplete attributes
-			
-			if (a->name == NULL || a->value == NULL) {
-				return SDB_E_INVALID_META_RESPONSE;
+	if (strcmp(name, "Attribute") == 0 && ((p->section == SDB_S_ATTRIBUTES && depth == 3) || (p->section == SDB_S_ITEMS && depth == 4))) {
+		struct sdb_attribute* a = sdb_response_current_attribute(p);
+		if (a->name == NULL || a->value == NULL) {
+			if (response->internal->errout != NULL) {
+				fprintf(response->internal->errout, "SimpleDB ERROR: Incomplete attribute in the AWS response\n");
 			}
+			sdb_response_fail(p, SDB_E_INVALID_META_RESPONSE);
+		}
+	}
+	else if (p->section == SDB_S_ITEMS && depth == 3 && response->items[response->size - 1].name == NULL) {
+		if (response->internal->errout != NULL) {
+			fprintf(response->internal->errout, "SimpleDB ERROR: Item without a name in the AWS response\n");
 		}
+		sdb_response_fail(p, SDB_E_INVALID_META_RESPONSE);
 	}
+}
+
+
+/**
+ * SAX callback for text, which may arrive in several pieces
+ */
+static void sdb_response_characters(void* ctx, const xmlChar* ch, int len)
+{
+	struct sdb_response_parser* p = (struct sdb_response_parser*) ctx;
+	if (p->collect == SDB_C_NONE || p->result != SDB_OK) return;
 	
-	assert(item->name);
-	assert(index == size);
+	if (p->text_size + len + 1 > p->text_capacity) {
+		p->text_capacity = 2 * (p->text_size + len) + 256;
+		p->text = (char*) realloc(p->text, p->text_capacity);
+		assert(p->text);
+	}
 	
-	return SDB_OK;
+	memcpy(p->text + p->text_size, ch, len);
+	p->text_size += len;
 }
 
 
 /**
- * Parse the list of items
+ * Parse the response from the SAX events of the XML, without building a tree
  * 
- * @param response the response data structure (must be initalized)
- * @param items the list of items
+ * @param response the response data structure
+ * @param buffer the buffer to parse
+ * @param length the length of the data in the buffer
  * @return SDB_OK if no errors occurred
  */
-int sdb_response_parse_items(struct sdb_response* response, xmlNodePtr items)
+int sdb_response_parse(struct sdb_response* response, const char* buffer, size_t length)
 {
-	xmlNodePtr cur, content;
-	int size = 0;
-	
-	
-	// Count the attributes and determine whether we have more incoming data
-	 
-	response->has_more = FALSE;
-	
-	for (cur = items->children; cur != NULL; cur = cur->next) {
-		
-		
-		// The item
-		
-		if (strcmp(cur->name, "Item") == 0 || strcmp(cur->name, "ItemName") == 0) {
-			size++;
-			continue;
-		}
-		
-		
-		// The next token
-		
-		if (strcmp(cur->name, "NextToken") == 0) {
-			assert(cur->children != NULL);
-			content = cur->children;
-			response->internal->next_token = XML_GET_CONTENT(content); 
-			assert(response->internal->next_token != NULL);
-			response->has_more = TRUE;
-			continue;
-		}
-		
-		
-		// The list of nodes to ignore
-		
-		if (strcmp(cur->name, "RequestID") == 0) continue;
-		if (strcmp(cur->name, "RequestId") == 0) continue;
-		
-		
-		// Handle errors
-		
-		if (response->internal->errout != NULL) {
-			fprintf(response->internal->errout, "SimpleDB ERROR: Invalid node \"%s\" in the AWS list of items\n", cur->name);
-		}
-		return SDB_E_INVALID_META_RESPONSE;
+	// Initialize the parser
+	
+	struct sdb_response_parser p;
+	memset(&p, 0, sizeof(p));
+	p.response = response;
+	p.result = SDB_OK;
+	p.text_capacity = 256;
+	p.text = (char*) malloc(p.text_capacity);
+	
+	xmlSAXHandler handler;
+	memset(&handler, 0, sizeof(handler));
+	handler.initialized = XML_SAX2_MAGIC;
+	handler.startElementNs = sdb_response_start_element;
+	handler.endElementNs = sdb_response_end_element;
+	handler.characters = sdb_response_characters;
+	handler.cdataBlock = sdb_response_characters;
+	
+	p.context = xmlCreatePushParserCtxt(&handler, &p, NULL, 0, "response.xml");
+	if (p.context == NULL) {
+		free(p.text);
+		return SDB_E_INVALID_XML_RESPONSE;
 	}
 	
 	
-	// Allocate the memory if this is a new result set, otherwise prepare to append
-	
-	int start = 0;
-	
-	if (response->type == SDB_R_NONE) {
-		
-		response->size = size;
-		response->type = SDB_R_ITEM_LIST;
-		response->items = (struct sdb_item*) malloc(size * sizeof(struct sdb_item));  
-	}
-	else if (response->type == SDB_R_ITEM_LIST) {
-		
-		struct sdb_item* old = response->items;
-		int newsize = response->size + size;
-		start = response->size;
-		
-		response->items = (struct sdb_item*) malloc(newsize * sizeof(struct sdb_item));
-		memcpy(response->items, old, response->size * sizeof(struct sdb_item));
-		free(old);
-		
-		response->size = newsize;
-	}
-	else assert(0);
-	
+	// Parse the XML
 	
+	int r = xmlParseChunk(p.context, buffer, (int) length, 1);
+	if (p.result == SDB_OK && (r != 0 || !p.context->wellFormed)) p.result = SDB_E_INVALID_XML_RESPONSE;
 	
-	// Pull out the items 
 	
-	int index = start;
-	for (cur = items->children; cur != NULL; cur = cur->next) {
-		
-		
-		// Item name
-		
-		if (strcmp(cur->name, "ItemName") == 0) {
-			assert(cur->children != NULL);
-			content = cur->children;
-			response->items[index].name = XML_GET_CONTENT(content);
-			response->items[index].size = 0; 
-			response->items[index].attributes = NULL; 
-			assert(response->items[index].name != NULL);
-			index++;
-			continue;
-		}
-		
-		
-		// Item with attributes
-		
-		if (strcmp(cur->name, "Item") == 0) {
-			SDB_SAFE(sdb_response_parse_item(response, &response->items[index++], cur));
-		}
-	}
+	// Cleanup
 	
-	assert(index - start == size);
+	xmlFreeParserCtxt(p.context);
+	free(p.text);
 	
-	return SDB_OK;
+	return p.result;
 }
@@ -41,8 +41,16 @@
 extern "C" {
 #endif
 
-#include <libxml/parser.h>
-#include <libxml/tree.h>
+/**
+ * A block of strings copied from a response
+ */
+struct sdb_response_block
+{
+	struct sdb_response_block* next;
+	size_t size;
+	size_t capacity;
+	char data[1];
+};
 
 
 /**
@@ -50,9 +58,9 @@ extern "C" {
  */
 struct sdb_response_internal
 {
-	// The parse tree
+	// The strings the response points to
 	
-	xmlDocPtr doc;
+	struct sdb_response_block* strings;
 	
 	
 	// Errors
@@ -62,7 +70,7 @@ struct sdb_response_internal
 	
 	// Metadata
 	
-	xmlChar* next_token;
+	char* next_token;
 	
 	
 	// Special stuff
@@ -120,7 +128,7 @@ struct sdb_response_internal* sdb_response_internal_allocate(void);
 void sdb_response_print(FILE* f, struct sdb_response* r);
 
 /**
- * Parse the response
+ * Parse the response from the SAX events of the XML, without building a tree
  * 
  * @param response the response data structure
  * @param buffer the buffer to parse
@@ -129,70 +137,6 @@ void sdb_response_print(FILE* f, struct sdb_response* r);
  */
 int sdb_response_parse(struct sdb_response* response, const char* buffer, size_t length);
 
-/**
- * Parse the errors section of a response
- * 
- * @param response the response data structure (must be initalized)
- * @param errors the errors node
- * @return SDB_OK if no errors occurred
- */
-int sdb_response_parse_errors(struct sdb_response* response, xmlNodePtr errors);
-
-/**
- * Parse the metadata section of a response
- * 
- * @param response the response data structure (must be initalized)
- * @param metadata the metadata node
- * @return SDB_OK if no errors occurred
- */
-int sdb_response_parse_metadata(struct sdb_response* response, xmlNodePtr metadata);
-
-/**
- * Parse the list of domains
- * 
- * @param response the response data structure (must be initalized)
- * @param domains the list of domains
- * @return SDB_OK if no errors occurred
- */
-int sdb_response_parse_domains(struct sdb_response* response, xmlNodePtr domains);
-
-/**
- * Parse the domain metadata
- * 
- * @param response the response data structure (must be initalized)
- * @param domain_metadata the domain metadata
- * @return SDB_OK if no errors occurred
- */
-int sdb_response_parse_domain_metadata(struct sdb_response* response, xmlNodePtr domain_metadata);
-
-/**
- * Parse the list of attributes
- * 
- * @param response the response data structure (must be initalized)
- * @param attributes the list of attributes
- * @return SDB_OK if no errors occurred
- */
-int sdb_response_parse_attributes(struct sdb_response* response, xmlNodePtr attributes);
-
-/**
- * Parse a single item
- * 
- * @param response the response data structure
- * @param item the item data structure
- * @param node the item node
- * @return SDB_OK if no errors occurred
- */
-int sdb_response_parse_item(struct sdb_response* response, struct sdb_item* item, xmlNodePtr node);
-
-/**
- * Parse the list of items
- * 
- * @param response the response data structure (must be initalized)
- * @param items the list of items
- * @return SDB_OK if no errors occurred
- */
-int sdb_response_parse_items(struct sdb_response* response, xmlNodePtr items);
-
 #ifdef __cplusplus
 }
 #endif
@@ -72,6 +72,13 @@ int cleanUpPort(NSString* port);
 int restartWebApp(NSBundle* webApp, NSString* port, NSString* user);
 int consoleAttachForWebApp(NSBundle* webApp, NSString* port, NSString* user);
 
+/*
+	Compiles the web app's html, json and xml templates into Contents/Resources/CompiledTemplates.bin, so the app does not
+	parse them at runtime. Templates are compiled with the matcher the app is configured to use (froth_template_matcher), 
+	and the blocks of each template are checked, on any error nothing is written and 1 is returned.
+ */
+int compileTemplatesForWebApp(NSBundle* webApp);
+
 
 int main (int argc, const char * argv[]) {
 	NSInitializeProcess(argc, argv);
@@ -83,6 +90,7 @@ int main (int argc, const char * argv[]) {
 	}
 	
 	NSArray* args = [[NSProcessInfo processInfo] arguments];
+	int status = 0;
 	NSString* option = nil;
 	NSString* webAppName = nil;
 	NSString* webAppMode = @"release";
@@ -105,6 +113,7 @@ int main (int argc, const char * argv[]) {
 		printf("-s [WebAppName] [mode] stops a webapp\n");
 		printf("-o [WebAppName] [mode] launches a webapp with stout to terminal\n");
 		printf("-c Outputs lighttpd configurations for all 'Enabled' webapps on the system for use with lighttpd's 'include_shell' option\n");
+		printf("-t [WebAppName|path.webApp] [mode] compiles a webapp's templates into its resources, checking them for errors\n");
 	} 
 	
 	//We need to parse through all web apps installed to generate lighttpd configurations.
@@ -112,6 +121,23 @@ int main (int argc, const char * argv[]) {
 		generateConfigurations();
 	}
 	
+	//Can be run on a built bundle at any path, ie as a build phase.
+	else if([option isEqualToString:@"-t"]) {
+		NSBundle* webApp = nil;
+		if([webAppName hasSuffix:@".webApp"]) {
+			webApp = [NSBundle bundleWithPath:[webAppName stringByStandardizingPath]];
+		} else {
+			webApp = bundleForWebApp(webAppName, webAppMode, userName);
+		}
+		
+		if(!webApp) {
+			printf("No webapp found for [%s]\n", [webAppName UTF8String]);
+			status = 1;
+		} else {
+			status = compileTemplatesForWebApp(webApp);
+		}
+	}
+	
 	//Lastly
 	else {
 		NSBundle* webApp = bundleForWebApp(webAppName, webAppMode, userName);
@@ -180,7 +206,7 @@ int main (int argc, const char * argv[]) {
 	}
 
     [pool drain];
-    return 0;
+    return status;
 }
 
 NSBundle* bundleForWebApp(NSString* name, NSString* mode, NSString* user) {
@@ -324,6 +350,45 @@ void generateConfigurations() {
 	printf("\n\n");
 }
 
+int compileTemplatesForWebApp(NSBundle* webApp) {
+	NSString* resourcePath = [webApp resourcePath];
+	
+	NSMutableArray* paths = [NSMutableArray array];
+	for(NSString* file in [[NSFileManager defaultManager] directoryContentsAtPath:resourcePath]) {
+		if([WebTemplateRegistry isTemplateResource:file]) {
+			[paths addObject:[resourcePath stringByAppendingPathComponent:file]];
+		}
+	}
+	
+	//Use the same matcher as the webapp, the archive is ignored by an app using a different one.
+	NSString* matcherClassName = [[webApp infoDictionary] valueForKey:@"froth_template_matcher"];
+	if(matcherClassName) {
+		Class matcherClass = NSClassFromString(matcherClassName);
+		if(!matcherClass) {
+			printf("Unknown froth_template_matcher class [%s]\n", [matcherClassName UTF8String]);
+			return 1;
+		}
+		[WebTemplateEnginePool setMatcherClass:matcherClass];
+	}
+	
+	MGTemplateEngine* engine = [WebTemplateEnginePool checkoutEngine];
+	NSString* archivePath = [resourcePath stringByAppendingPathComponent:WebTemplateArchiveFileName];
+	NSMutableArray* errors = [NSMutableArray array];
+	
+	BOOL written = [WebTemplateRegistry writeArchiveOfTemplatesAtPaths:paths engine:engine toPath:archivePath errors:errors];
+	[WebTemplateEnginePool checkinEngine:engine];
+	
+	for(NSString* error in errors) {
+		printf("error: %s\n", [error UTF8String]);
+	}
+	if(!written) {
+		printf("+Templates not compiled\n\t [%s]\n", [archivePath UTF8String]);
+		return 1;
+	}
+	printf("+Compiled %d templates\n\t [%s]\n", (int)[paths count], [archivePath UTF8String]);
+	return 0;
+}
+
 void f_wait(double time) {
 	//Simple wait function f_wait(0.2)
 	NSTimeInterval startTime = [[NSDate date] timeIntervalSince1970];
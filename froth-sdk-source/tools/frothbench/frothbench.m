@@ -0,0 +1,327 @@
+//
+//  Copyright (c) 2009 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+/*
+	frothbench renders representative templates through MGTemplateEngine with synthetic data sets of increasing size,
+	and reports the time, Objective-C allocations and bytes output per render. Each template is run with every matcher 
+	and cache mode given, so they can be compared side by side.
+ 
+	Builds with frothbench.xcodeproj like fmtool, as a Foundation tool linked against Froth.framework. Time with the 
+	Release configuration, Debug is built without optimization.
+ 
+	useage: frothbench [-n 10,100,1000] [-m AGRegexTemplateMatcher,WKScanningTemplateMatcher] [-c interpreted,compiled,fragments] 
+					   [-t seconds per run] [-only template name]
+ */
+
+#import <Foundation/Foundation.h>
+#import <objc/runtime.h>
+#import <Froth/MGTemplateEngine.h>
+#import <Froth/MGCompiledTemplate.h>
+#import <Froth/WKFunctionMarkers.h>
+
+#import <stdio.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
+#define kDefaultSizes		@"10,100,1000"
+#define kDefaultMatchers	@"AGRegexTemplateMatcher,WKScanningTemplateMatcher"
+#define kDefaultModes		@"interpreted,compiled,fragments"
+#define kDefaultSeconds		0.5
+
+/*
+	Cache modes:
+	interpreted	- the matcher scans the template on every render
+	compiled	- the template is compiled once, as views do with the WebTemplateRegistry
+	fragments	- compiled, with a fragment cache so {% cache %} blocks render once
+ */
+#define kModeInterpreted	@"interpreted"
+#define kModeCompiled		@"compiled"
+#define kModeFragments		@"fragments"
+
+#pragma mark -
+#pragma mark Allocation Counting
+
+/* 
+	Counts objects allocated through +[NSObject allocWithZone:]. Classes that override it (ie class clusters placeholders)
+	are not counted, so the figure is a lower bound that is comparable between runs.
+ */
+static unsigned long long kAllocations = 0;
+static IMP kAllocWithZone = NULL;
+
+static id countingAllocWithZone(id self, SEL _cmd, NSZone* zone) {
+	kAllocations++;
+	return kAllocWithZone(self, _cmd, zone);
+}
+
+static void installAllocationCounter(void) {
+	Method method = class_getClassMethod([NSObject class], @selector(allocWithZone:));
+	kAllocWithZone = method_setImplementation(method, (IMP)countingAllocWithZone);
+}
+
+#pragma mark -
+#pragma mark Timing
+
+static double nanoseconds(void) {
+#ifdef __APPLE__
+	static mach_timebase_info_data_t timebase;
+	if(timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return (double)mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+#endif
+}
+
+#pragma mark -
+#pragma mark Fragment Cache
+
+/* An in process fragment cache, so the fragments mode measures rendering and not memcached. */
+@interface BenchFragmentCache : NSObject <MGTemplateFragmentCache> {
+	NSMutableDictionary* m_fragments;
+}
+- (void)removeAllFragments;
+@end
+
+@implementation BenchFragmentCache
+
+- (id)init {
+	if(self = [super init]) {
+		m_fragments = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[m_fragments release];
+	[super dealloc];
+}
+
+- (NSData*)fragmentForKey:(NSString*)key name:(NSString*)name {
+	return [m_fragments objectForKey:key];
+}
+
+- (void)setFragment:(NSData*)fragment forKey:(NSString*)key name:(NSString*)name lifetime:(NSTimeInterval)seconds {
+	[m_fragments setObject:fragment forKey:key];
+}
+
+- (void)removeAllFragments {
+	[m_fragments removeAllObjects];
+}
+
+@end
+
+#pragma mark -
+#pragma mark Templates
+
+/*
+	Each benchmark is a template rendered with the data set, layout benchmarks render the template and then the layout
+	with the result as TemplateResult, as WebLayoutView does.
+ */
+static NSArray* benchmarkTemplates(void) {
+	NSDictionary* loops = [NSDictionary dictionaryWithObjectsAndKeys:@"loops", @"name", 
+		@"<table>\n"
+		 "{% for row in rows %}<tr class=\"{% cycle \"odd\" \"even\" %}\">"
+		 "{% for tag in row.tags %}<td>{{ tag }}</td>{% /for %}"
+		 "<td>{{ row.name }}</td><td>{{ row.email }}</td><td>{{ currentLoop.currentIndex }}</td></tr>\n"
+		 "{% /for %}</table>\n", @"template", nil];
+	
+	NSDictionary* conditionals = [NSDictionary dictionaryWithObjectsAndKeys:@"conditionals", @"name", 
+		@"<ul>\n"
+		 "{% for row in rows %}<li>"
+		 "{% if row.active %}"
+			"{% if row.score > 50 %}<b>{{ row.name }}</b>"
+			"{% else %}{% if row.score > 20 %}<i>{{ row.name }}</i>{% else %}{{ row.name }}{% /if %}{% /if %}"
+		 "{% else %}-{% /if %}"
+		 "</li>\n{% /for %}</ul>\n", @"template", nil];
+	
+	NSDictionary* filters = [NSDictionary dictionaryWithObjectsAndKeys:@"filters", @"name", 
+		@"{% for row in rows %}"
+		 "{{ row.name | uppercase }} {{ row.email | lowercase }} {{ row.joined | date_format: \"dd MMM yyyy\" }} "
+		 "{{ row.name | string_is_equal: \"user 1\" }}\n"
+		 "{% /for %}", @"template", nil];
+	
+	NSDictionary* layout = [NSDictionary dictionaryWithObjectsAndKeys:@"layout", @"name", 
+		@"<div class=\"list\">{% for row in rows %}<p>{{ row.name }} <a href=\"mailto:{{ row.email }}\">{{ row.email }}</a></p>\n{% /for %}</div>", @"template", 
+		@"<html>\n<head><title>{{ title }}</title></head>\n<body>\n"
+		 "<div id=\"sidebar\">{% cache \"sidebar\" 300 %}{% for row in rows %}{% if row.active %}<span>{{ row.name | capitalized }}</span>{% /if %}{% /for %}{% /cache %}</div>\n"
+		 "<div id=\"content\">{{ TemplateResult }}</div>\n"
+		 "</body>\n</html>\n", @"layout", nil];
+	
+	return [NSArray arrayWithObjects:loops, conditionals, filters, layout, nil];
+}
+
+static NSDictionary* dataSetOfSize(int size) {
+	NSMutableArray* rows = [NSMutableArray arrayWithCapacity:size];
+	for(int i=0; i<size; i++) {
+		NSDictionary* row = [NSDictionary dictionaryWithObjectsAndKeys:
+							 froth_str(@"user %d", i), @"name",
+							 froth_str(@"User%d@Example.com", i), @"email",
+							 [NSNumber numberWithInt:(i * 37) % 100], @"score",
+							 [NSNumber numberWithBool:(i % 3 != 0)], @"active",
+							 [NSArray arrayWithObjects:@"alpha", froth_str(@"group %d", i % 7), @"omega", nil], @"tags",
+							 [NSDate dateWithTimeIntervalSince1970:1262304000 + i * 86400], @"joined",
+							 nil];
+		[rows addObject:row];
+	}
+	return [NSDictionary dictionaryWithObjectsAndKeys:rows, @"rows", @"Benchmark", @"title", nil];
+}
+
+#pragma mark -
+#pragma mark Running
+
+static MGTemplateEngine* newEngine(Class matcherClass) {
+	MGTemplateEngine* engine = [[MGTemplateEngine alloc] init];
+	[engine loadFilter:[[[WKValueComparisonFilters alloc] init] autorelease]];
+	[engine loadMarker:[[[WKFunctionMarkers alloc] initWithTemplateEngine:engine] autorelease]];
+	[engine setMatcher:[[[matcherClass alloc] initWithTemplateEngine:engine] autorelease]];
+	return engine;
+}
+
+/* Renders once, the action template and then the layout if there is one. Returns the bytes output. */
+static NSUInteger renderOnce(MGTemplateEngine* engine, NSDictionary* benchmark, MGCompiledTemplate* compiled, 
+							 MGCompiledTemplate* compiledLayout, NSDictionary* data) {
+	NSData* result = nil;
+	if(compiled) {
+		result = [engine processCompiledTemplateToUTF8Data:compiled withVariables:data];
+	} else {
+		result = [[engine processTemplate:[benchmark objectForKey:@"template"] withVariables:data] dataUsingEncoding:NSUTF8StringEncoding];
+	}
+	
+	NSString* layout = [benchmark objectForKey:@"layout"];
+	if(layout) {
+		NSMutableDictionary* layoutData = [NSMutableDictionary dictionaryWithDictionary:data];
+		[layoutData setObject:result forKey:@"TemplateResult"];
+		if(compiledLayout) {
+			result = [engine processCompiledTemplateToUTF8Data:compiledLayout withVariables:layoutData];
+		} else {
+			result = [[engine processTemplate:layout withVariables:layoutData] dataUsingEncoding:NSUTF8StringEncoding];
+		}
+	}
+	return [result length];
+}
+
+static void runBenchmark(NSDictionary* benchmark, int size, Class matcherClass, NSString* mode, double seconds) {
+	NSAutoreleasePool* setupPool = [[NSAutoreleasePool alloc] init];
+	NSDictionary* data = dataSetOfSize(size);
+	MGTemplateEngine* engine = newEngine(matcherClass);
+	
+	BenchFragmentCache* fragmentCache = nil;
+	if([mode isEqualToString:kModeFragments]) {
+		fragmentCache = [[[BenchFragmentCache alloc] init] autorelease];
+	}
+	[MGTemplateEngine setFragmentCache:fragmentCache];
+	
+	MGCompiledTemplate* compiled = nil;
+	MGCompiledTemplate* compiledLayout = nil;
+	if(![mode isEqualToString:kModeInterpreted]) {
+		compiled = [engine compileTemplate:[benchmark objectForKey:@"template"]];
+		if([benchmark objectForKey:@"layout"]) {
+			compiledLayout = [engine compileTemplate:[benchmark objectForKey:@"layout"]];
+		}
+	}
+	
+	//Warm up, and fills the fragment cache
+	NSUInteger bytes = 0;
+	for(int i=0; i<3; i++) {
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		bytes = renderOnce(engine, benchmark, compiled, compiledLayout, data);
+		[pool drain];
+	}
+	
+	unsigned long long renders = 0;
+	unsigned long long allocations = kAllocations;
+	double start = nanoseconds();
+	double elapsed = 0;
+	do {
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		renderOnce(engine, benchmark, compiled, compiledLayout, data);
+		[pool drain];
+		renders++;
+		elapsed = nanoseconds() - start;
+	} while(elapsed < seconds * 1e9);
+	allocations = kAllocations - allocations;
+	
+	printf("%-14s %7d  %-28s %-12s %14.0f %14.1f %12lu\n", 
+		   [[benchmark objectForKey:@"name"] UTF8String], size, 
+		   [NSStringFromClass(matcherClass) UTF8String], [mode UTF8String], 
+		   elapsed / renders, (double)allocations / renders, (unsigned long)bytes);
+	
+	[MGTemplateEngine setFragmentCache:nil];
+	[engine release];
+	[setupPool drain];
+}
+
+static NSArray* listOption(NSArray* args, NSString* option, NSString* defaultValue) {
+	NSUInteger index = [args indexOfObject:option];
+	NSString* value = (index != NSNotFound && index + 1 < [args count]) ? [args objectAtIndex:index + 1] : defaultValue;
+	return (value) ? [value componentsSeparatedByString:@","] : nil;
+}
+
+int main (int argc, const char * argv[]) {
+	NSInitializeProcess(argc, argv);
+	NSAutoreleasePool * pool = [[NSAutoreleasePool alloc] init];
+	
+	NSArray* args = [[NSProcessInfo processInfo] arguments];
+	if([args containsObject:@"-h"]) {
+		printf("frothbench [-n 10,100,1000] [-m matcher,...] [-c interpreted,compiled,fragments] [-t seconds] [-only template]\n");
+		printf("templates: loops conditionals filters layout\n");
+		[pool drain];
+		return 0;
+	}
+	
+	NSArray* sizes = listOption(args, @"-n", kDefaultSizes);
+	NSArray* matchers = listOption(args, @"-m", kDefaultMatchers);
+	NSArray* modes = listOption(args, @"-c", kDefaultModes);
+	NSArray* only = listOption(args, @"-only", nil);
+	double seconds = [[listOption(args, @"-t", froth_str(@"%f", kDefaultSeconds)) lastObject] doubleValue];
+	
+	installAllocationCounter();
+	
+	printf("%-14s %7s  %-28s %-12s %14s %14s %12s\n", "template", "rows", "matcher", "mode", "ns/render", "allocs/render", "bytes");
+	for(NSDictionary* benchmark in benchmarkTemplates()) {
+		if(only && ![only containsObject:[benchmark objectForKey:@"name"]]) continue;
+		
+		for(NSString* size in sizes) {
+			for(NSString* matcherName in matchers) {
+				Class matcherClass = NSClassFromString(matcherName);
+				if(!matcherClass) {
+					printf("Unknown matcher class [%s]\n", [matcherName UTF8String]);
+					continue;
+				}
+				for(NSString* mode in modes) {
+					runBenchmark(benchmark, [size intValue], matcherClass, mode, seconds);
+				}
+			}
+		}
+		printf("\n");
+	}
+	
+	[pool drain];
+	return 0;
+}
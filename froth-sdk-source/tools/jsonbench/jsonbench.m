@@ -0,0 +1,467 @@
+//
+//  Copyright (c) 2009 Thinking Code Software Inc. http://www.thinkingcode.ca
+//
+//	Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//	files (the "Software"), to deal in the Software without
+//	restriction, including without limitation the rights to use,
+//	copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following
+//	conditions:
+
+//	The above copyright notice and this permission notice shall be
+//	included in all copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//	OTHER DEALINGS IN THE SOFTWARE.
+
+/*
+	jsonbench times the JSON parsers and writers over a synthetic corpus: small API payloads, large arrays of records, 
+	deep nesting and strings heavy with unicode escapes. For each it reports MB/s, Objective-C allocations per operation 
+	and the process's peak resident memory after the run. It then checks each engine's output, decoding in whole and 
+	in small chunks, round tripping the writers, and inputs every parser must accept or reject. It exits with 1 if a 
+	WK engine fails a check, SBJson results are shown for comparison only.
+ 
+	Builds with jsonbench.xcodeproj like fmtool, as a Foundation tool linked against Froth.framework. Time with the 
+	Release configuration, Debug is built without optimization.
+ 
+	useage: jsonbench [-n records in the large array] [-t seconds per run] [-only document name] [-check]
+ */
+
+#import <Foundation/Foundation.h>
+#import <objc/runtime.h>
+#import <Froth/SBJsonParser.h>
+#import <Froth/SBJsonWriter.h>
+#import <Froth/WKJsonParser.h>
+#import <Froth/WKJsonStreamParser.h>
+#import <Froth/WKJsonWriter.h>
+
+#import <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
+#define kDefaultRecords		10000
+#define kDefaultSeconds		0.5
+#define kDeepNesting		256
+#define kStreamChunkSize	65536
+
+#pragma mark -
+#pragma mark Allocation Counting
+
+/* Counts objects allocated through +[NSObject allocWithZone:], a lower bound that is comparable between runs. */
+static unsigned long long kAllocations = 0;
+static IMP kAllocWithZone = NULL;
+
+static id countingAllocWithZone(id self, SEL _cmd, NSZone* zone) {
+	kAllocations++;
+	return kAllocWithZone(self, _cmd, zone);
+}
+
+static void installAllocationCounter(void) {
+	Method method = class_getClassMethod([NSObject class], @selector(allocWithZone:));
+	kAllocWithZone = method_setImplementation(method, (IMP)countingAllocWithZone);
+}
+
+#pragma mark -
+#pragma mark Timing and Memory
+
+static double nanoseconds(void) {
+#ifdef __APPLE__
+	static mach_timebase_info_data_t timebase;
+	if(timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return (double)mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+#endif
+}
+
+/* The process's resident high water mark in KB, run one document with -only to see its own peak. */
+static long peakMemoryKB(void) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+#pragma mark -
+#pragma mark Corpus
+
+static NSDictionary* record(int i) {
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithInt:i], @"id",
+			[NSString stringWithFormat:@"User Number %d", i], @"name",
+			[NSString stringWithFormat:@"user%d@example.com", i], @"email",
+			[NSNumber numberWithBool:(i % 2 == 0)], @"active",
+			[NSDecimalNumber decimalNumberWithString:[NSString stringWithFormat:@"%d.%d", i % 100, i % 10]], @"score",
+			[NSNumber numberWithLongLong:1262304000000LL + i], @"created",
+			[NSNull null], @"deleted",
+			[NSArray arrayWithObjects:@"alpha", @"beta", [NSString stringWithFormat:@"group %d", i % 7], nil], @"tags",
+			[NSDictionary dictionaryWithObjectsAndKeys:@"123 Main Street", @"street", @"Vancouver", @"city", @"V6B 1A1", @"postal", nil], @"address",
+			nil];
+}
+
+/* Text from SBJsonWriter, the records are ascii so its output is correct */
+static NSData* writeReference(id object) {
+	SBJsonWriter* writer = [[SBJsonWriter alloc] init];
+	writer.humanReadable = NO;
+	NSData* data = [[writer stringWithObject:object] dataUsingEncoding:NSUTF8StringEncoding];
+	[writer release];
+	return data;
+}
+
+static NSDictionary* documentNamed(NSString* name, NSData* json, id expected) {
+	return [NSDictionary dictionaryWithObjectsAndKeys:name, @"name", json, @"json", expected, @"expected", nil];
+}
+
+static NSArray* corpus(int records) {
+	NSMutableArray* documents = [NSMutableArray array];
+	
+	NSDictionary* small = [NSDictionary dictionaryWithObjectsAndKeys:record(1), @"user", @"ok", @"status", 
+						   [NSArray arrayWithObjects:record(2), record(3), nil], @"friends", nil];
+	[documents addObject:documentNamed(@"small", writeReference(small), small)];
+	
+	NSMutableArray* large = [NSMutableArray arrayWithCapacity:records];
+	for(int i=0; i<records; i++) {
+		[large addObject:record(i)];
+	}
+	[documents addObject:documentNamed(@"large", writeReference(large), large)];
+	
+	//Alternating objects and arrays, kDeepNesting levels down
+	NSMutableString* deepJson = [NSMutableString string];
+	id deep = [NSNumber numberWithInt:1];
+	for(int i=0; i<kDeepNesting; i++) {
+		[deepJson appendString:(i % 2) ? @"[" : @"{\"level\":"];
+	}
+	[deepJson appendString:@"1"];
+	for(int i=kDeepNesting - 1; i>=0; i--) {
+		[deepJson appendString:(i % 2) ? @"]" : @"}"];
+		deep = (i % 2) ? (id)[NSArray arrayWithObject:deep] : (id)[NSDictionary dictionaryWithObject:deep forKey:@"level"];
+	}
+	[documents addObject:documentNamed(@"deep", [deepJson dataUsingEncoding:NSUTF8StringEncoding], deep)];
+	
+	//Escaped and raw multi byte characters, with a surrogate pair
+	NSString* escapedString = @"\"caf\\u00e9 \\u4e2d\\u6587 \\ud83d\\ude00 na\xc3\xafve \xe6\x97\xa5\xe6\x9c\xac \\\"quoted\\\" \\\\ \\/ \\n\\t\"";
+	NSString* decodedString = [NSString stringWithUTF8String:"caf\xc3\xa9 \xe4\xb8\xad\xe6\x96\x87 \xf0\x9f\x98\x80 na\xc3\xafve \xe6\x97\xa5\xe6\x9c\xac \"quoted\" \\ / \n\t"];
+	NSMutableString* unicodeJson = [NSMutableString stringWithString:@"["];
+	NSMutableArray* unicode = [NSMutableArray array];
+	for(int i=0; i<2000; i++) {
+		[unicodeJson appendFormat:@"%@%@", (i) ? @"," : @"", escapedString];
+		[unicode addObject:decodedString];
+	}
+	[unicodeJson appendString:@"]"];
+	[documents addObject:documentNamed(@"unicode", [unicodeJson dataUsingEncoding:NSUTF8StringEncoding], unicode)];
+	
+	return documents;
+}
+
+#pragma mark -
+#pragma mark Engines
+
+typedef id (*DecodeFunction)(NSData* json);
+typedef NSData* (*EncodeFunction)(id object);
+
+/* As WebRequest decoded bodies before WKJsonParser, to a string first */
+static id decodeSBJson(NSData* json) {
+	SBJsonParser* parser = [[SBJsonParser alloc] init];
+	NSString* string = [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding];
+	id object = [parser objectWithString:string];
+	[string release];
+	[parser release];
+	return object;
+}
+
+static id decodeWKJson(NSData* json) {
+	WKJsonParser* parser = [[WKJsonParser alloc] init];
+	id object = [parser objectWithData:json];
+	[parser release];
+	return object;
+}
+
+/* Tokenizing only, no delegate */
+static id decodeWKStreamEvents(NSData* json) {
+	WKJsonStreamParser* parser = [[WKJsonStreamParser alloc] init];
+	const char* bytes = [json bytes];
+	NSUInteger length = [json length];
+	BOOL parsed = YES;
+	for(NSUInteger offset=0; parsed && offset<length; offset+=kStreamChunkSize) {
+		parsed = [parser parseBytes:bytes + offset length:MIN(kStreamChunkSize, length - offset)];
+	}
+	parsed = parsed && [parser finish];
+	[parser release];
+	return (parsed) ? [NSNull null] : nil;
+}
+
+static id readArrayInChunks(NSData* json, NSUInteger chunkSize) {
+	WKJsonArrayReader* reader = [[WKJsonArrayReader alloc] init];
+	NSMutableArray* elements = [NSMutableArray array];
+	const char* bytes = [json bytes];
+	NSUInteger length = [json length];
+	BOOL parsed = YES;
+	for(NSUInteger offset=0; parsed && offset<length; offset+=chunkSize) {
+		parsed = [reader parseBytes:bytes + offset length:MIN(chunkSize, length - offset)];
+		id element;
+		while(element = [reader nextElement]) {
+			[elements addObject:element];
+		}
+	}
+	parsed = parsed && [reader finish];
+	[reader release];
+	return (parsed) ? elements : nil;
+}
+
+static id decodeWKArrayReader(NSData* json) {
+	return readArrayInChunks(json, kStreamChunkSize);
+}
+
+static NSData* encodeSBJson(id object) {
+	SBJsonWriter* writer = [[SBJsonWriter alloc] init];
+	writer.humanReadable = NO;
+	NSData* data = [[writer stringWithObject:object] dataUsingEncoding:NSUTF8StringEncoding];
+	[writer release];
+	return data;
+}
+
+static NSData* encodeWKJson(id object) {
+	WKJsonWriter* writer = [[WKJsonWriter alloc] init];
+	NSData* data = [writer dataWithObject:object];
+	[writer release];
+	return data;
+}
+
+typedef struct {
+	const char* name;
+	DecodeFunction decode;
+	BOOL arraysOnly;		// Top level arrays only
+	BOOL checked;			// Output is a Foundation object to compare
+	BOOL reference;			// Failures are reported but do not fail the run
+} Decoder;
+
+typedef struct {
+	const char* name;
+	EncodeFunction encode;
+	BOOL reference;
+} Encoder;
+
+static Decoder kDecoders[] = {
+	{ "SBJsonParser",			decodeSBJson,			NO,		YES,	YES },
+	{ "WKJsonParser",			decodeWKJson,			NO,		YES,	NO },
+	{ "WKJsonStreamParser",		decodeWKStreamEvents,	NO,		NO,		NO },
+	{ "WKJsonArrayReader",		decodeWKArrayReader,	YES,	YES,	NO },
+};
+
+static Encoder kEncoders[] = {
+	{ "SBJsonWriter",			encodeSBJson,			YES },
+	{ "WKJsonWriter",			encodeWKJson,			NO },
+};
+
+#define kDecoderCount (sizeof(kDecoders) / sizeof(Decoder))
+#define kEncoderCount (sizeof(kEncoders) / sizeof(Encoder))
+
+#pragma mark -
+#pragma mark Benchmarks
+
+static void printResult(const char* engine, NSString* document, const char* operation, double elapsed, 
+						unsigned long long operations, unsigned long long allocations, NSUInteger bytes) {
+	double seconds = elapsed / 1e9;
+	printf("%-20s %-9s %-7s %10.1f %14.1f %12lu %10ld\n", engine, [document UTF8String], operation, 
+		   ((double)bytes * operations / (1024.0 * 1024.0)) / seconds, (double)allocations / operations, 
+		   (unsigned long)bytes, peakMemoryKB());
+}
+
+static void benchmarkDecoder(Decoder* decoder, NSDictionary* document, double seconds) {
+	NSData* json = [document objectForKey:@"json"];
+	unsigned long long operations = 0;
+	unsigned long long allocations = kAllocations;
+	double start = nanoseconds();
+	double elapsed = 0;
+	do {
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		decoder->decode(json);
+		[pool drain];
+		operations++;
+		elapsed = nanoseconds() - start;
+	} while(elapsed < seconds * 1e9);
+	printResult(decoder->name, [document objectForKey:@"name"], "decode", elapsed, operations, kAllocations - allocations, [json length]);
+}
+
+static void benchmarkEncoder(Encoder* encoder, NSDictionary* document, double seconds) {
+	id object = [document objectForKey:@"expected"];
+	NSUInteger bytes = [encoder->encode(object) length];
+	unsigned long long operations = 0;
+	unsigned long long allocations = kAllocations;
+	double start = nanoseconds();
+	double elapsed = 0;
+	do {
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		encoder->encode(object);
+		[pool drain];
+		operations++;
+		elapsed = nanoseconds() - start;
+	} while(elapsed < seconds * 1e9);
+	printResult(encoder->name, [document objectForKey:@"name"], "encode", elapsed, operations, kAllocations - allocations, bytes);
+}
+
+#pragma mark -
+#pragma mark Conformance
+
+static int kFailures = 0;
+
+static void report(const char* engine, BOOL reference, NSString* check, BOOL passed) {
+	if(!passed && !reference) {
+		kFailures++;
+	}
+	printf("%-20s %-40s %s\n", engine, [check UTF8String], (passed) ? "ok" : (reference) ? "MISMATCH (reference)" : "FAILED");
+}
+
+static void checkDocument(NSDictionary* document) {
+	NSString* name = [document objectForKey:@"name"];
+	NSData* json = [document objectForKey:@"json"];
+	id expected = [document objectForKey:@"expected"];
+	BOOL isArray = [expected isKindOfClass:[NSArray class]];
+	
+	for(NSUInteger i=0; i<kDecoderCount; i++) {
+		Decoder* decoder = &kDecoders[i];
+		if(decoder->arraysOnly && !isArray) continue;
+		
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		id decoded = decoder->decode(json);
+		BOOL passed = (decoder->checked) ? [decoded isEqual:expected] : (decoded != nil);
+		report(decoder->name, decoder->reference, [NSString stringWithFormat:@"decode %@", name], passed);
+		[pool drain];
+	}
+	
+	//Tokens split at every position
+	if(isArray) {
+		NSUInteger chunkSizes[] = { 1, 7, 4093 };
+		for(int i=0; i<3; i++) {
+			if(chunkSizes[i] == 1 && [json length] > 1024 * 1024) continue;
+			NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+			BOOL passed = [readArrayInChunks(json, chunkSizes[i]) isEqual:expected];
+			report("WKJsonArrayReader", NO, [NSString stringWithFormat:@"decode %@ in %lu byte chunks", name, (unsigned long)chunkSizes[i]], passed);
+			[pool drain];
+		}
+	}
+	
+	for(NSUInteger i=0; i<kEncoderCount; i++) {
+		Encoder* encoder = &kEncoders[i];
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		BOOL passed = [decodeWKJson(encoder->encode(expected)) isEqual:expected];
+		report(encoder->name, encoder->reference, [NSString stringWithFormat:@"round trip %@", name], passed);
+		[pool drain];
+	}
+}
+
+static void checkInputs(void) {
+	const char* accepted[] = {
+		"[]", "{}", " \t\r\n[ ] ", "[0,-0,1e10,1.5E-3,-12,123456789012345678901234567890]", 
+		"[\" \\/ \\b\\f\\n\\r\\t\\u0041\"]", "[[[[{}]]]]", "{\"a\":{\"b\":[true,false,null]}}", "[\"\xe2\x82\xac\"]", NULL
+	};
+	const char* rejected[] = {
+		"[1,]", "{\"a\":1,}", "[01]", "[1 2]", "{\"a\" 1}", "{1:2}", "[+1]", "[1.]", "[1e]", "[-]", 
+		"[\"\\x\"]", "[\"abc", "[1] x", "[\"\\ud800\"]", "[\"a\\u00\"]", "[tru]", "[\"a\tb\"]", "[\"\xff\"]", "", "1", NULL
+	};
+	
+	for(NSUInteger i=0; i<kDecoderCount; i++) {
+		Decoder* decoder = &kDecoders[i];
+		int failed = 0;
+		NSMutableArray* failures = [NSMutableArray array];
+		
+		for(int j=0; accepted[j]; j++) {
+			NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+			if(!decoder->arraysOnly || accepted[j][strspn(accepted[j], " \t\r\n")] == '[') {
+				if(!decoder->decode([NSData dataWithBytes:accepted[j] length:strlen(accepted[j])])) {
+					[failures addObject:[NSString stringWithFormat:@"accept %s", accepted[j]]];
+					failed++;
+				}
+			}
+			[pool drain];
+		}
+		for(int j=0; rejected[j]; j++) {
+			NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+			//The stream parser accepts fragments, it is only checked on arrays and objects
+			if(decoder->decode != decodeWKStreamEvents || rejected[j][0] == '[' || rejected[j][0] == '{') {
+				if(decoder->decode([NSData dataWithBytes:rejected[j] length:strlen(rejected[j])])) {
+					[failures addObject:[NSString stringWithFormat:@"reject %s", rejected[j]]];
+					failed++;
+				}
+			}
+			[pool drain];
+		}
+		
+		report(decoder->name, decoder->reference, @"accepts and rejects inputs", failed == 0);
+		for(NSString* failure in failures) {
+			printf("    %s\n", [failure UTF8String]);
+		}
+	}
+}
+
+#pragma mark -
+
+static NSString* option(NSArray* args, NSString* name) {
+	NSUInteger index = [args indexOfObject:name];
+	return (index != NSNotFound && index + 1 < [args count]) ? [args objectAtIndex:index + 1] : nil;
+}
+
+int main (int argc, const char * argv[]) {
+	NSInitializeProcess(argc, argv);
+	NSAutoreleasePool * pool = [[NSAutoreleasePool alloc] init];
+	
+	NSArray* args = [[NSProcessInfo processInfo] arguments];
+	if([args containsObject:@"-h"]) {
+		printf("jsonbench [-n records] [-t seconds] [-only small|large|deep|unicode] [-check]\n");
+		[pool drain];
+		return 0;
+	}
+	
+	int records = (option(args, @"-n")) ? [option(args, @"-n") intValue] : kDefaultRecords;
+	double seconds = (option(args, @"-t")) ? [option(args, @"-t") doubleValue] : kDefaultSeconds;
+	NSString* only = option(args, @"-only");
+	BOOL checkOnly = [args containsObject:@"-check"];
+	
+	NSArray* documents = corpus(records);
+	installAllocationCounter();
+	
+	if(!checkOnly) {
+		printf("%-20s %-9s %-7s %10s %14s %12s %10s\n", "engine", "document", "op", "MB/s", "allocs/op", "bytes", "peak KB");
+		for(NSDictionary* document in documents) {
+			if(only && ![only isEqualToString:[document objectForKey:@"name"]]) continue;
+			BOOL isArray = [[document objectForKey:@"expected"] isKindOfClass:[NSArray class]];
+			
+			for(NSUInteger i=0; i<kDecoderCount; i++) {
+				if(kDecoders[i].arraysOnly && !isArray) continue;
+				benchmarkDecoder(&kDecoders[i], document, seconds);
+			}
+			for(NSUInteger i=0; i<kEncoderCount; i++) {
+				benchmarkEncoder(&kEncoders[i], document, seconds);
+			}
+			printf("\n");
+		}
+	}
+	
+	for(NSDictionary* document in documents) {
+		if(only && ![only isEqualToString:[document objectForKey:@"name"]]) continue;
+		checkDocument(document);
+	}
+	checkInputs();
+	
+	printf("\n%d failure%s\n", kFailures, (kFailures == 1) ? "" : "s");
+	[pool drain];
+	return (kFailures) ? 1 : 0;
+}